@@ -0,0 +1,1587 @@
+// Headless benchmarks for engine hot paths, doesn't create a window
+// or GL context so it can run on CI machines.
+//
+// usage: grend-bench [--format json|csv] [--output file] [--filter substring]
+//                    [--warmup N] [--reps N] [--scale factor] [--list]
+#include <grend/ecs/ecs.hpp>
+#include <grend/sceneNode.hpp>
+#include <grend/sceneModel.hpp>
+#include <grend/compiledModel.hpp>
+#include <grend/renderQueue.hpp>
+#include <grend/animation.hpp>
+#include <grend/bufferAllocator.hpp>
+#include <grend/quadtree.hpp>
+#include <grend/audioMixer.hpp>
+#include <grend/contactStream.hpp>
+#include <grend/camera.hpp>
+#include <grend/profile.hpp>
+#include <grend/logger.hpp>
+#include <grend/shaderCache.hpp>
+#include <grend/objParser.hpp>
+#include <grend/meshOptimizer.hpp>
+#include <grend/occlusionBuffer.hpp>
+#include <grend/probeScheduler.hpp>
+#include <grend/terrain.hpp>
+#include <grend/jobQueue.hpp>
+#include <grend/ecs/voxelVolume.hpp>
+#include <grend/particleSystem.hpp>
+#include <grend/raycast.hpp>
+#include <grend/ecs/bufferComponent.hpp>
+#include <grend/textureCache.hpp>
+#include <grend/prefab.hpp>
+#include <grend/ecs/entityList.hpp>
+#include <grend/replication.hpp>
+#include <grend/utility.hpp>
+#include <grend-config.h>
+#if defined(PHYSICS_BULLET)
+#include <grend/bulletPhysics.hpp>
+#endif
+#include <stb/stb_image_write.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace grendx;
+
+struct benchOptions {
+	enum format {
+		JSON,
+		CSV,
+	} format = format::JSON;
+
+	std::string output = "";
+	std::string filter = "";
+	unsigned warmup = 3;
+	unsigned reps   = 10;
+	float    scale  = 1.0;
+	bool     list   = false;
+};
+
+struct benchResult {
+	std::string name;
+	// number of work items per repetition, for per-item timings
+	size_t items;
+	// nanoseconds per repetition
+	std::vector<double> samples;
+
+	double min(void)    const { return *std::min_element(samples.begin(), samples.end()); }
+	double max(void)    const { return *std::max_element(samples.begin(), samples.end()); }
+	double mean(void)   const {
+		double sum = 0;
+		for (double s : samples) sum += s;
+		return sum / samples.size();
+	}
+
+	double median(void) const {
+		std::vector<double> sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		size_t n = sorted.size();
+		return (n & 1)? sorted[n/2] : (sorted[n/2 - 1] + sorted[n/2]) * 0.5;
+	}
+
+	double stddev(void) const {
+		double m = mean(), sum = 0;
+		for (double s : samples) sum += (s - m)*(s - m);
+		return sqrt(sum / samples.size());
+	}
+};
+
+// results are written here so the optimizer can't drop benchmark bodies
+static volatile size_t sink = 0;
+
+class benchSuite {
+	public:
+		benchSuite(const benchOptions& opts) : options(opts) {}
+
+		size_t scaled(size_t n) const {
+			return std::max<size_t>(1, n * options.scale);
+		}
+
+		bool enabled(const std::string& name) const {
+			return options.filter.empty()
+			    || name.find(options.filter) != std::string::npos;
+		}
+
+		// reset() runs untimed before each repetition, body() is timed
+		void run(const std::string& name,
+		         size_t items,
+		         std::function<void()> reset,
+		         std::function<size_t()> body)
+		{
+			if (!enabled(name)) {
+				return;
+			}
+
+			if (options.list) {
+				puts(name.c_str());
+				return;
+			}
+
+			benchResult res = { .name = name, .items = items };
+			fprintf(stderr, "running %s (%zu items)...\n", name.c_str(), items);
+
+			for (unsigned i = 0; i < options.warmup + options.reps; i++) {
+				if (reset) reset();
+
+				uint64_t start = profile::now();
+				sink = sink + body();
+				uint64_t end = profile::now();
+
+				if (i >= options.warmup) {
+					res.samples.push_back(end - start);
+				}
+			}
+
+			results.push_back(res);
+		}
+
+		void run(const std::string& name,
+		         size_t items,
+		         std::function<size_t()> body)
+		{
+			run(name, items, nullptr, body);
+		}
+
+		void write(FILE *fp) const {
+			if (options.format == benchOptions::format::CSV) {
+				fprintf(fp, "name,items,reps,min_ns,median_ns,mean_ns,max_ns,stddev_ns,ns_per_item\n");
+
+				for (auto& r : results) {
+					fprintf(fp, "%s,%zu,%zu,%.0f,%.0f,%.0f,%.0f,%.0f,%.3f\n",
+					        r.name.c_str(), r.items, r.samples.size(),
+					        r.min(), r.median(), r.mean(), r.max(),
+					        r.stddev(), r.median() / r.items);
+				}
+
+				return;
+			}
+
+			fprintf(fp, "{\n");
+			fprintf(fp, "\t\"warmup\": %u,\n", options.warmup);
+			fprintf(fp, "\t\"repetitions\": %u,\n", options.reps);
+			fprintf(fp, "\t\"scale\": %g,\n", options.scale);
+			fprintf(fp, "\t\"results\": [");
+
+			for (size_t i = 0; i < results.size(); i++) {
+				auto& r = results[i];
+
+				fprintf(fp, "%s\n\t\t{\"name\": \"%s\", \"items\": %zu, "
+				            "\"min_ns\": %.0f, \"median_ns\": %.0f, "
+				            "\"mean_ns\": %.0f, \"max_ns\": %.0f, "
+				            "\"stddev_ns\": %.0f, \"ns_per_item\": %.3f}",
+				        (i > 0)? "," : "",
+				        r.name.c_str(), r.items,
+				        r.min(), r.median(), r.mean(), r.max(),
+				        r.stddev(), r.median() / r.items);
+			}
+
+			fprintf(fp, "\n\t]\n}\n");
+		}
+
+		benchOptions options;
+		std::vector<benchResult> results;
+};
+
+// components used to populate synthetic worlds
+struct benchPosition : public ecs::component {
+	benchPosition(ecs::regArgs t) : ecs::component(ecs::doRegister(this, t)) {}
+	virtual ~benchPosition() {}
+	glm::vec3 position = glm::vec3(0);
+};
+
+struct benchVelocity : public ecs::component {
+	benchVelocity(ecs::regArgs t) : ecs::component(ecs::doRegister(this, t)) {}
+	virtual ~benchVelocity() {}
+	glm::vec3 velocity = glm::vec3(1);
+};
+
+struct benchTag : public ecs::component {
+	benchTag(ecs::regArgs t) : ecs::component(ecs::doRegister(this, t)) {}
+	virtual ~benchTag() {}
+};
+
+static void benchECS(benchSuite& suite) {
+	ecs::entityManager manager;
+	size_t count = suite.scaled(10000);
+
+	for (size_t i = 0; i < count; i++) {
+		auto ent = manager.construct<ecs::entity>();
+		ent->attach<benchPosition>();
+
+		// half of the entities are moving, a tenth are tagged
+		if (i % 2 == 0) ent->attach<benchVelocity>();
+		if (i % 10 == 0) ent->attach<benchTag>();
+	}
+
+	suite.run("ecs.search.1", count, [&] {
+		size_t n = 0;
+		for (auto [ent, pos] : manager.search<benchPosition>()) {
+			n += (pos != nullptr);
+		}
+		return n;
+	});
+
+	suite.run("ecs.search.2", count, [&] {
+		size_t n = 0;
+		for (auto [ent, pos, vel] : manager.search<benchPosition, benchVelocity>()) {
+			pos->position += vel->velocity;
+			n++;
+		}
+		return n;
+	});
+
+	suite.run("ecs.search.3", count, [&] {
+		size_t n = 0;
+		for (auto [ent, pos, vel, tag]
+		     : manager.search<benchPosition, benchVelocity, benchTag>())
+		{
+			n += (tag != nullptr);
+		}
+		return n;
+	});
+
+	suite.run("ecs.get", count, [&] {
+		size_t n = 0;
+		for (auto ent : manager.entities) {
+			n += ent->get<benchVelocity>() != nullptr;
+		}
+		return n;
+	});
+}
+
+struct benchScene {
+	sceneNode::ptr root;
+	size_t meshes = 0;
+	size_t lights = 0;
+	size_t probes = 0;
+};
+
+// grid of meshes with lights and probes scattered through it, meshes
+// have a fake compiled mesh so they're queued without any GL objects
+static benchScene buildScene(ecs::entityManager& manager,
+                             size_t meshes, size_t lights, size_t probes)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> pos(-200.f, 200.f);
+
+	benchScene ret;
+	ret.root = manager.construct<sceneNode>();
+
+	auto opaque = std::make_shared<compiledMesh>();
+	auto blend  = std::make_shared<compiledMesh>();
+	opaque->blend = material::blend_mode::Opaque;
+	blend->blend  = material::blend_mode::Blend;
+	// LOD chain as generated by sceneModel::optimizeMeshes()
+	opaque->lods  = {{0, 3000, 0.f}, {3000, 1500, 0.01f}, {4500, 750, 0.03f}, {5250, 375, 0.08f}};
+
+	// group meshes into models of 8 to get some tree depth
+	sceneNode::ptr model;
+	for (size_t i = 0; i < meshes; i++) {
+		if (i % 8 == 0) {
+			model = manager.construct<sceneNode>();
+			model->transform.setPosition({pos(rng), pos(rng)*0.1f, pos(rng)});
+			setNode("model" + std::to_string(i), ret.root, model);
+		}
+
+		sceneMesh::ptr mesh = manager.construct<sceneMesh>();
+		mesh->comped_mesh    = (i % 16 == 0)? blend : opaque;
+		mesh->boundingBox    = {glm::vec3(-1), glm::vec3(1)};
+		mesh->boundingSphere = {glm::vec3(0), 1.7f};
+		mesh->transform.setPosition({(i%8)*2.f, 0, 0});
+		setNode("mesh" + std::to_string(i), model, mesh);
+	}
+
+	for (size_t i = 0; i < lights; i++) {
+		sceneLightPoint::ptr light = manager.construct<sceneLightPoint>();
+		light->transform.setPosition({pos(rng), pos(rng)*0.1f, pos(rng)});
+		setNode("light" + std::to_string(i), ret.root, light);
+	}
+
+	for (size_t i = 0; i < probes; i++) {
+		sceneReflectionProbe::ptr probe = manager.construct<sceneReflectionProbe>();
+		probe->transform.setPosition({pos(rng), pos(rng)*0.1f, pos(rng)});
+		setNode("probe" + std::to_string(i), ret.root, probe);
+	}
+
+	ret.meshes = meshes;
+	ret.lights = lights;
+	ret.probes = probes;
+	return ret;
+}
+
+static void benchRenderQueue(benchSuite& suite) {
+	ecs::entityManager manager;
+	auto scene = buildScene(manager,
+	                        suite.scaled(5000),
+	                        suite.scaled(256),
+	                        suite.scaled(32));
+
+	auto cam = std::make_shared<camera>();
+	cam->setViewport(1280, 720);
+	cam->setPosition({0, 10, 0});
+	cam->setDirection({0.7, 0, 0.7}, {0, 1, 0});
+	cam->setFar(150.f);
+
+	renderQueue que;
+	renderQueue full;
+	full.add(scene.root);
+
+	suite.run("renderQueue.add", scene.meshes + scene.lights + scene.probes,
+		[&] { que.clear(); },
+		[&] {
+			que.add(scene.root);
+			return que.meshes.size();
+		});
+
+	suite.run("renderQueue.cull", scene.meshes + scene.lights,
+		[&] { que = full; },
+		[&] {
+			cullQueue(que, cam, 1280, 720, 0.03);
+			return que.meshes.size() + que.lights.size();
+		});
+
+	lodSelector lods;
+	suite.run("renderQueue.selectLods", scene.meshes,
+		[&] { que = full; },
+		[&] {
+			selectLods(que, cam, 720, lods, lodPass::Main);
+			return size_t(que.meshes.back().lod);
+		});
+
+	suite.run("renderQueue.sort", scene.meshes,
+		[&] { que = full; },
+		[&] {
+			sortQueue(que, cam);
+			return que.meshes.size();
+		});
+
+	suite.run("renderQueue.nearestProbe", 1000,
+		[&] {
+			size_t n = 0;
+			for (unsigned i = 0; i < 1000; i++) {
+				glm::vec3 p(i % 100 - 50.f, 0, i / 10 - 50.f);
+				n += (bool)full.nearest_reflection_probe(p);
+			}
+			return n;
+		});
+}
+
+static void benchAnimation(benchSuite& suite) {
+	size_t rigs      = suite.scaled(64);
+	size_t joints    = 48;
+	size_t keyframes = 120;
+
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+	// one animation map per rig, each joint has translation, rotation
+	// and scale channels
+	std::vector<std::vector<animationChannel::ptr>> channels;
+	std::vector<TRS> poses(rigs * joints);
+
+	for (size_t r = 0; r < rigs; r++) {
+		channels.push_back({});
+
+		for (size_t j = 0; j < joints; j++) {
+			auto chan  = std::make_shared<animationChannel>();
+			auto trans = std::make_shared<animationTranslation>();
+			auto rot   = std::make_shared<animationRotation>();
+			auto scale = std::make_shared<animationScale>();
+
+			for (size_t k = 0; k < keyframes; k++) {
+				float t = k / 30.f;
+				trans->frametimes.push_back(t);
+				rot->frametimes.push_back(t);
+				scale->frametimes.push_back(t);
+
+				trans->translations.push_back({unit(rng), unit(rng), unit(rng)});
+				rot->rotations.push_back(glm::normalize(
+					glm::quat(unit(rng), unit(rng), unit(rng), unit(rng))));
+				scale->scales.push_back(glm::vec3(1 + 0.1*unit(rng)));
+			}
+
+			chan->animations = {trans, rot, scale};
+			channels.back().push_back(chan);
+		}
+	}
+
+	float endtime = (keyframes - 1) / 30.f;
+	float time = 0;
+
+	suite.run("animation.sample", rigs * joints, [&] {
+		// advance a frame each repetition so keyframe lookups move around
+		time = fmod(time + 1/60.f, endtime);
+
+		for (size_t r = 0; r < rigs; r++) {
+			for (size_t j = 0; j < joints; j++) {
+				channels[r][j]->applyTransform(poses[r*joints + j], time, endtime);
+			}
+		}
+
+		return poses.size();
+	});
+}
+
+static void benchAllocators(benchSuite& suite) {
+	{
+		size_t count = suite.scaled(4096);
+		std::vector<bufferNode*> nodes;
+
+		suite.run("bufferAllocator.churn", count, [&] {
+			bufferAllocator alloc;
+			std::mt19937 rng(99);
+			std::uniform_int_distribution<size_t> size(16, 65536);
+
+			nodes.clear();
+			for (size_t i = 0; i < count; i++) {
+				nodes.push_back(alloc.allocate(size(rng)));
+
+				// free every third allocation to fragment the buffer
+				if (i % 3 == 0) {
+					alloc.free(nodes[i / 2]);
+					nodes[i / 2] = nullptr;
+				}
+			}
+
+			for (auto node : nodes) {
+				if (node) alloc.free(node);
+			}
+
+			return nodes.size();
+		});
+	}
+
+	{
+		size_t count = suite.scaled(2048);
+		std::vector<quadtree::node_id> ids;
+
+		suite.run("quadtree.churn", count, [&] {
+			quadtree tree(8192);
+			std::mt19937 rng(77);
+			std::uniform_int_distribution<unsigned> exp(4, 9);
+
+			ids.clear();
+			for (size_t i = 0; i < count; i++) {
+				ids.push_back(tree.alloc(1 << exp(rng)));
+
+				if (i % 4 == 0) {
+					tree.free(ids[i / 2]);
+				}
+			}
+
+			size_t valid = 0;
+			for (auto id : ids) {
+				valid += tree.valid(id);
+			}
+
+			return valid;
+		});
+	}
+}
+
+static void benchAudio(benchSuite& suite) {
+	audioMixer mixer;
+	auto cam = std::make_shared<camera>();
+	mixer.setCamera(cam);
+
+	// one second of noise, shared by all the channels
+	auto buf = std::make_shared<audioBuffer>();
+	std::mt19937 rng(5);
+	std::uniform_int_distribution<int> sample(-8000, 8000);
+
+	for (unsigned i = 0; i < 44100; i++) {
+		buf->push_back(sample(rng));
+	}
+
+	auto buffers = std::make_shared<channelBuffers>(channelBuffers {buf});
+	size_t channels = suite.scaled(32);
+
+	for (size_t i = 0; i < channels; i++) {
+		audioChannel::ptr chan;
+
+		if (i % 2) {
+			chan = std::make_shared<stereoAudioChannel>(buffers, audioChannel::mode::Loop);
+		} else {
+			chan = std::make_shared<spatialAudioChannel>(buffers, audioChannel::mode::Loop);
+			chan->worldPosition = glm::vec3(i, 0, 2);
+		}
+
+		mixer.add(chan);
+	}
+
+	// same size as the SDL callback buffer
+	std::vector<int16_t> stream(4096);
+
+	suite.run("audio.mix", stream.size() / 2, [&] {
+		mixer.mix(stream.data(), stream.size());
+		return (size_t)stream[0];
+	});
+}
+
+static void benchContacts(benchSuite& suite) {
+	size_t objects = suite.scaled(2048);
+	size_t pairs   = objects * 2;
+
+	// fake object pointers, the stream only uses them as keys
+	std::vector<physicsObject*> objs;
+	for (size_t i = 0; i < objects; i++) {
+		objs.push_back(reinterpret_cast<physicsObject*>((i + 1) * 64));
+	}
+
+	contactStream stream;
+	unsigned step = 0;
+
+	suite.run("contactStream.step", pairs, [&] {
+		stream.beginStep();
+		step++;
+
+		// most pairs persist between steps, some begin and end
+		for (size_t i = 0; i < pairs; i++) {
+			size_t a = i % objects;
+			size_t b = (i * 7 + (i % 13 == 0? step : 0)) % objects;
+			if (a == b) continue;
+
+			stream.addContact(objs[a], objs[b], nullptr, nullptr,
+			                  1, ~0u, 1, ~0u,
+			                  glm::vec3(0), glm::vec3(0), glm::vec3(0, 1, 0),
+			                  0.01);
+		}
+
+		stream.endStep();
+		return stream.acquire().size();
+	});
+}
+
+static void benchProfiler(benchSuite& suite) {
+	size_t zones = suite.scaled(4096);
+
+	suite.run("profile.zone", zones, [&] {
+		profile::newFrame();
+
+		for (size_t i = 0; i < zones; i++) {
+			GREND_PROFILE_ZONE("bench zone");
+		}
+
+		profile::endFrame();
+		return zones;
+	});
+}
+
+static void benchLogger(benchSuite& suite) {
+	size_t messages = suite.scaled(1000);
+
+	// keep the console clean, formatting and callbacks still happen
+	// on the writer thread
+	LogConsoleOutput(false);
+	LogSetRateLimit(0);
+
+	suite.run("log.suppressed", messages, [&] {
+		for (size_t i = 0; i < messages; i++) {
+			LogCatFmt(logcat::ecs, Debug, "suppressed {} {}", i, 1.5f);
+		}
+		return messages;
+	});
+
+	suite.run("log.emitted", messages,
+		[&] { LogFlush(); },
+		[&] {
+			for (size_t i = 0; i < messages; i++) {
+				LogCatFmt(logcat::ecs, Info, "emitted {} {} {}", i, 1.5f, "str");
+			}
+			return messages;
+		});
+
+	LogFlush();
+	LogSetRateLimit(50);
+	LogConsoleOutput(true);
+}
+
+static void benchShaders(benchSuite& suite) {
+	// uses the unbaked sources, since those still have includes to resolve
+	const std::string path = GR_PREFIX "shaders/src/pixel-shading-metal-roughness-pbr.frag";
+	std::vector<std::pair<std::string, std::string>> jobs;
+
+	for (unsigned i = 0; i < 16; i++) {
+		jobs.push_back({path, "#version 300 es\n#define VARIANT " + std::to_string(i) + "\n"});
+	}
+
+	std::unique_ptr<shaderSourceCache> cache;
+	auto reset = [&] { cache = std::make_unique<shaderSourceCache>(GR_PREFIX "shaders/"); };
+
+	reset();
+	if (!cache->preprocess(path, "")->good) {
+		fprintf(stderr, "skipping shader benchmarks, couldn't load %s\n", path.c_str());
+		return;
+	}
+
+	suite.run("shader.preprocess.cold", jobs.size(), reset, [&] {
+		size_t n = 0;
+		for (auto& [file, header] : jobs) {
+			n += cache->preprocess(file, header)->source.size();
+		}
+		return n;
+	});
+
+	suite.run("shader.preprocess.batch", jobs.size(), reset, [&] {
+		cache->preprocessBatch(jobs);
+		return jobs.size();
+	});
+
+	// warm cache, only costs the staleness checks
+	reset();
+	cache->preprocessBatch(jobs);
+
+	suite.run("shader.preprocess.cached", jobs.size(), [&] {
+		size_t n = 0;
+		for (auto& [file, header] : jobs) {
+			n += cache->preprocess(file, header)->hash & 1;
+		}
+		return n;
+	});
+}
+
+static void benchObj(benchSuite& suite) {
+	// textured grid with shared normals, written out so the file path
+	// (mmap, chunking) gets measured too
+	size_t n = suite.scaled(512);
+	std::string path = (std::filesystem::temp_directory_path() / "grend-bench.obj").string();
+	FILE *fp = fopen(path.c_str(), "w");
+
+	if (!fp) {
+		fprintf(stderr, "skipping obj benchmarks, couldn't write %s\n", path.c_str());
+		return;
+	}
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> height(0.f, 1.f);
+
+	fprintf(fp, "o grid\nusemtl ground\nvn 0 1 0\n");
+	for (size_t y = 0; y < n; y++) {
+		for (size_t x = 0; x < n; x++) {
+			fprintf(fp, "v %f %f %f\nvt %f %f\n",
+			        x*0.1f, height(rng), y*0.1f, float(x)/n, float(y)/n);
+		}
+	}
+
+	for (size_t y = 0; y + 1 < n; y++) {
+		for (size_t x = 0; x + 1 < n; x++) {
+			size_t a = y*n + x + 1, b = a + 1, c = a + n, d = c + 1;
+			fprintf(fp, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", a, a, b, b, d, d, c, c);
+		}
+	}
+
+	fclose(fp);
+	size_t tris = 2*(n - 1)*(n - 1);
+
+	suite.run("obj.parse", tris, [&] {
+		objData data;
+		parseObjFile(path, data);
+		return data.vertices.size();
+	});
+
+	suite.run("obj.parse.serial", tris, [&] {
+		objData data;
+		parseObjFile(path, data, 1);
+		return data.vertices.size();
+	});
+
+	std::filesystem::remove(path);
+}
+
+static void benchMeshOptimizer(benchSuite& suite) {
+	// bumpy grid with triangles shuffled, roughly what unoptimized
+	// exporter output looks like to the vertex cache
+	struct vert { float position[3]; float uv[2]; };
+
+	size_t n = suite.scaled(256);
+	std::vector<vert> verts;
+	std::vector<uint32_t> source;
+
+	for (size_t y = 0; y < n; y++) {
+		for (size_t x = 0; x < n; x++) {
+			float fx = float(x)/n, fy = float(y)/n;
+			verts.push_back({{fx, 0.05f*sinf(fx*12)*cosf(fy*12), fy}, {fx, fy}});
+		}
+	}
+
+	for (uint32_t y = 0; y + 1 < n; y++) {
+		for (uint32_t x = 0; x + 1 < n; x++) {
+			uint32_t a = y*n + x, b = a + 1, c = a + n, d = c + 1;
+			source.insert(source.end(), {a, c, b, b, c, d});
+		}
+	}
+
+	std::mt19937 rng(1234);
+	for (size_t i = source.size()/3 - 1; i > 0; i--) {
+		size_t j = std::uniform_int_distribution<size_t>(0, i)(rng);
+		std::swap_ranges(&source[i*3], &source[i*3 + 3], &source[j*3]);
+	}
+
+	size_t tris = source.size() / 3;
+	std::vector<uint32_t> indices;
+	auto reset = [&] { indices = source; };
+
+	suite.run("mesh.optimize.cache", tris, reset, [&] {
+		optimizeVertexCache(indices.data(), indices.size(), verts.size());
+		return size_t(indices[0]);
+	});
+
+	optimizeVertexCache(source.data(), source.size(), verts.size());
+
+	suite.run("mesh.optimize.overdraw", tris, reset, [&] {
+		optimizeOverdraw(indices.data(), indices.size(),
+		                 verts[0].position, verts.size(), sizeof(vert));
+		return size_t(indices[0]);
+	});
+
+	suite.run("mesh.simplify", tris, reset, [&] {
+		return simplifyMesh(indices.data(), indices.data(), indices.size(),
+		                    verts[0].position, verts[0].uv, verts.size(),
+		                    sizeof(vert), indices.size() / 2, 0.01f);
+	});
+}
+
+static void benchOcclusion(benchSuite& suite) {
+	// rows of subdivided walls in front of the camera, with boxes scattered
+	// behind and between them
+	auto cam = std::make_shared<camera>();
+	cam->setViewport(1280, 720);
+	cam->setPosition({0, 1, 0});
+	cam->setDirection({0, 0, -1}, {0, 1, 0});
+	cam->setFar(200.f);
+	glm::mat4 viewProj = cam->viewProjTransform();
+
+	std::vector<glm::vec3> wall;
+	std::vector<uint32_t>  wallIndices;
+	unsigned n = 16;
+
+	for (unsigned y = 0; y <= n; y++) {
+		for (unsigned x = 0; x <= n; x++) {
+			wall.push_back({x*16.f/n - 8.f, y*4.f/n, 0});
+		}
+	}
+
+	for (unsigned y = 0; y < n; y++) {
+		for (unsigned x = 0; x < n; x++) {
+			uint32_t a = y*(n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+			wallIndices.insert(wallIndices.end(), {a, b, c, b, d, c});
+		}
+	}
+
+	std::vector<glm::mat4> walls;
+	for (int i = 0; i < 8; i++) {
+		walls.push_back(glm::translate(glm::vec3((i%2)? 6.f : -6.f, 0, -10.f - 10.f*i)));
+	}
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> xpos(-30.f, 30.f), zpos(-100.f, -5.f);
+	std::vector<AABB> boxes(suite.scaled(10000));
+
+	for (auto& box : boxes) {
+		glm::vec3 p(xpos(rng), 0, zpos(rng));
+		box = {p, p + glm::vec3(1)};
+	}
+
+	occlusionBuffer buffer;
+	size_t tris = walls.size() * wallIndices.size() / 3;
+
+	auto rasterize = [&] {
+		buffer.clear();
+		for (auto& m : walls) {
+			buffer.addOccluder(viewProj * m, &wall[0].x, sizeof(glm::vec3), wall.size(),
+			                   wallIndices.data(), wallIndices.size());
+		}
+		buffer.rasterize();
+	};
+
+	suite.run("occlusion.rasterize", tris, [&] {
+		rasterize();
+		return buffer.triangles();
+	});
+
+	rasterize();
+	suite.run("occlusion.test", boxes.size(), [&] {
+		size_t visible = 0;
+		for (auto& box : boxes) {
+			visible += buffer.testAABB(viewProj, box);
+		}
+		return visible;
+	});
+}
+
+static void benchProbeScheduler(benchSuite& suite) {
+	// a grid of dynamic probes, all requesting updates every frame, with
+	// the camera moving through them
+	std::vector<glm::vec3> probes;
+	unsigned side = std::max(2u, unsigned(sqrtf(suite.scaled(1024))));
+
+	for (unsigned y = 0; y < side; y++) {
+		for (unsigned x = 0; x < side; x++) {
+			probes.push_back({x*4.f, 0, y*4.f});
+		}
+	}
+
+	probeScheduler sched;
+	unsigned frame = 0;
+
+	suite.run("probeScheduler.frame", probes.size(), [&] {
+		for (auto& p : probes) {
+			sched.request(&p, p, 10);
+		}
+
+		sched.schedule(glm::vec3(frame % side * 4.f, 0, 0));
+
+		size_t steps = 0;
+		probeScheduler::step st;
+		while (sched.next(st)) {
+			sched.finished(st, 100000);
+			steps++;
+		}
+
+		sched.newFrame();
+		frame++;
+		return steps;
+	});
+}
+
+static float benchHeight(float x, float y) {
+	return sinf(x * 0.013f) * 24.f + cosf(y * 0.021f) * 12.f
+	     + sinf((x + y) * 0.11f) * 2.f;
+}
+
+static void benchTerrain(benchSuite& suite) {
+	terrainSettings settings;
+	terrainChunkData data;
+	unsigned chunks = std::max(1u, unsigned(suite.scaled(64)));
+
+	suite.run("terrain.generateChunk", chunks, [&] {
+		size_t verts = 0;
+		for (unsigned i = 0; i < chunks; i++) {
+			terrainChunkKey key = {int(i % 8), int(i / 8), i % settings.levels};
+			generateTerrainChunk(settings, benchHeight, key, data);
+			verts += data.vertices.size();
+		}
+		return verts;
+	});
+
+	// a camera flying across a 4km map
+	std::vector<terrainChunkKey> keys;
+	unsigned positions = std::max(1u, unsigned(suite.scaled(256)));
+
+	suite.run("terrain.select", positions, [&] {
+		size_t total = 0;
+		for (unsigned i = 0; i < positions; i++) {
+			float t = float(i) / positions;
+			keys.clear();
+			selectTerrainChunks(settings, 4096, 4096,
+			                    glm::vec3(t * 4096, 30, 2048 + 1024*sinf(t * 6.28f)),
+			                    keys);
+			total += keys.size();
+		}
+		return total;
+	});
+}
+
+static float benchDensity(float x, float y, float z) {
+	// rolling ground with some overhangs
+	return 16.f - y + sinf(x * 0.15f) * 4.f + cosf(z * 0.11f) * 4.f
+	     + sinf((x + y + z) * 0.3f) * 2.f;
+}
+
+static void benchVoxels(benchSuite& suite) {
+	const unsigned n = 32;
+	const unsigned p = voxelPaddedSize(n);
+	std::vector<float> samples(p*p*p);
+
+	for (unsigned z = 0; z < p; z++) {
+		for (unsigned y = 0; y < p; y++) {
+			for (unsigned x = 0; x < p; x++) {
+				samples[(z*p + y)*p + x] = benchDensity(x, y, z);
+			}
+		}
+	}
+
+	std::vector<sceneModel::vertex>  verts;
+	std::vector<sceneMesh::faceType> indices;
+	size_t chunks = suite.scaled(16);
+
+	// items are voxels, so ns_per_item gives meshing throughput
+	suite.run("voxel.meshChunk", chunks * n*n*n, [&] {
+		size_t tris = 0;
+		for (size_t i = 0; i < chunks; i++) {
+			voxelMeshChunk(samples.data(), n, 0.f, 1.f, verts, indices);
+			tris += indices.size() / 3;
+		}
+		return tris;
+	});
+
+	// editing and remeshing a volume on the job queue
+	ecs::entityManager manager;
+	jobQueue jobs;
+	sceneNode::ptr root = manager.construct<sceneNode>();
+	auto *volume = root->attach<voxelVolume>();
+	int side = std::max(1, int(sqrtf(suite.scaled(16))));
+
+	volume->fill({0, 0, 0}, {side*int(n) - 1, int(n) - 1, side*int(n) - 1}, benchDensity);
+	volume->remesh(&jobs);
+
+	// a crater in the middle of every chunk
+	auto dig = [&] {
+		for (int z = 0; z < side; z++) {
+			for (int x = 0; x < side; x++) {
+				glm::vec3 center((x + 0.5f)*n, 16, (z + 0.5f)*n);
+				volume->addSphere(center, 5.f, -0.5f);
+			}
+		}
+	};
+
+	dig();
+	size_t dirty = volume->dirtyChunks();
+	volume->remesh(&jobs);
+
+	suite.run("voxel.remeshEdit", dirty * n*n*n, dig, [&] {
+		return volume->remesh(&jobs);
+	});
+}
+
+static void benchParticles(benchSuite& suite) {
+	particleSettings settings;
+	settings.spawnRate    = 0;
+	settings.lifetimeMin  = settings.lifetimeMax = 1e6f;
+	settings.maxParticles = suite.scaled(1000000);
+	settings.drag         = 0.1f;
+	settings.sizeCurve.keys  = {{0.f, 0.5f}, {0.2f, 1.f}, {1.f, 0.f}};
+	settings.colorCurve.keys = {{0.f, glm::vec4(1)}, {1.f, glm::vec4(1, 0.5f, 0, 0)}};
+
+	particleSimulation sim(settings);
+	sim.burst(settings.maxParticles);
+	sim.step(1/60.f, glm::vec3(0));
+
+	jobQueue jobs;
+	size_t count = sim.count();
+
+	suite.run("particles.step", count, [&] {
+		sim.step(1/60.f, glm::vec3(0));
+		return sim.count();
+	});
+
+	suite.run("particles.stepParallel", count, [&] {
+		sim.step(1/60.f, glm::vec3(0), &jobs);
+		return sim.count();
+	});
+
+	std::vector<glm::vec4> positions(count), colors(count);
+
+	suite.run("particles.writeBillboards", count, [&] {
+		sim.writeBillboards(positions.data(), colors.data(), &jobs);
+		return count;
+	});
+}
+
+static void benchRaycast(benchSuite& suite) {
+	ecs::entityManager manager;
+
+	// bumpy grid, instanced around the scene with random transforms
+	unsigned n = 128;
+	sceneModel::ptr model = manager.construct<sceneModel>();
+	sceneMesh::ptr  mesh  = manager.construct<sceneMesh>();
+	auto& verts = model->attach<ecs::bufferComponent<sceneModel::vertex>>()->data;
+	auto& faces = mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+	setNode("mesh", model, mesh);
+
+	for (unsigned y = 0; y < n; y++) {
+		for (unsigned x = 0; x < n; x++) {
+			float fx = float(x)/(n - 1) - 0.5f, fy = float(y)/(n - 1) - 0.5f;
+			sceneModel::vertex v = {};
+			v.position = {fx*8, 0.3f*sinf(fx*20)*cosf(fy*20), fy*8};
+			verts.push_back(v);
+		}
+	}
+
+	for (unsigned y = 0; y + 1 < n; y++) {
+		for (unsigned x = 0; x + 1 < n; x++) {
+			unsigned a = y*n + x, b = a + 1, c = a + n, d = c + 1;
+			faces.insert(faces.end(), {a, c, b, b, c, d});
+		}
+	}
+
+	size_t tris = faces.size() / 3;
+
+	suite.run("raycast.buildMesh", tris, [&] { mesh->bvh = nullptr; }, [&] {
+		model->buildBVHs();
+		return mesh->bvh->nodes();
+	});
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	size_t rays = suite.scaled(100000);
+	std::vector<glm::vec3> origins(rays), dirs(rays);
+
+	// rays from above, mostly pointing down into the grid
+	for (size_t i = 0; i < rays; i++) {
+		origins[i] = {unit(rng)*4, 5, unit(rng)*4};
+		dirs[i]    = {unit(rng)*0.5f, -1, unit(rng)*0.5f};
+	}
+
+	suite.run("raycast.mesh", rays, [&] {
+		size_t hits = 0;
+		meshHit hit;
+
+		for (size_t i = 0; i < rays; i++) {
+			hits += mesh->bvh->raycast(origins[i], dirs[i], FLT_MAX, hit);
+		}
+
+		return hits;
+	});
+
+	sceneNode::ptr root = manager.construct<sceneNode>();
+	size_t instances = suite.scaled(1000);
+	float extent = 20.f * sqrtf(instances);
+
+	for (size_t i = 0; i < instances; i++) {
+		sceneNode::ptr node = manager.construct<sceneNode>();
+		node->transform.setPosition({unit(rng)*extent, unit(rng)*10, unit(rng)*extent});
+		node->transform.setRotation(glm::quat(glm::vec3(unit(rng), unit(rng)*3, unit(rng))));
+		setNode("model", node, model);
+		setNode("instance" + std::to_string(i), root, node);
+	}
+
+	raycastScene scene;
+
+	suite.run("raycast.buildScene", instances, [&] {
+		scene.clear();
+		scene.add(root);
+		scene.build();
+		return scene.instances();
+	});
+
+	// camera-ish rays fanning out over the scene
+	for (size_t i = 0; i < rays; i++) {
+		origins[i] = {unit(rng)*extent*0.5f, 30, unit(rng)*extent*0.5f};
+		dirs[i]    = {unit(rng), -0.5f, unit(rng)};
+	}
+
+	suite.run("raycast.scene", rays, [&] {
+		size_t hits = 0;
+		raycastHit hit;
+
+		for (size_t i = 0; i < rays; i++) {
+			hits += scene.raycast(origins[i], dirs[i], hit);
+		}
+
+		return hits;
+	});
+}
+
+static void benchTextureCache(benchSuite& suite) {
+	namespace fs = std::filesystem;
+
+	size_t count = suite.scaled(16);
+	unsigned side = 256;
+	fs::path dir = fs::temp_directory_path() / "grend-bench-textures";
+	std::vector<std::string> paths;
+	std::vector<uint8_t> px(side*side*4);
+	std::mt19937 rng(1234);
+
+	fs::create_directories(dir);
+
+	for (size_t i = 0; i < count; i++) {
+		for (auto& c : px) c = rng() & 0x3f;
+		std::string path = (dir / ("tex" + std::to_string(i) + ".png")).string();
+
+		if (!stbi_write_png(path.c_str(), side, side, 4, px.data(), side*4)) {
+			fprintf(stderr, "skipping texture cache benchmarks, couldn't write %s\n",
+			        path.c_str());
+			return;
+		}
+
+		paths.push_back(path);
+	}
+
+	textureFileCache cache;
+
+	suite.run("texture.loadCold", count, [&] { cache.clear(); }, [&] {
+		size_t n = 0;
+		for (auto& path : paths) {
+			n += cache.load(path)->width;
+		}
+		return n;
+	});
+
+	suite.run("texture.loadCached", count, [&] {
+		size_t n = 0;
+		for (auto& path : paths) {
+			n += cache.load(path)->width;
+		}
+		return n;
+	});
+
+	// textures that differ in a single byte, everywhere a sampling hash
+	// would skip over, all of them have to stay distinct
+	size_t variants = suite.scaled(4096);
+	std::vector<textureData::ptr> textures;
+	std::fill(px.begin(), px.end(), 0x80);
+
+	for (size_t i = 0; i < variants; i++) {
+		auto tex = std::make_shared<textureData>();
+		tex->width = tex->height = side;
+		tex->channels = 4;
+		tex->pixels = px;
+		std::get<std::vector<uint8_t>>(tex->pixels)[(i*7919 + 1) % px.size()] ^= 1;
+		textures.push_back(tex);
+	}
+
+	suite.run("texture.intern", variants, [&] { cache.clear(); }, [&] {
+		size_t n = 0;
+		for (auto& tex : textures) {
+			tex->invalidateHash();
+			n += cache.intern(tex) == tex;
+		}
+		return n;
+	});
+
+	suite.run("texture.hash", variants * px.size(), [&] {
+		size_t n = 0;
+		for (auto& tex : textures) {
+			n += hashTexture(*tex) & 1;
+		}
+		return n;
+	});
+
+	fs::remove_all(dir);
+}
+
+static void benchPrefab(benchSuite& suite) {
+	ecs::entityManager manager;
+
+	// character-ish prefab, a small hierarchy of plain nodes with a few
+	// models hanging off of it
+	sceneNode::ptr source = manager.construct<sceneNode>();
+	std::vector<sceneNode::ptr> parts = {source};
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+	for (unsigned i = 0; i < 32; i++) {
+		sceneNode::ptr node = manager.construct<sceneNode>();
+		node->transform.setPosition({unit(rng), unit(rng), unit(rng)});
+		setNode("part" + std::to_string(i), parts[rng() % parts.size()], node);
+		parts.push_back(node);
+	}
+
+	for (unsigned i = 0; i < 4; i++) {
+		sceneModel::ptr model = manager.construct<sceneModel>();
+		sceneMesh::ptr  mesh  = manager.construct<sceneMesh>();
+		auto& verts = model->attach<ecs::bufferComponent<sceneModel::vertex>>()->data;
+		auto& faces = mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+
+		verts.resize(1024);
+		for (unsigned k = 0; k < 1024*3; k++) {
+			faces.push_back(rng() % verts.size());
+		}
+
+		setNode("mesh", model, mesh);
+		setNode("model" + std::to_string(i), parts[rng() % parts.size()], model);
+	}
+
+	prefab fab(source);
+	size_t count = suite.scaled(1000);
+	std::vector<sceneNode::ptr> instances;
+
+	auto releaseAll = [&] {
+		for (auto& inst : instances) {
+			fab.release(&manager, inst);
+		}
+
+		instances.clear();
+		manager.clearFreedEntities();
+	};
+
+	suite.run("prefab.instantiate", count, releaseAll, [&] {
+		fab.instantiate(&manager, count, instances);
+		return instances.size() * fab.instancedNodes();
+	});
+
+	releaseAll();
+
+	suite.run("prefab.makeUnique", count, releaseAll, [&] {
+		fab.instantiate(&manager, count, instances);
+		size_t n = 0;
+
+		for (auto& inst : instances) {
+			for (auto& ent : inst->flatten().entries) {
+				if (ent.node->type == sceneNode::objType::Model) {
+					n += fab.makeUnique(inst, ent.node) != nullptr;
+					break;
+				}
+			}
+		}
+
+		return n;
+	});
+
+	releaseAll();
+}
+
+static void benchEntityList(benchSuite& suite) {
+	ecs::entityManager manager;
+	size_t count = suite.scaled(50000);
+
+	for (size_t i = 0; i < count; i++) {
+		auto ent = manager.construct<ecs::entity>();
+		ent->name = "Entity " + std::to_string(i);
+		ent->attach<benchPosition>();
+
+		if (i % 10 == 0) ent->attach<benchTag>();
+	}
+
+	// what the editor's search field would have, a type plus part of a name
+	std::string typeSearch = demangle(getTypeName<benchTag>()) + " entity 12";
+	ecs::entityListCache cache;
+
+	suite.run("entityList.rebuild", count, [&] { cache.clear(); }, [&] {
+		return cache.query(&manager, "ntity 1").size();
+	});
+
+	suite.run("entityList.typeSearch", count, [&] { manager.generation++; }, [&] {
+		return cache.query(&manager, typeSearch).size();
+	});
+
+	// steady state, once per frame with nothing changing
+	size_t frames = suite.scaled(10000);
+	suite.run("entityList.cached", frames, [&] {
+		size_t n = 0;
+		for (size_t i = 0; i < frames; i++) {
+			n += cache.query(&manager, typeSearch).size();
+		}
+		return n;
+	});
+}
+
+static void benchReplication(benchSuite& suite) {
+	auto schema = std::make_shared<replicationSchema>();
+	ecs::entityManager serverWorld, clientWorld;
+	size_t count = suite.scaled(1000);
+	std::vector<ecs::entity*> ents;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+	for (size_t i = 0; i < count; i++) {
+		auto ent = serverWorld.construct<ecs::entity>();
+		ent->attach<ecs::replicated>();
+		ent->transform.setPosition({unit(rng)*100, 0, unit(rng)*100});
+		ents.push_back(ent);
+	}
+
+	float loss = 0.05f;
+	auto [serverEnd, clientEnd] = loopbackTransport::makePair(loss);
+	replicationServer server(schema, &serverWorld);
+	replicationClient client(schema, &clientWorld, clientEnd);
+	server.addClient(serverEnd);
+
+	// a tenth of the world moves each tick, the rest sits still
+	auto step = [&] {
+		for (size_t i = 0; i < count / 10; i++) {
+			auto ent = ents[rng() % count];
+			TRS t = ent->transform.getTRS();
+			t.position += glm::vec3(unit(rng), 0, unit(rng)) * 0.1f;
+			t.rotation  = glm::normalize(t.rotation * glm::quat(glm::vec3(0, unit(rng)*0.1f, 0)));
+			ent->transform.set(t);
+		}
+
+		server.receive();
+		server.tick();
+		client.receive();
+		client.interpolate(client.latestTick() - 2.f);
+		return client.latestTick();
+	};
+
+	size_t ticks = 10;
+	suite.run("replication.tick", count * ticks, [&] {
+		size_t n = 0;
+		for (size_t i = 0; i < ticks; i++) {
+			n += step();
+		}
+		return n;
+	});
+
+	auto stats = server.getStats();
+	if (stats.entities > 0) {
+		fprintf(stderr, "replication: %.3f bytes per entity per tick, "
+		                "%.0f%% loss, %lu full snapshots\n",
+		        double(stats.bytes) / stats.entities, loss*100,
+		        (unsigned long)stats.fullSnapshots);
+	}
+}
+
+static void benchPhysicsQueries(benchSuite& suite) {
+#if defined(PHYSICS_BULLET)
+	bulletPhysics phys;
+	std::vector<physicsObject::ptr> objects;
+	size_t side = 32;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+	// grid of static boxes and spheres, odd rows on a second layer
+	for (size_t x = 0; x < side; x++) {
+		for (size_t z = 0; z < side; z++) {
+			glm::vec3 pos(x*4.f, 0, z*4.f);
+			AABBExtent box = {glm::vec3(0), glm::vec3(1)};
+			auto obj = ((x + z) % 2)
+				? phys.addBox(nullptr, pos, 0.f, box)
+				: phys.addSphere(nullptr, pos, 0.f, 1.f);
+
+			obj->setCollisionLayer((z % 2)? 2 : 1);
+			objects.push_back(obj);
+		}
+	}
+
+	size_t count = suite.scaled(10000);
+	float size = side*4.f;
+	std::vector<physicsRay> rays(count);
+	std::vector<physicsSweep> sweeps(count);
+	std::vector<physicsOverlap> overlaps(count);
+	std::vector<physicsHit> hits(count), singleHits(count);
+	std::vector<physicsHit> overlapHits;
+	std::vector<physicsOverlapRange> ranges(count);
+
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 from(unit(rng)*size, 10.f, unit(rng)*size);
+		glm::vec3 to = from + glm::vec3(unit(rng)*8, -20.f, unit(rng)*8);
+
+		rays[i]     = {from, to};
+		sweeps[i]   = {from, to, 0.5f, (i % 2)? 1.f : 0.f};
+		overlaps[i] = {
+			.shape  = (i % 2)? physicsOverlap::Box : physicsOverlap::Sphere,
+			.center = glm::vec3(from.x, 0, from.z),
+			.radius = 1.5f,
+			.extent = glm::vec3(1.5f),
+		};
+	}
+
+	jobQueue jobs;
+
+	suite.run("physics.raycast", count, [&] {
+		size_t n = 0;
+		for (size_t i = 0; i < count; i++) {
+			singleHits[i] = {};
+			n += phys.raycast(rays[i], singleHits[i]);
+		}
+		return n;
+	});
+
+	suite.run("physics.raycastBatch", count, [&] {
+		phys.raycastBatch(rays, hits, &jobs);
+		return (size_t)std::count_if(hits.begin(), hits.end(),
+		                             [] (auto& h) { return h.obj != nullptr; });
+	});
+
+	suite.run("physics.sweepBatch", count, [&] {
+		phys.sweepBatch(sweeps, hits, &jobs);
+		return (size_t)std::count_if(hits.begin(), hits.end(),
+		                             [] (auto& h) { return h.obj != nullptr; });
+	});
+
+	suite.run("physics.overlapBatch", count, [&] {
+		overlapHits.clear();
+		phys.overlapBatch(overlaps, overlapHits, ranges, &jobs);
+		return overlapHits.size();
+	});
+
+#else
+	fprintf(stderr, "physics queries: built without bullet, skipping\n");
+#endif
+}
+
+static void benchShapeCache(benchSuite& suite) {
+#if defined(PHYSICS_BULLET)
+	ecs::entityManager manager;
+
+	// bumpy grid, placed many times like a prop in a level
+	unsigned n = 64;
+	sceneModel::ptr model = manager.construct<sceneModel>();
+	sceneMesh::ptr  mesh  = manager.construct<sceneMesh>();
+	auto& verts = model->attach<ecs::bufferComponent<sceneModel::vertex>>()->data;
+	auto& faces = mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+	setNode("mesh", model, mesh);
+
+	for (unsigned y = 0; y < n; y++) {
+		for (unsigned x = 0; x < n; x++) {
+			float fx = float(x)/(n - 1) - 0.5f, fy = float(y)/(n - 1) - 0.5f;
+			sceneModel::vertex v = {};
+			v.position = {fx*8, 0.3f*sinf(fx*20)*cosf(fy*20), fy*8};
+			verts.push_back(v);
+		}
+	}
+
+	for (unsigned y = 0; y + 1 < n; y++) {
+		for (unsigned x = 0; x + 1 < n; x++) {
+			unsigned a = y*n + x, b = a + 1, c = a + n, d = c + 1;
+			faces.insert(faces.end(), {a, c, b, b, c, d});
+		}
+	}
+
+	bulletPhysics phys;
+	std::vector<physicsObject::ptr> objects;
+	size_t tris = faces.size() / 3;
+	size_t instances = suite.scaled(500);
+
+	auto place = [&] (size_t i) {
+		TRS t;
+		t.position = glm::vec3((i % 32)*10.f, 0, (i / 32)*10.f);
+		t.scale    = glm::vec3((i % 4)? 1.f : 2.f);
+		objects.push_back(phys.addStaticMesh(nullptr, t, model, mesh));
+	};
+
+	auto reset = [&] {
+		objects.clear();
+		phys.shapes.clear();
+	};
+
+	suite.run("shapeCache.build", tris, reset, [&] {
+		place(0);
+		return objects.size();
+	});
+
+	suite.run("shapeCache.instances", instances, reset, [&] {
+		for (size_t i = 0; i < instances; i++) {
+			place(i);
+		}
+		return objects.size();
+	});
+
+	reset();
+	for (size_t i = 0; i < instances; i++) {
+		place(i);
+	}
+
+	auto stats = phys.shapes.getStats();
+	fprintf(stderr, "shape cache: %zu instances share %zu KB of collision data "
+	                "(%zu meshes, %zu scaled)\n",
+	        instances, stats.bytes >> 10, stats.meshes, stats.scaled);
+
+	// loading BVHs cooked on the first build
+	auto dir = std::filesystem::temp_directory_path() / "grend-bench-cooked";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	phys.shapes.setCookPath(dir.string());
+
+	// first one writes the cooked file
+	reset();
+	place(0);
+
+	suite.run("shapeCache.cookedLoad", tris, reset, [&] {
+		place(0);
+		return objects.size();
+	});
+
+	phys.shapes.setCookPath("");
+	std::filesystem::remove_all(dir);
+
+	suite.run("shapeCache.convex", tris, reset, [&] {
+		TRS t;
+		objects.push_back(phys.addDynamicMesh(nullptr, t, 1.f, model, mesh));
+		return objects.size();
+	});
+
+#else
+	fprintf(stderr, "shape cache: built without bullet, skipping\n");
+#endif
+}
+
+static void usage(const char *name) {
+	fprintf(stderr,
+		"usage: %s [--format json|csv] [--output file] [--filter substring]\n"
+		"       %*s [--warmup N] [--reps N] [--scale factor] [--list]\n",
+		name, (int)strlen(name), "");
+}
+
+int main(int argc, char *argv[]) {
+	benchOptions opts;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--list") {
+			opts.list = true;
+
+		} else if (arg == "--format" && hasValue) {
+			std::string fmt = argv[++i];
+			opts.format = (fmt == "csv")
+				? benchOptions::format::CSV
+				: benchOptions::format::JSON;
+
+		} else if (arg == "--output" && hasValue) {
+			opts.output = argv[++i];
+
+		} else if (arg == "--filter" && hasValue) {
+			opts.filter = argv[++i];
+
+		} else if (arg == "--warmup" && hasValue) {
+			opts.warmup = atoi(argv[++i]);
+
+		} else if (arg == "--reps" && hasValue) {
+			opts.reps = std::max(1, atoi(argv[++i]));
+
+		} else if (arg == "--scale" && hasValue) {
+			opts.scale = atof(argv[++i]);
+
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	benchSuite suite(opts);
+
+	benchECS(suite);
+	benchRenderQueue(suite);
+	benchAnimation(suite);
+	benchAllocators(suite);
+	benchAudio(suite);
+	benchContacts(suite);
+	benchProfiler(suite);
+	benchLogger(suite);
+	benchShaders(suite);
+	benchObj(suite);
+	benchMeshOptimizer(suite);
+	benchOcclusion(suite);
+	benchProbeScheduler(suite);
+	benchTerrain(suite);
+	benchVoxels(suite);
+	benchParticles(suite);
+	benchRaycast(suite);
+	benchTextureCache(suite);
+	benchPrefab(suite);
+	benchEntityList(suite);
+	benchReplication(suite);
+	benchPhysicsQueries(suite);
+	benchShapeCache(suite);
+
+	if (opts.list) {
+		return 0;
+	}
+
+	FILE *fp = opts.output.empty()? stdout : fopen(opts.output.c_str(), "w");
+	if (!fp) {
+		fprintf(stderr, "couldn't open %s\n", opts.output.c_str());
+		return 1;
+	}
+
+	suite.write(fp);
+
+	if (fp != stdout) {
+		fclose(fp);
+	}
+
+	return 0;
+}
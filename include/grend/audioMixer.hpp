@@ -90,9 +90,13 @@ class audioMixer : public IoC::Service {
 		typedef std::weak_ptr<audioMixer> weakptr;
 
 		audioMixer(SDLContext *ctx);
+		// not attached to an audio device, samples are pulled with mix()
+		audioMixer() {};
 
 		void setCamera(camera::ptr cam);
 		std::pair<int16_t, int16_t> getSample(camera::ptr cam);
+		// fill an interleaved stereo buffer with the current camera
+		void mix(int16_t *stream, size_t samples);
 		size_t add(audioChannel::ptr channel);
 		void   remove(size_t id);
 
@@ -23,6 +23,7 @@ struct bufferNode {
 class bufferAllocator {
 	public:
 		bufferAllocator();
+		~bufferAllocator();
 		bufferNode *allocate(size_t amount);
 		void free(bufferNode *ptr);
 		unsigned alignment = 4;
@@ -4,6 +4,7 @@
 #include <grend/sceneModel.hpp>
 #include <grend/octree.hpp>
 #include <grend/physics.hpp>
+#include <grend/bulletShapeCache.hpp>
 #include <grend/TRS.hpp>
 
 #include <unordered_map>
@@ -16,6 +17,8 @@
 #include "btBulletDynamicsCommon.h"
 #include "LinearMath/btIDebugDraw.h"
 #include <mutex>
+#include <atomic>
+#include <functional>
 #include <condition_variable>
 
 namespace grendx {
@@ -50,9 +53,33 @@ class bulletObject : public physicsObject {
 
 		btRigidBody *body;
 		btCollisionShape *shape;
+		// set for shapes from the shape cache, keeps them alive
+		std::shared_ptr<btCollisionShape> sharedShape;
 		btDefaultMotionState *motionState;
 		float mass;
 		void *data;
+
+		// transform at the end of the last step, only touched while
+		// holding the physics lock
+		TRS lastStepTransform;
+		bool haveLastStep = false;
+
+		// last values given from the game thread, returned until a
+		// snapshot from the step they're applied in is published, so a get
+		// right after a set sees the new value (static objects never show
+		// up in snapshots)
+		TRS requestedTransform;
+		glm::vec3 requestedVelocity = glm::vec3(0);
+		glm::vec3 requestedAngularFactor = glm::vec3(1);
+		uint64_t transformStep = 0;
+		uint64_t velocityStep  = 0;
+
+	private:
+		// reads the body, only from the physics thread or with the lock held
+		TRS bodyTransform(void);
+		// state in the snapshot rigidBodyUpdateSystem acquired this frame,
+		// nullptr if it's older than pendingStep. Game thread only.
+		const physicsSnapshot::entry *published(uint64_t pendingStep);
 };
 
 #include <grend/glManager.hpp>
@@ -142,8 +169,15 @@ class bulletPhysics : public physics {
 		              sceneModel::ptr model,
 		              sceneMesh::ptr mesh);
 
-		// map of submesh name to physics object ID
-		// TODO: multimap?
+		virtual physicsObject::ptr
+		addDynamicMesh(void *data,
+		               const TRS& transform,
+		               float mass,
+		               sceneModel::ptr model,
+		               sceneMesh::ptr mesh);
+
+		// static body for each mesh in the model, using the same shared
+		// shapes as addStaticMesh()
 		virtual std::map<sceneMesh::ptr, physicsObject::ptr>
 		addModelMeshBoxes(sceneModel::ptr mod);
 
@@ -154,18 +188,67 @@ class bulletPhysics : public physics {
 		virtual size_t numObjects(void);
 		virtual void filterCollisions(void);
 		virtual void stepSimulation(float delta);
+		virtual contactStream *getContacts(void) { return &contacts; };
+		virtual tripleBuffer<physicsSnapshot> *getSnapshots(void) { return &snapshots; };
+		virtual void setAsyncStepping(bool async);
+
+		// run a function modifying the simulation, this is deferred to
+		// the start of the next step while stepping asynchronously.
+		// Returns the step of the first snapshot that includes the change.
+		uint64_t defer(std::function<void()> func);
+
+		virtual bool raycast(const physicsRay& ray, physicsHit& hit);
+		virtual bool sweep(const physicsSweep& query, physicsHit& hit);
+		virtual size_t overlap(const physicsOverlap& query,
+		                       std::vector<physicsHit>& hits);
+
+		virtual void raycastBatch(std::span<const physicsRay> rays,
+		                          std::span<physicsHit> hits,
+		                          jobQueue *jobs = nullptr);
+		virtual void sweepBatch(std::span<const physicsSweep> queries,
+		                        std::span<physicsHit> hits,
+		                        jobQueue *jobs = nullptr);
+		virtual void overlapBatch(std::span<const physicsOverlap> queries,
+		                          std::vector<physicsHit>& hits,
+		                          std::span<physicsOverlapRange> ranges,
+		                          jobQueue *jobs = nullptr);
+
+		// collision shapes for meshes, shared between bodies
+		bulletShapeCache shapes;
 
 	private:
+		void runDeferred(void);
+		void publishSnapshot(float delta);
+
+		// should be called with bulletMutex held, these only read the
+		// world so any number can run at once
+		bool raycastLocked(const physicsRay& ray, physicsHit& hit);
+		bool sweepLocked(const physicsSweep& query, physicsHit& hit);
+		size_t overlapLocked(const physicsOverlap& query,
+		                     std::vector<physicsHit>& hits);
+
 		btDefaultCollisionConfiguration *collisionConfig;
 		btCollisionDispatcher *dispatcher;
-		btBroadphaseInterface *pairCache;
+		btDbvtBroadphase *pairCache;
 		btSequentialImpulseConstraintSolver *solver;
 		btDiscreteDynamicsWorld *world;
 
 		std::map<bulletObject *, physicsObject::weakptr> objects;
 		std::mutex bulletMutex;
 
-		bulletDebugDrawer debugDrawer;
+		contactStream contacts;
+		tripleBuffer<physicsSnapshot> snapshots;
+		uint64_t stepCount = 0;
+
+		std::atomic<bool> asyncStepping = false;
+		std::mutex deferredMutex;
+		std::vector<std::function<void()>> deferred;
+		std::vector<std::function<void()>> runningDeferred;
+		// step deferred functions will be applied in, guarded by deferredMutex
+		uint64_t deferredStep = 1;
+
+		// created on first use, it needs a GL context
+		std::unique_ptr<bulletDebugDrawer> debugDrawer;
 };
 
 // namespace grendx
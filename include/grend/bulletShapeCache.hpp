@@ -0,0 +1,150 @@
+#pragma once
+
+#include <grend/glmIncludes.hpp>
+#include <grend/sceneModel.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "btBulletDynamicsCommon.h"
+
+namespace grendx {
+
+/**
+ * Collision shapes built from meshes, shared between every body using the
+ * same geometry.
+ *
+ * Meshes are identified by a hash of their triangles, so instances of one
+ * model (or separate models with identical geometry) end up with the same
+ * shape. Triangles are copied out of the model, only the vertices a mesh
+ * actually uses are kept, so shapes don't depend on the model staying
+ * loaded.
+ *
+ * Static meshes share one triangle mesh shape and BVH per mesh, instances
+ * with a different scale get a scaled wrapper around it (also shared).
+ * If cookPath is set, BVHs are written there after being built and loaded
+ * in place from there instead of rebuilding them next time. Cooked files
+ * are specific to the Bullet build that wrote them, and rejected otherwise.
+ *
+ * Dynamic meshes get a set of convex hulls, one per connected part of the
+ * mesh, simplified to at most maxHullVertices each.
+ *
+ * Shapes stay cached until purge() finds nothing else using them. All
+ * functions are thread-safe, shapes are built while holding the cache's
+ * lock.
+ */
+class bulletShapeCache {
+	public:
+		struct stats {
+			size_t hits         = 0;
+			size_t built        = 0;
+			size_t cookedLoads  = 0;
+			size_t cookedWrites = 0;
+			// cooked files that were out of date or from another build
+			size_t cookedRejected = 0;
+			size_t hulls        = 0;
+
+			size_t meshes = 0;
+			size_t scaled = 0;
+			size_t convex = 0;
+			// triangles, vertices and BVH nodes held by cached meshes
+			size_t bytes  = 0;
+		};
+
+		static constexpr unsigned maxHulls        = 32;
+		static constexpr unsigned maxHullVertices = 42;
+
+		~bulletShapeCache();
+
+		// triangle mesh with the given scale, for static bodies, nullptr
+		// if the mesh has no triangles
+		std::shared_ptr<btCollisionShape> staticMesh(sceneModel::ptr model,
+		                                             sceneMesh::ptr mesh,
+		                                             const glm::vec3& scale);
+		// convex hulls with the scale baked in, for dynamic bodies. The mesh
+		// origin is used as the center of mass.
+		std::shared_ptr<btCollisionShape> convexMesh(sceneModel::ptr model,
+		                                             sceneMesh::ptr mesh,
+		                                             const glm::vec3& scale);
+
+		// drops shapes that aren't used by anything, returns the number dropped
+		size_t purge(void);
+		void clear(void);
+		stats getStats(void);
+
+		// directory for cooked BVHs, empty to disable
+		void setCookPath(const std::string& path);
+
+	private:
+		// triangles of a mesh, with unused vertices removed
+		struct triangles {
+			std::vector<btScalar> positions;
+			std::vector<int>      indices;
+			uint64_t hash = 0;
+		};
+
+		struct meshEntry {
+			~meshEntry();
+
+			triangles tris;
+			btTriangleIndexVertexArray *array = nullptr;
+			btBvhTriangleMeshShape *shape = nullptr;
+			// set when the BVH was loaded in place from a cooked file
+			void *cooked = nullptr;
+			size_t bytes = 0;
+		};
+
+		struct scaledEntry {
+			std::shared_ptr<meshEntry> base;
+			std::unique_ptr<btScaledBvhTriangleMeshShape> shape;
+		};
+
+		struct convexEntry {
+			std::vector<std::unique_ptr<btConvexHullShape>> hulls;
+			std::unique_ptr<btCompoundShape> compound;
+			btCollisionShape *shape = nullptr;
+		};
+
+		struct shapeKey {
+			uint64_t hash;
+			// scale in 1/1024ths
+			int32_t scale[3];
+
+			bool operator==(const shapeKey& other) const = default;
+		};
+
+		struct keyHash {
+			size_t operator()(const shapeKey& k) const {
+				uint64_t h = k.hash;
+				for (int32_t s : k.scale) {
+					h = (h ^ uint32_t(s)) * 0x100000001b3ull;
+				}
+				return h;
+			}
+		};
+
+		static bool extract(sceneModel::ptr model, sceneMesh::ptr mesh,
+		                    triangles& out);
+		static shapeKey makeKey(uint64_t hash, const glm::vec3& scale);
+
+		std::shared_ptr<meshEntry> getMesh(triangles&& tris);
+		bool loadCooked(meshEntry& entry);
+		void writeCooked(const meshEntry& entry);
+		std::string cookedFile(uint64_t hash) const;
+
+		std::mutex mtx;
+		std::string cookPath;
+
+		std::unordered_map<uint64_t, std::shared_ptr<meshEntry>> meshes;
+		std::unordered_map<shapeKey, std::shared_ptr<scaledEntry>, keyHash> scaled;
+		std::unordered_map<shapeKey, std::shared_ptr<convexEntry>, keyHash> convex;
+		stats counters;
+};
+
+// namespace grendx
+}
@@ -55,6 +55,9 @@ class camera {
 		glm::mat4 viewTransform(void);
 		glm::mat4 viewProjTransform(void);
 		glm::vec4 worldToScreenPosition(glm::vec3 pos);
+		// inverse of worldToScreenPosition(), ray through a [0, 1] screen
+		// position starting at the near plane, dir is normalized
+		void screenToWorldRay(glm::vec2 pos, glm::vec3& origin, glm::vec3& dir);
 		bool onScreen(glm::vec4 pos);
 
 		bool sphereInFrustum(const BSphere& sphere);
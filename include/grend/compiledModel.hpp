@@ -41,6 +41,16 @@ class compiledMesh {
 		Buffer::ptr elements;
 		compiledMaterial::ptr mat;
 		material::blend_mode blend;
+
+		// index ranges in elements, lods[0] is the full mesh, followed by
+		// sceneMesh::lods. Empty for meshes with no indices.
+		struct lodRange {
+			GLuint offset;
+			GLuint count;
+			float  error;
+		};
+
+		std::vector<lodRange> lods;
 };
 
 // TODO: camelCase
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <grend/glmIncludes.hpp>
+
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <stdint.h>
+
+namespace grendx {
+
+class physicsObject;
+
+struct contactEvent {
+	enum type : uint8_t {
+		Begin,   // pair started touching this step
+		Persist, // pair was touching last step and is still touching
+		End,     // pair was touching last step, isn't anymore
+	};
+
+	physicsObject *a, *b;
+	void *adata, *bdata;
+
+	// deepest contact point on each object, and the contact normal
+	// on b (pointing from b towards a)
+	glm::vec3 positionA;
+	glm::vec3 positionB;
+	glm::vec3 normal;
+	float depth;
+
+	enum type kind;
+};
+
+/**
+ * Per-pair contact tracking and event buffering for physics implementations.
+ *
+ * The physics implementation wraps each step's contact generation in
+ * beginStep()/endStep(), and calls addContact() once for each touching pair.
+ * Pairs are tracked across steps to generate begin/persist/end events,
+ * and pairs whose collision layers don't match are dropped before any
+ * event is generated.
+ *
+ * Events are double-buffered: the writer side accumulates into a back buffer,
+ * consumers swap it out with acquire(). Buffers are reused between steps,
+ * so once they've grown to the working set size no more allocations happen.
+ * acquire() may be called from a different thread than the writer.
+ *
+ * This doesn't depend on any particular physics library (or on GL),
+ * so it can be driven directly with synthetic contacts.
+ */
+class contactStream {
+	public:
+		struct statistics {
+			uint64_t steps = 0;
+			uint64_t events = 0;
+			uint64_t filtered = 0;
+			size_t   activePairs = 0;
+		};
+
+		contactStream(size_t reserve = 256);
+
+		// collision layer test, objects only generate contact events if
+		// each object's layer is in the other object's mask
+		static bool accepts(uint32_t layerA, uint32_t maskA,
+		                    uint32_t layerB, uint32_t maskB)
+		{
+			return (layerA & maskB) && (layerB & maskA);
+		}
+
+		// writer side, these should only be called from the thread
+		// running the simulation
+		void beginStep(void);
+		// returns false if the contact was filtered out
+		bool addContact(physicsObject *a, physicsObject *b,
+		                void *adata, void *bdata,
+		                uint32_t layerA, uint32_t maskA,
+		                uint32_t layerB, uint32_t maskB,
+		                const glm::vec3& positionA,
+		                const glm::vec3& positionB,
+		                const glm::vec3& normal,
+		                float depth);
+		void endStep(void);
+
+		// drops tracked pairs and buffered events which reference obj,
+		// should be called when an object is removed from the simulation
+		void removeObject(physicsObject *obj);
+		void clear(void);
+
+		// reader side, returns all events published since the last call,
+		// the returned buffer is valid until the next call to acquire()
+		const std::vector<contactEvent>& acquire(void);
+
+		statistics stats(void);
+
+	private:
+		struct pairKey {
+			physicsObject *a, *b;
+
+			bool operator==(const pairKey& other) const {
+				return a == other.a && b == other.b;
+			}
+		};
+
+		struct pairHash {
+			size_t operator()(const pairKey& k) const {
+				uintptr_t x = (uintptr_t)k.a;
+				uintptr_t y = (uintptr_t)k.b;
+				return std::hash<uintptr_t>{}(x ^ (y*0x9e3779b97f4a7c15ull));
+			}
+		};
+
+		struct pairState {
+			uint64_t lastStep;
+			// index of this step's event in stepEvents
+			size_t eventIndex;
+			contactEvent last;
+		};
+
+		std::unordered_map<pairKey, pairState, pairHash> pairs;
+		uint64_t curStep = 0;
+		statistics counters;
+
+		// events generated during the current step, only touched by the writer
+		std::vector<contactEvent> stepEvents;
+
+		// published events, swapped between writer and reader under lock
+		std::mutex bufferMutex;
+		std::vector<contactEvent> back;
+		std::vector<contactEvent> front;
+};
+
+// namespace grendx
+}
@@ -3,8 +3,21 @@
 #include <grend/ecs/ecs.hpp>
 #include <grend/physics.hpp>
 
+#include <span>
+
 namespace grendx::ecs {
 
+// contact event as seen from one entity in the pair
+struct contact {
+	contactEvent::type kind;
+	// may be null for physics objects outside the ECS
+	entity *other;
+	// contact point on this entity, normal points towards the other object
+	glm::vec3 position;
+	glm::vec3 normal;
+	float depth;
+};
+
 class collisionHandler : public component {
 	public:
 		collisionHandler(regArgs t,
@@ -12,10 +25,27 @@ class collisionHandler : public component {
 
 		virtual ~collisionHandler();
 
+		/**
+		 * Handle a batch of contact events involving this entity, called once
+		 * per frame with every event for the entity from every physics step
+		 * since the last update.
+		 *
+		 * The default implementation calls onCollision() for each begin/persist
+		 * event with an entity matching the handler tags. Handlers interested
+		 * in end events, or in skipping the per-event conversion, should
+		 * override this.
+		 */
+		virtual void
+		onContacts(entityManager *manager, entity *ent,
+		           std::span<const contact> contacts);
+
 		virtual void
 		onCollision(entityManager *manager, entity *ent,
 		            entity *other, collision& col) = 0;
 
+		// true if other has all of the tags this handler filters for
+		bool matches(entityManager *manager, entity *other);
+
 		std::vector<const char *> tags;
 
 		// serialization stuff
@@ -29,6 +59,23 @@ class entitySystemCollision : public entitySystem {
 
 		virtual ~entitySystemCollision();
 		virtual void update(entityManager *manager, float delta);
+
+		// dispatch events to collision handlers, exposed so the event stream
+		// can be driven without a physics service
+		void dispatch(entityManager *manager,
+		              const std::vector<contactEvent>& events);
+
+	private:
+		// scratch buffers, kept around between frames so dispatching
+		// doesn't allocate once they've grown to the working set size
+		struct target {
+			entity *ent;
+			// index into the event buffer, low bit selects the side
+			uint32_t event;
+		};
+
+		std::vector<target>  targets;
+		std::vector<contact> batch;
 };
 
 // namespace grendx::ecs
@@ -125,6 +125,12 @@ class entityManager : public IoC::Service {
 		std::set<entity*> added;
 		std::set<entity*> condemned;
 
+		// bumped whenever an entity is added, removed or freed, or a
+		// component is (un)registered, caches built from queries (eg. the
+		// editor's entity list) compare against this to know when they're
+		// stale. Renaming entities doesn't change it.
+		uint64_t generation = 1;
+
 		// TODO: might be a good idea to rename constructComponent and constructEntity,
 		//       would be annoyingly verbose though...
 		//       makeComponent, makeEntity?
@@ -38,6 +38,7 @@ class editor : public IoC::Service {
 				<< std::endl;
 
 			drawers[demangled] = drawer;
+			cachedEntity = nullptr;
 		}
 
 		template <DrawableComponent T>
@@ -59,24 +60,52 @@ class editor : public IoC::Service {
 
 			auto* manager = ent->manager;
 
-			auto drawComponent = [&] (component *comp) {
-				for (auto& subtype : manager->componentTypes[comp]) {
-					const std::string& demangled = demangle(subtype);
-
-					if (has(demangled)) {
-						drawers[demangled](comp);
+			// resolving drawers walks every component and type name, only
+			// redo that when the entity's components might have changed
+			if (ent != cachedEntity
+			    || manager != cachedManager
+			    || manager->generation != cachedGeneration)
+			{
+				cachedEntity     = ent;
+				cachedManager    = manager;
+				cachedGeneration = manager->generation;
+				cachedDrawers.clear();
+
+				auto addComponent = [&] (component *comp) {
+					for (auto& subtype : manager->componentTypes[comp]) {
+						auto it = drawers.find(demangle(subtype));
+
+						if (it != drawers.end()) {
+							cachedDrawers.push_back({comp, &it->second});
+						}
 					}
+				};
+
+				addComponent(ent);
+
+				for (component *comp : ent->getAll<component>()) {
+					addComponent(comp);
 				}
-			};
+			}
 
-			drawComponent(ent);
+			for (auto& [comp, drawer] : cachedDrawers) {
+				(*drawer)(comp);
 
-			for (component *comp : ent->getAll<component>()) {
-				drawComponent(comp);
+				if (manager->generation != cachedGeneration) {
+					// drawer attached or removed something, components
+					// may have been freed, pick it up next frame
+					break;
+				}
 			}
 		}
 
 		std::map<std::string, EditorDrawer> drawers;
+
+	private:
+		entity        *cachedEntity  = nullptr;
+		entityManager *cachedManager = nullptr;
+		uint64_t       cachedGeneration = 0;
+		std::vector<std::pair<component*, EditorDrawer*>> cachedDrawers;
 };
 
 // namespace grendx::ecs
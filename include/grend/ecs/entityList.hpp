@@ -0,0 +1,76 @@
+#pragma once
+
+#include <grend/ecs/ecs.hpp>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace grendx::ecs {
+
+/**
+ * Cached entity search, for listing entities in large scenes.
+ *
+ * The search text is split on spaces, words that are component type names
+ * (as shown by demangle()) must all be attached to matching entities, any
+ * other word must appear in the entity's name or type name, ignoring case.
+ * An empty search matches every entity.
+ *
+ * Results are only recomputed when the search text changes or when the
+ * manager's generation does (entities added, removed, or components
+ * attached). Type searches go through the manager's component index, and
+ * the lowercased names used for word searches are kept in an index that is
+ * updated incrementally, only new or renamed entities are touched.
+ *
+ * Renaming an entity doesn't change the manager's generation, searches
+ * with words in them are also recomputed after baseLink::renamed(), which
+ * whatever renames entities should call (the editor and deserializer do).
+ */
+class entityListCache {
+	public:
+		struct stats {
+			size_t queries  = 0;
+			size_t rebuilds = 0;
+			size_t indexed  = 0;
+		};
+
+		// matching entities, in the same order as entityManager::entities
+		const std::vector<entity*>& query(entityManager *manager,
+		                                  const std::string& search);
+		// drops everything, the next query rebuilds from scratch
+		void clear(void);
+		stats getStats(void) const;
+
+	private:
+		struct entry {
+			std::string name;
+			std::string lowerName;
+			// entities can be freed and another allocated at the same
+			// address, the type is checked along with the name
+			const char *mangledType;
+			const std::string *lowerType;
+			uint64_t seen;
+		};
+
+		void updateIndex(entityManager *manager);
+		void rebuild(entityManager *manager);
+		const std::string *lowerTypeName(const char *mangled);
+
+		std::unordered_map<entity*, entry> index;
+		// mangled type name -> lowercased demangled name
+		std::unordered_map<const char *, std::string> lowerTypes;
+		std::vector<entity*> results;
+
+		entityManager *lastManager = nullptr;
+		uint64_t    lastGeneration = 0;
+		// baseLink::nameGeneration as of the last rebuild, 0 if the search
+		// had no words
+		uint64_t    lastNames = 0;
+		std::string lastSearch;
+		stats counters;
+};
+
+// namespace grendx::ecs
+}
@@ -3,19 +3,24 @@
 #include <grend/ecs/ecs.hpp>
 #include <grend/ecs/ref.hpp>
 
+#include <atomic>
+#include <stdint.h>
+
 namespace grendx::ecs {
 
 class baseLink : public component {
 	public:
 		baseLink(regArgs t)
 			: component(doRegister(this, t)),
+			  owner(t.ent),
 			  basePtr(nullptr)
-			{ }
+			{}
 
 		baseLink(regArgs t, entity* target)
 			: component(doRegister(this, t)),
+			  owner(t.ent),
 			  basePtr(target)
-			{ }
+			{}
 
 		~baseLink() {};
 
@@ -23,23 +28,72 @@ class baseLink : public component {
 			return basePtr;
 		}
 
+		// entity this link is attached to
+		entity *getOwner(void) {
+			return owner;
+		}
+
 		static nlohmann::json serializer(component *comp) { return {}; };
 		static void deserializer(component *comp, nlohmann::json j) {};
 
+		// bumped when entities are renamed, caches keyed by name (eg.
+		// sceneNode child indexes) compare against this to know when
+		// they're stale. Links being added or removed go through linkHooks.
+		static inline std::atomic<uint64_t> nameGeneration = 1;
+
+		static void renamed(void) {
+			nameGeneration.fetch_add(1, std::memory_order_relaxed);
+		}
+
+	protected:
+		void setBaseRef(entity *target) {
+			basePtr = target;
+		}
+
 	private:
+		entity *owner;
 		ref<entity> basePtr;
 };
 
+// called when a link<T> is attached to or removed from owner, or its target
+// changes, specialized by types that keep indexes of their links (see
+// sceneNode). target is nullptr for links without one. Links are
+// also removed when their owner is freed, in which case owner and target
+// may both be condemned entities that have already been deleted.
+template <typename T>
+struct linkHooks {
+	static void attached(entity *owner, T *target) {}
+	static void detached(entityManager *manager, entity *owner, T *target) {}
+};
+
 template <typename T = entity>
 class link : public baseLink {
 	public:
+		// hooks run for links without a target too, the owner still has
+		// a new link (eg. one that gets its target set later)
 		link(regArgs t)
-			: baseLink(doRegister(this, t)) {}
+			: baseLink(doRegister(this, t))
+		{
+			linkHooks<T>::attached(t.ent, nullptr);
+		}
 
 		link(regArgs t, T* target)
-			: baseLink(doRegister(this, t), target) {}
+			: baseLink(doRegister(this, t), target)
+		{
+			linkHooks<T>::attached(t.ent, target);
+		}
+
+		// points the link somewhere else, as if it were removed and
+		// attached again
+		void setRef(T* target) {
+			linkHooks<T>::detached(manager, getOwner(), getRef().getPtr());
+			setBaseRef(target);
+			linkHooks<T>::attached(getOwner(), target);
+		}
 
-		~link() {};
+		~link() {
+			linkHooks<T>::detached(manager, getOwner(), getRef().getPtr());
+		};
 
 		ref<T> getRef(void) {
 			return ref_cast<T>(getBaseRef());
@@ -69,10 +69,10 @@ class mailbox {
 		template <typename T>
 		void add(std::shared_ptr<T> ptr) {
 			const char *type = getTypeName<T>();
-			LogFmt("queueing message of type {}", type);
+			LogCatFmt(logcat::ecs, Debug, "queueing message of type {}", type);
 
 			if (messages.size() >= maxMessages) {
-				LogErrorFmt("Message dropped, of type {}", type);
+				LogCatFmt(logcat::ecs, Error, "Message dropped, of type {}", type);
 				return;
 			}
 
@@ -95,7 +95,7 @@ class router {
 			subscribers[type].push_back(mbox);
 
 			if (debug) {
-				LogFmt("[SUB] {}", type);
+				LogCatFmt(logcat::ecs, Debug, "[SUB] {}", type);
 			}
 		}
 
@@ -142,17 +142,17 @@ class router {
 			if (subscribers.find(type) == subscribers.end()) {
 				// no mailboxes waiting for this message type,
 				// nothing to do
-				if (debug) LogFmt("      (No subscribers, dropped {})", type);
+				if (debug) LogCatFmt(logcat::ecs, Debug, "      (No subscribers, dropped {})", type);
 				return;
 			}
 
 			for (auto& mbox : subscribers[type]) {
 				if (auto ptr = mbox.lock()) {
 					ptr->add(message);
-					if (debug) LogFmt("      -> sent to subscriber");
+					if (debug) LogCatFmt(logcat::ecs, Debug, "      -> sent to subscriber");
 
 				} else {
-					if (debug) LogFmt("      -> couldn't lock subscriber");
+					if (debug) LogCatFmt(logcat::ecs, Debug, "      -> couldn't lock subscriber");
 					// TODO: remove subscriber from list
 				}
 			}
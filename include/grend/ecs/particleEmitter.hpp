@@ -0,0 +1,42 @@
+#pragma once
+
+#include <grend/particleSystem.hpp>
+#include <grend/sceneNode.hpp>
+#include <grend/ecs/ecs.hpp>
+
+namespace grendx {
+
+/**
+ * Runs a particleSimulation and feeds it to the entity it's attached to,
+ * which should be a sceneBillboardParticles (positions, sizes and colors)
+ * or a sceneParticles (translation and scale transforms).
+ *
+ * Particles are simulated in world space and spawned at position, which
+ * follows the entity's transform if followEntity is set. The instance
+ * storage on the node grows as needed.
+ */
+class particleEmitter
+	: public ecs::component,
+	  public ecs::updatable
+{
+	public:
+		particleEmitter(ecs::regArgs t);
+		particleEmitter(ecs::regArgs t, const particleSettings& settings);
+		virtual ~particleEmitter();
+
+		virtual void update(ecs::entityManager *manager, float delta);
+
+		// simulation settings and emitter state, particles themselves
+		// aren't saved, deserializing clears the simulation
+		static nlohmann::json serializer(component *comp);
+		static void deserializer(component *comp, nlohmann::json j);
+		static void drawEditor(component *comp) {};
+
+		particleSimulation simulation;
+		glm::vec3 position = glm::vec3(0);
+		bool followEntity = true;
+		bool paused = false;
+};
+
+// namespace grendx
+}
@@ -41,6 +41,16 @@ class rigidBody
 			// TODO: should show warning if there's no physics object
 		}
 
+		// layer and mask are kept across activation/deactivation
+		virtual void setCollisionLayer(uint32_t layer, uint32_t mask = ~0u) {
+			collisionLayer = layer;
+			collisionMask  = mask;
+
+			if (phys) {
+				phys->setCollisionLayer(layer, mask);
+			}
+		}
+
 		virtual void initBody(entityManager *manager, entity *ent) {
 			// class needs to be instantiable for serialization,
 			// so this can't be an abstract function, so note that
@@ -54,6 +64,7 @@ class rigidBody
 				initBody(manager, ent);
 				// TODO: cached angular factor
 				phys->setAngularFactor(cachedAngularFactor);
+				phys->setCollisionLayer(collisionLayer, collisionMask);
 				phys->collisionQueue = cachedQueue;
 			}
 		}
@@ -73,6 +84,8 @@ class rigidBody
 		float mass = 0.f;
 		glm::vec3 cachedAngularFactor = glm::vec3(1.f);
 		glm::vec3 position;
+		uint32_t collisionLayer = 1;
+		uint32_t collisionMask  = ~0u;
 		std::shared_ptr<std::vector<collision>> cachedQueue = nullptr;
 
 		// serialization stuff
@@ -212,6 +225,14 @@ class rigidBodyStaticMesh : public rigidBody,
 			}
 		}
 
+		virtual void setCollisionLayer(uint32_t layer, uint32_t mask = ~0u) {
+			rigidBody::setCollisionLayer(layer, mask);
+
+			for (auto& p : meshObjects) {
+				if (p) p->setCollisionLayer(layer, mask);
+			}
+		}
+
 		virtual void update(entityManager *manager, float delta) {
 			bool needsReset = false;
 
@@ -239,6 +260,8 @@ class rigidBodyStaticMesh : public rigidBody,
 				initBody(manager, ent);
 
 				for (auto& p : meshObjects) {
+					if (!p) continue;
+					p->setCollisionLayer(collisionLayer, collisionMask);
 					p->collisionQueue = cachedQueue;
 				}
 			}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <grend/sceneModel.hpp>
+#include <grend/ecs/ecs.hpp>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace grendx {
+
+class jobQueue;
+
+// density at a point in volume space, values >= isoLevel are solid
+typedef float (*densityFunction)(float x, float y, float z);
+
+struct voxelChunkHash {
+	size_t operator()(const glm::ivec3& k) const {
+		uint64_t h = uint64_t(uint32_t(k.x)) * 0x9e3779b97f4a7c15ull;
+		h ^= uint64_t(uint32_t(k.y)) * 0xc2b2ae3d27d4eb4full;
+		h ^= uint64_t(uint32_t(k.z)) * 0x165667b19e3779f9ull;
+		return h ^ (h >> 31);
+	}
+};
+
+// samples along each side of the padded grid a chunk is meshed from, two
+// extra samples on each side for cells and gradients across chunk borders
+static inline unsigned voxelPaddedSize(unsigned chunkSize) {
+	return chunkSize + 4;
+}
+
+// Meshes one chunk from a padded density grid (x fastest, sample (i,j,k) is
+// voxel (i-2, j-2, k-2) of the chunk) with dual contouring. Each cell the
+// surface passes through gets one vertex, at the mean of the crossings on its
+// edges, and each crossing edge owned by the chunk gets a quad between the
+// four cells around it. Normals come from the density gradient. Positions
+// are relative to the chunk origin. No GL or ECS dependencies.
+void voxelMeshChunk(const float *samples,
+                    unsigned chunkSize,
+                    float isoLevel,
+                    float voxelSize,
+                    std::vector<sceneModel::vertex>& vertices,
+                    std::vector<sceneMesh::faceType>& indices);
+
+/**
+ * Editable voxel volume, stored as chunks of densities.
+ *
+ * Edits mark only the chunks whose meshes they touch as dirty, including
+ * neighbours that sample across the border. Dirty chunks are remeshed in
+ * parallel on the job queue, straight into the buffer components of a
+ * model per chunk, linked under the volume's entity (which needs to be a
+ * sceneNode) and picked up by compileModel() on the next draw.
+ *
+ * Coordinates are in voxels, or in volume space (voxels * voxelSize) for
+ * the functions taking floats. Chunks that were never written are filled
+ * with emptyDensity and take no memory.
+ */
+class voxelVolume
+	: public ecs::component,
+	  public ecs::updatable
+{
+	public:
+		struct volumeSettings {
+			// voxels along each side of a chunk
+			unsigned chunkSize    = 32;
+			float    voxelSize    = 1.f;
+			float    isoLevel     = 0.f;
+			float    emptyDensity = -1.f;
+			// chunks remeshed per update(), 0 for no limit
+			unsigned remeshBudget = 16;
+		};
+
+		voxelVolume(ecs::regArgs t);
+		voxelVolume(ecs::regArgs t, const volumeSettings& settings);
+		virtual ~voxelVolume();
+
+		float get(const glm::ivec3& voxel) const;
+		void  set(const glm::ivec3& voxel, float density);
+		// evaluates func at every voxel in [min, max]
+		void  fill(const glm::ivec3& min, const glm::ivec3& max, densityFunction func);
+		// adds amount, fading out towards the radius, negative to dig
+		void  addSphere(const glm::vec3& center, float radius, float amount);
+
+		// remeshes up to budget dirty chunks (0 for all of them) on the
+		// given job queue, or serially, returns the number remeshed
+		size_t remesh(jobQueue *jobs = nullptr, size_t budget = 0);
+		size_t dirtyChunks(void) const { return dirty.size(); }
+		size_t storedChunks(void) const { return chunks.size(); }
+
+		// remeshes with the engine's job queue, if there is one
+		virtual void update(ecs::entityManager *manager, float delta);
+
+		// set on construction or by deserializer(), changing it after
+		// anything has been written leaves chunks with the wrong size
+		volumeSettings settings;
+
+		// settings plus every chunk that isn't entirely emptyDensity,
+		// densities are stored base64 encoded. Deserializing replaces the
+		// volume's contents and marks everything dirty.
+		static nlohmann::json serializer(component *comp);
+		static void deserializer(component *comp, nlohmann::json j);
+		static void drawEditor(component *comp) {};
+
+	private:
+		struct chunk {
+			// chunkSize^3 densities, x fastest
+			std::vector<float> density;
+		};
+
+		struct chunkMesh {
+			sceneModel::ptr model;
+			sceneMesh::ptr  mesh;
+			std::vector<sceneModel::vertex>  *vertices;
+			std::vector<sceneMesh::faceType> *indices;
+		};
+
+		chunk& getChunk(const glm::ivec3& key);
+		void   markDirty(const glm::ivec3& min, const glm::ivec3& max);
+		// copies the padded sample grid for a chunk into out
+		void   gather(const glm::ivec3& key, std::vector<float>& out) const;
+		chunkMesh& getMesh(sceneNode *root, const glm::ivec3& key);
+
+		std::unordered_map<glm::ivec3, chunk, voxelChunkHash>     chunks;
+		std::unordered_map<glm::ivec3, chunkMesh, voxelChunkHash> meshes;
+		std::unordered_set<glm::ivec3, voxelChunkHash>            dirty;
+};
+
+// namespace grendx
+}
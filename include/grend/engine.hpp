@@ -55,6 +55,21 @@ void drawIrradianceProbe(renderQueue& queue,
                          glm::mat4& transform,
                          renderContext *rctx);
 
+// incremental probe updates, one face or convolution pass per step, see
+// probeScheduler. Return true once the last step is drawn and swapped in.
+unsigned reflectionProbeSteps(sceneReflectionProbe::ptr probe);
+unsigned irradianceProbeSteps(sceneIrradianceProbe::ptr probe);
+bool drawReflectionProbeStep(renderQueue& queue,
+                             sceneReflectionProbe::ptr probe,
+                             glm::mat4& transform,
+                             renderContext *rctx,
+                             unsigned step);
+bool drawIrradianceProbeStep(renderQueue& queue,
+                             sceneIrradianceProbe::ptr probe,
+                             glm::mat4& transform,
+                             renderContext *rctx,
+                             unsigned step);
+
 void buildTilemap(renderQueue::LightQ& queue, camera::ptr cam, renderContext *rctx);
 void buildTilemapTiled(renderQueue::LightQ& queue, camera::ptr cam, renderContext *rctx);
 void buildTilemapClustered(renderQueue::LightQ& queue, camera::ptr cam, renderContext *rctx);
@@ -21,6 +21,8 @@
 #include <grend/ecs/ecs.hpp>
 #include <grend/filePane.hpp>
 
+#include <mutex>
+
 namespace grendx {
 
 class gameEditor : public gameView {
@@ -146,8 +148,9 @@ class gameEditor : public gameView {
 		                 std::set<sceneNode*>& selectedPath);
 
 		// TODO: why is this in the editor class?
-		// list of log messages
+		// list of log messages, appended to from the logger thread
 		std::list<std::string> logEntries;
+		std::mutex logMutex;
 
 		ecs::ref<ecs::entity> getSelectedEntity(void) { return curEntity; };
 
@@ -7,10 +7,12 @@
 #include <grend/glmIncludes.hpp>
 #include <grend/bufferAllocator.hpp>
 #include <grend/textureData.hpp>
+#include <grend/shaderCache.hpp>
 
 #include <vector>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <utility>
 #include <set>
@@ -287,10 +289,20 @@ class Shader : public Obj {
 		typedef std::map<std::string, value> parameters;
 
 		Shader(GLuint o);
+		// preprocesses the source, compiling is deferred until the program
+		// is linked (and skipped if there's a cached program binary)
 		bool load(std::string path, const parameters& options);
 		bool reload(void);
+		bool compile(void);
+		// switches from a packed (stripped) source to the full source,
+		// returns false if the current source didn't come from a pack
+		bool unpack(void);
+
 		std::string filepath = "";
 		parameters compiledOptions;
+		std::shared_ptr<const preprocessedShader> processed;
+		// hash of the source that was last compiled successfully, 0 if none
+		uint64_t compiledHash = 0;
 };
 
 // combines parameter maps together, entries later in the list will override
@@ -308,6 +320,8 @@ class Program : public Obj {
 
 		bool good(void) { return linked; };
 		bool reload(void);
+		// links from the program binary cache if possible, otherwise
+		// compiles shaders and links normally, then stores the binary
 		bool link(void);
 		std::string log(void);
 
@@ -344,12 +358,20 @@ class Program : public Obj {
 		// for every mesh call compared to testing a pointer per mesh
 		std::unordered_map<const char *, uintptr_t> objCache;
 
-		std::map<std::string, GLint>  uniforms;
+		std::unordered_map<std::string, GLint> uniforms;
 		std::map<std::string, GLuint> attributes;
 		std::map<std::string, GLuint> uniformBlocks;
 		std::map<std::string, GLuint> storageBlocks;
 
 		Shader::parameters valueCache;
+
+		// uniform names from shader reflection (packed shaders only), names
+		// that aren't in here are known to not exist so lookups can skip GL
+		std::unordered_set<std::string> reflectedUniforms;
+
+	private:
+		// fill uniform/block location caches from reflection info
+		void prefetchUniforms(void);
 };
 
 class Framebuffer : public Obj {
@@ -7,6 +7,7 @@
 #include <vector>
 #include <list>
 #include <utility>
+#include <functional>
 #include <memory>
 #include <condition_variable>
 #include <chrono>
@@ -30,10 +31,18 @@ class jobQueue : public IoC::Service {
 		void runDeferred(void);
 		bool runSingleDeferred(void);
 
+		// calls fn(i) for i in [0, count) on the async workers, with the
+		// calling thread helping out, and returns once every call finished.
+		// The caller never waits on queued jobs, so this is safe to use from
+		// inside an async job (and on emscripten, where it runs serially).
+		// fn must not throw.
+		void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
 	private:
 		// worker main loop
 		void worker(void);
-		// blocks if there's no available jobs
+		// blocks if there's no available jobs, returns an empty task once
+		// the queue is shutting down and drained
 		std::packaged_task<bool()> getAsync(void);
 
 		bool running = true;
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <grend/IoC.hpp>
+#include <grend/glmIncludes.hpp>
+
+#include <unordered_map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+// screen-space error LOD selection, picks one of the index ranges generated
+// by sceneModel::optimizeMeshes() for each queued mesh. No GL dependencies,
+// see selectLods() in renderQueue.cpp for where this is used
+
+namespace grendx {
+
+enum class lodPass {
+	Main,
+	Shadow,
+	Probe,
+	Count,
+};
+
+struct lodSettings {
+	bool  enabled    = true;
+	// largest allowed projected error, in pixels
+	float pixelError = 1.f;
+	// multipliers on pixelError, shadow maps and probes are low resolution
+	// or blurred, so they can get away with much coarser geometry
+	float shadowBias = 4.f;
+	float probeBias  = 4.f;
+	// relative band around the threshold where the previous level is kept,
+	// so meshes at the threshold distance don't flip every frame
+	float hysteresis = 0.2f;
+};
+
+// projected size in pixels of one world unit at the given distance
+float lodPixelScale(float fovyDegrees, unsigned viewHeight, float distance);
+
+// levels[0] is the full mesh, with error 0, errors are increasing and
+// already converted to pixels. Returns the coarsest level within threshold,
+// widened by hysteresis if there's a previous level (-1 for none).
+unsigned selectLod(const float *errors, size_t levels,
+                   float threshold, int previous = -1, float hysteresis = 0.f);
+
+class lodSelector : public IoC::Service {
+	public:
+		typedef std::shared_ptr<lodSelector> ptr;
+		typedef std::weak_ptr<lodSelector>   weakptr;
+
+		struct passStats {
+			size_t meshes    = 0;
+			// triangles in the selected levels, and in full detail
+			size_t triangles = 0;
+			size_t fullTriangles = 0;
+		};
+
+		virtual ~lodSelector();
+
+		// mesh and instance identify an instance across frames (see
+		// renderQueue::queueEnt::instance), errors are in the mesh's units
+		// and pixelScale converts them to pixels (see lodPixelScale())
+		unsigned select(const void *mesh,
+		                uint64_t instance,
+		                lodPass pass,
+		                const float *errors,
+		                size_t levels,
+		                float pixelScale);
+
+		void addTriangles(lodPass pass, size_t selected, size_t full);
+
+		// stats for the last finished frame, expires old hysteresis state
+		void newFrame(void);
+		const passStats& stats(lodPass pass) const {
+			return lastFrame[size_t(pass)];
+		}
+
+		lodSettings settings;
+
+	private:
+		struct instanceState {
+			uint32_t lastFrame;
+			uint8_t  level;
+		};
+
+		std::unordered_map<uint64_t, instanceState> instances;
+		passStats current[size_t(lodPass::Count)];
+		passStats lastFrame[size_t(lodPass::Count)];
+		uint32_t frame = 0;
+};
+
+// namespace grendx
+}
@@ -1,29 +1,220 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <functional>
+#include <atomic>
+#include <tuple>
+#include <type_traits>
+#include <new>
+#include <cstddef>
+#include <stdint.h>
 
 #include <format>
 
+// messages below this level are compiled out entirely,
+// 0 = debug, 1 = info, 2 = warning, 3 = error
+#ifndef GREND_LOG_LEVEL
+#define GREND_LOG_LEVEL 0
+#endif
+
 namespace grendx {
 
 enum LogType {
+	Debug,
 	Info,
 	Warning,
 	Error,
 };
 
+/**
+ * Named log category with a runtime level threshold.
+ *
+ * Messages are checked against their category's level before any formatting
+ * happens, so disabled messages cost a load and a branch. Levels can be set
+ * directly, or with LogConfigure() (also read from the GREND_LOG environment
+ * variable on startup).
+ */
+class logCategory {
+	public:
+		logCategory(const char *_name, enum LogType _level = LogType::Info);
+
+		bool enabled(enum LogType type) const {
+			return type >= level.load(std::memory_order_relaxed);
+		}
+
+		void setLevel(enum LogType type) {
+			level.store(type, std::memory_order_relaxed);
+		}
+
+		const char *name;
+		std::atomic<int> level;
+};
+
+namespace logcat {
+	extern logCategory general;
+	extern logCategory ecs;
+	extern logCategory loader;
+	extern logCategory render;
+	extern logCategory physics;
+	extern logCategory audio;
+	extern logCategory editor;
+}
+
+// per call site state for rate limiting repeated messages, created by the
+// logging macros
+struct logSite {
+	std::atomic<uint64_t> window     = 0;
+	std::atomic<uint32_t> count      = 0;
+	std::atomic<uint32_t> suppressed = 0;
+};
+
+/**
+ * Queued log message.
+ *
+ * Arguments that can be safely copied (numbers, pointer values, strings)
+ * are stored in the record and formatted on the writer thread, anything
+ * else is formatted on the calling thread before queueing.
+ */
+struct logRecord {
+	enum { storageSize = 128 };
+
+	enum LogType type;
+	const logCategory *category;
+	std::string_view format;
+	// formats the stored arguments into out, and destroys them
+	void (*formatter)(logRecord& rec, std::string& out);
+
+	alignas(std::max_align_t) unsigned char storage[storageSize];
+};
+
+namespace logging {
+	// argument types as stored in records, void if the type
+	// can't be deferred
+	template <typename T, typename = void>
+	struct capture { using type = void; };
+
+	template <typename T>
+	struct capture<T, std::enable_if_t<std::is_arithmetic_v<T>>> { using type = T; };
+
+	template <> struct capture<const char *>     { using type = std::string; };
+	template <> struct capture<char *>           { using type = std::string; };
+	template <> struct capture<std::string>      { using type = std::string; };
+	template <> struct capture<std::string_view> { using type = std::string; };
+	template <> struct capture<void *>           { using type = const void *; };
+	template <> struct capture<const void *>     { using type = const void *; };
+
+	template <typename T>
+	using captureType = typename capture<std::decay_t<T>>::type;
+
+	template <typename... Args>
+	constexpr bool deferrable =
+		(!std::is_void_v<captureType<Args>> && ...)
+		&& sizeof(std::tuple<captureType<Args>...>) <= logRecord::storageSize;
+
+	template <typename Tuple>
+	void formatRecord(logRecord& rec, std::string& out) {
+		Tuple *args = std::launder(reinterpret_cast<Tuple*>(rec.storage));
+
+		std::apply([&] (auto&... xs) {
+			out = std::vformat(rec.format, std::make_format_args(xs...));
+		}, *args);
+
+		args->~Tuple();
+	}
+
+	// queue management, returns a slot to fill in and commit, or
+	// nullptr if the queue is full (message is dropped)
+	logRecord *reserve(enum LogType type);
+	void commit(logRecord *rec);
+
+	// rate limiting, returns false if the message should be dropped,
+	// suppressed is set to the count of messages dropped since the last
+	// one that was let through
+	bool allow(logSite& site, uint32_t& suppressed);
+	void reportSuppressed(const logCategory& cat, enum LogType type, uint32_t count);
+
+	template <typename... Args>
+	void emit(logSite& site,
+	          const logCategory& cat,
+	          enum LogType type,
+	          std::format_string<Args...> fmt,
+	          Args&&... args)
+	{
+		uint32_t suppressed = 0;
+		if (!allow(site, suppressed)) {
+			return;
+		}
+
+		if (suppressed > 0) {
+			reportSuppressed(cat, type, suppressed);
+		}
+
+		logRecord *rec = reserve(type);
+		if (!rec) return;
+
+		rec->type     = type;
+		rec->category = &cat;
+
+		if constexpr (deferrable<Args...>) {
+			using Tuple = std::tuple<captureType<Args>...>;
+			new (rec->storage) Tuple(std::forward<Args>(args)...);
+			rec->format    = fmt.get();
+			rec->formatter = formatRecord<Tuple>;
+
+		} else {
+			using Tuple = std::tuple<std::string>;
+			new (rec->storage) Tuple(std::format(fmt, std::forward<Args>(args)...));
+			rec->format    = "{}";
+			rec->formatter = formatRecord<Tuple>;
+		}
+
+		commit(rec);
+	}
+
+	// namespace logging
+}
+
+void LogDebug(const std::string& message);
 void LogInfo(const std::string& message);
 void LogWarn(const std::string& message);
 void LogError(const std::string& message);
 
-#define LogFmt(...)      LogInfo(std::format(__VA_ARGS__));
-#define LogInfoFmt(...)  LogInfo(std::format(__VA_ARGS__));
-#define LogWarnFmt(...)  LogWarn(std::format(__VA_ARGS__));
-#define LogErrorFmt(...) LogError(std::format(__VA_ARGS__));
+#define GREND_LOG_AT(CATEGORY, TYPE, ...) \
+	do { \
+		if constexpr ((TYPE) >= GREND_LOG_LEVEL) { \
+			if ((CATEGORY).enabled(TYPE)) { \
+				static ::grendx::logSite logSite_; \
+				::grendx::logging::emit(logSite_, (CATEGORY), (TYPE), __VA_ARGS__); \
+			} \
+		} \
+	} while (0)
 
+// category-specific variants, eg. LogCatFmt(logcat::ecs, Debug, "thing {}", x)
+#define LogCatFmt(CATEGORY, TYPE, ...) \
+	GREND_LOG_AT(CATEGORY, ::grendx::LogType::TYPE, __VA_ARGS__)
+
+#define LogFmt(...)      GREND_LOG_AT(::grendx::logcat::general, ::grendx::LogType::Info, __VA_ARGS__);
+#define LogDebugFmt(...) GREND_LOG_AT(::grendx::logcat::general, ::grendx::LogType::Debug, __VA_ARGS__);
+#define LogInfoFmt(...)  GREND_LOG_AT(::grendx::logcat::general, ::grendx::LogType::Info, __VA_ARGS__);
+#define LogWarnFmt(...)  GREND_LOG_AT(::grendx::logcat::general, ::grendx::LogType::Warning, __VA_ARGS__);
+#define LogErrorFmt(...) GREND_LOG_AT(::grendx::logcat::general, ::grendx::LogType::Error, __VA_ARGS__);
+
+// callbacks are called from the logger thread, in message order
 using LogCallbackFunc = std::function<void(enum LogType, const std::string&)>;
 void LogCallback(LogCallbackFunc callback);
 
+// category level configuration, in the form "category=level,...",
+// "*" sets every category, eg. "*=warning,ecs=debug"
+void LogConfigure(const std::string& spec);
+logCategory *LogFindCategory(std::string_view name);
+
+// messages per second allowed from a single call site, 0 to disable limiting
+void LogSetRateLimit(unsigned perSecond);
+// enable/disable writing messages to the console (callbacks still run)
+void LogConsoleOutput(bool enabled);
+// block until all queued messages have been written
+void LogFlush(void);
+
 // namespace grendx
 }
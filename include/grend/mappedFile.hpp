@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace grendx {
+
+// read-only view of a file's contents, memory-mapped where that's available,
+// otherwise read into a buffer
+class mappedFile {
+	public:
+		mappedFile() = default;
+		mappedFile(const std::string& path) { open(path); }
+		~mappedFile() { close(); }
+
+		mappedFile(const mappedFile&) = delete;
+		mappedFile& operator=(const mappedFile&) = delete;
+		mappedFile(mappedFile&& other) noexcept { *this = std::move(other); }
+		mappedFile& operator=(mappedFile&& other) noexcept;
+
+		bool open(const std::string& path);
+		void close(void);
+
+		// empty files are "good" too, this only fails if the file couldn't
+		// be opened or read
+		bool good(void) const { return isOpen; }
+
+		const char *data(void) const { return ptr; }
+		size_t size(void) const { return length; }
+		std::string_view view(void) const { return {ptr, length}; }
+
+	private:
+		const char *ptr = nullptr;
+		size_t length = 0;
+		bool isOpen = false;
+		bool isMapped = false;
+		// used when the file can't be mapped
+		std::vector<char> buffer;
+};
+
+// namespace grendx
+}
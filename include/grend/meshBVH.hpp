@@ -0,0 +1,156 @@
+#pragma once
+
+#include <grend/glmIncludes.hpp>
+#include <grend/boundingBox.hpp>
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+namespace grendx {
+
+// distance along the ray to where it enters the box, if it does before tmax,
+// inv is 1/direction
+static inline bool rayBoxEntry(const AABB& box,
+                               const glm::vec3& origin,
+                               const glm::vec3& inv,
+                               float tmax,
+                               float& tnear)
+{
+	float t0 = 0, t1 = tmax;
+
+	for (int i = 0; i < 3; i++) {
+		float a = (box.min[i] - origin[i]) * inv[i];
+		float b = (box.max[i] - origin[i]) * inv[i];
+
+		t0 = fmaxf(t0, fminf(a, b));
+		t1 = fminf(t1, fmaxf(a, b));
+	}
+
+	tnear = t0;
+	return t0 <= t1;
+}
+
+/**
+ * Bounding volume hierarchy over boxes, built with binned SAH splits.
+ * Used for triangles within a mesh (meshBVH) and for mesh instances in a
+ * scene (raycastScene).
+ */
+struct bvhTree {
+	struct node {
+		AABB box;
+		// leaves: range [first, first + count) in order,
+		// interior nodes: count is 0, the left child follows this node
+		// and the right child is at first
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// build() keeps the tree within this depth, for the traversal stack
+	static constexpr unsigned maxDepth = 96;
+
+	std::vector<node>     nodes;
+	// primitive indices, in leaf order
+	std::vector<uint32_t> order;
+
+	void build(const std::vector<AABB>& boxes, unsigned maxLeaf = 4);
+
+	// calls leaf(position) for each primitive position in order whose leaf
+	// the ray reaches within tmax, nearer boxes first. leaf() returns the
+	// distance to a hit, which shrinks tmax, or anything >= tmax for none.
+	template <typename F>
+	void traverse(const glm::vec3& origin,
+	              const glm::vec3& dir,
+	              float& tmax,
+	              F&& leaf) const
+	{
+		if (nodes.empty()) {
+			return;
+		}
+
+		glm::vec3 inv(1.f / dir.x, 1.f / dir.y, 1.f / dir.z);
+		uint32_t stack[maxDepth + 1];
+		unsigned top = 0;
+		float t;
+
+		if (!rayBoxEntry(nodes[0].box, origin, inv, tmax, t)) {
+			return;
+		}
+
+		stack[top++] = 0;
+
+		while (top > 0) {
+			const node& n = nodes[stack[--top]];
+
+			if (n.count > 0) {
+				for (uint32_t i = n.first; i < n.first + n.count; i++) {
+					tmax = fminf(tmax, leaf(i));
+				}
+
+				continue;
+			}
+
+			uint32_t a = &n - nodes.data() + 1, b = n.first;
+			float ta, tb;
+			bool hitA = rayBoxEntry(nodes[a].box, origin, inv, tmax, ta);
+			bool hitB = rayBoxEntry(nodes[b].box, origin, inv, tmax, tb);
+
+			// nearer child on top of the stack, so tmax shrinks sooner
+			if (hitA && hitB && tb < ta) {
+				std::swap(a, b);
+			}
+
+			if (hitB) stack[top++] = b;
+			if (hitA) stack[top++] = a;
+		}
+	}
+};
+
+struct meshHit {
+	// in units of the ray direction's length
+	float    distance;
+	uint32_t triangle;
+	// barycentric coordinates of the hit along the triangle's second and
+	// third vertices
+	float    u, v;
+	// geometric normal, not normalized, facing against the ray
+	glm::vec3 normal;
+};
+
+/**
+ * Triangle BVH for ray casts against a mesh in its object space. Triangles
+ * are two-sided, and ones with out of range indices are skipped. No GL or
+ * ECS dependencies, see sceneModel::buildBVHs().
+ */
+class meshBVH {
+	public:
+		typedef std::shared_ptr<meshBVH> ptr;
+		typedef std::weak_ptr<meshBVH>   weakptr;
+
+		meshBVH(const float *positions, size_t stride, size_t vertexCount,
+		        const uint32_t *indices, size_t indexCount);
+
+		// closest hit within maxDist
+		bool raycast(const glm::vec3& origin,
+		             const glm::vec3& dir,
+		             float maxDist,
+		             meshHit& out) const;
+
+		const AABB& bounds(void) const { return box; }
+		size_t triangles(void) const { return triIndex.size(); }
+		size_t nodes(void) const { return tree.nodes.size(); }
+
+	private:
+		bvhTree tree;
+		AABB box = {glm::vec3(0), glm::vec3(0)};
+
+		// first vertex and edges of each triangle, in tree order
+		std::vector<glm::vec3> v0, e1, e2;
+		std::vector<uint32_t>  triIndex;
+};
+
+// namespace grendx
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// import-time mesh optimization passes. No GL/ECS dependencies, everything
+// works on 32 bit triangle list indices and interleaved float vertex data
+// given as a pointer to the first element plus a byte stride
+// (see sceneModel::optimizeMeshes() for how the engine uses these)
+
+namespace grendx {
+
+// false if GREND_MESH_OPTIMIZE=0 is set, for checking import times and
+// comparing against unoptimized meshes
+bool meshOptimizeEnabled(void);
+
+// average number of post-transform cache misses per triangle, for a FIFO
+// cache of the given size. 0.5 is the lower bound for regular grids,
+// 3 is the worst case.
+float computeACMR(const uint32_t *indices, size_t indexCount,
+                  size_t vertexCount, unsigned cacheSize = 16);
+
+// reorders triangles for post-transform cache locality (Forsyth's
+// linear-speed algorithm)
+void optimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+// splits cache-optimized triangles into clusters wherever that raises the
+// ACMR by no more than threshold, and sorts clusters so that outward
+// facing ones are drawn first, which helps depth testing reject more of
+// the inner ones
+void optimizeOverdraw(uint32_t *indices, size_t indexCount,
+                      const float *positions, size_t vertexCount,
+                      size_t vertexStride, float threshold = 1.05f);
+
+// table ordering vertices by first use in the index buffer, so vertex
+// fetches are mostly sequential. Unreferenced vertices keep their relative
+// order at the end. remap[old] = new.
+std::vector<uint32_t> vertexFetchRemap(const uint32_t *indices, size_t indexCount,
+                                       size_t vertexCount);
+
+void remapIndices(uint32_t *indices, size_t indexCount,
+                  const std::vector<uint32_t>& remap);
+
+template <typename T>
+void remapVertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap) {
+	std::vector<T> ret(vertices.size());
+
+	for (size_t i = 0; i < vertices.size() && i < remap.size(); i++) {
+		ret[remap[i]] = vertices[i];
+	}
+
+	vertices.swap(ret);
+}
+
+// largest extent of the vertices' bounding box, simplification errors are
+// relative to this
+float meshExtent(const float *positions, size_t vertexCount, size_t vertexStride);
+
+/**
+ * Quadric error simplification by edge collapse.
+ *
+ * Writes at most indexCount indices to dest (which may alias indices) and
+ * returns the number written, stopping at targetIndexCount or when the next
+ * collapse would exceed targetError (relative to meshExtent()).
+ *
+ * Vertices are welded by position and texcoord (texcoords can be null),
+ * vertices sharing a position with different texcoords (UV seams) and
+ * non-manifold vertices are kept in place, and mesh borders only collapse
+ * along themselves. Output indices reference one of the original vertices
+ * for each welded group.
+ *
+ * resultError, if given, is set to the largest error of any collapse made,
+ * also relative to meshExtent().
+ */
+size_t simplifyMesh(uint32_t *dest,
+                    const uint32_t *indices, size_t indexCount,
+                    const float *positions, const float *texcoords,
+                    size_t vertexCount, size_t vertexStride,
+                    size_t targetIndexCount, float targetError,
+                    float *resultError = nullptr);
+
+// namespace grendx
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <grend/glmIncludes.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <stdint.h>
+
+// wavefront .obj/.mtl parsing, kept separate from building scene nodes
+// (see load_object() in objModel.cpp) so that it doesn't need an entity
+// manager or GL types
+
+namespace grendx {
+
+struct objData {
+	struct vertex {
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+
+	// run of triangles with one object name/material, started by
+	// "o" and "usemtl" statements
+	struct group {
+		std::string object;
+		// empty if no material was given
+		std::string material;
+		// triangle list, indexes into vertices
+		std::vector<uint32_t> indices;
+	};
+
+	// vertices are deduplicated by (position, texcoord, normal) index when
+	// the file has normals. Without normals every face corner gets its own
+	// vertex, so that generated normals are flat.
+	std::vector<vertex> vertices;
+	std::vector<group> groups;
+	// as written in "mtllib" statements, relative to the .obj
+	std::vector<std::string> materialLibs;
+
+	bool haveNormals   = false;
+	bool haveTexcoords = false;
+};
+
+struct mtlMaterial {
+	std::string name;
+
+	// only set if present in the file
+	std::optional<glm::vec4> ambient;
+	std::optional<glm::vec4> diffuse;
+	std::optional<glm::vec4> specular;
+	std::optional<float>     opacity;
+	std::optional<float>     specularExponent;
+	std::optional<int>       illum;
+
+	// as written in the file, relative to the .mtl, empty if not present
+	std::string diffuseMap;
+	std::string specularMap;
+	std::string ambientOcclusionMap;
+	std::string normalMap;
+};
+
+// source is split into line-aligned chunks parsed on up to maxThreads
+// threads (0 for hardware concurrency). Returns false if nothing could be
+// parsed, malformed statements and out-of-range indices are skipped.
+bool parseObj(std::string_view source, objData& out, unsigned maxThreads = 0);
+// memory-maps the file and parses it as above
+bool parseObjFile(const std::string& path, objData& out, unsigned maxThreads = 0);
+
+void parseMtl(std::string_view source, std::vector<mtlMaterial>& out);
+
+// namespace grendx
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <grend/IoC.hpp>
+#include <grend/glmIncludes.hpp>
+#include <grend/boundingBox.hpp>
+#include <grend/lodSelector.hpp>
+
+#include <vector>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace grendx {
+
+class jobQueue;
+
+/**
+ * Low resolution software depth buffer for occlusion culling.
+ *
+ * Occluder triangles are clipped against the near plane and binned into
+ * horizontal bands of rows, then each band is rasterized independently
+ * (on the job workers, if given) into a float depth buffer, sampling at pixel
+ * centers. A max-depth pyramid built on top of that answers conservative
+ * "is this box hidden" queries in a constant number of reads.
+ *
+ * Depths are OpenGL NDC z remapped to [0, 1], so the same view-projection
+ * matrix used for rendering can be used here. No GL dependencies.
+ */
+class occlusionBuffer {
+	public:
+		occlusionBuffer(unsigned width = 256, unsigned height = 128);
+
+		void resize(unsigned width, unsigned height);
+		// clears depths to the far plane and drops queued occluders
+		void clear(void);
+
+		// queues the triangles of an indexed mesh, transformed into clip space
+		// by mvp. Positions are given as a pointer to the first vertex's
+		// position and a byte stride between vertices.
+		void addOccluder(const glm::mat4& mvp,
+		                 const float *positions, size_t stride, size_t vertexCount,
+		                 const uint32_t *indices, size_t indexCount);
+
+		// rasterizes everything queued since clear(), and rebuilds the
+		// depth pyramid. Runs serially if jobs is null.
+		void rasterize(jobQueue *jobs = nullptr);
+
+		// true if any part of the box could be visible
+		bool testAABB(const glm::mat4& mvp, const AABB& box) const;
+		// rectangle in NDC xy, with the nearest depth of the tested object
+		bool testRect(glm::vec2 ndcMin, glm::vec2 ndcMax, float nearestDepth) const;
+
+		unsigned width(void)  const { return w; }
+		unsigned height(void) const { return h; }
+		size_t triangles(void) const { return tris.size(); }
+
+		// level 0 depth at pixel (x, y), for debugging/tests
+		float depth(unsigned x, unsigned y) const { return levels[0][y*w + x]; }
+
+	private:
+		// screen space triangle, x/y in pixels, z in [0, 1]
+		struct screenTri {
+			float x[3], y[3], z[3];
+		};
+
+		void addClipTriangle(const glm::vec4 *clip);
+		void rasterizeBand(unsigned band);
+		void buildPyramid(void);
+
+		unsigned w = 0, h = 0;
+		std::vector<screenTri> tris;
+		std::vector<std::vector<uint32_t>> bands;
+		// levels[0] is full resolution, each level after that stores the
+		// farthest depth of a 2x2 block of the previous one
+		std::vector<std::vector<float>> levels;
+		std::vector<std::pair<unsigned, unsigned>> levelSizes;
+
+		// transformed vertices, reused between occluders
+		std::vector<glm::vec4> clipVerts;
+};
+
+// occlusion culling state for render queues, see occlusionCullQueue()
+// in renderQueue.cpp
+class occlusionCuller : public IoC::Service {
+	public:
+		typedef std::shared_ptr<occlusionCuller> ptr;
+		typedef std::weak_ptr<occlusionCuller>   weakptr;
+
+		struct cullSettings {
+			bool enabled = true;
+			// per pass, shadow cube faces each rasterize their own occluders
+			bool passes[size_t(lodPass::Count)] = {true, true, false};
+			// occluders smaller than this fraction of the screen height
+			// aren't worth rasterizing
+			float minOccluderSize = 0.05f;
+			// per pass, occluders are rasterized at full detail
+			size_t maxOccluderTriangles = 8192;
+		};
+
+		struct frameStats {
+			size_t passes    = 0;
+			size_t occluders = 0;
+			size_t occluderTriangles = 0;
+			size_t tested = 0;
+			size_t culled = 0;
+			// nanoseconds
+			uint64_t rasterizeTime = 0;
+			uint64_t testTime      = 0;
+		};
+
+		virtual ~occlusionCuller();
+
+		// stats for the last finished frame
+		void newFrame(void);
+		const frameStats& stats(void) const { return lastFrame; }
+
+		cullSettings settings;
+		occlusionBuffer buffer;
+		frameStats current;
+
+	private:
+		frameStats lastFrame;
+};
+
+// namespace grendx
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <grend/glmIncludes.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <random>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace grendx {
+
+class jobQueue;
+
+// piecewise linear curve over normalized particle age, keys sorted by time
+template <typename T>
+struct particleCurve {
+	std::vector<std::pair<float, T>> keys;
+
+	bool empty(void) const { return keys.empty(); }
+
+	T eval(float t) const {
+		if (t <= keys.front().first) return keys.front().second;
+		if (t >= keys.back().first)  return keys.back().second;
+
+		size_t i = 1;
+		while (keys[i].first < t) i++;
+
+		auto& [t0, a] = keys[i - 1];
+		auto& [t1, b] = keys[i];
+		float x = (t - t0) / std::max(t1 - t0, 1e-6f);
+		return a + (b - a)*x;
+	}
+};
+
+struct particleSettings {
+	// particles spawned per second
+	float spawnRate = 50.f;
+
+	struct burst {
+		// seconds since the emitter started
+		float    time;
+		unsigned count;
+		// repeats every interval seconds, 0 for once
+		float    interval = 0.f;
+	};
+
+	std::vector<burst> bursts;
+
+	// seconds
+	float lifetimeMin = 1.f;
+	float lifetimeMax = 2.f;
+
+	// initial velocity around direction, spread 0 goes straight along
+	// direction, 1 goes in any direction
+	glm::vec3 direction = glm::vec3(0, 1, 0);
+	float spread   = 0.25f;
+	float speedMin = 1.f;
+	float speedMax = 2.f;
+
+	// world units spawned particles are scattered over around the origin
+	float spawnRadius = 0.f;
+
+	float sizeMin = 0.1f;
+	float sizeMax = 0.2f;
+	glm::vec4 color = glm::vec4(1);
+
+	glm::vec3 gravity = glm::vec3(0, -9.81f, 0);
+	// fraction of velocity lost per second
+	float drag = 0.f;
+
+	// multiply the initial size and color over each particle's lifetime
+	particleCurve<float>     sizeCurve;
+	particleCurve<glm::vec4> colorCurve;
+
+	size_t maxParticles = 100000;
+};
+
+/**
+ * CPU particle simulation, with particles stored as structures of arrays.
+ *
+ * Integration, curve evaluation and output are split into blocks run with
+ * jobQueue::parallelFor. The per-particle loops are straight-line float math
+ * over contiguous arrays, written to be auto-vectorized rather than with
+ * intrinsics, since the same code builds for emscripten. Dead particles are
+ * removed and bounds are accumulated in the same per-block pass, survivors
+ * keep their order and live particles are always [0, count).
+ *
+ * No GL or ECS dependencies, see particleEmitter for the component feeding
+ * sceneParticles/sceneBillboardParticles.
+ */
+class particleSimulation {
+	public:
+		// particles per parallelFor block
+		static constexpr size_t blockSize = 8192;
+
+		particleSimulation(const particleSettings& settings = particleSettings(),
+		                   uint32_t seed = 1);
+
+		// spawns count particles now, in addition to the rate and bursts
+		void burst(unsigned count);
+		// advances by delta seconds, spawning at origin (in world space)
+		void step(float delta, const glm::vec3& origin, jobQueue *jobs = nullptr);
+		void clear(void);
+
+		size_t count(void) const { return live; }
+
+		// xyz position and w size, and colors, for billboards
+		void writeBillboards(glm::vec4 *positions, glm::vec4 *colors,
+		                     jobQueue *jobs = nullptr) const;
+		// translation and uniform scale, for instanced meshes, transformed
+		// by toLocal (eg. the inverse of the instancing node's world matrix)
+		void writeTransforms(glm::mat4 *transforms,
+		                     const glm::mat4& toLocal = glm::mat4(1),
+		                     jobQueue *jobs = nullptr) const;
+
+		// box around every live particle, padded by the largest particle
+		// size, as of the last step(). Both are the spawn origin if there
+		// are no particles.
+		const glm::vec3& boundsMin(void) const { return bmin; }
+		const glm::vec3& boundsMax(void) const { return bmax; }
+
+		particleSettings settings;
+
+		// particle data, only [0, count()) is valid
+		std::vector<float> px, py, pz;
+		std::vector<float> vx, vy, vz;
+		std::vector<float> age, lifetime;
+		std::vector<float> startSize, size;
+		std::vector<float> r, g, b, a;
+
+	private:
+		// survivors and bounds of one block after simulate()
+		struct blockResult {
+			size_t    live;
+			glm::vec3 min, max;
+			float     maxSize;
+		};
+
+		void spawn(size_t n, const glm::vec3& origin, blockResult& res);
+		void simulate(size_t begin, size_t end, float delta, blockResult& res);
+		void forBlocks(jobQueue *jobs, const std::function<void(size_t, size_t)>& fn) const;
+
+		size_t live = 0;
+		std::vector<blockResult> blockResults;
+		glm::vec3 bmin = glm::vec3(0), bmax = glm::vec3(0);
+		unsigned pendingBurst = 0;
+		float spawnAccum = 0;
+		float time = 0;
+		std::minstd_rand rng;
+};
+
+// namespace grendx
+}
@@ -6,6 +6,8 @@
 #include <grend/TRS.hpp>
 #include <grend/boundingBox.hpp>
 #include <grend/IoC.hpp>
+#include <grend/contactStream.hpp>
+#include <grend/tripleBuffer.hpp>
 
 #include <unordered_map>
 #include <unistd.h>
@@ -14,6 +16,10 @@
 #include <memory>
 #include <iostream>
 #include <functional>
+#include <chrono>
+#include <span>
+#include <vector>
+#include <algorithm>
 
 namespace grendx {
 
@@ -22,6 +28,7 @@ class sceneModel;
 class sceneMesh;
 
 class physicsObject;
+class jobQueue;
 
 struct collision {
 	std::shared_ptr<physicsObject> a, b;
@@ -31,6 +38,43 @@ struct collision {
 	float depth;
 };
 
+// dynamic object transforms at the end of a simulation step,
+// along with the transform from the step before for interpolation
+struct physicsSnapshot {
+	struct entry {
+		physicsObject *obj;
+		void *data;
+		TRS previous;
+		TRS current;
+		glm::vec3 velocity;
+	};
+
+	// sorted by obj
+	std::vector<entry> transforms;
+	uint64_t step = 0;
+	float stepSize = 0.f;
+	std::chrono::steady_clock::time_point time;
+
+	// nullptr if the object isn't in the snapshot
+	const entry *find(const physicsObject *obj) const {
+		auto it = std::lower_bound(transforms.begin(), transforms.end(), obj,
+			[] (const entry& e, const physicsObject *o) { return e.obj < o; });
+
+		return (it != transforms.end() && it->obj == obj)? &*it : nullptr;
+	}
+
+	// interpolation amount between previous and current transforms
+	// for the given time, [0, 1]
+	float interpolation(std::chrono::steady_clock::time_point now) const {
+		if (stepSize <= 0.f) {
+			return 1.f;
+		}
+
+		std::chrono::duration<float> elapsed = now - time;
+		return glm::clamp(elapsed.count() / stepSize, 0.f, 1.f);
+	}
+};
+
 class physicsObject {
 	public:
 		typedef std::shared_ptr<physicsObject> ptr;
@@ -57,9 +101,82 @@ class physicsObject {
 
 		virtual void removeSelf(void) = 0;
 
+		// collision layers, contact events are only generated between
+		// objects where each object's layer is in the other object's mask
+		virtual void setCollisionLayer(uint32_t layer, uint32_t mask = ~0u) {
+			collisionLayer = layer;
+			collisionMask  = mask;
+		}
+
+		uint32_t collisionLayer = 1;
+		uint32_t collisionMask  = ~0u;
+
+		// legacy per-object collision queue, prefer physics::getContacts(),
+		// filtered by collision layer the same way
 		std::shared_ptr<std::vector<collision>> collisionQueue = nullptr;
 };
 
+// which objects a scene query can hit
+struct physicsQueryFilter {
+	// objects are skipped unless their collision layer is in the mask
+	uint32_t mask = ~0u;
+	// skipped objects, eg. the querying entity's own body
+	physicsObject *ignore = nullptr;
+	void *ignoreData = nullptr;
+
+	bool accepts(const physicsObject *obj, void *data) const {
+		return (obj->collisionLayer & mask)
+		    && obj != ignore
+		    && !(ignoreData && data == ignoreData);
+	}
+};
+
+struct physicsRay {
+	glm::vec3 from;
+	glm::vec3 to;
+	physicsQueryFilter filter;
+};
+
+// sphere, or a capsule along the y axis if height > 0 (height doesn't
+// include the end caps, same as addCapsule())
+struct physicsSweep {
+	glm::vec3 from;
+	glm::vec3 to;
+	float radius;
+	float height = 0.f;
+	physicsQueryFilter filter;
+};
+
+struct physicsOverlap {
+	enum shape : uint8_t {
+		Sphere,
+		// axis-aligned, tested against object bounds
+		Box,
+	};
+
+	enum shape shape = Sphere;
+	glm::vec3 center;
+	float radius = 0.f;
+	// half extents, for boxes
+	glm::vec3 extent = glm::vec3(0);
+	physicsQueryFilter filter;
+};
+
+struct physicsHit {
+	physicsObject *obj = nullptr;
+	void *data = nullptr;
+	glm::vec3 position = glm::vec3(0);
+	glm::vec3 normal   = glm::vec3(0);
+	// distance along the ray or sweep, [0, 1]
+	float fraction = 1.f;
+};
+
+// hits for one query of a batched overlap, hits[first, first + count)
+struct physicsOverlapRange {
+	uint32_t first = 0;
+	uint32_t count = 0;
+};
+
 class physics : public IoC::Service {
 	public:
 		typedef std::shared_ptr<physics> ptr;
@@ -123,8 +240,19 @@ class physics : public IoC::Service {
 		              sceneModel::ptr model,
 		              sceneMesh::ptr  mesh) = 0;
 
-		// map of submesh name to physics object ID
-		// TODO: multimap?
+		// movable mesh, collides as a set of convex hulls generated from
+		// the mesh, the mesh origin is used as the center of mass
+		virtual physicsObject::ptr
+		addDynamicMesh(void *data,
+		               const TRS& transform,
+		               float mass,
+		               sceneModel::ptr model,
+		               sceneMesh::ptr  mesh)
+		{
+			return nullptr;
+		};
+
+		// static body for each mesh in the model, keyed by mesh
 		virtual std::map<sceneMesh::ptr, physicsObject::ptr>
 		addModelMeshBoxes(sceneModel::ptr mod) = 0;
 
@@ -133,6 +261,95 @@ class physics : public IoC::Service {
 
 		virtual void filterCollisions(void) = 0;
 		virtual void stepSimulation(float delta) = 0;
+
+		/**
+		 * Contact events generated by the simulation.
+		 *
+		 * Events are generated after each step, consumers should call
+		 * contactStream::acquire() once per frame to pick them up.
+		 *
+		 * @return The contact stream, or nullptr if the implementation
+		 *         doesn't generate contact events.
+		 */
+		virtual contactStream *getContacts(void) { return nullptr; };
+
+		/**
+		 * Transforms of dynamic objects, published after each step.
+		 *
+		 * Read these rather than querying the simulation while it's being
+		 * stepped from another thread. rigidBodyUpdateSystem acquire()s
+		 * the latest snapshot once per frame, other readers (including
+		 * physicsObject getters) should only use readBuffer(), from the
+		 * same (game) thread.
+		 *
+		 * @return The snapshot buffer, or nullptr if not supported.
+		 */
+		virtual tripleBuffer<physicsSnapshot> *getSnapshots(void) { return nullptr; };
+
+		/**
+		 * Set whether the simulation is being stepped from another thread.
+		 *
+		 * When enabled, physicsObject setters are queued and applied at the
+		 * start of the next step rather than touching the simulation directly.
+		 */
+		virtual void setAsyncStepping(bool async) {};
+
+		/**
+		 * Scene queries, against every object in the world.
+		 *
+		 * Queries wait for a step in progress to finish, so they're safe
+		 * to call while the simulation is stepped on another thread.
+		 * The batched versions wait once for the whole batch, and spread
+		 * queries over jobs' workers if given. Batch results are in the same
+		 * order as the queries, misses have a null obj.
+		 *
+		 * Implementations without query support never hit anything.
+		 */
+		virtual bool raycast(const physicsRay& ray, physicsHit& hit) {
+			return false;
+		};
+
+		virtual bool sweep(const physicsSweep& query, physicsHit& hit) {
+			return false;
+		};
+
+		// appends every overlapping object to hits, returns the number found
+		virtual size_t overlap(const physicsOverlap& query,
+		                       std::vector<physicsHit>& hits)
+		{
+			return 0;
+		};
+
+		virtual void raycastBatch(std::span<const physicsRay> rays,
+		                          std::span<physicsHit> hits,
+		                          jobQueue *jobs = nullptr)
+		{
+			for (size_t i = 0; i < rays.size() && i < hits.size(); i++) {
+				hits[i] = {};
+				raycast(rays[i], hits[i]);
+			}
+		};
+
+		virtual void sweepBatch(std::span<const physicsSweep> queries,
+		                        std::span<physicsHit> hits,
+		                        jobQueue *jobs = nullptr)
+		{
+			for (size_t i = 0; i < queries.size() && i < hits.size(); i++) {
+				hits[i] = {};
+				sweep(queries[i], hits[i]);
+			}
+		};
+
+		virtual void overlapBatch(std::span<const physicsOverlap> queries,
+		                          std::vector<physicsHit>& hits,
+		                          std::span<physicsOverlapRange> ranges,
+		                          jobQueue *jobs = nullptr)
+		{
+			for (size_t i = 0; i < queries.size() && i < ranges.size(); i++) {
+				ranges[i].first = hits.size();
+				ranges[i].count = overlap(queries[i], hits);
+			}
+		};
 };
 
 // namespace grendx
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <grend/physics.hpp>
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <stdint.h>
+
+namespace grendx {
+
+/**
+ * Steps a physics service at a fixed rate on its own thread.
+ *
+ * Real time is accumulated and consumed in fixed steps, so simulation
+ * results don't depend on the render frame rate. Consumers read transforms
+ * through physics::getSnapshots() and interpolate between the last two steps.
+ *
+ * On platforms without threads (emscripten) start() does nothing, and
+ * update() runs the same accumulator on the calling thread instead.
+ */
+class physicsThread {
+	public:
+		typedef std::shared_ptr<physicsThread> ptr;
+		typedef std::weak_ptr<physicsThread>   weakptr;
+
+		struct statistics {
+			uint64_t steps = 0;
+			// number of times the step limit was hit and time was dropped
+			uint64_t overruns = 0;
+			// wall time taken by the last step, in seconds
+			float lastStepTime = 0.f;
+		};
+
+		physicsThread(physics *phys,
+		              float stepSize = 1.f/60.f,
+		              unsigned maxSteps = 4);
+		~physicsThread();
+
+		void start(void);
+		void stop(void);
+		bool running(void) { return threadRunning; };
+
+		// accumulate time and step on the calling thread, does nothing
+		// if the stepping thread is running
+		void update(float delta);
+
+		statistics stats(void);
+
+		const float stepSize;
+		// maximum steps to run at once before dropping accumulated time,
+		// keeps a slow simulation from falling further and further behind
+		const unsigned maxSteps;
+
+	private:
+		void worker(void);
+		// runs as many steps as are due, returns the remaining accumulated time
+		double runSteps(double accumulated);
+
+		physics *phys;
+		std::thread thread;
+		std::atomic<bool> threadRunning = false;
+		std::mutex mtx;
+		std::condition_variable waiter;
+
+		double accumulator = 0.0;
+		std::mutex statsMutex;
+		statistics counters;
+};
+
+// namespace grendx
+}
@@ -5,6 +5,7 @@
 #include <grend/gameMain.hpp>
 #include <grend/modalSDLInput.hpp>
 #include <grend/physics.hpp>
+#include <grend/physicsThread.hpp>
 #include <memory>
 
 namespace grendx {
@@ -18,6 +19,10 @@ class playerView : public gameView {
 		virtual void render();
 		virtual void logic(float delta);
 
+		// physics runs at a fixed rate on its own thread, started
+		// on the first logic() call
+		physicsThread::ptr physStepper = nullptr;
+
 		/*
 	private:
 		void drawMainMenu(int wx, int wy);
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <grend/sceneNode.hpp>
+#include <grend/sceneModel.hpp>
+#include <grend/ecs/ecs.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <unordered_set>
+#include <stdint.h>
+
+namespace grendx {
+
+/**
+ * Frozen template of a loaded scene, for spawning many copies of it.
+ *
+ * The tree is flattened once when the prefab is created. Plain nodes, skins,
+ * lights and probes are created for each instance, lights and probes with
+ * the source's settings but their own shadow maps and probe state. Everything
+ * else (models with their meshes, vertex/index buffers and compiled GPU data,
+ * particles) is immutable and linked into every instance by reference, along
+ * with anything below it.
+ *
+ * To change a shared node in one instance, makeUnique() replaces it with a
+ * private copy in that instance only. Components other than scene links
+ * and the ones copied by makeUnique() aren't instanced.
+ *
+ * The source scene's shared nodes, lights and probes must outlive the
+ * prefab and its instances.
+ */
+class prefab {
+	public:
+		typedef std::shared_ptr<prefab> ptr;
+		typedef std::weak_ptr<prefab>   weakptr;
+
+		prefab(sceneNode::ptr source);
+
+		sceneNode::ptr instantiate(ecs::entityManager *manager);
+		// count instances at once, roots are appended to out
+		void instantiate(ecs::entityManager *manager,
+		                 size_t count,
+		                 std::vector<sceneNode::ptr>& out);
+		// removes the nodes owned by an instance (including unique copies),
+		// shared nodes are left alone
+		void release(ecs::entityManager *manager, sceneNode::ptr instance);
+
+		// replaces shared, linked somewhere under instance, with a private
+		// copy for that instance and returns it. Copies share compiled data
+		// with the original until the copy's compiled flag is cleared.
+		// Only models (and instanced nodes, which are already unique) can be
+		// copied, returns nullptr for anything else.
+		sceneNode::ptr makeUnique(sceneNode::ptr instance, sceneNode::ptr shared);
+
+		// nodes created per instance, and links to shared nodes in each
+		size_t instancedNodes(void) const;
+		size_t sharedNodes(void) const;
+
+	private:
+		struct templateNode {
+			// index of the parent node, or sceneHierarchy::none for the root
+			uint32_t parent;
+			sceneNode::objType type;
+			std::string name;
+
+			// set for shared nodes, linked into instances as-is
+			sceneNode *shared = nullptr;
+			// lights and probes, settings are copied from this node
+			sceneNode *settings = nullptr;
+
+			// node state, for instanced nodes
+			bool defaultTransform = true;
+			TRS  origTransform;
+			TRS  transform;
+			bool visible = true;
+			uint32_t animChannel = 0;
+			std::map<std::string, float> extraProperties;
+
+			// skins, joints are indices of template nodes, or
+			// sceneHierarchy::none for joints outside of the prefab
+			std::vector<glm::mat4> inverseBind;
+			std::vector<glm::mat4> skinTransforms;
+			std::vector<uint32_t>  joints;
+			std::vector<sceneNode*> externalJoints;
+		};
+
+		std::vector<templateNode> nodes;
+		// shared nodes can be linked more than once
+		std::unordered_set<sceneNode*> shared;
+		size_t sharedCount = 0;
+};
+
+// namespace grendx
+}
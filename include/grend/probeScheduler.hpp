@@ -0,0 +1,121 @@
+#pragma once
+
+#include <grend/IoC.hpp>
+#include <grend/glmIncludes.hpp>
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace grendx {
+
+/**
+ * Spreads reflection and irradiance probe updates over several frames.
+ *
+ * An update is split into steps (one cube face render, or one convolution
+ * pass), which are drawn into spare atlas nodes while the previous result
+ * keeps being sampled, and swapped in once the last step is done. Each frame
+ * the requested updates are ordered by staleness and distance from the
+ * camera, and steps are handed out until the frame's step or time budget is
+ * used up. Updates that are already underway are finished first, so a probe
+ * isn't left with a half-drawn update for long.
+ *
+ * No GL dependencies, see updateReflections() in renderQueue.cpp for the
+ * renderer side.
+ */
+class probeScheduler : public IoC::Service {
+	public:
+		typedef std::shared_ptr<probeScheduler> ptr;
+		typedef std::weak_ptr<probeScheduler>   weakptr;
+
+		struct schedSettings {
+			bool enabled = true;
+			// at least one step runs every frame while anything is pending
+			unsigned stepBudget = 6;
+			// no new steps are started after this many milliseconds,
+			// 0 for no limit
+			float timeBudget = 2.f;
+			// priority halves at this distance from the camera
+			float distanceScale = 16.f;
+		};
+
+		struct step {
+			const void *probe;
+			unsigned index;
+			unsigned count;
+
+			bool last(void) const { return index + 1 >= count; }
+		};
+
+		struct frameStats {
+			size_t pending   = 0;
+			size_t steps     = 0;
+			size_t completed = 0;
+			// nanoseconds spent in steps
+			uint64_t stepTime = 0;
+			// frames from first request to completion, for updates
+			// completed this frame
+			unsigned maxLatency = 0;
+			float    avgLatency = 0;
+		};
+
+		virtual ~probeScheduler();
+
+		// call every frame for each probe that needs an update, or that
+		// has one in progress. Urgent probes (ie. never drawn) go first.
+		void request(const void *probe,
+		             const glm::vec3& position,
+		             unsigned steps,
+		             bool urgent = false);
+		// true if the probe has an update underway, which needs to be
+		// requested even if the probe wouldn't otherwise be updated
+		bool inProgress(const void *probe) const;
+
+		// orders this frame's requests, call after all request()s
+		void schedule(const glm::vec3& viewPos);
+		// next step to draw, false once the frame's budget is used up
+		bool next(step& out);
+		// report a drawn step and how long it took, in nanoseconds
+		void finished(const step& s, uint64_t ns);
+
+		// stats for the last finished frame, drops updates for probes
+		// that weren't requested
+		void newFrame(void);
+		const frameStats& stats(void) const { return lastFrame; }
+		// slowest update ever completed, in frames
+		unsigned worstLatency(void) const { return worst; }
+
+		schedSettings settings;
+
+	private:
+		struct task {
+			const void *probe;
+			glm::vec3 position;
+			unsigned  steps;
+			unsigned  progress;
+			uint32_t  firstRequested;
+			uint32_t  lastRequested;
+			bool      urgent;
+			float     priority;
+		};
+
+		float priority(const task& t, const glm::vec3& viewPos) const;
+
+		std::unordered_map<const void*, task>     tasks;
+		std::unordered_map<const void*, uint32_t> lastCompleted;
+		std::vector<task*> order;
+		size_t   cursor   = 0;
+		size_t   stepsRun = 0;
+		uint64_t timeUsed = 0;
+		uint64_t latencySum = 0;
+
+		frameStats current;
+		frameStats lastFrame;
+		unsigned   worst = 0;
+		uint32_t   frame = 1;
+};
+
+// namespace grendx
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <map>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace grendx::profile {
+
+// nanoseconds on a monotonic clock
+static inline uint64_t now(void) {
+	auto t = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+}
+
+// raw timestamp for zones, reading the clock is most of the cost of a zone
+// so use the TSC where available, ticks are converted to nanoseconds
+// when events are collected
+static inline uint64_t ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return now();
+#endif
+}
+
+// completed zone, names must have static storage duration
+// (string literals, __func__), events only store the pointer
+// (begin/end are in ticks() while buffered, nanoseconds once collected)
+struct event {
+	const char *name;
+	uint64_t begin;
+	uint64_t end;
+	uint32_t thread;
+	uint32_t depth;
+};
+
+/**
+ * Per-thread event buffer.
+ *
+ * Single producer (the owning thread), single consumer (whatever thread
+ * calls endFrame()) ring, so recording an event never takes a lock.
+ * Events are dropped if the ring fills up before being collected.
+ */
+class threadBuffer {
+	public:
+		enum { capacity = 1 << 13 };
+
+		bool push(const event& ev) {
+			size_t h = head.load(std::memory_order_relaxed);
+			size_t t = tail.load(std::memory_order_acquire);
+
+			if (h - t >= capacity) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			events[h & (capacity - 1)] = ev;
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		// consumer side
+		template <typename F>
+		size_t drain(F&& func) {
+			size_t t = tail.load(std::memory_order_relaxed);
+			size_t h = head.load(std::memory_order_acquire);
+
+			for (size_t i = t; i < h; i++) {
+				func(events[i & (capacity - 1)]);
+			}
+
+			tail.store(h, std::memory_order_release);
+			return h - t;
+		}
+
+		uint32_t id = 0;
+		std::atomic<const char *> name = "thread";
+		std::atomic<uint64_t> dropped = 0;
+
+		// owner-only state for nesting
+		struct openGroup {
+			const char *name;
+			uint64_t begin;
+		};
+
+		enum { maxGroupDepth = 64 };
+		openGroup groups[maxGroupDepth];
+		uint32_t depth = 0;
+
+	private:
+		std::atomic<size_t> head = 0;
+		std::atomic<size_t> tail = 0;
+		event events[capacity];
+};
+
+threadBuffer *registerThread(void);
+
+inline threadBuffer& localBuffer(void) {
+	static thread_local threadBuffer *buf = nullptr;
+
+	if (!buf) {
+		buf = registerThread();
+	}
+
+	return *buf;
+}
+
+// name shown for the calling thread in captures/traces
+void setThreadName(const char *name);
+
+/**
+ * RAII profiling zone, records an event covering its lifetime.
+ *
+ * Use the GREND_PROFILE_ZONE() macro rather than constructing these directly.
+ */
+class zone {
+	public:
+		zone(const char *_name)
+			: name(_name),
+			  buf(localBuffer()),
+			  depth(buf.depth++),
+			  begin(ticks()) {}
+
+		~zone() {
+			buf.depth--;
+			buf.push({name, begin, ticks(), buf.id, depth});
+		}
+
+		zone(const zone&) = delete;
+		zone& operator=(const zone&) = delete;
+
+	private:
+		const char *name;
+		threadBuffer& buf;
+		uint32_t depth;
+		uint64_t begin;
+};
+
+#define GREND_PROFILE_CONCAT_(a, b) a##b
+#define GREND_PROFILE_CONCAT(a, b) GREND_PROFILE_CONCAT_(a, b)
+#define GREND_PROFILE_ZONE(NAME) \
+	::grendx::profile::zone GREND_PROFILE_CONCAT(profileZone_, __LINE__)(NAME)
+#define GREND_PROFILE_FUNCTION() GREND_PROFILE_ZONE(__func__)
+
+// explicit begin/end pairs, for spans that don't map to a scope,
+// names have the same requirements as zones
+void startGroup(const char *name);
+void endGroup(void);
+
+// frame boundaries, should be called from the main thread,
+// endFrame() collects events from all threads into the frame history
+void newFrame(void);
+void endFrame(void);
+
+struct frameRecord {
+	uint64_t index = 0;
+	uint64_t begin = 0;
+	uint64_t end = 0;
+	// thread that called newFrame()/endFrame()
+	uint32_t mainThread = 0;
+	std::vector<event> events;
+
+	double duration(void) const {
+		return (end - begin) / 1e9;
+	}
+};
+
+struct zoneStats {
+	const char *name;
+	unsigned calls;
+	double total;   // seconds
+	double longest; // seconds
+};
+
+// frame history, most recent first, valid until the next endFrame()
+// (history accessors should only be used from the main thread)
+size_t historySize(void);
+const frameRecord *getHistory(size_t framesAgo = 0);
+void setHistoryLength(size_t frames);
+
+// per-name totals over a frame, sorted by total time
+std::vector<zoneStats> aggregate(const frameRecord& frame);
+
+// thread names indexed by thread id
+std::vector<std::string> threadNames(void);
+// events dropped since startup due to full buffers
+uint64_t droppedEvents(void);
+
+// write the frame history in chrome trace_event json format,
+// viewable with chrome://tracing or perfetto
+bool exportChromeTrace(const std::string& path);
+
+// nested view of a frame for display, groups with the same name under
+// the same parent are merged
+struct group {
+	std::map<std::string, group> subgroups;
+	double seconds = 0.0;
+	unsigned calls = 0;
+};
+
+group buildTree(const frameRecord& frame);
+
+// namespace grendx::profile
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <grend/glmIncludes.hpp>
+#include <grend/meshBVH.hpp>
+#include <grend/sceneNode.hpp>
+#include <grend/sceneModel.hpp>
+#include <grend/ecs/ecs.hpp>
+
+#include <vector>
+#include <float.h>
+#include <stdint.h>
+
+namespace grendx {
+
+struct raycastHit {
+	// nearest node above the mesh with a sceneComponent, or the owner
+	// passed to raycastScene::add()
+	ecs::entity    *entity = nullptr;
+	sceneMesh::ptr  mesh;
+	// id passed to raycastScene::add()
+	uint32_t  id = 0;
+	// index of the triangle in the mesh's faces
+	uint32_t  triangle = 0;
+	float     distance = FLT_MAX;
+	glm::vec3 point;
+	// normalized, facing against the ray
+	glm::vec3 normal;
+};
+
+/**
+ * Mesh instances in world space with a BVH over their bounds, for ray casts
+ * against the scene on the CPU. Each instance references its mesh's
+ * sceneMesh::bvh, so rebuilding this is cheap, it's meant to be refilled
+ * whenever the scene changes (ie. once per query in the editor).
+ *
+ * Skinned and instanced meshes are tested in their bind pose, particles
+ * are skipped.
+ */
+class raycastScene {
+	public:
+		// adds every visible mesh under node, with transform as the parent
+		// transform, meshes without BVHs have them built
+		void add(sceneNode::ptr node,
+		         ecs::entity *owner = nullptr,
+		         const glm::mat4& transform = glm::mat4(1),
+		         uint32_t id = 0);
+		// adds the scene nodes of every entity with a sceneComponent
+		void addEntities(ecs::entityManager *manager);
+		void clear(void);
+
+		// builds the top level BVH, called by raycast() if anything changed
+		void build(void);
+
+		// closest hit within maxDist, dir doesn't need to be normalized,
+		// distances are in world units
+		bool raycast(const glm::vec3& origin,
+		             const glm::vec3& dir,
+		             raycastHit& out,
+		             float maxDist = FLT_MAX);
+
+		size_t instances(void) const { return meshes.size(); }
+
+	private:
+		struct instance {
+			glm::mat4       transform;
+			glm::mat4       inverse;
+			sceneMesh::ptr  mesh;
+			meshBVH::ptr    bvh;
+			ecs::entity    *entity;
+			uint32_t        id;
+		};
+
+		void addRec(sceneNode::ptr node,
+		            sceneModel *model,
+		            ecs::entity *owner,
+		            const glm::mat4& transform,
+		            uint32_t id);
+
+		std::vector<instance> meshes;
+		bvhTree tree;
+		bool dirty = false;
+};
+
+// namespace grendx
+}
@@ -16,16 +16,25 @@ class renderAtlases {
 		renderAtlases(unsigned refSize    = 2048,
 		              unsigned shadowSize = 4096,
 		              unsigned irradSize  = 1024,
-		              unsigned coeffSize  = 1024)
+		              unsigned coeffSize  = 1024,
+		              unsigned staticShadowSize = 2048)
 		{
 			reflections = atlas::ptr(new atlas(refSize));
 			shadows     = atlas::ptr(new atlas(shadowSize, atlas::mode::Depth));
 			irradiance  = atlas::ptr(new atlas(irradSize));
 			irradianceCoefficients = atlas::ptr(new atlas(coeffSize));
+
+			// static shadow casters are drawn here once and copied into
+			// the shadow atlas, needs to be a separate texture since
+			// blitting within the same image isn't allowed in WebGL
+			if (staticShadowSize) {
+				staticShadows = atlas::ptr(new atlas(staticShadowSize, atlas::mode::Depth));
+			}
 		}
 
 		atlas::ptr reflections;
 		atlas::ptr shadows;
+		atlas::ptr staticShadows; // may be null
 		atlas::ptr irradiance;
 		atlas::ptr irradianceCoefficients;
 };
@@ -3,6 +3,8 @@
 #include <grend/renderFlags.hpp>
 #include <grend/renderContext.hpp>
 #include <grend/renderFramebuffer.hpp>
+#include <grend/lodSelector.hpp>
+#include <grend/occlusionBuffer.hpp>
 
 #include <grend/sceneNode.hpp>
 
@@ -14,6 +16,11 @@ void getNodeTransform(sceneNode::ptr obj,
                       glm::mat4& outTrans,
                       bool& outInverted);
 
+// extends the path of a parent node (0 for none) with a child, paths stay
+// the same while the tree does, so they identify instances of shared
+// (ie. prefab) nodes regardless of where they are
+uint64_t instancePath(uint64_t parent, const sceneNode *node);
+
 class renderQueue {
 	public:
 		renderQueue() {};
@@ -33,6 +40,11 @@ class renderQueue {
 			bool      inverted;
 			T         data;
 			uint32_t  renderID;
+			// index into compiledMesh::lods, set by cullQueue()
+			uint8_t   lod = 0;
+			// identifies the instance across frames, a hash of the nodes
+			// it was reached through (see instancePath()), 0 if unknown
+			uint64_t  instance = 0;
 		};
 
 		void add(sceneNode::ptr obj,
@@ -46,12 +58,14 @@ class renderQueue {
 		bool addNode(sceneNode::ptr obj,
 		             uint32_t renderID = 0,
 		             glm::mat4 trans = glm::mat4(1),
-		             bool inverted = false);
+		             bool inverted = false,
+		             uint64_t instance = 0);
 
 		void addMesh(sceneNode::ptr obj,
 		             uint32_t renderID = 0,
 		             const glm::mat4& trans = glm::mat4(1),
-		             bool inverted = false);
+		             bool inverted = false,
+		             uint64_t instance = 0);
 
 		void addSkinned(sceneNode::ptr obj,
 		                sceneSkin::ptr skin,
@@ -121,12 +135,27 @@ struct multiRenderQueue {
 };
 
 void updateLights(renderContext *rctx, renderQueue& lights);
-void updateReflections(renderContext *rctx, renderQueue& refs);
+// spreads probe updates over frames if there's a probeScheduler service,
+// cam is used to prioritize nearby probes
+void updateReflections(renderContext *rctx, renderQueue& refs,
+                       camera::ptr cam = nullptr);
 void updateReflectionProbe(renderContext *rctx, renderQueue& que, camera::ptr cam);
 void sortQueue(renderQueue& queue, camera::ptr cam);
-void cullQueue(renderQueue& queue, camera::ptr cam, unsigned width, unsigned height, float lightext);
+// also occlusion culls and selects mesh LODs for the given pass, if there are
+// occlusionCuller and lodSelector services
+void cullQueue(renderQueue& queue, camera::ptr cam, unsigned width, unsigned height, float lightext,
+               lodPass pass = lodPass::Main);
 void sortQueue(multiRenderQueue& queue, camera::ptr cam);
-void cullQueue(multiRenderQueue& queue, camera::ptr cam, unsigned width, unsigned height, float lightext);
+void cullQueue(multiRenderQueue& queue, camera::ptr cam, unsigned width, unsigned height, float lightext,
+               lodPass pass = lodPass::Main);
+// rasterizes occluder meshes in the queue and removes static meshes hidden
+// behind them, doesn't need a GL context
+void occlusionCullQueue(renderQueue& queue, camera::ptr cam,
+                        occlusionCuller& culler, lodPass pass);
+// sets the LOD level of each (already culled) static mesh from its projected
+// error, doesn't need a GL context
+void selectLods(renderQueue& queue, camera::ptr cam, unsigned height,
+                lodSelector& lods, lodPass pass);
 void batchQueue(renderQueue& queue);
 
 void shaderSync(Program::ptr program, renderContext *rctx, renderQueue& que);
@@ -11,6 +11,8 @@ struct renderSettings {
 	bool shadowsEnabled = true;
 	unsigned shadowSize = 256;
 	unsigned shadowAtlasSize = 4096;
+	// static casters are cached in a separate atlas, 0 disables
+	unsigned staticShadowAtlasSize = 2048;
 
 	// TODO: might be modal, for eg. screenspace shadows
 	bool reflectionsEnabled = true;
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <grend/TRS.hpp>
+#include <grend/ecs/ecs.hpp>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace grendx {
+
+namespace ecs {
+
+// marks an entity for replication, the server assigns a network ID the
+// first time the entity goes into a snapshot, and it stays the same for as
+// long as the component is attached
+class replicated : public component {
+	public:
+		replicated(regArgs t, uint32_t id = 0)
+			: component(doRegister(this, t)),
+			  netID(id) {}
+		virtual ~replicated();
+
+		uint32_t netID;
+};
+
+// namespace ecs
+}
+
+/**
+ * What gets replicated, and how it's quantized.
+ *
+ * Every replicated entity sends its transform. Components can be added with
+ * add<T>(), each one gets a network type ID in the order it was added, so
+ * both ends need to add the same types in the same order. A component's
+ * state is written as a fixed number of int32 fields, quantize() helps with
+ * floats. Only the first component of each type on an entity is sent.
+ */
+class replicationSchema {
+	public:
+		typedef std::shared_ptr<replicationSchema> ptr;
+		typedef std::weak_ptr<replicationSchema>   weakptr;
+
+		using writeFunc  = std::function<void(ecs::component *comp, int32_t *fields)>;
+		using readFunc   = std::function<void(ecs::component *comp, const int32_t *fields)>;
+		using attachFunc = std::function<ecs::component*(ecs::entity *ent)>;
+
+		struct codec {
+			const char *type;
+			unsigned fields;
+			writeFunc  write;
+			readFunc   read;
+			attachFunc attach;
+		};
+
+		// position xyz, packed rotation, scale xyz
+		static constexpr unsigned transformFields = 7;
+		// field change masks are 64 bits, and type masks 32
+		static constexpr unsigned maxFields = 64;
+		static constexpr unsigned maxTypes  = 32;
+
+		template <typename T>
+		bool add(unsigned fields, writeFunc write, readFunc read) {
+			return add({
+				getTypeName<T>(), fields, write, read,
+				[] (ecs::entity *ent) -> ecs::component* {
+					return ent->attach<T>();
+				}
+			});
+		}
+
+		bool add(const codec& c);
+
+		// fields sent for an entity with the given components
+		unsigned fieldCount(uint32_t typeMask) const;
+
+		static int32_t quantize(float value, float steps) {
+			return int32_t(lroundf(value * steps));
+		}
+
+		static float dequantize(int32_t value, float steps) {
+			return value / steps;
+		}
+
+		void writeTransform(const TRS& transform, int32_t *fields) const;
+		TRS  readTransform(const int32_t *fields) const;
+
+		// quantization steps per unit
+		float positionSteps = 1024.f;
+		float scaleSteps    = 1024.f;
+
+		std::vector<codec> codecs;
+		unsigned totalFields = transformFields;
+};
+
+// replicated state of every entity at one tick, sorted by network ID
+struct netSnapshot {
+	uint32_t tick = 0;
+	std::vector<uint32_t> ids;
+	std::vector<uint32_t> typeMasks;
+	// start of each entity's fields
+	std::vector<uint32_t> offsets;
+	std::vector<int32_t>  fields;
+
+	void clear(void);
+	// index of the entity, or -1
+	ptrdiff_t find(uint32_t id) const;
+	const int32_t *get(size_t idx) const { return fields.data() + offsets[idx]; }
+};
+
+// changes from a baseline snapshot, as sent over the wire
+struct netDelta {
+	struct entry {
+		uint32_t id;
+		uint32_t typeMask;
+		// set for entities that are new, or whose components changed,
+		// their fields are relative to zero instead of the baseline
+		bool     newMask;
+		uint64_t changed;
+		// first of the changed values
+		uint32_t start;
+	};
+
+	uint32_t tick = 0;
+	// 0 for full snapshots
+	uint32_t baseTick = 0;
+	std::vector<entry>    entries;
+	std::vector<int32_t>  values;
+	std::vector<uint32_t> removed;
+
+	void clear(void);
+};
+
+// wire format used by replicationServer and replicationClient.
+// makeDelta() takes a null base for full snapshots
+void makeDelta(const replicationSchema& schema,
+               const netSnapshot& cur,
+               const netSnapshot *base,
+               netDelta& out);
+void writeDelta(const netDelta& delta, std::vector<uint8_t>& out);
+// false for malformed packets, ie. truncated or with IDs that don't increase
+bool readDelta(const std::vector<uint8_t>& packet, netDelta& out);
+// false if the delta doesn't fit the baseline or the schema
+bool applyDelta(const replicationSchema& schema,
+                const netDelta& delta,
+                const netSnapshot *base,
+                netSnapshot& out);
+
+// unreliable datagrams, packets may be lost, duplicated or reordered
+class byteTransport {
+	public:
+		typedef std::shared_ptr<byteTransport> ptr;
+		typedef std::weak_ptr<byteTransport>   weakptr;
+
+		virtual ~byteTransport();
+
+		virtual void send(const uint8_t *data, size_t length) = 0;
+		// returns false when nothing is waiting
+		virtual bool receive(std::vector<uint8_t>& packet) = 0;
+};
+
+/**
+ * In-process transport, for testing replication without sockets.
+ *
+ * makePair() returns two connected endpoints, packets sent from one are
+ * received by the other in order, or dropped with the given probability.
+ * Endpoints can be used from different threads.
+ */
+class loopbackTransport : public byteTransport {
+	public:
+		typedef std::shared_ptr<loopbackTransport> ptr;
+		typedef std::weak_ptr<loopbackTransport>   weakptr;
+
+		struct stats {
+			uint64_t packets = 0;
+			uint64_t dropped = 0;
+			uint64_t bytes   = 0;
+		};
+
+		static std::pair<ptr, ptr> makePair(float loss = 0.f, unsigned seed = 1);
+
+		virtual void send(const uint8_t *data, size_t length);
+		virtual bool receive(std::vector<uint8_t>& packet);
+
+		// can be changed at any time, eg. to let a last packet through
+		float loss;
+		stats getStats(void);
+
+	private:
+		struct queue {
+			std::mutex mtx;
+			std::deque<std::vector<uint8_t>> packets;
+		};
+
+		loopbackTransport(std::shared_ptr<queue> in,
+		                  std::shared_ptr<queue> out,
+		                  float loss, unsigned seed)
+			: loss(loss), incoming(in), outgoing(out), rng(seed) {}
+
+		std::shared_ptr<queue> incoming;
+		std::shared_ptr<queue> outgoing;
+		std::minstd_rand rng;
+		stats counters;
+};
+
+/**
+ * Sends snapshots of replicated entities to clients.
+ *
+ * Each tick() captures the quantized state of every entity with an
+ * ecs::replicated component, then sends every client a delta against the
+ * latest snapshot that client acknowledged. Only entities and fields that
+ * changed since then are sent, clients that haven't acknowledged anything
+ * recently enough get a full snapshot. Snapshots are kept for historySize
+ * ticks.
+ */
+class replicationServer {
+	public:
+		struct stats {
+			uint64_t ticks    = 0;
+			uint64_t packets  = 0;
+			uint64_t bytes    = 0;
+			// entities captured, summed over ticks
+			uint64_t entities = 0;
+			uint64_t fullSnapshots = 0;
+		};
+
+		static constexpr unsigned historySize = 32;
+
+		replicationServer(replicationSchema::ptr schema,
+		                  ecs::entityManager *manager);
+
+		unsigned addClient(byteTransport::ptr transport);
+		void removeClient(unsigned id);
+
+		// reads acks from clients, call before tick()
+		void receive(void);
+		void tick(void);
+
+		uint32_t currentTick(void) const { return tickCount; }
+		stats getStats(void) const { return counters; }
+
+	private:
+		struct client {
+			byteTransport::ptr transport;
+			uint32_t ackedTick = 0;
+		};
+
+		void capture(netSnapshot& out);
+
+		replicationSchema::ptr schema;
+		ecs::entityManager *manager;
+
+		std::unordered_map<unsigned, client> clients;
+		unsigned nextClient = 1;
+		uint32_t nextID     = 1;
+		uint32_t tickCount  = 0;
+
+		std::vector<netSnapshot> history;
+		std::vector<std::pair<uint32_t, ecs::entity*>> captured;
+		netDelta delta;
+		std::vector<uint8_t> packet;
+		stats counters;
+};
+
+/**
+ * Receives snapshots from a replicationServer and applies them.
+ *
+ * Entities that show up in snapshots are created with spawn (a plain
+ * ecs::entity by default) along with their replicated components, and
+ * removed once they're gone from the server. Component fields are applied
+ * as soon as a newer snapshot arrives, transforms go into a per-entity
+ * buffer and are set by interpolate(), which should be given a tick a
+ * little behind latestTick() so there's something to interpolate towards
+ * when packets are lost.
+ */
+class replicationClient {
+	public:
+		struct stats {
+			uint64_t packets = 0;
+			uint64_t applied = 0;
+			// stale or duplicate snapshots
+			uint64_t ignored = 0;
+			// deltas against a baseline that's no longer around
+			uint64_t missingBaseline = 0;
+			uint64_t invalid = 0;
+		};
+
+		static constexpr unsigned historySize = 32;
+		static constexpr unsigned bufferSize  = 8;
+
+		replicationClient(replicationSchema::ptr schema,
+		                  ecs::entityManager *manager,
+		                  byteTransport::ptr transport);
+
+		// reads every waiting snapshot, and acknowledges the newest one
+		void receive(void);
+		void interpolate(float tick);
+
+		uint32_t latestTick(void) const { return latest; }
+		ecs::entity *find(uint32_t netID);
+		stats getStats(void) const { return counters; }
+
+		std::function<ecs::entity*(ecs::entityManager *manager, uint32_t netID)> spawn;
+
+	private:
+		struct remote {
+			ecs::entity *ent;
+			struct sample {
+				uint32_t tick;
+				TRS transform;
+			} samples[bufferSize];
+			unsigned count = 0;
+			// last snapshot the entity was in
+			uint32_t seen = 0;
+		};
+
+		void apply(const netSnapshot& snap);
+
+		replicationSchema::ptr schema;
+		ecs::entityManager *manager;
+		byteTransport::ptr transport;
+
+		std::vector<netSnapshot> history;
+		netSnapshot decoded;
+		netDelta delta;
+		std::unordered_map<uint32_t, remote> entities;
+		std::vector<uint8_t> packet;
+		uint32_t latest = 0;
+		stats counters;
+};
+
+// namespace grendx
+}
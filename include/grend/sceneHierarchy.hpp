@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <string_view>
+#include <stdint.h>
+
+namespace grendx {
+
+class sceneNode;
+
+// interned node names, ids are stable for the lifetime of the program and
+// 0 is never a valid id, so hot lookups can intern names once up front
+uint32_t internName(std::string_view name);
+// returns 0 if the name has never been interned (so no node can have it)
+uint32_t findInternedName(std::string_view name);
+
+/**
+ * Flattened copy of the tree under a scene node.
+ *
+ * Nodes are stored in depth-first order with parent/first-child/next-sibling
+ * indices, and each entry knows where its subtree ends, so full traversals
+ * are a linear walk over the array and subtrees can be skipped with a jump.
+ * Parents always come before their children, so per-node state that depends
+ * on the parent (eg. accumulated transforms) can be computed in one pass.
+ *
+ * This only mirrors the structure, node state (transforms, visibility) is
+ * read from the nodes themselves. Use sceneNode::flatten() to get a cached
+ * copy which is rebuilt when links change.
+ */
+class sceneHierarchy {
+	public:
+		enum : uint32_t { none = UINT32_MAX };
+
+		struct entry {
+			sceneNode *node;
+			uint32_t parent;
+			uint32_t firstChild;
+			uint32_t nextSibling;
+			// one past the last node in this node's subtree
+			uint32_t end;
+		};
+
+		void build(sceneNode *root);
+		// index of a node in entries, or none
+		uint32_t indexOf(sceneNode *node) const;
+
+		std::vector<entry> entries;
+		// sceneNode subtree version this was built at
+		uint64_t generation = 0;
+
+	private:
+		std::unordered_map<sceneNode*, uint32_t> indices;
+};
+
+// namespace grendx
+}
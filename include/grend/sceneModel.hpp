@@ -20,6 +20,8 @@ namespace grendx {
 // defined in glManager.hpp
 class compiledMesh;
 class compiledModel;
+// defined in meshBVH.hpp
+class meshBVH;
 
 class sceneMesh : public sceneNode {
 	public:
@@ -43,6 +45,37 @@ class sceneMesh : public sceneNode {
 
 		struct AABB    boundingBox;
 		struct BSphere boundingSphere;
+
+		// reduced detail index buffers generated at import, referencing the
+		// same vertices as the full mesh, coarsest last
+		struct lodLevel {
+			std::vector<faceType> indices;
+			// largest deviation from the full mesh, in object space units
+			float error = 0;
+		};
+
+		// not serialized, regenerated on import
+		std::vector<lodLevel> lods;
+
+		// rasterized for occlusion culling, set from an "occluder" extra
+		// property on glTF meshes
+		bool occluder = false;
+
+		// index data shared between meshes with the same vertex layout
+		// (ie. terrain chunks), used instead of the mesh's own faces
+		struct sharedIndexData {
+			std::vector<faceType> indices;
+			// compiled once for every mesh sharing these, see compileMesh()
+			std::shared_ptr<compiledMesh> compiled;
+		};
+
+		// not serialized
+		std::shared_ptr<sharedIndexData> sharedIndices;
+
+		// triangle BVH for ray casts, in object space. Not serialized,
+		// built at import or on first use by sceneModel::buildBVHs(),
+		// reset to nullptr when the mesh's geometry changes
+		std::shared_ptr<meshBVH> bvh;
 };
 
 // used for joint indices
@@ -120,6 +153,21 @@ class sceneModel : public sceneNode {
 		void genTangents(void);
 		void genAABBs(void);
 
+		struct optimizeStats {
+			float acmrBefore = 0;
+			float acmrAfter  = 0;
+			size_t lodLevels = 0;
+		};
+
+		// reorders mesh indices for the vertex cache and overdraw, builds
+		// sceneMesh::lods and reorders vertices for fetch locality,
+		// see meshOptimizer.hpp. Face indices must be valid.
+		optimizeStats optimizeMeshes(unsigned maxLods = 4);
+
+		// builds sceneMesh::bvh for meshes that don't have one, from the
+		// bind pose vertex positions, see meshBVH.hpp
+		void buildBVHs(void);
+
 		static nlohmann::json serializer(component *comp);
 		static void deserializer(component *comp, nlohmann::json j);
 
@@ -10,13 +10,16 @@
 #include <grend/quadtree.hpp>
 #include <grend/boundingBox.hpp>
 #include <grend/TRS.hpp>
+#include <grend/sceneHierarchy.hpp>
 
 #include <memory>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <string>
 #include <stdint.h>
+#include <float.h>
 
 #include <iostream>
 #include <sstream>
@@ -25,6 +28,17 @@ namespace grendx {
 
 size_t allocateObjID(void);
 
+class sceneNode;
+
+namespace ecs {
+	// keeps child indexes and flattened hierarchies up to date as links change
+	template <>
+	struct linkHooks<sceneNode> {
+		static void attached(entity *owner, sceneNode *target);
+		static void detached(entityManager *manager, entity *owner, sceneNode *target);
+	};
+}
+
 class sceneNode : public ecs::entity {
 	public:
 		// used for type checking, dynamically-typed tree here
@@ -58,11 +72,21 @@ class sceneNode : public ecs::entity {
 
 		// setNode isn't a member function, since it needs to be able to set
 		// the shared pointer parent
-		//sceneNode::ptr getNode(std::string name);
-		// TODO: these are much less efficient now that that nodes aren't indexed in a map
+		// children are indexed by interned name, new children are added to
+		// the index as they're linked, removing or renaming children (see
+		// ecs::baseLink::renamed()) rebuilds it on the next lookup
 		sceneNode::ptr getNode(std::string name);
+		sceneNode::ptr getNode(uint32_t nameID);
 		void removeNode(std::string name);
 		bool hasNode(std::string name);
+		bool hasNode(uint32_t nameID);
+
+		// flattened copy of this subtree, rebuilt when links under this
+		// node change, should only be used from the thread that owns the
+		// scene. Changes are found through parent pointers, so for nodes
+		// linked in more than one place (eg. shared prefab nodes) only
+		// the tree they were first linked into notices.
+		const sceneHierarchy& flatten(void);
 
 		static nlohmann::json serializer(component *comp);
 		static void deserializer(component *comp, nlohmann::json j);
@@ -88,6 +112,21 @@ class sceneNode : public ecs::entity {
 		// intended to map to gltf extra properties, useful for exporting
 		// info from blender
 		std::map<std::string, float> extraProperties;
+
+	private:
+		friend struct ecs::linkHooks<sceneNode>;
+
+		void updateChildIndex(void);
+		// marks this node's and every ancestor's flattened copy as stale
+		void subtreeChanged(void);
+
+		// interned name -> first child with that name
+		std::unordered_map<uint32_t, sceneNode*> childIndex;
+		// name generation the index was built at, 0 if it needs a rebuild
+		uint64_t childIndexGeneration = 0;
+		// bumped by subtreeChanged()
+		uint64_t subtreeVersion = 1;
+		std::unique_ptr<sceneHierarchy> hierarchy;
 };
 
 /*
@@ -174,21 +213,32 @@ class sceneParticles : public sceneNode {
 
 		void update(void);
 		void syncBuffer(void);
+		// there's no upper limit, instances are uploaded and drawn
+		// in chunks of instancesPerBuffer
+		void resize(unsigned instances);
+		// instances in uniform buffer i, for the active instances
+		unsigned bufferInstances(unsigned i) const;
 
 		static nlohmann::json serializer(component *comp);
 		static void deserializer(component *comp, nlohmann::json j);
 
 		static void drawEditor(component *comp);
 
+		// matches the array size in lib/instanced-uniforms.glsl
+		static constexpr unsigned instancesPerBuffer = 256;
+
 		std::vector<glm::mat4> positions;
 		// approximate bounding sphere for instances in this object,
-		// used for culling
-		float radius;
+		// relative to the node like the instance transforms, used for culling,
+		// never culled until set
+		glm::vec3 center = glm::vec3(0);
+		float radius = FLT_MAX;
 		bool synced = false;
 		unsigned activeInstances;
 		unsigned maxInstances;
 
-		std::shared_ptr<Buffer> ubuffer = nullptr;
+		// only the buffers holding active instances are updated
+		std::vector<std::shared_ptr<Buffer>> ubuffers;
 };
 
 class sceneBillboardParticles : public sceneNode {
@@ -201,22 +251,34 @@ class sceneBillboardParticles : public sceneNode {
 
 		void update(void);
 		void syncBuffer(void);
+		void resize(unsigned instances);
+		unsigned bufferInstances(unsigned i) const;
+		// sorts active instances back to front, for blending
+		void sortByDepth(const glm::vec3& viewPos);
 
 		static nlohmann::json serializer(component *comp);
 		static void deserializer(component *comp, nlohmann::json j);
 
 		static void drawEditor(component *comp);
 
+		// matches the array sizes in lib/billboard-uniforms.glsl
+		static constexpr unsigned instancesPerBuffer = 512;
+
 		std::vector<glm::vec4> positions; /* xyz position, w scale */
+		std::vector<glm::vec4> colors;    /* multiplies the vertex color */
 
 		// approximate bounding sphere for instances in this object,
-		// used for culling
-		float radius;
+		// in world space like the positions, used for culling, never culled
+		// until set
+		glm::vec3 center = glm::vec3(0);
+		float radius = FLT_MAX;
 		bool synced = false;
+		// sort before drawing, for blended particles
+		bool depthSort = false;
 		unsigned activeInstances;
 		unsigned maxInstances;
 
-		std::shared_ptr<Buffer> ubuffer = nullptr;
+		std::vector<std::shared_ptr<Buffer>> ubuffers;
 };
 
 class sceneLight : public sceneNode {
@@ -346,6 +408,9 @@ class sceneReflectionProbe : public sceneNode {
 		static void drawEditor(component *comp);
 
 		quadtree::node_id faces[5][6];
+		// faces being drawn by an incremental update (see probeScheduler),
+		// swapped into faces once it's finished
+		quadtree::node_id updateFaces[5][6] = {};
 		// bounding box for parallax correction
 		AABB boundingBox = {
 			.min = glm::vec3(-1),
@@ -379,6 +444,7 @@ class sceneIrradianceProbe : public sceneNode {
 		sceneReflectionProbe *source;
 
 		quadtree::node_id faces[6];
+		quadtree::node_id updateFaces[6] = {};
 		quadtree::node_id coefficients[6];
 
 		AABB boundingBox = {
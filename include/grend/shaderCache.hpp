@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <shared_mutex>
+#include <utility>
+#include <stdint.h>
+#include <time.h>
+
+// shader source loading/preprocessing, kept separate from the GL side
+// (see shaderPreprocess.hpp) so that it can be used and tested without a
+// context
+
+namespace grendx {
+
+enum : uint64_t { shaderHashSeed = 0xcbf29ce484222325ull };
+
+// 64 bit FNV-1a, chainable by passing the previous hash as the seed
+static inline uint64_t hashShaderString(std::string_view str,
+                                        uint64_t seed = shaderHashSeed)
+{
+	uint64_t h = seed;
+
+	for (unsigned char c : str) {
+		h ^= c;
+		h *= 0x100000001b3ull;
+	}
+
+	return h;
+}
+
+struct shaderReflection;
+
+struct preprocessedShader {
+	typedef std::shared_ptr<const preprocessedShader> ptr;
+
+	// file this was loaded from, with the modification time and size it
+	// had at the time, used to check whether the result is stale
+	struct dependency {
+		std::string path;
+		time_t mtime;
+		int64_t size;
+		// hash of the file contents, only stored for packed shaders since
+		// modification times don't survive installing
+		uint64_t hash = 0;
+	};
+
+	std::string source;
+	// hash of the full source (including the define header)
+	uint64_t hash = 0;
+	// false if the top-level file couldn't be read
+	bool good = false;
+	std::vector<dependency> dependencies;
+	// uniform info, only available for shaders loaded from packs
+	std::shared_ptr<const shaderReflection> reflection;
+};
+
+/**
+ * Cache for shader sources and preprocessed results.
+ *
+ * Files (both top-level shaders and #includes) are cached by path,
+ * and reloaded when their modification time or size change. Preprocessed
+ * shaders are cached by path and define header, and are reused as long as
+ * none of the files that went into them have changed.
+ *
+ * All functions are thread-safe.
+ */
+class shaderSourceCache {
+	public:
+		// includes are looked up relative to includePath
+		shaderSourceCache(std::string _includePath)
+			: includePath(std::move(_includePath)) {}
+
+		// header is prepended to the processed source as-is, it should
+		// contain the #version line and any defines
+		preprocessedShader::ptr preprocess(const std::string& path,
+		                                   const std::string& header);
+
+		// same as above, for source that didn't come from a file
+		preprocessedShader::ptr preprocessSource(const std::string& source,
+		                                         const std::string& header);
+
+		// preprocess a set of (path, header) pairs on worker threads, blocks
+		// until all are done, results end up in the cache
+		void preprocessBatch(const std::vector<std::pair<std::string, std::string>>& jobs);
+
+		// load preprocessed shaders from an archive written by shaderComp.
+		// Packed entries are checked against the files they were built from
+		// the first time they're used, and ignored if any of those files
+		// exist and have different contents. Files that aren't there are
+		// assumed to match.
+		bool loadPack(const std::string& path);
+		// whether there's a packed entry for a (path, header) pair
+		bool isPacked(const std::string& path, const std::string& header);
+		// stop using the packed entry for a (path, header) pair, the next
+		// preprocess() reads the sources instead. Returns false if there
+		// was no packed entry.
+		bool unpack(const std::string& path, const std::string& header);
+
+		void clear(void);
+
+		// cache key for a (path, header) pair
+		static std::string key(const std::string& path, const std::string& header);
+
+		std::string includePath;
+
+	private:
+		struct fileEntry {
+			time_t mtime;
+			int64_t size;
+			std::shared_ptr<const std::string> contents;
+		};
+
+		// returns an empty string if the file can't be read
+		std::shared_ptr<const std::string> load(const std::string& path,
+		                                        preprocessedShader::dependency& dep);
+		bool stale(const preprocessedShader& shader);
+		// compares a packed shader against the loose files, current gets
+		// the files' current state
+		bool packStale(const preprocessedShader& shader,
+		               std::vector<preprocessedShader::dependency>& current);
+		// cached result, if it's up to date
+		preprocessedShader::ptr findFresh(const std::string& k);
+		void process(std::string_view source,
+		             std::string& out,
+		             std::vector<std::string>& included,
+		             std::vector<preprocessedShader::dependency>& deps);
+
+		std::shared_mutex filesMtx;
+		std::unordered_map<std::string, fileEntry> files;
+
+		std::shared_mutex resultsMtx;
+		// path + '\0' + header -> result
+		std::unordered_map<std::string, preprocessedShader::ptr> results;
+		std::unordered_map<std::string, preprocessedShader::ptr> packed;
+};
+
+// cache used by the engine's shader loading, includes are looked up in
+// GR_PREFIX "shaders/"
+shaderSourceCache& shaderSources(void);
+
+// namespace grendx
+}
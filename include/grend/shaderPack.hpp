@@ -0,0 +1,53 @@
+#pragma once
+
+#include <grend/shaderCache.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <stdint.h>
+
+// offline shader permutation packing, no GL dependencies so this can be
+// used from headless tools (see shaderComp)
+
+namespace grendx {
+
+struct shaderReflection {
+	struct uniform {
+		std::string type;
+		std::string name;
+		// 0 if not an array
+		unsigned arraySize = 0;
+	};
+
+	struct block {
+		std::string name;
+		// empty if the block has no instance name
+		std::string instance;
+		std::vector<uniform> members;
+	};
+
+	std::vector<uniform> uniforms;
+	std::vector<block>   blocks;
+};
+
+// evaluates #if/#ifdef/#ifndef/#elif/#else/#endif with the macros defined
+// in the source, other directives are kept as-is. Returns false (and leaves
+// out untouched) if a condition can't be evaluated.
+bool resolveShaderConditionals(std::string_view source, std::string& out);
+
+// removes functions not reachable from main() and uniforms that aren't
+// referenced by anything that's kept, and fills in reflection info for the
+// uniforms that are left. Expects source with conditionals resolved.
+std::string stripShader(std::string_view source, shaderReflection& reflection);
+
+// packed archive of preprocessed shaders, keyed by shaderSourceCache::key()
+typedef std::vector<std::pair<std::string, preprocessedShader::ptr>> shaderPackEntries;
+
+bool writeShaderPack(const std::string& path, const shaderPackEntries& entries);
+bool readShaderPack(const std::string& path, shaderPackEntries& entries);
+
+// namespace grendx
+}
@@ -2,17 +2,35 @@
 
 #include <grend/glmIncludes.hpp>
 #include <grend/glManager.hpp>
+#include <grend/shaderCache.hpp>
 
 #include <variant>
 #include <map>
+#include <vector>
 #include <string>
+#include <utility>
 
 namespace grendx {
 
 typedef std::map<std::string, Shader::parameters> shaderOptions;
+typedef std::pair<std::string, Shader::parameters> shaderFileOptions;
+
+// #version line and defines for the given options, prepended to every shader
+std::string shaderDefineHeader(const Shader::parameters& opts);
 
 std::string preprocessShader(std::string& source,
                              const Shader::parameters& opts);
 
+// cached, see shaderSourceCache
+preprocessedShader::ptr preprocessShaderFile(const std::string& path,
+                                             const Shader::parameters& opts);
+// preprocess shaders in parallel, so that later preprocessShaderFile() calls
+// with the same arguments are cache hits
+void preprocessShaderFiles(const std::vector<shaderFileOptions>& files);
+
+// every shader source (and option set) loaded by renderContext::loadShaders(),
+// defined in renderer.cpp, used to build shader packs
+std::vector<shaderFileOptions> engineShaderFiles(const Shader::parameters& opts);
+
 // namespace grendx;
 }
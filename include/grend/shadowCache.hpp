@@ -0,0 +1,103 @@
+#pragma once
+
+#include <grend/IoC.hpp>
+#include <grend/glmIncludes.hpp>
+#include <grend/quadtree.hpp>
+
+#include <unordered_map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+// bookkeeping for incremental shadow map updates, see drawShadowCubeMap()
+// and drawSpotlightShadow() in rendererProbes.cpp for where this is used.
+// No GL dependencies.
+
+namespace grendx {
+
+// hash of a mesh pointer and its world transform, changes whenever the
+// caster would draw differently into a shadow map
+uint64_t shadowCasterHash(const void *mesh, const glm::mat4& transform);
+
+class shadowCache : public IoC::Service {
+	public:
+		typedef std::shared_ptr<shadowCache> ptr;
+		typedef std::weak_ptr<shadowCache>   weakptr;
+
+		struct cacheSettings {
+			bool enabled = true;
+			// casters that haven't moved for this many frames are drawn
+			// into the static shadow layer, and only redrawn when that
+			// layer is invalidated
+			unsigned staticFrames = 30;
+			// shadow map faces redrawn per frame, faces that have never
+			// been drawn don't wait for the budget
+			unsigned faceBudget = 12;
+		};
+
+		struct frameStats {
+			size_t lights        = 0;
+			size_t casters       = 0;
+			size_t staticCasters = 0;
+			size_t facesDrawn    = 0;
+			size_t facesSkipped  = 0;
+			size_t facesDeferred = 0;
+			size_t staticDrawn   = 0;
+		};
+
+		// what was last drawn into one shadow map face
+		struct faceState {
+			quadtree::node_id liveMap   = 0;
+			quadtree::node_id staticMap = 0;
+			uint64_t staticSig  = 0;
+			uint64_t dynamicSig = 0;
+			bool     drawn      = false;
+		};
+
+		struct lightState {
+			faceState faces[6];
+			uint32_t  lastUpdate = 0;
+			uint32_t  lastSeen   = 0;
+		};
+
+		virtual ~shadowCache();
+
+		// atlas identifies the shadow atlas the faces were drawn into, state
+		// for all lights is dropped if it changes (ie. settings were applied)
+		lightState& light(const void *light, const void *atlas);
+		// frame the light's shadows were last redrawn, for prioritizing
+		uint32_t lastUpdate(const void *light) const;
+
+		// tracks how long the caster has been still, mesh and transform
+		// identify an instance across frames
+		bool isStatic(const void *mesh, const glm::mat4& transform);
+
+		// false if the frame's face budget is used up, optional faces
+		// are ones that still have a usable (if stale) shadow map
+		bool takeBudget(bool optional);
+
+		// stats for the last finished frame, expires old state
+		void newFrame(void);
+		const frameStats& stats(void) const { return lastFrame; }
+		uint32_t frameNumber(void) const { return frame; }
+
+		cacheSettings settings;
+		frameStats current;
+
+	private:
+		struct casterState {
+			uint64_t hash;
+			uint32_t stillSince;
+			uint32_t lastSeen;
+		};
+
+		std::unordered_map<const void*, lightState> lights;
+		std::unordered_map<uint64_t, casterState> casters;
+		const void *currentAtlas = nullptr;
+		unsigned budgetUsed = 0;
+		frameStats lastFrame;
+		uint32_t frame = 1;
+};
+
+// namespace grendx
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <grend/sceneModel.hpp>
+#include <grend/geometryGeneration.hpp>
+#include <grend/boundingBox.hpp>
+
+#include <unordered_map>
+#include <vector>
+#include <future>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace grendx {
+
+class jobQueue;
+
+/**
+ * Chunked, streamed heightmap terrain.
+ *
+ * The terrain is covered by a quadtree of chunks, a level 0 chunk covers
+ * chunkSize units, and each level up covers twice that with the same number
+ * of vertices (CDLOD style). Every chunk uses the same vertex layout, so all
+ * chunks share one index buffer, with skirts around the edges hiding cracks
+ * between chunks of different levels.
+ *
+ * Chunks are picked by distance from the camera, generated on the job
+ * workers, and kept around until the memory budget is exceeded, in which
+ * case the ones that went unused the longest are dropped. Until a chunk is
+ * ready its nearest loaded ancestor (or its children) is drawn instead.
+ *
+ * The generation and selection functions have no GL or ECS dependencies.
+ */
+struct terrainSettings {
+	// size of a level 0 chunk, in world units
+	float    chunkSize  = 64.f;
+	// quads along each side of a chunk, at every level
+	unsigned chunkQuads = 32;
+	// quadtree levels, the largest chunks cover 2^(levels-1) level 0 chunks
+	// along each side
+	unsigned levels     = 6;
+	// level 0 chunks are used within this distance, doubling each level
+	float    lodDistance = 96.f;
+	// fraction of a level's range after which chunks start morphing
+	// towards the next level, see terrainMorphFactor()
+	float    morphStart  = 0.7f;
+	// skirt depth for level 0 chunks, doubling each level
+	float    skirtDepth  = 2.f;
+	// texture coordinates per world unit
+	float    uvScale     = 1.f / 12.f;
+	// vertex memory kept for loaded chunks, in bytes
+	size_t   memoryBudget = 64 << 20;
+	// chunks generated at once
+	unsigned maxPending  = 16;
+};
+
+struct terrainChunkKey {
+	int      x, y;
+	unsigned level;
+
+	bool operator==(const terrainChunkKey& other) const {
+		return x == other.x && y == other.y && level == other.level;
+	}
+};
+
+struct terrainChunkHash {
+	size_t operator()(const terrainChunkKey& k) const {
+		uint64_t h = (uint64_t(uint32_t(k.x)) << 32) | uint32_t(k.y);
+		h ^= uint64_t(k.level) * 0x9e3779b97f4a7c15ull;
+		return h ^ (h >> 29);
+	}
+};
+
+struct terrainChunkData {
+	terrainChunkKey key;
+	// chunk origin in terrain space, positions are relative to this
+	glm::vec3 origin;
+	std::vector<sceneModel::vertex> vertices;
+	AABB    boundingBox;
+	BSphere boundingSphere;
+};
+
+// vertices per chunk, grid followed by the skirt
+size_t terrainChunkVertices(const terrainSettings& settings);
+// shared by every chunk, grid triangles followed by the skirt
+void terrainChunkIndices(const terrainSettings& settings,
+                         std::vector<sceneMesh::faceType>& out);
+// heights are sampled in terrain space (the terrain node's local space)
+void generateTerrainChunk(const terrainSettings& settings,
+                          heightFunction func,
+                          const terrainChunkKey& key,
+                          terrainChunkData& out);
+// appends the chunks covering [0, width] x [0, depth] to draw from viewPos,
+// given in terrain space
+void selectTerrainChunks(const terrainSettings& settings,
+                         float width, float depth,
+                         const glm::vec3& viewPos,
+                         std::vector<terrainChunkKey>& out);
+// CDLOD morph factor for a selected chunk, in [0, 1]. 0 within the first
+// morphStart of the chunk's level range, rising to 1 where the next level
+// takes over, so geometry can be blended towards the coarser grid before
+// switching. Always 0 for the top level.
+float terrainMorphFactor(const terrainSettings& settings,
+                         const terrainChunkKey& key,
+                         const glm::vec3& viewPos);
+
+class terrain {
+	public:
+		typedef std::shared_ptr<terrain> ptr;
+		typedef std::weak_ptr<terrain>   weakptr;
+
+		struct terrainStats {
+			size_t selected  = 0;
+			size_t loaded    = 0;
+			size_t pending   = 0;
+			size_t generated = 0;
+			size_t evicted   = 0;
+			size_t memory    = 0;
+		};
+
+		terrain(float width, float depth, heightFunction func,
+		        const terrainSettings& settings = terrainSettings());
+		~terrain();
+
+		// call once per frame from the main thread, viewPos in terrain
+		// space. Chunks are generated on jobs, if given, and otherwise
+		// serially before returning.
+		void update(const glm::vec3& viewPos, jobQueue *jobs = nullptr);
+
+		// chunk models are linked under this node
+		sceneNode::ptr getNode(void) const { return root; }
+		const terrainStats& stats(void) const { return current; }
+
+		const terrainSettings settings;
+
+	private:
+		struct chunk {
+			sceneModel::ptr model;
+			size_t   bytes;
+			uint32_t lastUsed;
+		};
+
+		struct pendingChunk {
+			std::shared_ptr<terrainChunkData> data;
+			std::future<bool> done;
+		};
+
+		void addChunk(terrainChunkData& data);
+		void evict(void);
+		// loaded chunks standing in for key while it isn't loaded, returns
+		// true if that's an ancestor rather than the children
+		bool fallback(const terrainChunkKey& key, std::vector<terrainChunkKey>& out);
+
+		float width, depth;
+		heightFunction func;
+
+		sceneNode::ptr root;
+		std::shared_ptr<sceneMesh::sharedIndexData> indices;
+
+		std::unordered_map<terrainChunkKey, chunk, terrainChunkHash> chunks;
+		std::unordered_map<terrainChunkKey, pendingChunk, terrainChunkHash> pending;
+		std::vector<terrainChunkKey> selected;
+
+		terrainStats current;
+		size_t   memory = 0;
+		uint32_t frame  = 0;
+};
+
+// namespace grendx
+}
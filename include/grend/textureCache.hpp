@@ -0,0 +1,118 @@
+#pragma once
+
+#include <grend/textureData.hpp>
+
+#include <string>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// decoded texture cache, kept separate from the GL side (see texcache() in
+// glManager.hpp) so that it can be used and tested without a context
+
+namespace grendx {
+
+// 64 bit xxHash (XXH64) of the whole buffer
+uint64_t hashBytes(const void *data, size_t length, uint64_t seed = 0);
+
+// hash of the pixels, dimensions, format and sampler settings, anything that
+// would make two textures upload differently
+uint64_t hashTexture(const textureData& tex);
+// exact comparison of everything hashTexture() covers
+bool sameTexture(const textureData& a, const textureData& b);
+// size of the decoded pixels
+size_t textureBytes(const textureData& tex);
+
+// sampler settings, which vary per use of a texture without changing the
+// decoded pixels
+struct textureSampler {
+	textureData::filter minFilter = textureData::filter::LinearMipmapLinear;
+	textureData::filter magFilter = textureData::filter::Linear;
+	textureData::wrap   wrapS     = textureData::wrap::Repeat;
+	textureData::wrap   wrapT     = textureData::wrap::Repeat;
+
+	bool operator==(const textureSampler& other) const = default;
+};
+
+/**
+ * Two level cache for decoded textures.
+ *
+ * Files are cached by canonical path, load options and sampler settings,
+ * and reused as long as their modification time and size haven't changed,
+ * a hit doesn't touch the file beyond a stat(). A file loaded with
+ * non-default sampler settings is copied from the default entry once, not
+ * decoded again. Cached files are kept within a byte budget, least recently
+ * used first out.
+ *
+ * Every texture that goes through the cache, from files or from intern(),
+ * is also deduplicated by content: textures with the same hashTexture() are
+ * compared in full before being shared, so hash collisions can't alias
+ * different textures. Deduplication only tracks textures that are still
+ * alive, it doesn't keep anything in memory by itself.
+ *
+ * All functions are thread-safe.
+ */
+class textureFileCache {
+	public:
+		struct stats {
+			size_t pathHits      = 0;
+			size_t pathMisses    = 0;
+			// decoded or interned textures that matched an existing one
+			size_t contentHits   = 0;
+			size_t contentMisses = 0;
+			size_t evictions     = 0;
+			// decoded bytes held for cached files
+			size_t bytes         = 0;
+			size_t entries       = 0;
+		};
+
+		textureFileCache(size_t budgetBytes = 256 << 20)
+			: budget(budgetBytes) {}
+
+		// throws like textureData::load_texture() if the file can't be loaded.
+		// The returned texture is shared, it shouldn't be modified.
+		textureData::ptr load(const std::string& path,
+		                      bool flipVertical = false,
+		                      const textureSampler& sampler = textureSampler());
+		// returns an existing texture with the same contents if there is one,
+		// otherwise registers and returns tex
+		textureData::ptr intern(textureData::ptr tex);
+
+		void setBudget(size_t budgetBytes);
+		void clear(void);
+		stats getStats(void);
+
+	private:
+		struct fileEntry {
+			time_t  mtime;
+			int64_t size;
+			textureData::ptr data;
+			size_t  bytes;
+			std::list<std::string>::iterator lru;
+		};
+
+		// assumes mtx is held
+		textureData::ptr internLocked(textureData::ptr tex);
+		void evict(void);
+
+		std::mutex mtx;
+		size_t budget;
+		stats counters;
+
+		// canonical path + '\0' + options -> entry, most recently used first
+		std::unordered_map<std::string, fileEntry> files;
+		std::list<std::string> lru;
+		// hashTexture() -> live textures with that hash
+		std::unordered_map<uint64_t, std::vector<textureData::weakptr>> contents;
+};
+
+// cache used by the engine's texture loading
+textureFileCache& textureFiles(void);
+
+// namespace grendx
+}
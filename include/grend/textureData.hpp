@@ -72,6 +72,33 @@ class textureData {
 		enum wrap wrapT = wrap::Repeat;
 
 		enum imageType type = imageType::Plain;
+
+		// hashTexture() of this, computed on first use and kept until the
+		// texture changes. Changes to the dimensions, format, sampler
+		// settings or pixel buffer size are picked up on their own, call
+		// invalidateHash() after writing to the pixels.
+		uint64_t hash(void) const;
+		void invalidateHash(void) { hashDirty = true; };
+
+	private:
+		// everything hash() can check cheaply for changes
+		struct hashState {
+			const void *data;
+			size_t bytes;
+			int width, height, channels;
+			size_t format;
+			enum filter minFilter, magFilter;
+			enum wrap wrapS, wrapT;
+			enum imageType type;
+
+			bool operator==(const hashState& other) const = default;
+		};
+
+		hashState currentState(void) const;
+
+		mutable hashState hashedState = {};
+		mutable uint64_t  cachedHash = 0;
+		mutable bool      hashDirty = true;
 };
 
 // namespace grendx
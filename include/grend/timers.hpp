@@ -6,6 +6,9 @@
 #include <map>
 #include <stdint.h>
 
+// profiling used to be part of this header, keep it available
+#include <grend/profile.hpp>
+
 namespace grendx {
 
 class sma_counter {
@@ -30,39 +33,5 @@ class sma_counter {
 		//uint32_t begin = 0;
 };
 
-namespace profile {
-
-void newFrame(void);
-void endFrame(void);
-void startGroup(std::string name);
-void endGroup(void);
-
-typedef std::chrono::time_point<std::chrono::high_resolution_clock> timepoint;
-
-struct timer {
-	timepoint begin;
-	timepoint end;
-	bool active;
-
-	double duration(void) {
-		std::chrono::duration<double> secs = end - begin;
-		return secs.count();
-	}
-};
-
-struct group {
-	std::map<std::string, timer> times;
-	std::map<std::string, group> subgroups;
-
-	timer groupTimer;
-};
-
-// shared pointer to avoid copying data when examining a particular
-// frame capture, makes handling multiple frame captures easy
-std::shared_ptr<group> getFrame(void);
-
-// namespace profile
-}
-
 // namespace grendx
 }
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+namespace grendx {
+
+/**
+ * Lock-free single producer, single consumer triple buffer.
+ *
+ * The writer fills writeBuffer() and calls publish(), the reader calls
+ * acquire() to pick up the most recently published buffer. Neither side
+ * ever blocks, intermediate buffers are dropped if the writer publishes
+ * faster than the reader acquires. Buffers are reused, so containers
+ * inside T keep their capacity between publishes.
+ */
+template <typename T>
+class tripleBuffer {
+	public:
+		// writer side
+		T& writeBuffer(void) {
+			return buffers[writeIndex];
+		}
+
+		void publish(void) {
+			uint8_t prev = middle.exchange(writeIndex | fresh, std::memory_order_acq_rel);
+			writeIndex = prev & indexMask;
+		}
+
+		// reader side, returns true if there was a new buffer
+		bool acquire(void) {
+			if (!(middle.load(std::memory_order_relaxed) & fresh)) {
+				return false;
+			}
+
+			uint8_t prev = middle.exchange(readIndex, std::memory_order_acq_rel);
+			readIndex = prev & indexMask;
+			return true;
+		}
+
+		const T& readBuffer(void) const {
+			return buffers[readIndex];
+		}
+
+	private:
+		enum {
+			indexMask = 0x3,
+			fresh     = 0x4,
+		};
+
+		T buffers[3];
+		uint8_t writeIndex = 0;
+		uint8_t readIndex  = 1;
+		std::atomic<uint8_t> middle = 2;
+};
+
+// namespace grendx
+}
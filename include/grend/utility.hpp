@@ -1,6 +1,9 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
+#include <functional>
+#include <stddef.h>
 
 namespace grendx {
 
@@ -20,6 +23,12 @@ const std::string& demangle(const char *type);
 const char *remangle(const std::string& demang);
 void eraseChars(std::string& str, std::string_view chars);
 
+// calls fn(i) for i in [0, count) across up to maxThreads threads (0 for
+// hardware concurrency), including the calling thread, blocks until done.
+// Runs serially on emscripten.
+void parallelFor(size_t count, const std::function<void(size_t)>& fn,
+                 unsigned maxThreads = 0);
+
 // TODO: maybe move these to cpp, not used frequently enough
 //       and not performanceto justify being in the header
 static inline std::string filename_extension(std::string fname) {
@@ -1,32 +1,205 @@
 #include <iostream>
+#include <grend-config.h>
 #include <grend/utility.hpp>
 #include <grend/shaderPreprocess.hpp>
+#include <grend/shaderPack.hpp>
 #include <grend/glslObject.hpp>
 #include <grend/logger.hpp>
 
+#include <set>
+#include <string.h>
+#include <stdlib.h>
+
 using namespace grendx;
 
-int main(int argc, char *argv[]) {
-	std::string source    = load_file(argv[1]);
-	//std::string processed = preprocessShader(source, options);
-	//std::cout << processed << std::endl;
+// resolve conditionals and strip unused code, falls back to the
+// unmodified source (with no reflection info) if that fails. path is where
+// the source will be installed, the engine checks the packed version against
+// it (and the includes) before using it.
+static preprocessedShader::ptr packShader(const std::string& path,
+                                          const std::string& source,
+                                          const std::string& header)
+{
+	static shaderSourceCache cache(GR_PREFIX "shaders/");
+
+	auto processed = cache.preprocessSource(source, header);
+	auto ret = std::make_shared<preprocessedShader>(*processed);
+	std::string resolved;
+
+	if (resolveShaderConditionals(processed->source, resolved)) {
+		auto refl = std::make_shared<shaderReflection>();
+		ret->source     = stripShader(resolved, *refl);
+		ret->hash       = hashShaderString(ret->source);
+		ret->reflection = refl;
+	}
 
-	try {
-		auto t = glslObject(source);
-		//auto t = parseGlsl(source);
-		//dump_tokens_tree(t);
+	// mtimes don't mean anything once installed, store content hashes
+	ret->dependencies.clear();
+	ret->dependencies.push_back({path, 0, int64_t(source.size()),
+	                             hashShaderString(source)});
 
-		/*
-		if (!t.empty()) {
-			LogInfo("Parsed shader successfully");
-		} else {
-			LogInfo("Couldn't parse shader.");
+	for (auto& dep : processed->dependencies) {
+		if (dep.size < 0) {
+			// missing include, nothing to compare against later
+			continue;
 		}
-		*/
 
-	} catch (std::exception& e) {
-		LogErrorFmt("Exception, couldn't parse shader: {}", e.what());
+		std::string contents = load_file(dep.path);
+		ret->dependencies.push_back({dep.path, 0, int64_t(contents.size()),
+		                             hashShaderString(contents)});
+	}
+
+	return ret;
+}
+
+// parses name=value, integers and floats only since that's all
+// shaderDefineHeader() handles
+static bool parseOption(const std::string& arg, Shader::parameters& opts) {
+	size_t eq = arg.find('=');
+
+	if (eq == std::string::npos || eq == 0) {
+		return false;
+	}
+
+	std::string name  = arg.substr(0, eq);
+	std::string value = arg.substr(eq + 1);
+	char *end = nullptr;
+
+	if (value.find_first_of(".eE") == std::string::npos) {
+		long v = strtol(value.c_str(), &end, 0);
+		opts[name] = GLint(v);
+	} else {
+		opts[name] = GLfloat(strtod(value.c_str(), &end));
+	}
+
+	return end && end != value.c_str() && *end == '\0';
+}
+
+// keys include the define header, so opts has to match the renderer's
+// globalShaderOptions for the pack to be used
+static int pack(const std::string& output, const std::string& sourceDir,
+                const Shader::parameters& globalOpts)
+{
+	const std::string bakedPrefix = GR_PREFIX "shaders/baked/";
+	shaderPackEntries entries;
+	std::set<std::string> seen;
+
+	for (auto& [path, opts] : engineShaderFiles(globalOpts)) {
+		std::string header = shaderDefineHeader(opts);
+		std::string key    = shaderSourceCache::key(path, header);
+
+		if (!seen.insert(key).second) {
+			continue;
+		}
+
+		// keys use the installed paths, but sources are read from the build tree
+		std::string readPath = path;
+		if (!sourceDir.empty() && path.compare(0, bakedPrefix.size(), bakedPrefix) == 0) {
+			readPath = sourceDir + "/" + path.substr(bakedPrefix.size());
+		}
+
+		std::string source = load_file(readPath);
+		if (source.empty()) {
+			LogErrorFmt("Couldn't load {}, skipping", readPath);
+			continue;
+		}
+
+		auto shader = packShader(path, source, header);
+		if (!shader->reflection) {
+			LogWarnFmt("Couldn't resolve conditionals in {}, packing as-is", readPath);
+		}
+
+		entries.push_back({key, shader});
+	}
+
+	if (!writeShaderPack(output, entries)) {
+		LogErrorFmt("Couldn't write {}", output);
+		return 1;
+	}
+
+	LogInfoFmt("Packed {} shader permutations into {}", entries.size(), output);
+	return 0;
+}
+
+static int reflect(const std::string& path) {
+	auto shader = packShader(path, load_file(path), shaderDefineHeader({}));
+
+	if (!shader->reflection) {
+		LogErrorFmt("Couldn't resolve conditionals in {}", path);
+		return 1;
+	}
+
+	for (auto& u : shader->reflection->uniforms) {
+		std::cout << "uniform " << u.type << " " << u.name;
+		if (u.arraySize) std::cout << "[" << u.arraySize << "]";
+		std::cout << std::endl;
+	}
+
+	for (auto& b : shader->reflection->blocks) {
+		std::cout << "block " << b.name << " " << b.instance << std::endl;
+
+		for (auto& u : b.members) {
+			std::cout << "    " << u.type << " " << u.name;
+			if (u.arraySize) std::cout << "[" << u.arraySize << "]";
+			std::cout << std::endl;
+		}
 	}
 
 	return 0;
 }
+
+static void usage(const char *name) {
+	std::cerr << "usage: " << name << " shader" << std::endl
+	          << "       " << name << " --reflect shader" << std::endl
+	          << "       " << name << " --pack output [--source-dir baked-shaders]"
+	                                   " [--option name=value ...]" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+	// every skipped/failed shader should show up
+	LogSetRateLimit(0);
+
+	if (argc < 2) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	int ret = 0;
+
+	if (strcmp(argv[1], "--pack") == 0 && argc >= 3) {
+		std::string sourceDir;
+		Shader::parameters opts;
+
+		for (int i = 3; i + 1 < argc; i += 2) {
+			if (strcmp(argv[i], "--source-dir") == 0) {
+				sourceDir = argv[i + 1];
+
+			} else if (strcmp(argv[i], "--option") == 0 && parseOption(argv[i + 1], opts)) {
+				continue;
+
+			} else {
+				usage(argv[0]);
+				return 1;
+			}
+		}
+
+		ret = pack(argv[2], sourceDir, opts);
+
+	} else if (strcmp(argv[1], "--reflect") == 0 && argc >= 3) {
+		ret = reflect(argv[2]);
+
+	} else {
+		std::string source = load_file(argv[1]);
+
+		try {
+			auto t = glslObject(source);
+
+		} catch (std::exception& e) {
+			LogErrorFmt("Exception, couldn't parse shader: {}", e.what());
+			ret = 1;
+		}
+	}
+
+	LogFlush();
+	return ret;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+// drawn in chunks of sceneBillboardParticles::instancesPerBuffer
 layout (std140) uniform billboardPositions {
-	vec4 positions[1024];
+	vec4 positions[512];
+	vec4 colors[512];
 };
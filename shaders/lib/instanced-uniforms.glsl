@@ -3,6 +3,7 @@
 uniform mat4 innerTrans;
 uniform mat4 outerTrans;
 
+// drawn in chunks of sceneParticles::instancesPerBuffer
 layout (std140) uniform instanceTransforms {
 	mat4 transforms[256];
 };
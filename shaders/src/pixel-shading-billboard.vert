@@ -51,7 +51,7 @@ void main(void) {
 	f_texcoord = texcoord;
 	f_position = transform * v_invrot * m * vec4(in_Position, 1.0);
 	f_lightmap = a_lightmap;
-	f_color = v_color;
+	f_color = v_color * colors[gl_InstanceID];
 
 	gl_Position = p*v * f_position;
 }
@@ -27,21 +27,20 @@ void applyAnimation(sceneNode::ptr node, animationMap::ptr anim, float time) {
 		return;
 	}
 
-	auto chans = anim->find(node->animChannel);
+	for (const auto& ent : node->flatten().entries) {
+		sceneNode *cur = ent.node;
+		auto chans = anim->find(cur->animChannel);
 
-	if (chans != anim->end()) {
-		TRS t = node->transform.getOrig();
+		if (chans != anim->end()) {
+			TRS t = cur->transform.getOrig();
 
-		for (auto& ch : chans->second) {
-			//SDL_Log("Have animation channel %08x", node->animChannel);
-			ch->applyTransform(t, time, anim->endtime);
-		}
-
-		node->transform.set(t);
-	}
+			for (auto& ch : chans->second) {
+				//SDL_Log("Have animation channel %08x", cur->animChannel);
+				ch->applyTransform(t, time, anim->endtime);
+			}
 
-	for (auto link : node->nodes()) {
-		applyAnimation(link->getRef(), anim, time);
+			cur->transform.set(t);
+		}
 	}
 }
 
@@ -2,6 +2,7 @@
 #include <grend/sdlContext.hpp>
 #include <grend/utility.hpp>
 #include <grend/logger.hpp>
+#include <grend/profile.hpp>
 #include <stdint.h>
 
 using namespace grendx;
@@ -54,19 +55,25 @@ static void mixCallback(void *userdata, uint8_t *stream, int len) {
 	audioMixer *mix = reinterpret_cast<audioMixer*>(userdata);
 	assert(mix != nullptr);
 
-	if (mix->currentCam == nullptr) {
+	// called from SDL's audio thread
+	profile::setThreadName("audio");
+	GREND_PROFILE_ZONE("Audio mix");
+
+	mix->mix(reinterpret_cast<int16_t*>(stream), len/2);
+}
+
+void audioMixer::mix(int16_t *stream, size_t samples) {
+	if (currentCam == nullptr) {
 		puts("nullptr!");
-		memset(stream, 0, len);
+		memset(stream, 0, samples*sizeof(int16_t));
 		return;
 	}
 
-	int16_t *s16strm = reinterpret_cast<int16_t*>(stream);
-
-	for (int i = 0; i < len/2; i += 2) {
+	for (size_t i = 0; i + 1 < samples; i += 2) {
 		// TODO: interpolate over velocity
-		auto sample = mix->getSample(mix->currentCam);
-		s16strm[i]   = sample.first;
-		s16strm[i+1] = sample.second;
+		auto sample = getSample(currentCam);
+		stream[i]   = sample.first;
+		stream[i+1] = sample.second;
 	}
 }
 
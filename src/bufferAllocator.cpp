@@ -11,6 +11,14 @@ bufferAllocator::bufferAllocator() {
 	start = end = &sentinel;
 }
 
+bufferAllocator::~bufferAllocator() {
+	for (bufferNode *it = end; it != &sentinel;) {
+		bufferNode *prev = it->prev;
+		delete it;
+		it = prev;
+	}
+}
+
 bufferNode *bufferAllocator::allocate(size_t amount) {
 	for (auto it = freeNodes.begin(); it != freeNodes.end(); it++) {
 		// node is larger than needed, split into two chunks
@@ -35,6 +43,11 @@ bufferNode *bufferAllocator::allocate(size_t amount) {
 
 				ret->next = temp;
 				ret->size = amount;
+
+				// the destructor walks back from the tail
+				if (ret == end) {
+					end = temp;
+				}
 			}
 
 			ret->state = bufferNode::states::Used;
@@ -4,9 +4,17 @@
 #include <grend/physics.hpp>
 #include <grend/bulletPhysics.hpp>
 #include <grend/logger.hpp>
+#include <grend/jobQueue.hpp>
 #include <grend/ecs/bufferComponent.hpp>
 //#include "btBulletDynamicsCommon.h"
 
+#include "BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h"
+#include "BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
+#include "BulletCollision/NarrowPhaseCollision/btPointCollector.h"
+#include "BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h"
+
+#include <algorithm>
+
 using namespace grendx;
 
 // non-pure virtual destructors for rtti
@@ -27,7 +35,6 @@ bulletPhysics::bulletPhysics() {
 	                                              solver, collisionConfig);
 
 	world->setGravity(btVector3(0, -15, 0));
-	world->setDebugDrawer(&debugDrawer);
 }
 
 bulletPhysics::~bulletPhysics() {
@@ -62,6 +69,7 @@ void bulletObject::setTransform(const TRS& transform) {
 
 	trans.setOrigin(btVector3(t.x, t.y, t.z));
 	trans.setRotation(btQuaternion(r.x, r.y, r.z, r.w));
+	requestedTransform = transform;
 
 	/*
 	if (body->getMotionState()) {
@@ -71,10 +79,49 @@ void bulletObject::setTransform(const TRS& transform) {
 		body->setWorldTransform(trans);
 	}
 	*/
-	body->setWorldTransform(trans);
+	// capture the body rather than this, the object may be gone by the
+	// time a deferred call runs
+	btRigidBody *b = body;
+	transformStep = runtime->defer([=] () { b->setWorldTransform(trans); });
+}
+
+static TRS toTRS(const btTransform& trans) {
+	const btVector3& t = trans.getOrigin();
+	btQuaternion r = trans.getRotation();
+
+	return {
+		.position = glm::vec3(t.x(), t.y(), t.z()),
+		// glm quats are wxyz, btquaternion xyzw
+		.rotation = glm::quat(r.w(), r.x(), r.y(), r.z()),
+	};
+}
+
+const physicsSnapshot::entry *bulletObject::published(uint64_t pendingStep) {
+	if (!runtime || mass == 0.f) {
+		return nullptr;
+	}
+
+	// not acquired here, getters would each move the read buffer along
+	const physicsSnapshot& snap = runtime->getSnapshots()->readBuffer();
+
+	if (snap.step < pendingStep) {
+		// from before the last set was applied
+		return nullptr;
+	}
+
+	return snap.find(this);
 }
 
 TRS bulletObject::getTransform(void) {
+	// never touches the body, it may be in the middle of a step
+	if (auto entry = published(transformStep)) {
+		return entry->current;
+	}
+
+	return requestedTransform;
+}
+
+TRS bulletObject::bodyTransform(void) {
 	btTransform trans;
 
 	if (body && body->getMotionState()) {
@@ -84,53 +131,50 @@ TRS bulletObject::getTransform(void) {
 		trans = body->getWorldTransform();
 	}
 
-	glm::vec3 position = glm::vec3(
-		float(trans.getOrigin().getX()),
-		float(trans.getOrigin().getY()),
-		float(trans.getOrigin().getZ())
-	);
-
-	btQuaternionFloatData bdata;
-	trans.getRotation().serializeFloat(bdata);
-	glm::quat rotation = glm::quat(
-		// glm quats are wxyz, btquaternion xyzw
-		bdata.m_floats[3], bdata.m_floats[0],
-		bdata.m_floats[1], bdata.m_floats[2]
-	);
-
-	return {
-		.position = position,
-		.rotation = rotation,
-	};
+	return toTRS(trans);
 }
 
 void bulletObject::setPosition(glm::vec3 pos) {
 }
 
 void bulletObject::setVelocity(glm::vec3 vel) {
-	body->activate(true);
-	body->setLinearVelocity(btVector3(vel.x, vel.y, vel.z));
+	requestedVelocity = vel;
+	btRigidBody *b = body;
+	velocityStep = runtime->defer([=] () {
+		b->activate(true);
+		b->setLinearVelocity(btVector3(vel.x, vel.y, vel.z));
+	});
 }
 
 void bulletObject::setAcceleration(glm::vec3 accel) {
-	body->activate(true);
-	body->applyCentralForce(btVector3(accel.x, accel.y, accel.z));
+	btRigidBody *b = body;
+	runtime->defer([=] () {
+		b->activate(true);
+		b->applyCentralForce(btVector3(accel.x, accel.y, accel.z));
+	});
 }
 
 void bulletObject::setAngularFactor(float amount) {
-	body->setAngularFactor(btScalar(amount));
+	requestedAngularFactor = glm::vec3(amount);
+	btRigidBody *b = body;
+	runtime->defer([=] () { b->setAngularFactor(btScalar(amount)); });
 	// TODO: implement impObject::setAngularFactor();
 }
 
 void bulletObject::setAngularFactor(const glm::vec3& amount) {
-	body->setAngularFactor(btVector3(amount.x, amount.y, amount.z));
+	requestedAngularFactor = amount;
+	btRigidBody *b = body;
+	btVector3 factor(amount.x, amount.y, amount.z);
+	runtime->defer([=] () { b->setAngularFactor(factor); });
 	// TODO: implement impObject::setAngularFactor();
 }
 
 glm::vec3 bulletObject::getVelocity(void) {
-	// TODO
-	auto v = body->getLinearVelocity();
-	return glm::vec3(v.x(), v.y(), v.z());
+	if (auto entry = published(velocityStep)) {
+		return entry->velocity;
+	}
+
+	return requestedVelocity;
 }
 
 glm::vec3 bulletObject::getAcceleration(void) {
@@ -139,19 +183,28 @@ glm::vec3 bulletObject::getAcceleration(void) {
 }
 
 glm::vec3 bulletObject::getAngularFactor(void) {
-	auto v = body->getAngularFactor();
-	return {v.x(), v.y(), v.z()};
+	// only changed through setAngularFactor()
+	return requestedAngularFactor;
 }
 
 void bulletPhysics::drawDebug(glm::mat4 cam) {
-	if (debugDrawer.getDebugMode()) {
+	if (debugDrawer && debugDrawer->getDebugMode()) {
 		world->debugDrawWorld();
-		debugDrawer.flushLines(cam);
+		debugDrawer->flushLines(cam);
 	}
 }
 
 void bulletPhysics::setDebugMode(int mode) {
-	debugDrawer.setDebugMode(mode);
+	if (!debugDrawer) {
+		if (mode == btIDebugDraw::DBG_NoDebug) {
+			return;
+		}
+
+		debugDrawer = std::make_unique<bulletDebugDrawer>();
+		world->setDebugDrawer(debugDrawer.get());
+	}
+
+	debugDrawer->setDebugMode(mode);
 }
 
 void
@@ -210,6 +263,7 @@ bulletPhysics::addSphere(void *data, glm::vec3 pos,
 	}
 
 	ret->motionState = new btDefaultMotionState(trans);
+	ret->requestedTransform = toTRS(trans);
 	ret->body = new btRigidBody(btScalar(mass), ret->motionState, ret->shape, localInertia);
 	ret->body->setLinearFactor(btVector3(1, 1, 1));
 	ret->body->setUserPointer(ret.get());
@@ -247,6 +301,7 @@ bulletPhysics::addBox(void *data,
 	}
 
 	ret->motionState = new btDefaultMotionState(trans);
+	ret->requestedTransform = toTRS(trans);
 	ret->body = new btRigidBody(btScalar(mass), ret->motionState, ret->shape, localInertia);
 	ret->body->setLinearFactor(btVector3(1, 1, 1));
 	ret->body->setAngularFactor(btScalar(1));
@@ -286,6 +341,7 @@ bulletPhysics::addCylinder(void *data,
 	}
 
 	ret->motionState = new btDefaultMotionState(trans);
+	ret->requestedTransform = toTRS(trans);
 	ret->body = new btRigidBody(btScalar(mass), ret->motionState, ret->shape, localInertia);
 	ret->body->setLinearFactor(btVector3(1, 1, 1));
 	ret->body->setAngularFactor(btScalar(1));
@@ -326,6 +382,7 @@ bulletPhysics::addCapsule(void *data,
 	}
 
 	ret->motionState = new btDefaultMotionState(trans);
+	ret->requestedTransform = toTRS(trans);
 	ret->body = new btRigidBody(btScalar(mass), ret->motionState, ret->shape, localInertia);
 	ret->body->setLinearFactor(btVector3(1, 1, 1));
 	ret->body->setAngularFactor(btScalar(1));
@@ -344,41 +401,72 @@ bulletPhysics::addStaticMesh(void *data,
                              sceneModel::ptr model,
                              sceneMesh::ptr mesh)
 {
-	std::lock_guard<std::mutex> lock(bulletMutex);
-
-	auto vertBuf = model->get<ecs::bufferComponent<sceneModel::vertex>>();
-	auto faceBuf = mesh->get<ecs::bufferComponent<sceneMesh::faceType>>();
+	// shared with every other instance of the mesh, built (or loaded)
+	// before taking the physics lock so stepping isn't held up
+	auto shape = shapes.staticMesh(model, mesh, transform.scale);
 
-	if (!vertBuf || !faceBuf) {
+	if (!shape) {
+		LogError("WARNING: bulletPhysics::addStaticMesh(): "
+		         "can't add mesh with no elements");
 		return nullptr;
 	}
 
-	auto& verts = vertBuf->data;
-	auto& faces = faceBuf->data;
+	std::lock_guard<std::mutex> lock(bulletMutex);
 
-	if (faces.size() / 3 == 0) {
-		LogError("WARNING: bulletPhysics::addStaticMesh(): "
+	bulletObject::ptr ret = std::make_shared<bulletObject>();
+	ret->runtime = this;
+	ret->mass = 0.f;
+	ret->data = data;
+	ret->shape = shape.get();
+	ret->sharedShape = shape;
+
+	btVector3 localInertia(0, 0, 0);
+	btTransform trans;
+
+	glm::vec3 pos = transform.position;
+	glm::quat rot = transform.rotation;
+	trans.setIdentity();
+	trans.setOrigin(btVector3(pos.x, pos.y, pos.z));
+	trans.setRotation(btQuaternion(rot.x, rot.y, rot.z, rot.w));
+
+	ret->motionState = new btDefaultMotionState(trans);
+	ret->requestedTransform = toTRS(trans);
+	ret->body = new btRigidBody(btScalar(0.f), ret->motionState, ret->shape, localInertia);
+	ret->body->setLinearFactor(btVector3(1, 1, 1));
+	ret->body->setAngularFactor(btScalar(1));
+	ret->body->setUserPointer(ret.get());
+	world->addRigidBody(ret->body);
+
+	auto p = std::dynamic_pointer_cast<physicsObject>(ret);
+	objects.insert({ret.get(), p});
+	return p;
+}
+
+physicsObject::ptr
+bulletPhysics::addDynamicMesh(void *data,
+                              const TRS& transform,
+                              float mass,
+                              sceneModel::ptr model,
+                              sceneMesh::ptr mesh)
+{
+	auto shape = shapes.convexMesh(model, mesh, transform.scale);
+
+	if (!shape) {
+		LogError("WARNING: bulletPhysics::addDynamicMesh(): "
 		         "can't add mesh with no elements");
 		return nullptr;
 	}
 
-	btTriangleIndexVertexArray* indexArray =
-		new btTriangleIndexVertexArray(faces.size() / 3,
-		                               (int*)faces.data(),
-		                               sizeof(GLuint[3]),
-		                               verts.size(),
-		                               (GLfloat*)verts.data(),
-									   sizeof(sceneModel::vertex));
+	std::lock_guard<std::mutex> lock(bulletMutex);
 
 	bulletObject::ptr ret = std::make_shared<bulletObject>();
 	ret->runtime = this;
-	ret->mass = 0.f;
+	ret->mass = mass;
 	ret->data = data;
-	ret->shape = new btBvhTriangleMeshShape(indexArray, true /* useQuantizedAabbCompression */ );
-
-	btVector3 scale(transform.scale.x, transform.scale.y, transform.scale.z);
-	ret->shape->setLocalScaling(scale);
+	ret->shape = shape.get();
+	ret->sharedShape = shape;
 
+	bool isDynamic = mass != 0.f;
 	btVector3 localInertia(0, 0, 0);
 	btTransform trans;
 
@@ -388,8 +476,13 @@ bulletPhysics::addStaticMesh(void *data,
 	trans.setOrigin(btVector3(pos.x, pos.y, pos.z));
 	trans.setRotation(btQuaternion(rot.x, rot.y, rot.z, rot.w));
 
+	if (isDynamic) {
+		ret->shape->calculateLocalInertia(btScalar(mass), localInertia);
+	}
+
 	ret->motionState = new btDefaultMotionState(trans);
-	ret->body = new btRigidBody(btScalar(0.f), ret->motionState, ret->shape, localInertia);
+	ret->requestedTransform = toTRS(trans);
+	ret->body = new btRigidBody(btScalar(mass), ret->motionState, ret->shape, localInertia);
 	ret->body->setLinearFactor(btVector3(1, 1, 1));
 	ret->body->setAngularFactor(btScalar(1));
 	ret->body->setUserPointer(ret.get());
@@ -400,22 +493,35 @@ bulletPhysics::addStaticMesh(void *data,
 	return p;
 }
 
-// TODO: remove, don't think this is being used anywhere, don't remember what I
-//       had planned to do with it...
-//       must not be important then :P
+// static bodies for each mesh in the model, placed relative to the model,
+// shapes come from the cache so every instance of the model shares them
 std::map<sceneMesh::ptr, physicsObject::ptr>
 bulletPhysics::addModelMeshBoxes(sceneModel::ptr mod) {
-	return {};
+	std::map<sceneMesh::ptr, physicsObject::ptr> ret;
+
+	for (auto ptr : mod->nodes()) {
+		if ((*ptr)->type != sceneNode::objType::Mesh) {
+			continue;
+		}
+
+		auto mesh = ref_cast<sceneMesh>(ptr->getRef());
+		auto obj  = addStaticMesh(nullptr, mesh->transform.getTRS(), mod, mesh);
+
+		if (obj) {
+			ret[mesh] = obj;
+		}
+	}
+
+	return ret;
 }
 
 void bulletPhysics::remove(physicsObject::ptr obj) {
-	std::lock_guard<std::mutex> lock(bulletMutex);
-
 	bulletObject::ptr bobj = std::dynamic_pointer_cast<bulletObject>(obj);
 	LogInfo("remove(): got here, removing an object");
 
 	if (bobj) {
 		LogInfo("remove(): really removing");
+		// remove(bulletObject*) takes the lock
 		remove(bobj.get());
 	}
 }
@@ -429,6 +535,7 @@ void bulletPhysics::remove(bulletObject *ptr) {
 	if (it != objects.end()) {
 		world->removeRigidBody(ptr->body);
 		objects.erase(it);
+		contacts.removeObject(ptr);
 	}
 }
 
@@ -439,9 +546,66 @@ size_t bulletPhysics::numObjects(void) {
 	return objects.size();
 }
 
+static inline glm::vec3 toGlm(const btVector3& v) {
+	return glm::vec3(v.getX(), v.getY(), v.getZ());
+}
+
+// old per-object queues, only used if something registered a queue
+static void pushLegacyCollisions(bulletObject *aptr, physicsObject::weakptr wphysA,
+                                 bulletObject *bptr, physicsObject::weakptr wphysB,
+                                 void *adata, void *bdata,
+                                 btPersistentManifold *contact)
+{
+	physicsObject::ptr physA = wphysA.lock();
+	physicsObject::ptr physB = wphysB.lock();
+
+	if (!physA || !physB) {
+		// pointer to expired object, which is somehow still in the
+		// world, shouldn't reach here but have to handle this anyway
+		return;
+	}
+
+	int numContacts = contact->getNumContacts();
+	for (int k = 0; k < numContacts; k++) {
+		btManifoldPoint& pt = contact->getContactPoint(k);
+		float depth = pt.getDistance();
+
+		if (depth >= 0.f) {
+			continue;
+		}
+
+		if (physA->collisionQueue) {
+			physA->collisionQueue->push_back({
+				.a = physA,
+				.b = physB,
+				.adata = adata,
+				.bdata = bdata,
+				.position = toGlm(pt.getPositionWorldOnA()),
+				.normal = toGlm(-pt.m_normalWorldOnB),
+				.depth = depth,
+			});
+		}
+
+		if (physB->collisionQueue) {
+			physB->collisionQueue->push_back({
+				.a = physB,
+				.b = physA,
+				.adata = bdata,
+				.bdata = adata,
+				.position = toGlm(pt.getPositionWorldOnB()),
+				.normal = toGlm(pt.m_normalWorldOnB),
+				.depth = depth,
+			});
+		}
+	}
+}
+
+// should be called with bulletMutex held
 void bulletPhysics::filterCollisions(void) {
 	int manifolds = world->getDispatcher()->getNumManifolds();
 
+	contacts.beginStep();
+
 	for (int i = 0; i < manifolds; i++) {
 		btPersistentManifold *contact =
 			world->getDispatcher()->getManifoldByIndexInternal(i);
@@ -451,95 +615,499 @@ void bulletPhysics::filterCollisions(void) {
 		bulletObject *aptr = static_cast<bulletObject*>(a->getUserPointer());
 		bulletObject *bptr = static_cast<bulletObject*>(b->getUserPointer());
 
-		if (!objects.count(aptr) || !objects.count(bptr)) {
+		// find the deepest penetrating point, only one event is generated
+		// per pair per step
+		int numContacts = contact->getNumContacts();
+		int deepest = -1;
+		float depth = 0.f;
+
+		for (int k = 0; k < numContacts; k++) {
+			float d = contact->getContactPoint(k).getDistance();
+
+			if (d < depth) {
+				depth = d;
+				deepest = k;
+			}
+		}
+
+		if (deepest < 0) {
+			// touching bounds but not penetrating
+			continue;
+		}
+
+		auto ait = objects.find(aptr);
+		auto bit = objects.find(bptr);
+
+		if (ait == objects.end() || bit == objects.end()) {
 			// one of the objects isn't valid, this shouldn't happen
 			continue;
 		}
 
-		int numContacts = contact->getNumContacts();
-		for (int k = 0; k < numContacts; k++) {
-			btManifoldPoint& pt = contact->getContactPoint(k);
-			float depth = pt.getDistance();
-
-			if (depth < 0.f) {
-				physicsObject::weakptr wphysA = objects[aptr];
-				physicsObject::weakptr wphysB = objects[bptr];
-
-				physicsObject::ptr physA = wphysA.lock();
-				physicsObject::ptr physB = wphysB.lock();
-
-				if (!physA || !physB) {
-					// pointer to expired object, which is somehow still in the
-					// world, shouldn't reach here but have to handle this anyway
-					continue;
-				}
-
-				const btVector3& ptA = pt.getPositionWorldOnA();
-				const btVector3& ptB = pt.getPositionWorldOnB();
-				const btVector3& normalB =  pt.m_normalWorldOnB;
-				const btVector3& normalA = -pt.m_normalWorldOnB;
-
-				if (physA->collisionQueue) {
-					collision colA = {
-						.a = physA,
-						.b = physB,
-						.adata = aptr->data,
-						.bdata = bptr->data,
-						.position = glm::vec3(ptA.getX(), ptA.getY(), ptA.getZ()),
-						.normal = glm::vec3(normalA.getX(), normalA.getY(), normalA.getZ()),
-						.depth = depth,
-					};
-
-					physA->collisionQueue->push_back(colA);
-				}
-
-				if (physB->collisionQueue) {
-					collision colB = {
-						.a = physB,
-						.b = physA,
-						.adata = bptr->data,
-						.bdata = aptr->data,
-						.position = glm::vec3(ptB.getX(), ptB.getY(), ptB.getZ()),
-						.normal = glm::vec3(normalB.getX(), normalB.getY(), normalB.getZ()),
-						.depth = depth,
-					};
-
-					physB->collisionQueue->push_back(colB);
-				}
+		btManifoldPoint& pt = contact->getContactPoint(deepest);
+
+		// the legacy queues get the same layer filtering as the stream
+		bool accepted = contacts.addContact(aptr, bptr, aptr->data, bptr->data,
+			aptr->collisionLayer, aptr->collisionMask,
+			bptr->collisionLayer, bptr->collisionMask,
+			toGlm(pt.getPositionWorldOnA()),
+			toGlm(pt.getPositionWorldOnB()),
+			toGlm(pt.m_normalWorldOnB),
+			depth);
+
+		if (accepted && (aptr->collisionQueue || bptr->collisionQueue)) {
+			pushLegacyCollisions(aptr, ait->second, bptr, bit->second,
+			                     aptr->data, bptr->data, contact);
+		}
+	}
+
+	contacts.endStep();
+}
+
+static inline btVector3 toBt(const glm::vec3& v) {
+	return btVector3(v.x, v.y, v.z);
+}
+
+// Queries go straight to the broadphase trees and the static narrowphase
+// helpers instead of btCollisionWorld::rayTest() and friends, which share
+// scratch state between calls (the broadphase ray stacks, the dispatcher's
+// algorithm pool) and can't run on more than one thread at a time.
+template <typename F>
+struct leafVisitor : public btDbvt::ICollide {
+	F& fn;
+
+	leafVisitor(F& f) : fn(f) {}
+
+	void Process(const btDbvtNode *leaf) {
+		auto *proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+		auto *obj   = static_cast<btCollisionObject*>(proxy->m_clientObject);
+		auto *ptr   = static_cast<bulletObject*>(obj->getUserPointer());
+
+		if (ptr) {
+			fn(obj, ptr);
+		}
+	}
+};
+
+template <typename F>
+static void forEachOnRay(btDbvtBroadphase *broadphase,
+                         const btVector3& from,
+                         const btVector3& to,
+                         F fn)
+{
+	leafVisitor<F> visitor(fn);
+
+	// dynamic and static trees
+	for (auto& set : broadphase->m_sets) {
+		btDbvt::rayTest(set.m_root, from, to, visitor);
+	}
+}
+
+template <typename F>
+static void forEachInBox(btDbvtBroadphase *broadphase,
+                         const btVector3& min,
+                         const btVector3& max,
+                         F fn)
+{
+	leafVisitor<F> visitor(fn);
+	btDbvtVolume volume = btDbvtVolume::FromMM(min, max);
+
+	for (auto& set : broadphase->m_sets) {
+		set.collideTV(set.m_root, volume, visitor);
+	}
+}
+
+static btTransform translation(const btVector3& pos) {
+	btTransform ret;
+	ret.setIdentity();
+	ret.setOrigin(pos);
+	return ret;
+}
+
+static btVector3 closestOnTriangle(const btVector3& p,
+                                   const btVector3& a,
+                                   const btVector3& b,
+                                   const btVector3& c)
+{
+	// regions from Ericson, Real-Time Collision Detection 5.1.5
+	btVector3 ab = b - a, ac = c - a, ap = p - a;
+	btScalar d1 = ab.dot(ap), d2 = ac.dot(ap);
+	if (d1 <= 0 && d2 <= 0) return a;
+
+	btVector3 bp = p - b;
+	btScalar d3 = ab.dot(bp), d4 = ac.dot(bp);
+	if (d3 >= 0 && d4 <= d3) return b;
+
+	btScalar vc = d1*d4 - d3*d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab*(d1 / (d1 - d3));
+
+	btVector3 cp = p - c;
+	btScalar d5 = ab.dot(cp), d6 = ac.dot(cp);
+	if (d6 >= 0 && d5 <= d6) return c;
+
+	btScalar vb = d5*d2 - d1*d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac*(d2 / (d2 - d6));
+
+	btScalar va = d3*d6 - d5*d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+		return b + (c - b)*((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	btScalar denom = 1 / (va + vb + vc);
+	return a + ab*(vb*denom) + ac*(vc*denom);
+}
+
+struct sphereTriangleCallback : public btTriangleCallback {
+	btVector3 center;
+	btScalar  radius2;
+	bool hit = false;
+
+	sphereTriangleCallback(const btVector3& c, btScalar r)
+		: center(c), radius2(r*r) {}
+
+	virtual void processTriangle(btVector3 *tri, int part, int index) {
+		if (!hit) {
+			btVector3 p = closestOnTriangle(center, tri[0], tri[1], tri[2]);
+			hit = (p - center).length2() <= radius2;
+		}
+	}
+};
+
+static bool sphereOverlaps(const btCollisionObject *obj,
+                           const btVector3& center,
+                           btScalar radius)
+{
+	const btCollisionShape *shape = obj->getCollisionShape();
+	const btTransform& trans = obj->getWorldTransform();
+
+	if (shape->isConvex()) {
+		btSphereShape sphere(radius);
+		btVoronoiSimplexSolver simplex;
+		btGjkEpaPenetrationDepthSolver epa;
+		btGjkPairDetector gjk(&sphere, static_cast<const btConvexShape*>(shape),
+		                      &simplex, &epa);
+		btGjkPairDetector::ClosestPointInput input;
+		btPointCollector result;
+
+		input.m_transformA = translation(center);
+		input.m_transformB = trans;
+		gjk.getClosestPoints(input, result, nullptr);
+
+		return result.m_hasResult && result.m_distance <= 0;
+	}
+
+	if (shape->isConcave()) {
+		// triangles come out in the shape's (scaled) local space
+		btVector3 local = trans.invXform(center);
+		btVector3 r(radius, radius, radius);
+		sphereTriangleCallback callback(local, radius);
+
+		static_cast<const btConcaveShape*>(shape)
+			->processAllTriangles(&callback, local - r, local + r);
+		return callback.hit;
+	}
+
+	// anything else only has its bounds tested
+	return true;
+}
+
+bool bulletPhysics::raycastLocked(const physicsRay& ray, physicsHit& hit) {
+	btVector3 from = toBt(ray.from);
+	btVector3 to   = toBt(ray.to);
+	btTransform fromTrans = translation(from);
+	btTransform toTrans   = translation(to);
+	btCollisionWorld::ClosestRayResultCallback result(from, to);
+
+	forEachOnRay(pairCache, from, to, [&] (btCollisionObject *obj, bulletObject *ptr) {
+		if (ray.filter.accepts(ptr, ptr->data)) {
+			btCollisionWorld::rayTestSingle(fromTrans, toTrans, obj,
+			                                obj->getCollisionShape(),
+			                                obj->getWorldTransform(),
+			                                result);
+		}
+	});
+
+	if (!result.hasHit()) {
+		return false;
+	}
+
+	auto *ptr = static_cast<bulletObject*>(result.m_collisionObject->getUserPointer());
+	hit.obj      = ptr;
+	hit.data     = ptr->data;
+	hit.position = toGlm(result.m_hitPointWorld);
+	hit.normal   = toGlm(result.m_hitNormalWorld);
+	hit.fraction = result.m_closestHitFraction;
+
+	return true;
+}
+
+bool bulletPhysics::sweepLocked(const physicsSweep& query, physicsHit& hit) {
+	btVector3 from = toBt(query.from);
+	btVector3 to   = toBt(query.to);
+	btTransform fromTrans = translation(from);
+	btTransform toTrans   = translation(to);
+
+	btSphereShape  sphere(query.radius);
+	btCapsuleShape capsule(query.radius, query.height);
+	btConvexShape *shape = (query.height > 0.f)
+		? static_cast<btConvexShape*>(&capsule)
+		: static_cast<btConvexShape*>(&sphere);
+
+	btVector3 extent(query.radius, query.radius + query.height*0.5f, query.radius);
+	btVector3 min = from, max = from;
+	min.setMin(to);
+	max.setMax(to);
+
+	btCollisionWorld::ClosestConvexResultCallback result(from, to);
+
+	// bounds of the whole sweep, fine for the short sweeps used for
+	// movement, long diagonal sweeps will test more objects than needed
+	forEachInBox(pairCache, min - extent, max + extent,
+		[&] (btCollisionObject *obj, bulletObject *ptr) {
+			if (query.filter.accepts(ptr, ptr->data)) {
+				btCollisionWorld::objectQuerySingle(shape, fromTrans, toTrans, obj,
+				                                    obj->getCollisionShape(),
+				                                    obj->getWorldTransform(),
+				                                    result, 0.f);
 			}
+		});
+
+	if (!result.hasHit()) {
+		return false;
+	}
+
+	auto *ptr = static_cast<bulletObject*>(result.m_hitCollisionObject->getUserPointer());
+	hit.obj      = ptr;
+	hit.data     = ptr->data;
+	hit.position = toGlm(result.m_hitPointWorld);
+	hit.normal   = toGlm(result.m_hitNormalWorld);
+	hit.fraction = result.m_closestHitFraction;
+
+	return true;
+}
+
+size_t bulletPhysics::overlapLocked(const physicsOverlap& query,
+                                    std::vector<physicsHit>& hits)
+{
+	btVector3 center = toBt(query.center);
+	btVector3 extent = (query.shape == physicsOverlap::Sphere)
+		? btVector3(query.radius, query.radius, query.radius)
+		: toBt(query.extent);
+	btVector3 min = center - extent;
+	btVector3 max = center + extent;
+	size_t found = 0;
+
+	forEachInBox(pairCache, min, max, [&] (btCollisionObject *obj, bulletObject *ptr) {
+		if (!query.filter.accepts(ptr, ptr->data)) {
+			return;
+		}
+
+		// broadphase bounds are padded for moving objects
+		btVector3 objMin, objMax;
+		obj->getCollisionShape()->getAabb(obj->getWorldTransform(), objMin, objMax);
+
+		if (!TestAabbAgainstAabb2(min, max, objMin, objMax)) {
+			return;
+		}
+
+		if (query.shape == physicsOverlap::Sphere
+		    && !sphereOverlaps(obj, center, query.radius))
+		{
+			return;
+		}
+
+		physicsHit hit;
+		hit.obj      = ptr;
+		hit.data     = ptr->data;
+		hit.position = toGlm(obj->getWorldTransform().getOrigin());
+		hit.fraction = 0.f;
+		hits.push_back(hit);
+		found++;
+	});
+
+	return found;
+}
+
+bool bulletPhysics::raycast(const physicsRay& ray, physicsHit& hit) {
+	std::lock_guard<std::mutex> lock(bulletMutex);
+	return raycastLocked(ray, hit);
+}
+
+bool bulletPhysics::sweep(const physicsSweep& query, physicsHit& hit) {
+	std::lock_guard<std::mutex> lock(bulletMutex);
+	return sweepLocked(query, hit);
+}
+
+size_t bulletPhysics::overlap(const physicsOverlap& query,
+                              std::vector<physicsHit>& hits)
+{
+	std::lock_guard<std::mutex> lock(bulletMutex);
+	return overlapLocked(query, hits);
+}
+
+// queries per job, enough to be worth handing to a worker
+static constexpr size_t queryBlockSize = 64;
+
+static size_t queryBlocks(size_t count) {
+	return (count + queryBlockSize - 1) / queryBlockSize;
+}
+
+static void forQueryBlocks(jobQueue *jobs, size_t count,
+                           const std::function<void(size_t, size_t)>& fn)
+{
+	size_t blocks = queryBlocks(count);
+
+	auto block = [&] (size_t i) {
+		fn(i*queryBlockSize, std::min(count, (i + 1)*queryBlockSize));
+	};
+
+	if (jobs && blocks > 1) {
+		jobs->parallelFor(blocks, block);
+
+	} else {
+		for (size_t i = 0; i < blocks; i++) {
+			block(i);
 		}
 	}
 }
 
-void bulletPhysics::stepSimulation(float delta) {
+void bulletPhysics::raycastBatch(std::span<const physicsRay> rays,
+                                 std::span<physicsHit> hits,
+                                 jobQueue *jobs)
+{
 	std::lock_guard<std::mutex> lock(bulletMutex);
-	world->stepSimulation(delta, 10);
+	size_t count = std::min(rays.size(), hits.size());
 
-	for (auto& [rawptr, wphysptr] : objects) {
-		physicsObject::ptr physptr = wphysptr.lock();
+	forQueryBlocks(jobs, count, [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			hits[i] = {};
+			raycastLocked(rays[i], hits[i]);
+		}
+	});
+}
 
-		if (!physptr) {
-			continue;
+void bulletPhysics::sweepBatch(std::span<const physicsSweep> queries,
+                               std::span<physicsHit> hits,
+                               jobQueue *jobs)
+{
+	std::lock_guard<std::mutex> lock(bulletMutex);
+	size_t count = std::min(queries.size(), hits.size());
+
+	forQueryBlocks(jobs, count, [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			hits[i] = {};
+			sweepLocked(queries[i], hits[i]);
 		}
+	});
+}
 
-		bulletObject::ptr ptr = std::dynamic_pointer_cast<bulletObject>(physptr);
-		btTransform trans;
+void bulletPhysics::overlapBatch(std::span<const physicsOverlap> queries,
+                                 std::vector<physicsHit>& hits,
+                                 std::span<physicsOverlapRange> ranges,
+                                 jobQueue *jobs)
+{
+	std::lock_guard<std::mutex> lock(bulletMutex);
+	size_t count = std::min(queries.size(), ranges.size());
+	// each block collects into its own list, stitched together after
+	std::vector<std::vector<physicsHit>> blockHits(queryBlocks(count));
 
-		if (ptr && ptr->body && ptr->body->getMotionState()) {
-			ptr->body->getMotionState()->getWorldTransform(trans);
+	forQueryBlocks(jobs, count, [&] (size_t begin, size_t end) {
+		auto& out = blockHits[begin / queryBlockSize];
 
-		} else {
-			trans = ptr->body->getWorldTransform();
+		for (size_t i = begin; i < end; i++) {
+			ranges[i].first = out.size();
+			ranges[i].count = overlapLocked(queries[i], out);
 		}
+	});
 
-		/*
-		if (ptr->mass != 0) {
-			if (auto ref = ptr->obj) {
-				//ref->transform = ptr->getTransform();
-				ref->setTransform(ptr->getTransform());
-			}
+	for (size_t b = 0; b < blockHits.size(); b++) {
+		size_t offset = hits.size();
+		size_t end = std::min(count, (b + 1)*queryBlockSize);
+
+		for (size_t i = b*queryBlockSize; i < end; i++) {
+			ranges[i].first += offset;
 		}
-		*/
+
+		hits.insert(hits.end(), blockHits[b].begin(), blockHits[b].end());
 	}
 }
+
+void bulletPhysics::setAsyncStepping(bool async) {
+	asyncStepping = async;
+}
+
+uint64_t bulletPhysics::defer(std::function<void()> func) {
+	std::lock_guard<std::mutex> lock(deferredMutex);
+
+	if (!asyncStepping) {
+		func();
+
+	} else {
+		deferred.push_back(std::move(func));
+	}
+
+	return deferredStep;
+}
+
+// should be called with bulletMutex held
+void bulletPhysics::runDeferred(void) {
+	{
+		// only hold the queue lock long enough to swap buffers, so
+		// deferring from the main thread never waits on a step
+		std::lock_guard<std::mutex> lock(deferredMutex);
+		std::swap(deferred, runningDeferred);
+		// this step publishes stepCount + 1, anything deferred from
+		// here on waits for the one after
+		deferredStep = stepCount + 2;
+	}
+
+	for (auto& func : runningDeferred) {
+		func();
+	}
+
+	runningDeferred.clear();
+}
+
+// should be called with bulletMutex held
+void bulletPhysics::publishSnapshot(float delta) {
+	physicsSnapshot& snap = snapshots.writeBuffer();
+
+	snap.transforms.clear();
+	snap.step     = ++stepCount;
+	snap.stepSize = delta;
+	snap.time     = std::chrono::steady_clock::now();
+
+	// objects is ordered by pointer, so transforms end up sorted for find()
+	for (auto& [ptr, _] : objects) {
+		// static objects never move, no need to publish them
+		if (ptr->mass == 0.f || !ptr->body) {
+			continue;
+		}
+
+		TRS current = ptr->bodyTransform();
+		const btVector3& vel = ptr->body->getLinearVelocity();
+		TRS previous = ptr->haveLastStep? ptr->lastStepTransform : current;
+
+		ptr->lastStepTransform = current;
+		ptr->haveLastStep = true;
+
+		snap.transforms.push_back({
+			.obj      = ptr,
+			.data     = ptr->data,
+			.previous = previous,
+			.current  = current,
+			.velocity = glm::vec3(vel.x(), vel.y(), vel.z()),
+		});
+	}
+
+	snapshots.publish();
+}
+
+void bulletPhysics::stepSimulation(float delta) {
+	std::lock_guard<std::mutex> lock(bulletMutex);
+
+	runDeferred();
+	world->stepSimulation(delta, 10);
+	filterCollisions();
+	publishSnapshot(delta);
+}
 #endif
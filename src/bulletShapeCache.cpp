@@ -0,0 +1,506 @@
+#include <grend-config.h>
+
+#ifdef PHYSICS_BULLET
+#include <grend/bulletShapeCache.hpp>
+#include <grend/textureCache.hpp>
+#include <grend/ecs/bufferComponent.hpp>
+#include <grend/logger.hpp>
+#include <grend/profile.hpp>
+
+#include "BulletCollision/CollisionShapes/btShapeHull.h"
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <stdio.h>
+#include <math.h>
+
+namespace grendx {
+
+namespace {
+	struct cookedHeader {
+		enum : uint32_t {
+			MAGIC   = 0x53435247, /* "GRCS" */
+			VERSION = 1,
+		};
+
+		uint32_t magic;
+		uint32_t version;
+		// in-place BVHs depend on the scalar type and Bullet's layout
+		uint32_t scalarSize;
+		uint32_t bulletVersion;
+		uint64_t hash;
+		uint32_t vertices;
+		uint32_t triangles;
+		uint64_t bvhSize;
+	};
+
+	bool sameTriangles(const auto& a, const auto& b) {
+		return a.positions == b.positions && a.indices == b.indices;
+	}
+}
+
+bulletShapeCache::meshEntry::~meshEntry() {
+	// cooked BVHs live in their file buffer, the shape doesn't own them
+	btOptimizedBvh *bvh = cooked? shape->getOptimizedBvh() : nullptr;
+
+	delete shape;
+
+	if (bvh) {
+		bvh->~btOptimizedBvh();
+		btAlignedFree(cooked);
+	}
+
+	delete array;
+}
+
+bulletShapeCache::~bulletShapeCache() {}
+
+bool bulletShapeCache::extract(sceneModel::ptr model,
+                               sceneMesh::ptr mesh,
+                               triangles& out)
+{
+	auto vertBuf = model->get<ecs::bufferComponent<sceneModel::vertex>>();
+	auto faceBuf = mesh->get<ecs::bufferComponent<sceneMesh::faceType>>();
+
+	if (!vertBuf || !faceBuf) {
+		return false;
+	}
+
+	auto& verts = vertBuf->data;
+	auto& faces = mesh->sharedIndices
+		? mesh->sharedIndices->indices
+		: faceBuf->data;
+
+	// meshes index into the whole model's vertex buffer, only copy the
+	// vertices this one uses
+	std::vector<int> remap(verts.size(), -1);
+
+	auto addVertex = [&] (sceneMesh::faceType idx) {
+		if (remap[idx] < 0) {
+			const glm::vec3& p = verts[idx].position;
+			remap[idx] = out.positions.size() / 3;
+			out.positions.insert(out.positions.end(), {p.x, p.y, p.z});
+		}
+
+		out.indices.push_back(remap[idx]);
+	};
+
+	for (size_t i = 0; i + 2 < faces.size(); i += 3) {
+		auto a = faces[i], b = faces[i + 1], c = faces[i + 2];
+
+		if (a >= verts.size() || b >= verts.size() || c >= verts.size()) {
+			continue;
+		}
+
+		addVertex(a);
+		addVertex(b);
+		addVertex(c);
+	}
+
+	out.hash = hashBytes(out.positions.data(), out.positions.size()*sizeof(btScalar));
+	out.hash = hashBytes(out.indices.data(), out.indices.size()*sizeof(int), out.hash);
+
+	return !out.indices.empty();
+}
+
+bulletShapeCache::shapeKey bulletShapeCache::makeKey(uint64_t hash,
+                                                     const glm::vec3& scale)
+{
+	return {
+		.hash  = hash,
+		.scale = {
+			int32_t(lroundf(scale.x * 1024.f)),
+			int32_t(lroundf(scale.y * 1024.f)),
+			int32_t(lroundf(scale.z * 1024.f)),
+		},
+	};
+}
+
+std::string bulletShapeCache::cookedFile(uint64_t hash) const {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "/%016llx.bvh", (unsigned long long)hash);
+	return cookPath + buf;
+}
+
+bool bulletShapeCache::loadCooked(meshEntry& entry) {
+	std::ifstream ifs(cookedFile(entry.tris.hash), std::ios::binary);
+	cookedHeader header;
+
+	if (!ifs.read((char*)&header, sizeof(header))) {
+		// not cooked yet
+		return false;
+	}
+
+	auto& tris = entry.tris;
+	size_t numVerts = tris.positions.size() / 3;
+	size_t numTris  = tris.indices.size() / 3;
+
+	if (header.magic != cookedHeader::MAGIC
+	    || header.version != cookedHeader::VERSION
+	    || header.scalarSize != sizeof(btScalar)
+	    || header.bulletVersion != BT_BULLET_VERSION
+	    || header.hash != tris.hash
+	    || header.vertices != numVerts
+	    || header.triangles != numTris
+	    || header.bvhSize > UINT32_MAX)
+	{
+		counters.cookedRejected++;
+		return false;
+	}
+
+	// geometry is stored to catch hash collisions and stale files
+	triangles stored;
+	stored.positions.resize(tris.positions.size());
+	stored.indices.resize(tris.indices.size());
+	ifs.read((char*)stored.positions.data(), stored.positions.size()*sizeof(btScalar));
+	ifs.read((char*)stored.indices.data(), stored.indices.size()*sizeof(int));
+
+	if (!ifs || !sameTriangles(stored, tris)) {
+		counters.cookedRejected++;
+		return false;
+	}
+
+	void *buf = btAlignedAlloc(header.bvhSize, 16);
+	btOptimizedBvh *bvh = nullptr;
+
+	if (ifs.read((char*)buf, header.bvhSize)) {
+		bvh = btOptimizedBvh::deSerializeInPlace(buf, header.bvhSize, false);
+	}
+
+	if (!bvh) {
+		btAlignedFree(buf);
+		counters.cookedRejected++;
+		return false;
+	}
+
+	entry.shape  = new btBvhTriangleMeshShape(entry.array, true, false);
+	entry.shape->setOptimizedBvh(bvh);
+	entry.cooked = buf;
+	entry.bytes += header.bvhSize;
+	return true;
+}
+
+void bulletShapeCache::writeCooked(const meshEntry& entry) {
+	btOptimizedBvh *bvh = entry.shape->getOptimizedBvh();
+	unsigned size = bvh->calculateSerializeBufferSize();
+	void *buf = btAlignedAlloc(size, 16);
+
+	if (!bvh->serializeInPlace(buf, size, false)) {
+		btAlignedFree(buf);
+		return;
+	}
+
+	auto& tris = entry.tris;
+	cookedHeader header = {
+		.magic         = cookedHeader::MAGIC,
+		.version       = cookedHeader::VERSION,
+		.scalarSize    = sizeof(btScalar),
+		.bulletVersion = BT_BULLET_VERSION,
+		.hash          = tris.hash,
+		.vertices      = uint32_t(tris.positions.size() / 3),
+		.triangles     = uint32_t(tris.indices.size() / 3),
+		.bvhSize       = size,
+	};
+
+	// write then rename, so other processes never see partial files
+	std::string path = cookedFile(tris.hash);
+	std::string temp = path + ".tmp";
+	bool good;
+
+	{
+		std::ofstream ofs(temp, std::ios::binary);
+		ofs.write((char*)&header, sizeof(header));
+		ofs.write((char*)tris.positions.data(), tris.positions.size()*sizeof(btScalar));
+		ofs.write((char*)tris.indices.data(), tris.indices.size()*sizeof(int));
+		ofs.write((char*)buf, size);
+		good = !!ofs;
+	}
+
+	btAlignedFree(buf);
+
+	if (!good) {
+		LogCatFmt(logcat::physics, Warning,
+		          "Couldn't write cooked collision mesh to {}", temp);
+		return;
+	}
+
+	std::rename(temp.c_str(), path.c_str());
+	counters.cookedWrites++;
+}
+
+std::shared_ptr<bulletShapeCache::meshEntry>
+bulletShapeCache::getMesh(triangles&& tris) {
+	auto it = meshes.find(tris.hash);
+
+	if (it != meshes.end() && sameTriangles(it->second->tris, tris)) {
+		counters.hits++;
+		return it->second;
+	}
+
+	GREND_PROFILE_FUNCTION();
+
+	auto entry = std::make_shared<meshEntry>();
+	entry->tris = std::move(tris);
+
+	auto& t = entry->tris;
+	entry->array = new btTriangleIndexVertexArray(t.indices.size() / 3,
+	                                              t.indices.data(),
+	                                              3*sizeof(int),
+	                                              t.positions.size() / 3,
+	                                              t.positions.data(),
+	                                              3*sizeof(btScalar));
+	entry->bytes = t.positions.size()*sizeof(btScalar) + t.indices.size()*sizeof(int);
+
+	if (!cookPath.empty() && loadCooked(*entry)) {
+		counters.cookedLoads++;
+
+	} else {
+		entry->shape = new btBvhTriangleMeshShape(entry->array, true /* useQuantizedAabbCompression */);
+		entry->bytes += entry->shape->getOptimizedBvh()->calculateSerializeBufferSize();
+		counters.built++;
+
+		if (!cookPath.empty()) {
+			writeCooked(*entry);
+		}
+	}
+
+	if (it == meshes.end()) {
+		meshes.insert({entry->tris.hash, entry});
+
+	} else {
+		// hash collision, the existing entry stays, this one is shared
+		// by nothing and freed with its last user
+		LogCatFmt(logcat::physics, Warning,
+		          "Collision mesh hash collision on {:016x}", entry->tris.hash);
+	}
+
+	return entry;
+}
+
+std::shared_ptr<btCollisionShape>
+bulletShapeCache::staticMesh(sceneModel::ptr model,
+                             sceneMesh::ptr mesh,
+                             const glm::vec3& scale)
+{
+	triangles tris;
+
+	if (!extract(model, mesh, tris)) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(mtx);
+
+	shapeKey key = makeKey(tris.hash, scale);
+	bool unscaled = key.scale[0] == 1024
+	             && key.scale[1] == 1024
+	             && key.scale[2] == 1024;
+
+	if (!unscaled) {
+		auto it = scaled.find(key);
+
+		if (it != scaled.end() && sameTriangles(it->second->base->tris, tris)) {
+			counters.hits++;
+			return {it->second, it->second->shape.get()};
+		}
+	}
+
+	auto base = getMesh(std::move(tris));
+
+	if (unscaled) {
+		return {base, base->shape};
+	}
+
+	auto entry = std::make_shared<scaledEntry>();
+	entry->base  = base;
+	entry->shape = std::make_unique<btScaledBvhTriangleMeshShape>(
+		base->shape, btVector3(scale.x, scale.y, scale.z));
+
+	scaled.insert({key, entry});
+	return {entry, entry->shape.get()};
+}
+
+std::shared_ptr<btCollisionShape>
+bulletShapeCache::convexMesh(sceneModel::ptr model,
+                             sceneMesh::ptr mesh,
+                             const glm::vec3& scale)
+{
+	triangles tris;
+
+	if (!extract(model, mesh, tris)) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(mtx);
+
+	// hulls don't keep the triangles around, these are matched by hash only
+	shapeKey key = makeKey(tris.hash, scale);
+	auto it = convex.find(key);
+
+	if (it != convex.end()) {
+		counters.hits++;
+		return {it->second, it->second->shape};
+	}
+
+	GREND_PROFILE_FUNCTION();
+
+	// weld vertices at the same position, meshes are usually split along
+	// UV and normal seams
+	size_t numVerts = tris.positions.size() / 3;
+	auto pos = [&] (size_t i) { return &tris.positions[i*3]; };
+	std::vector<uint32_t> order(numVerts);
+	std::vector<uint32_t> welded(numVerts);
+
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&] (uint32_t a, uint32_t b) {
+		return std::lexicographical_compare(pos(a), pos(a) + 3, pos(b), pos(b) + 3);
+	});
+
+	for (size_t i = 0; i < numVerts; i++) {
+		bool same = i > 0 && std::equal(pos(order[i]), pos(order[i]) + 3,
+		                                pos(order[i - 1]));
+		welded[order[i]] = same? welded[order[i - 1]] : order[i];
+	}
+
+	// connected parts, each becomes one hull
+	std::vector<uint32_t> parent(numVerts);
+	std::iota(parent.begin(), parent.end(), 0);
+
+	auto find = [&] (uint32_t x) {
+		while (parent[x] != x) {
+			x = parent[x] = parent[parent[x]];
+		}
+		return x;
+	};
+
+	for (size_t i = 0; i < tris.indices.size(); i += 3) {
+		uint32_t a = find(welded[tris.indices[i]]);
+
+		for (size_t k = 1; k < 3; k++) {
+			parent[find(welded[tris.indices[i + k]])] = a;
+			a = find(a);
+		}
+	}
+
+	std::unordered_map<uint32_t, btAlignedObjectArray<btVector3>> parts;
+	btVector3 s(scale.x, scale.y, scale.z);
+
+	for (size_t i = 0; i < numVerts; i++) {
+		// duplicates don't change the hull, skip them
+		if (welded[i] == i) {
+			parts[find(i)].push_back(btVector3(pos(i)[0], pos(i)[1], pos(i)[2]) * s);
+		}
+	}
+
+	if (parts.size() > maxHulls) {
+		// too many pieces to be worth simulating separately, one hull
+		// around everything
+		btAlignedObjectArray<btVector3> all;
+
+		for (auto& [_, points] : parts) {
+			for (int i = 0; i < points.size(); i++) {
+				all.push_back(points[i]);
+			}
+		}
+
+		parts.clear();
+		parts[0] = all;
+	}
+
+	auto entry = std::make_shared<convexEntry>();
+
+	for (auto& [_, points] : parts) {
+		if (points.size() < 3) {
+			continue;
+		}
+
+		auto hull = std::make_unique<btConvexHullShape>(&points[0].x(), points.size(),
+		                                                sizeof(btVector3));
+
+		if (points.size() > int(maxHullVertices)) {
+			btShapeHull reduced(hull.get());
+
+			if (reduced.buildHull(hull->getMargin())) {
+				hull = std::make_unique<btConvexHullShape>(
+					&reduced.getVertexPointer()->x(),
+					reduced.numVertices(),
+					sizeof(btVector3));
+			}
+		}
+
+		entry->hulls.push_back(std::move(hull));
+	}
+
+	if (entry->hulls.empty()) {
+		return nullptr;
+	}
+
+	if (entry->hulls.size() == 1) {
+		entry->shape = entry->hulls[0].get();
+
+	} else {
+		btTransform identity;
+		identity.setIdentity();
+
+		entry->compound = std::make_unique<btCompoundShape>(true, entry->hulls.size());
+		for (auto& hull : entry->hulls) {
+			entry->compound->addChildShape(identity, hull.get());
+		}
+
+		entry->shape = entry->compound.get();
+	}
+
+	counters.built++;
+	counters.hulls += entry->hulls.size();
+	convex.insert({key, entry});
+	return {entry, entry->shape};
+}
+
+size_t bulletShapeCache::purge(void) {
+	std::lock_guard<std::mutex> lock(mtx);
+
+	auto unused = [] (const auto& it) {
+		return it.second.use_count() == 1;
+	};
+
+	// scaled shapes hold their base mesh, drop those first
+	size_t dropped = 0;
+	dropped += std::erase_if(scaled, unused);
+	dropped += std::erase_if(convex, unused);
+	dropped += std::erase_if(meshes, unused);
+
+	return dropped;
+}
+
+void bulletShapeCache::clear(void) {
+	std::lock_guard<std::mutex> lock(mtx);
+
+	// shapes still in use are kept alive by their users
+	scaled.clear();
+	convex.clear();
+	meshes.clear();
+}
+
+bulletShapeCache::stats bulletShapeCache::getStats(void) {
+	std::lock_guard<std::mutex> lock(mtx);
+
+	stats ret = counters;
+	ret.meshes = meshes.size();
+	ret.scaled = scaled.size();
+	ret.convex = convex.size();
+
+	for (auto& [_, entry] : meshes) {
+		ret.bytes += entry->bytes;
+	}
+
+	return ret;
+}
+
+void bulletShapeCache::setCookPath(const std::string& path) {
+	std::lock_guard<std::mutex> lock(mtx);
+	cookPath = path;
+}
+
+// namespace grendx
+}
+#endif
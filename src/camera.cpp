@@ -200,6 +200,17 @@ glm::vec4 camera::worldToScreenPosition(glm::vec3 pos) {
 	return clip;
 }
 
+void camera::screenToWorldRay(glm::vec2 pos, glm::vec3& origin, glm::vec3& dir) {
+	glm::mat4 inv = glm::inverse(viewProjTransform());
+	glm::vec2 ndc = pos*2.f - 1.f;
+
+	glm::vec4 nearPos = inv * glm::vec4(ndc, -1, 1);
+	glm::vec4 farPos  = inv * glm::vec4(ndc,  1, 1);
+
+	origin = glm::vec3(nearPos) / nearPos.w;
+	dir    = glm::normalize(glm::vec3(farPos) / farPos.w - origin);
+}
+
 bool camera::onScreen(glm::vec4 pos) {
 	return pos.x >= 0.f && pos.x <= 1.f
 	    && pos.y >= 0.f && pos.y <= 1.f
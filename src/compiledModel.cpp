@@ -78,6 +78,29 @@ compiledMaterial::ptr matcache(material *mat) {
 
 compiledMesh::ptr compileMesh(sceneMesh::ptr mesh) {
 	compiledMesh::ptr foo = compiledMesh::ptr(new compiledMesh());
+
+	if (auto& shared = mesh->sharedIndices) {
+		// element buffer is compiled for the first mesh and reused after
+		if (!shared->compiled) {
+			shared->compiled = compiledMesh::ptr(new compiledMesh());
+			shared->compiled->elements = genBuffer(GL_ELEMENT_ARRAY_BUFFER);
+			shared->compiled->elements->buffer(shared->indices.data(),
+			                                   shared->indices.size() * sizeof(GLuint));
+			shared->compiled->lods.push_back({0, GLuint(shared->indices.size()), 0.f});
+		}
+
+		mesh->comped_mesh = foo;
+		mesh->compiled = true;
+
+		foo->elements = shared->compiled->elements;
+		foo->lods     = shared->compiled->lods;
+
+		auto comp  = mesh->get<ecs::materialComponent>();
+		foo->mat   = comp? matcache(&comp->mat) : nullptr;
+		foo->blend = foo->mat? foo->mat->factors.blend : material::blend_mode::Opaque;
+		return foo;
+	}
+
 	auto faceBuf = mesh->get<ecs::bufferComponent<sceneMesh::faceType>>();
 
 	if (!faceBuf) {
@@ -96,8 +119,26 @@ compiledMesh::ptr compileMesh(sceneMesh::ptr mesh) {
 	mesh->compiled = true;
 
 	foo->elements = genBuffer(GL_ELEMENT_ARRAY_BUFFER);
-	foo->elements->buffer(faces.data(),
-	                      faces.size() * sizeof(GLuint));
+	foo->lods.push_back({0, GLuint(faces.size()), 0.f});
+
+	if (mesh->lods.empty()) {
+		foo->elements->buffer(faces.data(),
+		                      faces.size() * sizeof(GLuint));
+
+	} else {
+		// LOD levels go after the full mesh in the same buffer, so they
+		// share the VAO and only change the draw range
+		std::vector<GLuint> all(faces.begin(), faces.end());
+
+		for (auto& level : mesh->lods) {
+			foo->lods.push_back({GLuint(all.size()),
+			                     GLuint(level.indices.size()),
+			                     level.error});
+			all.insert(all.end(), level.indices.begin(), level.indices.end());
+		}
+
+		foo->elements->buffer(all.data(), all.size() * sizeof(GLuint));
+	}
 
 	auto comp = mesh->get<ecs::materialComponent>();
 	// TODO: more consistent naming here
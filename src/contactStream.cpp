@@ -0,0 +1,144 @@
+#include <grend/contactStream.hpp>
+
+#include <algorithm>
+
+using namespace grendx;
+
+contactStream::contactStream(size_t reserve) {
+	stepEvents.reserve(reserve);
+	back.reserve(reserve);
+	front.reserve(reserve);
+	pairs.reserve(reserve);
+}
+
+void contactStream::beginStep(void) {
+	curStep++;
+	stepEvents.clear();
+}
+
+bool contactStream::addContact(physicsObject *a, physicsObject *b,
+                               void *adata, void *bdata,
+                               uint32_t layerA, uint32_t maskA,
+                               uint32_t layerB, uint32_t maskB,
+                               const glm::vec3& positionA,
+                               const glm::vec3& positionB,
+                               const glm::vec3& normal,
+                               float depth)
+{
+	if (!accepts(layerA, maskA, layerB, maskB)) {
+		counters.filtered++;
+		return false;
+	}
+
+	contactEvent ev = {
+		.a = a,
+		.b = b,
+		.adata = adata,
+		.bdata = bdata,
+		.positionA = positionA,
+		.positionB = positionB,
+		.normal = normal,
+		.depth = depth,
+		.kind = contactEvent::Begin,
+	};
+
+	// keep pairs in a canonical order so (a, b) and (b, a) are tracked
+	// as the same pair
+	if (b < a) {
+		std::swap(ev.a, ev.b);
+		std::swap(ev.adata, ev.bdata);
+		std::swap(ev.positionA, ev.positionB);
+		ev.normal = -ev.normal;
+	}
+
+	auto [it, inserted] = pairs.try_emplace({ev.a, ev.b},
+	                                        pairState {curStep, stepEvents.size(), ev});
+	auto& state = it->second;
+
+	if (!inserted) {
+		if (state.lastStep == curStep) {
+			// already have an event for this pair this step
+			// (multiple manifolds for one pair), only keep the deepest
+			if (ev.depth < state.last.depth) {
+				ev.kind = state.last.kind;
+				state.last = ev;
+				stepEvents[state.eventIndex] = ev;
+			}
+
+			return true;
+		}
+
+		ev.kind = contactEvent::Persist;
+		state.lastStep = curStep;
+		state.eventIndex = stepEvents.size();
+		state.last = ev;
+	}
+
+	stepEvents.push_back(ev);
+	return true;
+}
+
+void contactStream::endStep(void) {
+	// any pair not touched this step has separated
+	for (auto it = pairs.begin(); it != pairs.end();) {
+		auto& state = it->second;
+
+		if (state.lastStep != curStep) {
+			contactEvent ev = state.last;
+			ev.kind = contactEvent::End;
+			stepEvents.push_back(ev);
+			it = pairs.erase(it);
+
+		} else {
+			it++;
+		}
+	}
+
+	counters.steps++;
+	counters.events += stepEvents.size();
+	counters.activePairs = pairs.size();
+
+	std::lock_guard<std::mutex> lock(bufferMutex);
+	// append rather than swap, the reader may not have picked up
+	// events from previous steps yet
+	back.insert(back.end(), stepEvents.begin(), stepEvents.end());
+	stepEvents.clear();
+}
+
+void contactStream::removeObject(physicsObject *obj) {
+	std::erase_if(pairs, [=] (const auto& p) {
+		return p.first.a == obj || p.first.b == obj;
+	});
+
+	auto involves = [=] (const contactEvent& ev) {
+		return ev.a == obj || ev.b == obj;
+	};
+
+	std::erase_if(stepEvents, involves);
+
+	// front is owned by the reader, which may be iterating over it
+	// right now (eg. a collision handler removing its own entity),
+	// so only the back buffer is scrubbed
+	std::lock_guard<std::mutex> lock(bufferMutex);
+	std::erase_if(back, involves);
+}
+
+void contactStream::clear(void) {
+	pairs.clear();
+	stepEvents.clear();
+
+	std::lock_guard<std::mutex> lock(bufferMutex);
+	back.clear();
+}
+
+const std::vector<contactEvent>& contactStream::acquire(void) {
+	std::lock_guard<std::mutex> lock(bufferMutex);
+
+	front.clear();
+	std::swap(front, back);
+	return front;
+}
+
+contactStream::statistics contactStream::stats(void) {
+	return counters;
+}
@@ -1,6 +1,8 @@
 #include <grend/ecs/ecs.hpp>
 #include <grend/ecs/collision.hpp>
 
+#include <algorithm>
+
 namespace grendx::ecs {
 
 // key functions for rtti
@@ -35,58 +37,109 @@ nlohmann::json collisionHandler::serialize(entityManager *manager) {
 	return {{"tags", tagsjson}};
 }
 
-void entitySystemCollision::update(entityManager *manager, float delta) {
-	// TODO: FIX
-#if 0
-	for (auto& col : *manager->collisions) {
-		if (!col.adata && !col.bdata) {
-			// two collision events outside the ECS, nothing to do
+bool collisionHandler::matches(entityManager *manager, entity *other) {
+	if (tags.empty()) {
+		return true;
+	}
+
+	// allow collisions with things outside the ECS
+	// TODO: documentation noting that 'other' may be null!
+	return other && manager->hasComponents(other, tags);
+}
+
+void collisionHandler::onContacts(entityManager *manager,
+                                  entity *ent,
+                                  std::span<const contact> contacts)
+{
+	for (const auto& c : contacts) {
+		if (c.kind == contactEvent::End || !matches(manager, c.other)) {
 			continue;
 		}
 
+		// no physics object pointers here, the shared pointers would need to
+		// be looked up per event, handlers can use the entity pointers
+		collision col = {
+			.a = nullptr,
+			.b = nullptr,
+			.adata = ent,
+			.bdata = c.other,
+			.position = c.position,
+			.normal = c.normal,
+			.depth = c.depth,
+		};
+
+		onCollision(manager, ent, c.other, col);
+	}
+}
+
+void entitySystemCollision::update(entityManager *manager, float delta) {
+	auto phys = engine::Services().tryResolve<physics>();
+	contactStream *stream = phys? phys->getContacts() : nullptr;
+
+	if (stream) {
+		dispatch(manager, stream->acquire());
+	}
+}
+
+void entitySystemCollision::dispatch(entityManager *manager,
+                                     const std::vector<contactEvent>& events)
+{
+	targets.clear();
+
+	for (uint32_t i = 0; i < events.size(); i++) {
+		const auto& ev = events[i];
+
 		entity *ents[2] = {
 			// TODO: maaaaaaybe dynamic cast... if we really don't care about
 			//       performance :P
-			//       (but would make other coexisting object systems possible...
-			//        particularly a simpler lua scripting system, ECS is great
-			//        but it does actually kinda suck for rapid prototyping (jams))
-			static_cast<entity*>(col.adata),
-			static_cast<entity*>(col.bdata),
+			static_cast<entity*>(ev.adata),
+			static_cast<entity*>(ev.bdata),
 		};
 
-		for (unsigned i = 0; i < 2; i++) {
-			entity *self  = ents[i];
-			entity *other = ents[!i];
+		for (uint32_t k = 0; k < 2; k++) {
+			entity *self = ents[k];
 
-			if (!self) {
-				// allow collisions with things outside the ECS
-				// TODO: documentation noting that 'other' may be null!
+			if (!self || !manager->valid(self)) {
+				// physics object outside the ECS
 				continue;
 			}
 
-			if (manager->hasComponents<collisionHandler, entity>(self)) {
-				//auto entcomps = manager->getEntityComponents(self);
-				auto range = self->getAll<collisionHandler>();
-
-				for (auto it = range.first; it != range.second; it++) {
-					auto& [_, comp] = *it;
-
-					collisionHandler *handler = dynamic_cast<collisionHandler*>(comp);
-					if (!handler) {
-						// no collision component...?
-						continue;
-					}
-
-					if (handler->tags.empty()
-					    || manager->hasComponents(other, handler->tags))
-					{
-						handler->onCollision(manager, self, other, col);
-					}
-				}
+			if (self->getAll<collisionHandler>().empty()) {
+				continue;
 			}
+
+			targets.push_back({self, (i << 1) | k});
+		}
+	}
+
+	// group by entity, event indices keep the events for each entity
+	// in the order they were generated
+	std::sort(targets.begin(), targets.end(),
+		[] (const target& a, const target& b) {
+			return (a.ent == b.ent)? a.event < b.event : a.ent < b.ent;
+		});
+
+	for (size_t i = 0; i < targets.size();) {
+		entity *self = targets[i].ent;
+		batch.clear();
+
+		for (; i < targets.size() && targets[i].ent == self; i++) {
+			const auto& ev = events[targets[i].event >> 1];
+			bool isA = (targets[i].event & 1) == 0;
+
+			batch.push_back({
+				.kind     = ev.kind,
+				.other    = static_cast<entity*>(isA? ev.bdata : ev.adata),
+				.position = isA? ev.positionA : ev.positionB,
+				.normal   = isA? -ev.normal : ev.normal,
+				.depth    = ev.depth,
+			});
+		}
+
+		for (auto handler : self->getAll<collisionHandler>()) {
+			handler->onContacts(manager, self, batch);
 		}
 	}
-#endif
 }
 
 // namespace grendx::ecs
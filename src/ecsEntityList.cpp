@@ -0,0 +1,184 @@
+#include <grend/ecs/entityList.hpp>
+#include <grend/ecs/link.hpp>
+#include <grend/utility.hpp>
+#include <grend/profile.hpp>
+
+#include <algorithm>
+#include <ctype.h>
+
+namespace grendx::ecs {
+
+static std::string lowercase(const std::string& str) {
+	std::string ret = str;
+
+	for (char& c : ret) {
+		c = tolower((unsigned char)c);
+	}
+
+	return ret;
+}
+
+const std::string *entityListCache::lowerTypeName(const char *mangled) {
+	auto it = lowerTypes.find(mangled);
+
+	if (it == lowerTypes.end()) {
+		it = lowerTypes.insert({mangled, lowercase(demangle(mangled))}).first;
+	}
+
+	// unordered_map nodes are stable, entries keep this pointer around
+	return &it->second;
+}
+
+void entityListCache::updateIndex(entityManager *manager) {
+	uint64_t gen = manager->generation;
+
+	for (entity *ent : manager->entities) {
+		auto [it, added] = index.try_emplace(ent);
+		entry& e = it->second;
+
+		if (added || e.name != ent->name) {
+			e.name      = ent->name;
+			e.lowerName = lowercase(ent->name);
+		}
+
+		// a new entity can be allocated where a freed one was, between
+		// rebuilds, and keep the old entry
+		if (added || e.mangledType != ent->mangledType) {
+			e.mangledType = ent->mangledType;
+			e.lowerType   = lowerTypeName(ent->mangledType);
+		}
+
+		e.seen = gen;
+	}
+
+	// freed entities, pointers could be reused by new entities later
+	std::erase_if(index, [gen] (const auto& it) {
+		return it.second.seen != gen;
+	});
+}
+
+void entityListCache::rebuild(entityManager *manager) {
+	GREND_PROFILE_FUNCTION();
+
+	updateIndex(manager);
+	results.clear();
+	counters.rebuilds++;
+
+	std::vector<const char *> types;
+	std::vector<std::string> words;
+	lastNames = 0;
+
+	for (const auto& word : split_string(lastSearch)) {
+		if (word.empty()) {
+			continue;
+		}
+
+		if (const char *mangled = remangle(word)) {
+			types.push_back(mangled);
+		} else {
+			words.push_back(lowercase(word));
+		}
+	}
+
+	if (!words.empty()) {
+		// names are only compared when there's something to compare
+		// them against, see query()
+		lastNames = baseLink::nameGeneration.load(std::memory_order_relaxed);
+	}
+
+	auto matchesWords = [&] (entity *ent) {
+		const entry& e = index[ent];
+
+		for (const auto& word : words) {
+			if (e.lowerName.find(word) == std::string::npos
+			    && e.lowerType->find(word) == std::string::npos)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	if (types.empty()) {
+		for (entity *ent : manager->entities) {
+			if (matchesWords(ent)) {
+				results.push_back(ent);
+			}
+		}
+
+		return;
+	}
+
+	// start from the rarest component, every match has to have it
+	const std::set<component*> *smallest = nullptr;
+
+	for (const char *type : types) {
+		auto& comps = manager->getComponents(type);
+
+		if (!smallest || comps.size() < smallest->size()) {
+			smallest = &comps;
+		}
+	}
+
+	for (component *comp : *smallest) {
+		entity *ent = manager->getEntity(comp);
+
+		if (manager->valid(ent)
+		    && manager->hasComponents(ent, types)
+		    && matchesWords(ent))
+		{
+			results.push_back(ent);
+		}
+	}
+
+	// entities with more than one of the component show up more than once
+	std::sort(results.begin(), results.end());
+	results.erase(std::unique(results.begin(), results.end()), results.end());
+}
+
+const std::vector<entity*>& entityListCache::query(entityManager *manager,
+                                                   const std::string& search)
+{
+	counters.queries++;
+
+	// renames don't change the manager's generation, they only matter
+	// to searches with words in them
+	bool renamed = lastNames != 0
+		&& lastNames != baseLink::nameGeneration.load(std::memory_order_relaxed);
+
+	if (manager != lastManager
+	    || manager->generation != lastGeneration
+	    || search != lastSearch
+	    || renamed)
+	{
+		if (manager != lastManager) {
+			index.clear();
+		}
+
+		lastManager    = manager;
+		lastGeneration = manager->generation;
+		lastSearch     = search;
+		rebuild(manager);
+	}
+
+	return results;
+}
+
+void entityListCache::clear(void) {
+	index.clear();
+	results.clear();
+	lastManager    = nullptr;
+	lastGeneration = 0;
+	lastNames      = 0;
+	lastSearch.clear();
+}
+
+entityListCache::stats entityListCache::getStats(void) const {
+	stats ret = counters;
+	ret.indexed = index.size();
+	return ret;
+}
+
+// namespace grendx::ecs
+}
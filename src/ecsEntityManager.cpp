@@ -1,4 +1,5 @@
 #include <grend/ecs/ecs.hpp>
+#include <grend/ecs/link.hpp>
 #include <grend/ecs/search.hpp>
 #include <grend/ecs/sceneComponent.hpp>
 #include <grend/logger.hpp>
@@ -128,16 +129,20 @@ void entityManager::add(entity *ent) {
 	//setNode("entity["+std::to_string((uintptr_t)ent)+"]", root, ent->getNode());
 	entities.insert(ent);
 	added.insert(ent);
+	generation++;
 }
 
 void entityManager::remove(entity *ent) {
 	condemned.insert(ent);
+	generation++;
 }
 
 bool entityManager::valid(entity *ent) {
+	// check membership before dereferencing, ent may be an arbitrary
+	// user data pointer (eg. from physics objects)
 	return ent != nullptr
-	    && ent->magic == component::MAGIC
-	    && entities.count(ent);
+	    && entities.count(ent)
+	    && ent->magic == component::MAGIC;
 }
 
 void entityManager::activate(entity *ent) {
@@ -233,6 +238,7 @@ void entityManager::freeEntity(entity *ent) {
 
 	entityComponents.erase(ent);
 	entities.erase(ent);
+	generation++;
 }
 
 // TODO: specialization or w/e
@@ -349,6 +355,7 @@ regArgs entityManager::registerComponent(const char *name,
 	componentEntities.insert({ptr, ent});
 	componentTypes[ptr].insert(name);
 	entityComponents[ent].insert({name, ptr});
+	generation++;
 
 	return regArgs(t.manager, t.ent, {regArgs::you_should_not_construct_this_directly::magic::OK});
 	//return t;
@@ -415,6 +422,7 @@ void entityManager::unregisterComponent(entity *ent, component *ptr) {
 
 	componentEntities.erase(ptr);
 	componentTypes.erase(ptr);
+	generation++;
 
 	// XXX: set a magic value indicating that the component is now invalid to
 	//      help catch use-after-free errors
@@ -536,6 +544,8 @@ void entity::deserializer(component *comp, nlohmann::json j) {
 	});
 
 	ent->name = j["name"];
+	// names index children, see baseLink::nameGeneration
+	ecs::baseLink::renamed();
 }
 
 // namespace grendx::ecs
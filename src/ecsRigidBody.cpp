@@ -53,6 +53,33 @@ rigidBodyStaticMesh::rigidBodyStaticMesh(regArgs t)
 }
 
 void rigidBodyUpdateSystem::update(entityManager *manager, float delta) {
+	auto phys = engine::Services().tryResolve<physics>();
+	auto snapshots = phys? phys->getSnapshots() : nullptr;
+
+	if (snapshots) {
+		// use the published transforms, interpolated between the last two
+		// steps, rather than reading from the simulation directly. This is
+		// the only acquire() each frame, physicsObject getters read the
+		// same buffer.
+		snapshots->acquire();
+		const physicsSnapshot& snap = snapshots->readBuffer();
+		float amount = snap.interpolation(std::chrono::steady_clock::now());
+
+		for (auto entry : snap.transforms) {
+			entity *ent = static_cast<entity*>(entry.data);
+
+			if (!manager->valid(ent) || !ent->active) {
+				continue;
+			}
+
+			TRS transform = mixtrs(entry.previous, entry.current, amount);
+			transform.scale = ent->transform.getTRS().scale;
+			ent->transform.set(transform);
+		}
+
+		return;
+	}
+
 	for (auto [ent, body] : manager->search<rigidBody>()) {
 		if (body->phys) {
 			TRS transform = body->phys->getTransform();
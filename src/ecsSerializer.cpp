@@ -15,7 +15,7 @@ abstractFactory::~abstractFactory() {};
 
 nlohmann::json serializer::serialize(entityManager *manager, entity *ent) {
 	for (auto [name, _] : factories) {
-		LogFmt("got a {}", name);
+		LogCatFmt(logcat::ecs, Debug, "got a {}", name);
 	}
 	using namespace nlohmann;
 
@@ -50,7 +50,7 @@ nlohmann::json serializer::serialize(entityManager *manager, entity *ent) {
 		const std::string& demangled = demangle(subtype);
 
 		if (has(demangled)) {
-			LogFmt("got here, serializing a {}", demangled);
+			LogCatFmt(logcat::ecs, Debug, "got here, serializing a {}", demangled);
 			json temp = serializers[demangled](ent);
 
 			if (!temp.empty()) {
@@ -89,7 +89,7 @@ entity *serializer::build(entityManager *manager, json serialized)
 
 	// TODO: exception handling
 	std::string typestr = enttype->get<std::string>();
-	LogFmt("Build entity: {}", typestr);
+	LogCatFmt(logcat::ecs, Debug, "Build entity: {}", typestr);
 
 	entity *ret = nullptr;
 
@@ -140,7 +140,7 @@ component *serializer::build(entityManager *manager,
 
 	// unmangled name stored in serialized form
 	std::string type = serialized[0].get<std::string>();
-	LogFmt("Attempting to add component {} to entity {}...", type, (void*)ent);
+	LogCatFmt(logcat::ecs, Debug, "Attempting to add component {} to entity {}...", type, (void*)ent);
 
 	if (!manager->valid(ent)) {
 		LogWarnFmt("Entity {} is invalid! This shouldn't happen!", (void*)ent);
@@ -150,7 +150,7 @@ component *serializer::build(entityManager *manager,
 		return nullptr;
 	}
 
-	LogFmt("Found component type {}", type);
+	LogCatFmt(logcat::ecs, Debug, "Found component type {}", type);
 
 	component *ret = factories[type]->allocate(manager, ent);
 	/*
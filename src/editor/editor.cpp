@@ -34,6 +34,7 @@ gameEditor::gameEditor()
 	auto ecs  = Resolve<ecs::entityManager>();
 
 	LogCallback([this] (LogType type, const std::string& msg) {
+		std::lock_guard<std::mutex> lock(this->logMutex);
 		this->logEntries.push_back(msg);
 	});
 
@@ -5,6 +5,7 @@
 #include <grend/ecs/ecs.hpp>
 #include <grend/ecs/serializer.hpp>
 #include <grend/ecs/editor.hpp>
+#include <grend/ecs/entityList.hpp>
 
 #include <imgui/imgui.h>
 #include <imgui/backends/imgui_impl_sdl.h>
@@ -18,6 +19,9 @@ using namespace grendx::engine;
 
 static char searchBuffer[0x1000] = "";
 static fileDialog export_entity_dialog("Export entity");
+// results are cached until the search or the entities change, so large
+// scenes don't get searched every frame
+static ecs::entityListCache entityList;
 
 static bool is_name_pair(nlohmann::json& value) {
 	return value.is_array()
@@ -184,6 +188,67 @@ static void handle_prompts(gameEditorUI *wrapper) {
 	}
 }
 
+// components and actions for the selected entity, drawn above the list
+// rather than inline so that list rows stay the same height
+static void selectedEntityPane(gameEditorUI *wrapper, ecs::entity *ent) {
+	gameEditor::ptr editor = wrapper->editor;
+	auto entities  = Resolve<ecs::entityManager>();
+	auto factories = Resolve<ecs::serializer>();
+
+	std::string entstr = demangle(ent->mangledType) + " : " + ent->name;
+	std::string popupstr = entstr + ":popup";
+
+	auto& components = entities->getEntityComponents(ent);
+	std::set<std::string> seen;
+	ImGui::Indent(16.f);
+	ImGui::TextColored(ImVec4(0.4f, 0.4f, 0.4f, 1.f), "%s", entstr.c_str());
+	ImGui::TextColored(ImVec4(0.4f, 0.4f, 0.4f, 1.f), "Attached components:");
+
+	std::string sectionName = entstr + ":components";
+	ImGui::TreePush(sectionName.c_str());
+
+	for (auto& [name, comp] : components) {
+		if (!seen.count(name)) {
+			const auto& demangled = demangle(name);
+			if (ImGui::Selectable(demangled.c_str())) {
+				strncat(searchBuffer, demangled.c_str(), sizeof(searchBuffer) - 1);
+				strncat(searchBuffer, " ", sizeof(searchBuffer) - 1);
+			}
+
+			seen.insert(name);
+		}
+	}
+
+	ImGui::TreePop();
+
+	std::string asdf = entstr + ":sec";
+	ImGui::TreePush(asdf.c_str());
+	if (ImGui::Button("Attach")) {
+		ImGui::OpenPopup(popupstr.c_str());
+	}
+
+	ImGui::SameLine();
+	if (ImGui::Button("Save")) {
+		export_entity_dialog.show();
+	}
+
+	if (ImGui::BeginPopup(popupstr.c_str())) {
+		for (const auto& [name, _] : factories->factories) {
+			if (ImGui::Selectable(name.c_str())) {
+				nlohmann::json j = {name, {}};
+
+				factories->build(entities, ent, j);
+			}
+		}
+
+		ImGui::EndPopup();
+	}
+	ImGui::TreePop();
+
+	ImGui::Unindent(16.f);
+	ImGui::Separator();
+}
+
 void gameEditorUI::entityEditorWindow() {
 	auto entities  = Resolve<ecs::entityManager>();
 	auto factories = Resolve<ecs::serializer>();
@@ -256,21 +321,9 @@ void gameEditorUI::entityListWindow() {
 	}
 	ImGui::SameLine();
 	ImGui::InputText("Search", searchBuffer, sizeof(searchBuffer));
-	auto tags = split_string(searchBuffer);
-	std::vector<const char *> tagchars;
 
 	auto* selectedEntity = editor->getSelectedEntity().getPtr();
 
-	for (const auto& v : tags) {
-		//tagchars.push_back(v.c_str());
-		if (const char *re = remangle(v)) {
-			tagchars.push_back(re);
-
-		} else if (v.length() > 0) {
-			tagchars.push_back("<invalid type name>");
-		}
-	}
-
 	ImGui::SameLine();
 	if (ImGui::Button("New entity")) {
 		//showAddEntityWindow = true;
@@ -336,103 +389,53 @@ void gameEditorUI::entityListWindow() {
 		ImGui::EndDragDropTarget();
 	}
 
-	ImGui::BeginChild("entityList", ImVec2(0, 0), false, 0);
-	unsigned entID = 0;
-	for (auto& ent : entities->entities) {
-		if (!entities->valid(ent)) {
-			ImGui::Text("[Invalid entity %p]", ent);
-			continue;
-		}
-
-		if (*searchBuffer && !entities->hasComponents(ent, tagchars)) {
-			// entity doesn't have the searched tags, filtered out
-			// TODO: wait, why am I not using the search interface here?
-			continue;
-		}
-
-		ImGui::PushID(entID++);
-
-		//std::string entstr = "entity #" + std::to_string((uintptr_t)ent);
-		std::string entstr = demangle(ent->mangledType) + " : " + ent->name;
-		std::string contextstr = entstr + ":context";
-		std::string popupstr = entstr + ":popup";
-
-		if (entities->condemned.count(ent)) {
-			entstr = "[deleted] " + entstr;
-		}
-
-		if (ImGui::Selectable(entstr.c_str(), ent == selectedEntity)) {
-			editor->setSelectedEntity(ent);
-		}
-
-		if (ent == selectedEntity) {
-			if (ImGui::BeginPopupContextItem(contextstr.c_str())) {
-				ImGui::TextColored(ImVec4(0.4f, 0.4f, 0.4f, 1.f), "Action");
-				ImGui::Separator();
+	if (entities->valid(selectedEntity)) {
+		selectedEntityPane(this, selectedEntity);
+	}
 
-				if (ImGui::Selectable("Delete")) {
-					entities->remove(selectedEntity);
-					editor->setSelectedEntity(nullptr);
-				}
+	const auto& matches = entityList.query(entities, searchBuffer);
+	ImGui::TextColored(ImVec4(0.4f, 0.4f, 0.4f, 1.f), "%lu matching",
+	                   (unsigned long)matches.size());
 
-				if (ImGui::Selectable("Duplicate")) { /* TODO */ }
-				ImGui::EndPopup();
-			}
+	ImGui::BeginChild("entityList", ImVec2(0, 0), false, 0);
 
-			auto& components = entities->getEntityComponents(ent);
-			std::set<std::string> seen;
-			ImGui::Separator();
-			ImGui::Indent(16.f);
-			ImGui::TextColored(ImVec4(0.4f, 0.4f, 0.4f, 1.f), "Attached components:");
-			//ImGui::Columns(2);
-
-			std::string sectionName = entstr + ":components";
-			ImGui::TreePush(sectionName.c_str());
-
-			for (auto& [name, comp] : components) {
-				if (!seen.count(name)) {
-					const auto& demangled = demangle(name);
-					if (ImGui::Selectable(demangled.c_str())) {
-						strncat(searchBuffer, demangled.c_str(), sizeof(searchBuffer) - 1);
-						strncat(searchBuffer, " ", sizeof(searchBuffer) - 1);
-					}
+	// only visible rows are drawn, rows need to be the same height for this
+	ImGuiListClipper clipper;
+	clipper.Begin(matches.size());
 
-					seen.insert(name);
-				}
-			}
+	while (clipper.Step()) {
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+			ecs::entity *ent = matches[i];
+			ImGui::PushID(i);
 
-			ImGui::TreePop();
+			std::string entstr = demangle(ent->mangledType) + " : " + ent->name;
+			std::string contextstr = entstr + ":context";
 
-			std::string asdf = entstr + ":sec";
-			ImGui::TreePush(asdf.c_str());
-			if (ImGui::Button("Attach")) {
-				ImGui::OpenPopup(popupstr.c_str());
+			if (entities->condemned.count(ent)) {
+				entstr = "[deleted] " + entstr;
 			}
 
-			ImGui::SameLine();
-			if (ImGui::Button("Save")) {
+			if (ImGui::Selectable(entstr.c_str(), ent == selectedEntity)) {
 				editor->setSelectedEntity(ent);
-				export_entity_dialog.show();
 			}
 
-			if (ImGui::BeginPopup(popupstr.c_str())) {
-				for (const auto& [name, _] : factories->factories) {
-					if (ImGui::Selectable(name.c_str())) {
-						nlohmann::json j = {name, {}};
+			if (ent == selectedEntity) {
+				if (ImGui::BeginPopupContextItem(contextstr.c_str())) {
+					ImGui::TextColored(ImVec4(0.4f, 0.4f, 0.4f, 1.f), "Action");
+					ImGui::Separator();
 
-						factories->build(entities, ent, j);
+					if (ImGui::Selectable("Delete")) {
+						entities->remove(selectedEntity);
+						editor->setSelectedEntity(nullptr);
 					}
-				}
 
-				ImGui::EndPopup();
+					if (ImGui::Selectable("Duplicate")) { /* TODO */ }
+					ImGui::EndPopup();
+				}
 			}
-			ImGui::TreePop();
 
-			ImGui::Unindent(16.f);
+			ImGui::PopID();
 		}
-
-		ImGui::Separator();
-		ImGui::PopID();
 	}
 
 	ImGui::EndChild();
@@ -5,6 +5,7 @@
 #include <grend/renderContext.hpp>
 #include <grend/scancodes.hpp>
 #include <grend/logger.hpp>
+#include <grend/raycast.hpp>
 
 // XXX: for updateEntityTransforms()
 #include <grend/ecs/rigidBody.hpp>
@@ -16,8 +17,9 @@ using namespace grendx;
 using namespace grendx::engine;
 
 void gameEditor::handleSelectObject() {
-	auto ctx  = Resolve<SDLContext>();
-	auto rend = Resolve<renderContext>();
+	auto ctx    = Resolve<SDLContext>();
+	auto state  = Resolve<gameState>();
+	auto ecs    = Resolve<ecs::entityManager>();
 
 	int x, y;
 	int win_x, win_y;
@@ -25,51 +27,55 @@ void gameEditor::handleSelectObject() {
 	SDL_GetWindowSize(ctx->window, &win_x, &win_y);
 
 	float fx = x/(1.f*win_x);
-	float fy = y/(1.f*win_y);
+	float fy = (win_y - y)/(1.f*win_y);
 
-	auto selectedEnt = getSelectedEntity();
-
-	uint32_t clickidx = rend->framebuffer->index(fx, fy);
-
-	LogErrorFmt("clicked object: {}", clickidx);
-	LogErrorFmt("ent object: {}", clickidx);
-	LogErrorFmt("clickables: {}", clickState.size());
-	LogErrorFmt("Selected entity: {}", (void*)selectedEnt.getPtr());
-
-	if (ecs::entity* ent = clickState.get(clickidx)) {
-		setSelectedEntity(ent);
-		LogErrorFmt("selected entity: {}@{}", clickidx, (void*)ent);
+	glm::vec3 origin, dir;
+	cam->screenToWorldRay({fx, fy}, origin, dir);
 
-	} else if (clickidx && selectedEnt) {
-		clickedX = (x*1.f / win_x);
-		clickedY = ((win_y - y)*1.f / win_y);
-
-		if (clickidx > 0 && clickidx <= 6) {
+	auto selectedEnt = getSelectedEntity();
+	raycastHit hit;
+
+	// transform handles are drawn over everything, so they're tested first
+	if (selectedEnt) {
+		raycastScene handles;
+		auto p = UIObjects->getNode("Orientation-Indicator");
+		auto m = p->transform.getMatrix();
+
+		handles.add(p->getNode("X-Axis"),     nullptr, m, 1);
+		handles.add(p->getNode("Y-Axis"),     nullptr, m, 2);
+		handles.add(p->getNode("Z-Axis"),     nullptr, m, 3);
+		handles.add(p->getNode("X-Rotation"), nullptr, m, 4);
+		handles.add(p->getNode("Y-Rotation"), nullptr, m, 5);
+		handles.add(p->getNode("Z-Rotation"), nullptr, m, 6);
+
+		if (handles.raycast(origin, dir, hit)) {
+			clickedX = fx;
+			clickedY = fy;
 			transformBuf = selectedEnt->transform.getTRS();
-			LogInfo("It's a UI model");
-
-		} else {
-			// TODO: store, look up entity IDs as render IDs
-			//selectedNode = getNonModel(clicked);
-		}
+			clickDepth = hit.distance;
+
+			switch (hit.id) {
+				case 1: setMode(MoveX); break;
+				case 2: setMode(MoveY); break;
+				case 3: setMode(MoveZ); break;
+				case 4: setMode(RotateX); break;
+				case 5: setMode(RotateY); break;
+				case 6: setMode(RotateZ); break;
+				default: break;
+			}
 
-		switch (clickidx) {
-			case 1: setMode(MoveX); break;
-			case 2: setMode(MoveY); break;
-			case 3: setMode(MoveZ); break;
-			case 4: setMode(RotateX); break;
-			case 5: setMode(RotateY); break;
-			case 6: setMode(RotateZ); break;
-			default: break;
+			return;
 		}
+	}
 
-		if (selectedEnt) {
-			// TODO: this isn't correct
-			clickDepth = glm::distance(selectedEnt->transform.getTRS().position, cam->position());
+	raycastScene scene;
+	scene.add(state->rootnode);
+	scene.addEntities(ecs);
 
-		} else {
-			clickDepth = 0.f;
-		}
+	if (scene.raycast(origin, dir, hit) && hit.entity) {
+		setSelectedEntity(hit.entity);
+		LogInfoFmt("selected entity: {} (triangle {}, distance {})",
+		           (void*)hit.entity, hit.triangle, hit.distance);
 
 	} else {
 		setSelectedEntity(nullptr);
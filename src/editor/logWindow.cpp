@@ -14,6 +14,7 @@ void gameEditorUI::logWindow() {
 	ImGui::Checkbox("Autoscroll", &autoscroll);
 
 	ImGui::BeginChild("Scroll");
+	std::lock_guard<std::mutex> lock(editor->logMutex);
 	for (auto& s : editor->logEntries) {
 		ImGui::TextUnformatted(s.c_str());
 	}
@@ -40,6 +40,8 @@ void gameEditor::addnodesRec(const std::string& name,
 
 					if (auto p = obj->parent) {
 						obj->name = std::string(namebuf);
+						// parent's child index is keyed by name
+						ecs::baseLink::renamed();
 					}
 				}
 
@@ -203,7 +203,7 @@ void gameEditorUI::menubar() {
 				ImGui::MenuItem("Entity list",       nullptr, &showEntityListWindow);
 				ImGui::MenuItem("Entity editor",     nullptr, &showEntityEditorWindow);
 				ImGui::MenuItem("Profiler",          nullptr, &showProfilerWindow);
-				ImGui::MenuItem("Metrics",           nullptr, &showProfilerWindow);
+				ImGui::MenuItem("Metrics",           nullptr, &showMetricsWindow);
 				ImGui::MenuItem("Settings",          nullptr, &showSettingsWindow);
 				ImGui::MenuItem("Console log",       nullptr, &showLogWindow);
 				ImGui::EndMenu();
@@ -1,4 +1,9 @@
 #include <grend/gameEditor.hpp>
+#include <grend/profile.hpp>
+#include <grend/lodSelector.hpp>
+#include <grend/shadowCache.hpp>
+#include <grend/probeScheduler.hpp>
+#include <grend/occlusionBuffer.hpp>
 
 #include <imgui/imgui.h>
 #include <imgui/backends/imgui_impl_sdl.h>
@@ -50,6 +55,87 @@ void gameEditorUI::metricsWindow() {
 	ImGui::Text("%s", total.c_str());
 
 #endif
-	ImGui::Text("TODO: reimplement this");
+	// frame times from the profiler history
+	size_t frames = profile::historySize();
+	double total = 0.0, longest = 0.0;
+
+	for (size_t i = 0; i < frames; i++) {
+		double t = profile::getHistory(i)->duration();
+		total += t;
+		longest = std::max(longest, t);
+	}
+
+	if (frames > 0 && total > 0.0) {
+		double avg = total / frames;
+		ImGui::Text("%.1f FPS (%.3fms/frame, worst %.3fms over %lu frames)",
+		            1.0/avg, avg*1000, longest*1000, (unsigned long)frames);
+	}
+
+	ImGui::Text("Dropped profiler events: %lu",
+	            (unsigned long)profile::droppedEvents());
+
+	if (auto lods = engine::Services().tryResolve<lodSelector>()) {
+		static const char *passNames[] = {"Main", "Shadow", "Probe"};
+
+		ImGui::Separator();
+		ImGui::Checkbox("Mesh LODs", &lods->settings.enabled);
+		ImGui::SliderFloat("LOD pixel error", &lods->settings.pixelError, 0.25f, 16.f);
+		ImGui::SliderFloat("Shadow LOD bias", &lods->settings.shadowBias, 1.f, 16.f);
+		ImGui::SliderFloat("Probe LOD bias",  &lods->settings.probeBias,  1.f, 16.f);
+
+		for (size_t i = 0; i < size_t(lodPass::Count); i++) {
+			auto& s = lods->stats(lodPass(i));
+			ImGui::Text("%s: %lu meshes, %lu triangles (%lu at full detail)",
+			            passNames[i], (unsigned long)s.meshes,
+			            (unsigned long)s.triangles, (unsigned long)s.fullTriangles);
+		}
+	}
+
+	if (auto occl = engine::Services().tryResolve<occlusionCuller>()) {
+		auto& s = occl->stats();
+
+		ImGui::Separator();
+		ImGui::Checkbox("Occlusion culling", &occl->settings.enabled);
+		ImGui::Text("Occlusion: %lu passes, %lu occluders (%lu triangles)",
+		            (unsigned long)s.passes, (unsigned long)s.occluders,
+		            (unsigned long)s.occluderTriangles);
+		ImGui::Text("Culled %lu of %lu meshes, %.3fms rasterizing, %.3fms testing",
+		            (unsigned long)s.culled, (unsigned long)s.tested,
+		            s.rasterizeTime/1e6, s.testTime/1e6);
+	}
+
+	if (auto shadows = engine::Services().tryResolve<shadowCache>()) {
+		auto& s = shadows->stats();
+		int budget = shadows->settings.faceBudget;
+
+		ImGui::Separator();
+		ImGui::Checkbox("Shadow caching", &shadows->settings.enabled);
+		if (ImGui::SliderInt("Shadow faces per frame", &budget, 1, 64)) {
+			shadows->settings.faceBudget = budget;
+		}
+		ImGui::Text("Shadows: %lu lights, %lu casters (%lu static)",
+		            (unsigned long)s.lights, (unsigned long)s.casters,
+		            (unsigned long)s.staticCasters);
+		ImGui::Text("Faces: %lu drawn, %lu unchanged, %lu deferred, %lu static layers",
+		            (unsigned long)s.facesDrawn, (unsigned long)s.facesSkipped,
+		            (unsigned long)s.facesDeferred, (unsigned long)s.staticDrawn);
+	}
+
+	if (auto probes = engine::Services().tryResolve<probeScheduler>()) {
+		auto& s = probes->stats();
+		int budget = probes->settings.stepBudget;
+
+		ImGui::Separator();
+		ImGui::Checkbox("Amortized probe updates", &probes->settings.enabled);
+		if (ImGui::SliderInt("Probe steps per frame", &budget, 1, 64)) {
+			probes->settings.stepBudget = budget;
+		}
+		ImGui::SliderFloat("Probe time budget (ms)", &probes->settings.timeBudget, 0.f, 8.f);
+		ImGui::Text("Probes: %lu pending, %lu steps (%.3fms), %lu completed",
+		            (unsigned long)s.pending, (unsigned long)s.steps,
+		            s.stepTime/1e6, (unsigned long)s.completed);
+		ImGui::Text("Update latency: %.1f avg, %u max, %u worst (frames)",
+		            s.avgLatency, s.maxLatency, probes->worstLatency());
+	}
 	ImGui::End();
 }
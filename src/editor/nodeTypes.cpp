@@ -55,6 +55,8 @@ void sceneParticles::drawEditor(component *comp) {
 	        || InputUInt("Max Instances",    &ent->maxInstances)
 	        || InputUInt("Active Instances", &ent->activeInstances))
 	{
+		// keeps the active count within the instance storage
+		ent->resize(ent->maxInstances);
 	}
 
 	endType();
@@ -67,8 +69,12 @@ void sceneBillboardParticles::drawEditor(component *comp) {
 	        || InputUInt("Max Instances",    &ent->maxInstances)
 	        || InputUInt("Active Instances", &ent->activeInstances))
 	{
+		// keeps the active count within the instance storage
+		ent->resize(ent->maxInstances);
 	}
 
+	ImGui::Checkbox("Depth sort", &ent->depthSort);
+
 	endType();
 }
 
@@ -23,13 +23,14 @@ static void drawProfilerGroups(profile::group *root,
 		= base_flags
 		| ((cur->subgroups.size() == 0)? ImGuiTreeNodeFlags_Leaf : 0);
 
-	double ms = cur->groupTimer.duration() * 1000;
-	double percent = cur->groupTimer.duration() / root->groupTimer.duration() * 100;
+	double ms = cur->seconds * 1000;
+	double percent = cur->seconds / root->seconds * 100;
 
 	std::string timestr = std::to_string(ms) + "ms";
 	std::string percentstr = std::to_string(percent) + "%%";
+	std::string callstr = (cur->calls > 1)? " x" + std::to_string(cur->calls) : "";
 
-	std::string txt = name + " : " + timestr + " (" + percentstr + ")";
+	std::string txt = name + callstr + " : " + timestr + " (" + percentstr + ")";
 
 	if (ImGui::TreeNodeEx(txt.c_str(), flags)) {
 		for (auto& [subname, subgroup] : cur->subgroups) {
@@ -40,8 +41,46 @@ static void drawProfilerGroups(profile::group *root,
 	}
 }
 
+static void drawAggregates(const profile::frameRecord& frame) {
+	static const ImGuiTableFlags flags
+		= ImGuiTableFlags_Borders
+		| ImGuiTableFlags_RowBg
+		| ImGuiTableFlags_ScrollY;
+
+	// averages over the whole history, for comparison with this frame
+	std::map<std::string_view, double> averages;
+	size_t frames = profile::historySize();
+
+	for (size_t i = 0; i < frames; i++) {
+		for (auto& stat : profile::aggregate(*profile::getHistory(i))) {
+			averages[stat.name] += stat.total / frames;
+		}
+	}
+
+	if (ImGui::BeginTable("Zones", 5, flags, ImVec2(0, 300))) {
+		ImGui::TableSetupColumn("Zone");
+		ImGui::TableSetupColumn("Calls");
+		ImGui::TableSetupColumn("Total (ms)");
+		ImGui::TableSetupColumn("Longest (ms)");
+		ImGui::TableSetupColumn("Average (ms)");
+		ImGui::TableHeadersRow();
+
+		for (auto& stat : profile::aggregate(frame)) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%s", stat.name);
+			ImGui::TableNextColumn(); ImGui::Text("%u", stat.calls);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", stat.total * 1000);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", stat.longest * 1000);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", averages[stat.name] * 1000);
+		}
+
+		ImGui::EndTable();
+	}
+}
+
 struct tabEntry {
-	std::shared_ptr<profile::group> group;
+	std::shared_ptr<profile::frameRecord> frame;
+	profile::group tree;
 	unsigned id;
 	bool opened;
 };
@@ -49,6 +88,8 @@ struct tabEntry {
 void gameEditorUI::profilerWindow() {
 	static std::vector<tabEntry> entries;
 	static unsigned counter = 0;
+	static std::string exportPath = "grend-trace.json";
+	static std::string exportStatus = "";
 
 	// if a tab was closed (in the last frame), erase it here
 	for (auto it = entries.begin(); it < entries.end();) {
@@ -57,26 +98,55 @@ void gameEditorUI::profilerWindow() {
 
 	ImGui::Begin("Profiler", &showProfilerWindow);
 
+	// frame time history, oldest to newest
+	std::vector<float> times;
+	for (size_t i = profile::historySize(); i > 0; i--) {
+		times.push_back(profile::getHistory(i - 1)->duration() * 1000);
+	}
+
+	if (!times.empty()) {
+		std::string label = std::to_string(times.back()) + "ms";
+		ImGui::PlotLines("Frame time", times.data(), times.size(), 0,
+		                 label.c_str(), 0.f, 33.3f, ImVec2(0, 60));
+	}
+
 	if (ImGui::Button("New capture")) {
-		auto ptr = profile::getFrame();
+		if (auto frame = profile::getHistory()) {
+			// copy, the history entry will be overwritten
+			auto ptr = std::make_shared<profile::frameRecord>(*frame);
+
+			entries.push_back({
+				.frame  = ptr,
+				.tree   = profile::buildTree(*ptr),
+				.id     = counter++,
+				.opened = true,
+			});
+		}
+	}
 
-		entries.push_back({
-			.group  = ptr,
-			.id     = counter++,
-			.opened = true,
-		});
+	ImGui::SameLine();
+	if (ImGui::Button("Export trace")) {
+		exportStatus = profile::exportChromeTrace(exportPath)
+			? "Wrote " + exportPath
+			: "Couldn't write " + exportPath;
 	}
 
+	ImGui::SameLine();
+	ImGui::Text("%s (dropped events: %lu)",
+	            exportStatus.c_str(),
+	            (unsigned long)profile::droppedEvents());
+
 	ImGui::SameLine();
 	static ImGuiTabBarFlags flags = ImGuiTabBarFlags_AutoSelectNewTabs;
-	if (ImGui::BeginTabBar("Captures"), flags) {
+	if (ImGui::BeginTabBar("Captures", flags)) {
 		for (unsigned i = 0; i < entries.size(); i++) {
 			auto& ent = entries[i];
 			std::string name = "Capture " + std::to_string(ent.id);
 
 			if (ent.opened && ImGui::BeginTabItem(name.c_str(), &ent.opened)) {
 				ImGui::Separator();
-				drawProfilerGroups(ent.group.get());
+				drawAggregates(*ent.frame);
+				drawProfilerGroups(&ent.tree);
 				ImGui::EndTabItem();
 			}
 		}
@@ -19,6 +19,7 @@ void gameEditorUI::settingsWindow() {
 	ImGui::Checkbox("Shadows enabled", &settings.shadowsEnabled);
 	ImGui::InputScalar("Shadow size", ImGuiDataType_U32, &settings.shadowSize, &showSteps);
 	ImGui::InputScalar("Shadow atlas size", ImGuiDataType_U32, &settings.shadowAtlasSize, &showSteps);
+	ImGui::InputScalar("Static shadow atlas size", ImGuiDataType_U32, &settings.staticShadowAtlasSize, &showSteps);
 
 	ImGui::Checkbox("Reflections enabled", &settings.reflectionsEnabled);
 	ImGui::InputScalar("Reflection size", ImGuiDataType_U32, &settings.reflectionSize, &showSteps);
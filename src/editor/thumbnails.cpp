@@ -5,6 +5,7 @@
 #include <grend/renderQueue.hpp>
 #include <grend/compiledModel.hpp>
 #include <grend/loadScene.hpp>
+#include <grend/textureCache.hpp>
 
 #include <grend/utility.hpp>
 
@@ -75,7 +76,7 @@ std::future<bool>& thumbnails::getThumbnailTask(std::string filePath) {
 
 		} else if (isImageExt(ext)) {
 			thumbnailTasks[strPath] = jobs->/*addAsync*/addDeferred([=, this] () {
-				auto data = std::make_shared<textureData>(filePath, true);
+				auto data = textureFiles().load(filePath, true);
 				Texture::ptr tex = texcache(data);
 
 				{
@@ -92,11 +93,11 @@ std::future<bool>& thumbnails::getThumbnailTask(std::string filePath) {
 				Texture::ptr tex;
 
 				if (fs::is_directory(filePath)) {
-					auto data = std::make_shared<textureData>(GR_PREFIX "assets/tex/ui/folder.png", true);
+					auto data = textureFiles().load(GR_PREFIX "assets/tex/ui/folder.png", true);
 					tex = texcache(data);
 
 				} else {
-					auto data = std::make_shared<textureData>(GR_PREFIX "assets/tex/ui/document.png", true);
+					auto data = textureFiles().load(GR_PREFIX "assets/tex/ui/document.png", true);
 					tex = texcache(data);
 				}
 
@@ -11,6 +11,10 @@
 #include <grend/gameView.hpp>
 #include <grend/jobQueue.hpp>
 #include <grend/audioMixer.hpp>
+#include <grend/lodSelector.hpp>
+#include <grend/occlusionBuffer.hpp>
+#include <grend/shadowCache.hpp>
+#include <grend/probeScheduler.hpp>
 
 #include <grend/ecs/ecs.hpp>
 #include <grend/ecs/serializer.hpp>
@@ -43,6 +47,7 @@ static uint32_t last_frame_time = 0;
 IoC::Container& grendx::engine::Services() { return gameServices; }
 
 void grendx::engine::initialize(const std::string& name, const renderSettings& settings) {
+	profile::setThreadName("main");
 	Services().bind<SDLContext, SDLContext>(name.c_str(), settings);
 	initializeOpengl();
 
@@ -62,6 +67,10 @@ void grendx::engine::initialize(const std::string& name, const renderSettings& s
 	Services().bind<audioMixer,         audioMixer>(&ctx);
 	Services().bind<jobQueue,           jobQueue>();
 	Services().bind<thumbnails,         thumbnails>();
+	Services().bind<lodSelector,        lodSelector>();
+	Services().bind<occlusionCuller,    occlusionCuller>();
+	Services().bind<shadowCache,        shadowCache>();
+	Services().bind<probeScheduler,     probeScheduler>();
 
 	ecs::addDefaultFactories();
 
@@ -89,6 +98,10 @@ void grendx::engine::step(gameView::ptr view) {
 	//frame_timer.start();
 	//clearMetrics();
 	profile::newFrame();
+	Resolve<lodSelector>()->newFrame();
+	Resolve<occlusionCuller>()->newFrame();
+	Resolve<shadowCache>()->newFrame();
+	Resolve<probeScheduler>()->newFrame();
 	handleInput(view);
 
 	auto jobs = Resolve<jobQueue>();
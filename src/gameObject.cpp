@@ -2,6 +2,8 @@
 #include <grend/glManager.hpp>
 #include <grend/utility.hpp>
 #include <grend/logger.hpp>
+#include <grend/prefab.hpp>
+#include <algorithm>
 #include <math.h>
 
 #include <grend/ecs/ecs.hpp>
@@ -27,10 +29,94 @@ size_t grendx::allocateObjID(void) {
 	return ++counter;
 }
 
+void ecs::linkHooks<sceneNode>::attached(entity *owner, sceneNode *target) {
+	auto node = dynamic_cast<sceneNode*>(owner);
+
+	if (!node) {
+		return;
+	}
+
+	// new links go last, so an existing child with the same name keeps
+	// its place, same as a full rebuild
+	uint64_t gen = ecs::baseLink::nameGeneration.load(std::memory_order_relaxed);
+	if (target && node->childIndexGeneration == gen) {
+		node->childIndex.try_emplace(internName(target->name), target);
+	}
+
+	node->subtreeChanged();
+}
+
+void ecs::linkHooks<sceneNode>::detached(entityManager *manager,
+                                         entity *owner,
+                                         sceneNode *target)
+{
+	// entities freed in the same batch may already be deleted, only their
+	// addresses can be compared
+	auto& freed = manager->condemned;
+
+	if (target && !freed.count(target) && target->parent.getPtr() == owner) {
+		target->parent = nullptr;
+	}
+
+	if (freed.count(owner)) {
+		return;
+	}
+
+	if (auto node = dynamic_cast<sceneNode*>(owner)) {
+		// another child with the same name might take over
+		node->childIndexGeneration = 0;
+		node->subtreeChanged();
+	}
+}
+
+void sceneNode::subtreeChanged(void) {
+	for (sceneNode *node = this; node; node = node->parent.getPtr()) {
+		node->subtreeVersion++;
+	}
+}
+
+void sceneNode::updateChildIndex(void) {
+	uint64_t gen = ecs::baseLink::nameGeneration.load(std::memory_order_relaxed);
+
+	if (gen == childIndexGeneration) {
+		return;
+	}
+
+	childIndex.clear();
+	childIndexGeneration = gen;
+
+	for (auto link : nodes()) {
+		if (auto node = link->getRef()) {
+			// first child with a name wins, same as the old linear search
+			childIndex.try_emplace(internName(node->name), node.getPtr());
+		}
+	}
+}
+
+sceneNode::ptr sceneNode::getNode(uint32_t nameID) {
+	updateChildIndex();
+
+	auto it = childIndex.find(nameID);
+	return (it == childIndex.end())? nullptr : it->second;
+}
+
 sceneNode::ptr sceneNode::getNode(std::string name) {
+	// updating first interns the names of all children
+	updateChildIndex();
+
+	if (uint32_t id = findInternedName(name)) {
+		auto it = childIndex.find(id);
+
+		if (it != childIndex.end() && it->second->name == name) {
+			return it->second;
+		}
+	}
+
+	// names that were never interned can still show up if a node was
+	// renamed without invalidating, fall back to a scan in that case
 	for (auto link : nodes()) {
 		auto node = link->getRef();
-		if (node->name == name) {
+		if (node && node->name == name) {
 			return node;
 		}
 	}
@@ -38,6 +124,19 @@ sceneNode::ptr sceneNode::getNode(std::string name) {
 	return nullptr;
 }
 
+const sceneHierarchy& sceneNode::flatten(void) {
+	if (!hierarchy) {
+		hierarchy = std::make_unique<sceneHierarchy>();
+	}
+
+	if (hierarchy->generation != subtreeVersion) {
+		hierarchy->build(this);
+		hierarchy->generation = subtreeVersion;
+	}
+
+	return *hierarchy;
+}
+
 void grendx::unlink(sceneNode::ptr node) {
 	if (!node)
 		return;
@@ -45,13 +144,21 @@ void grendx::unlink(sceneNode::ptr node) {
 	auto manager = engine::Resolve<ecs::entityManager>();
 
 	if (auto p = node->parent) {
+		ecs::link<sceneNode> *found = nullptr;
+
+		// find first, unregistering while iterating over the links would
+		// invalidate the range
 		for (auto *ptr : p->nodes()) {
 			if (node == ptr->getRef()) {
-				sceneNode::ptr ret = p;
-				// TODO: convenience function in entity to unregister components
-				manager->unregisterComponent(p.getPtr(), ptr);
+				found = ptr;
+				break;
 			}
 		}
+
+		if (found) {
+			// TODO: convenience function in entity to unregister components
+			manager->unregisterComponent(p.getPtr(), found);
+		}
 	}
 }
 
@@ -101,128 +208,19 @@ static animationCollection::ptr copyCollection(animationCollection::ptr anims) {
 }
 */
 
-template <typename T>
-static int indexOf(const std::vector<T>& vec, const T& value) {
-	for (size_t i = 0; i < vec.size(); i++) {
-		if (vec[i] == value) {
-			return i;
-		}
-	}
-
-	return -1;
-}
-
-static sceneNode::ptr copySkinNodes(sceneSkin::ptr target,
-                                     sceneSkin::ptr skin,
-                                     sceneNode::ptr node)
-{
-	if (!node) {
-		return node;
-	}
-
-	if (node->type != sceneNode::objType::None) {
-		// should only have pure node types under skin nodes
+sceneNode::ptr grendx::duplicate(sceneNode::ptr node) {
+	// TODO: meshes/models, particles shouldn't be copied, but would it make
+	//       sense to copy other types like lights, cameras?
+	if (node->type != sceneNode::objType::None
+	    && node->type != sceneNode::objType::Skin)
+	{
 		return node;
 	}
 
+	// plain nodes and skins are copied, anything else under them is
+	// linked by reference, see prefab.hpp
 	auto manager = engine::Resolve<ecs::entityManager>();
-	//sceneNode::ptr ret = std::make_shared<sceneNode>();
-	sceneNode::ptr ret = manager->construct<sceneNode>();
-
-	// copy generic sceneNode members
-	// XXX: two set transforms to ensure origTransform is the same
-	ret->transform.set(node->transform.getOrig());
-	ret->transform.set(node->transform.getTRS());
-	ret->visible         = node->visible;
-	ret->animChannel     = node->animChannel;
-	ret->extraProperties = node->extraProperties;
-
-	// TODO: bounds check
-	int i = indexOf(skin->joints, node);
-	if (i >= 0) {
-		target->joints[i] = ret;
-	}
-
-	// copy sub-nodes
-	for (auto link : node->nodes()) {
-		auto ptr = link->getRef();
-		auto& name = ptr->name;
-		setNode(name, ret, copySkinNodes(target, skin, ptr));
-	}
-
-	return ret;
-}
-
-static void copySkin(sceneSkin::ptr target, sceneSkin::ptr skin) {
-	target->inverseBind = skin->inverseBind;
-	target->transforms  = skin->transforms;
-
-	target->joints.resize(skin->joints.size());
-
-	for (auto link : skin->nodes()) {
-		auto ptr = link->getRef();
-		auto& name = ptr->name;
-		setNode(name, target, copySkinNodes(target, skin, ptr));
-	}
-}
-
-sceneNode::ptr grendx::duplicate(sceneNode::ptr node) {
-	// TODO: need to copy all attributes
-
-	auto manager = engine::Resolve<ecs::entityManager>();
-
-	auto doCopy = [&] (sceneNode::ptr ret, sceneNode::ptr node) {
-		// copy generic sceneNode members
-		// XXX: two set transforms to ensure origTransform is the same
-		ret->transform.set(node->transform.getOrig());
-		ret->transform.set(node->transform.getTRS());
-		ret->visible         = node->visible;
-		ret->animChannel     = node->animChannel;
-		ret->extraProperties = node->extraProperties;
-
-		// copy sub-nodes
-		for (auto link : node->nodes()) {
-			auto ptr = link->getRef();
-			auto sub = duplicate(ptr);
-
-			sub->name = ptr->name;
-			ret->attach<ecs::link<sceneNode>>(sub.getPtr());
-
-			//auto& name = ptr->name;
-			//setNode(name, ret, duplicate(ptr));
-		}
-
-		return ret;
-	};
-
-	// copy specific per-type object members
-	switch (node->type) {
-		case sceneNode::objType::None: {
-				sceneNode::ptr ret = manager->construct<sceneNode>();
-				return doCopy(ret, node);
-		   }
-
-		case sceneNode::objType::Skin:
-			{
-				//ret = std::make_shared<sceneSkin>();
-				sceneNode::ptr ret = manager->construct<sceneSkin>();
-
-				// small XXX: need to copy skin information after copying subnodes
-				//auto skin = std::static_pointer_cast<sceneSkin>(node);
-				//auto temp = std::static_pointer_cast<sceneSkin>(ret);
-				auto skin = node->get<sceneSkin>();
-				auto temp = manager->construct<sceneSkin>();
-
-				copySkin(temp, skin);
-				return ret;
-			}
-			break;
-
-		// TODO: meshes/models, particles shouldn't be copied, but would it make
-		//       sense to copy other types like lights, cameras?
-		default:
-			return node;
-	}
+	return prefab(node).instantiate(manager);
 }
 
 std::string grendx::getNodeName(sceneNode::ptr node) {
@@ -230,30 +228,25 @@ std::string grendx::getNodeName(sceneNode::ptr node) {
 }
 
 void sceneNode::removeNode(std::string name) {
-	// XXX
 	auto ent = getNode(name);
-	// TODO:
-	// TODO: convenience function
-	//manager->unregisterComponent(this, ent.getPtr());
+	if (!ent) return;
 
-	/*
-	auto it = nodes.find(name);
+	auto manager = engine::Resolve<ecs::entityManager>();
 
-	if (it != nodes.end()) {
-		nodes.erase(it);
+	for (auto *ptr : nodes()) {
+		if (ptr->getRef() == ent) {
+			manager->unregisterComponent(this, ptr);
+			break;
+		}
 	}
-	*/
 }
 
-bool sceneNode::hasNode(std::string name) {
-	// XXX: inefficient
-	for (auto ptr : nodes()) {
-		if ((*ptr)->name == name) {
-			return true;
-		}
-	}
+bool sceneNode::hasNode(uint32_t nameID) {
+	return getNode(nameID) != nullptr;
+}
 
-	return false;
+bool sceneNode::hasNode(std::string name) {
+	return getNode(name) != nullptr;
 }
 
 float sceneLightPoint::extent(float threshold) {
@@ -308,7 +301,22 @@ void sceneSkin::sync(Program::ptr program) {
 	}
 #endif
 
-	std::map<sceneNode*, glm::mat4> accumTransforms;
+	// accumulate transforms for the whole subtree in one pass, the skin
+	// itself is the root so it's left as identity
+	const auto& hier = flatten();
+	static thread_local std::vector<glm::mat4> accum;
+	accum.resize(hier.entries.size());
+
+	for (uint32_t k = 0; k < hier.entries.size(); k++) {
+		const auto& ent = hier.entries[k];
+		accum[k] = (ent.parent == sceneHierarchy::none)
+			? glm::mat4(1)
+			: accum[ent.parent] * ent.node->transform.getMatrix();
+	}
+
+	// joints that aren't under the skin node (shouldn't happen with
+	// well-formed models) fall back to walking up parent pointers
+	std::map<sceneNode*, glm::mat4> outsideTransforms;
 
 	for (unsigned i = 0; i < inverseBind.size(); i++) {
 		if (!joints[i]) {
@@ -316,8 +324,12 @@ void sceneSkin::sync(Program::ptr program) {
 			continue;
 		}
 
-		glm::mat4 accum = lookup(accumTransforms, this, joints[i].getPtr());
-		transforms[i] = accum*inverseBind[i];
+		uint32_t idx = hier.indexOf(joints[i].getPtr());
+		glm::mat4 mat = (idx != sceneHierarchy::none)
+			? accum[idx]
+			: lookup(outsideTransforms, this, joints[i].getPtr());
+
+		transforms[i] = mat*inverseBind[i];
 	}
 
 #if GLSL_VERSION < 300
@@ -336,16 +348,49 @@ void sceneSkin::sync(Program::ptr program) {
 #endif
 }
 
+// creates buffers until there are enough for count instances
+static void allocInstanceBuffers(std::vector<Buffer::ptr>& buffers,
+                                 unsigned count,
+                                 unsigned perBuffer,
+                                 size_t bytes)
+{
+	unsigned needed = (count + perBuffer - 1) / perBuffer;
+
+	while (buffers.size() < needed) {
+		auto buf = genBuffer(GL_UNIFORM_BUFFER, GL_DYNAMIC_DRAW);
+		buf->allocate(bytes);
+		buffers.push_back(buf);
+	}
+}
+
 void sceneParticles::syncBuffer(void) {
-	if (!ubuffer) {
-		ubuffer = genBuffer(GL_UNIFORM_BUFFER, GL_DYNAMIC_DRAW);
-		ubuffer->allocate(sizeof(GLfloat[16*256]));
+	if (synced) {
+		return;
 	}
 
-	if (!synced) {
-		ubuffer->update(positions.data(), 0, sizeof(GLfloat[16*activeInstances]));
-		synced = true;
+	allocInstanceBuffers(ubuffers, activeInstances, instancesPerBuffer,
+	                     sizeof(GLfloat[16*instancesPerBuffer]));
+
+	for (unsigned i = 0; i*instancesPerBuffer < activeInstances; i++) {
+		ubuffers[i]->update(positions.data() + i*instancesPerBuffer, 0,
+		                    sizeof(GLfloat[16]) * bufferInstances(i));
 	}
+
+	synced = true;
+}
+
+unsigned sceneParticles::bufferInstances(unsigned i) const {
+	unsigned base = i*instancesPerBuffer;
+	return (base < activeInstances)
+		? std::min(instancesPerBuffer, activeInstances - base)
+		: 0;
+}
+
+void sceneParticles::resize(unsigned instances) {
+	positions.resize(instances);
+	maxInstances    = instances;
+	activeInstances = std::min(activeInstances, instances);
+	synced = false;
 }
 
 void sceneParticles::update(void) {
@@ -359,23 +404,65 @@ void sceneParticles::update(void) {
 sceneParticles::sceneParticles(ecs::regArgs t, unsigned _maxInstances)
 	: sceneNode(ecs::doRegister(this, t), objType::Particles)
 {
-	positions.reserve(_maxInstances);
-	positions.resize(positions.capacity());
-
-	maxInstances = _maxInstances;
 	activeInstances = 0;
+	resize(_maxInstances);
 };
 
 void sceneBillboardParticles::syncBuffer(void) {
-	if (!ubuffer) {
-		ubuffer = genBuffer(GL_UNIFORM_BUFFER, GL_DYNAMIC_DRAW);
-		ubuffer->allocate(sizeof(GLfloat[4*1024]));
+	if (synced) {
+		return;
+	}
+
+	// positions in the first half of each buffer, colors in the second
+	constexpr size_t half = sizeof(GLfloat[4*instancesPerBuffer]);
+	allocInstanceBuffers(ubuffers, activeInstances, instancesPerBuffer, 2*half);
+
+	for (unsigned i = 0; i*instancesPerBuffer < activeInstances; i++) {
+		size_t bytes = sizeof(GLfloat[4]) * bufferInstances(i);
+
+		ubuffers[i]->update(positions.data() + i*instancesPerBuffer, 0,    bytes);
+		ubuffers[i]->update(colors.data()    + i*instancesPerBuffer, half, bytes);
 	}
 
-	if (!synced) {
-		ubuffer->update(positions.data(), 0, sizeof(GLfloat[4*activeInstances]));
-		synced = true;
+	synced = true;
+}
+
+unsigned sceneBillboardParticles::bufferInstances(unsigned i) const {
+	unsigned base = i*instancesPerBuffer;
+	return (base < activeInstances)
+		? std::min(instancesPerBuffer, activeInstances - base)
+		: 0;
+}
+
+void sceneBillboardParticles::resize(unsigned instances) {
+	positions.resize(instances);
+	colors.resize(instances, glm::vec4(1));
+	maxInstances    = instances;
+	activeInstances = std::min(activeInstances, instances);
+	synced = false;
+}
+
+void sceneBillboardParticles::sortByDepth(const glm::vec3& viewPos) {
+	std::vector<std::pair<float, unsigned>> order(activeInstances);
+
+	for (unsigned i = 0; i < activeInstances; i++) {
+		glm::vec3 d = glm::vec3(positions[i]) - viewPos;
+		order[i] = {glm::dot(d, d), i};
+	}
+
+	std::sort(order.begin(), order.end(),
+		[] (const auto& a, const auto& b) { return a.first > b.first; });
+
+	std::vector<glm::vec4> pos(activeInstances), col(activeInstances);
+
+	for (unsigned i = 0; i < activeInstances; i++) {
+		pos[i] = positions[order[i].second];
+		col[i] = colors[order[i].second];
 	}
+
+	std::copy(pos.begin(), pos.end(), positions.begin());
+	std::copy(col.begin(), col.end(), colors.begin());
+	synced = false;
 }
 
 void sceneBillboardParticles::update(void) {
@@ -389,11 +476,8 @@ void sceneBillboardParticles::update(void) {
 sceneBillboardParticles::sceneBillboardParticles(ecs::regArgs t, unsigned _maxInstances)
 	: sceneNode(ecs::doRegister(this, t), objType::BillboardParticles)
 {
-	positions.reserve(_maxInstances);
-	positions.resize(positions.capacity());
-
-	maxInstances = _maxInstances;
 	activeInstances = 0;
+	resize(_maxInstances);
 };
 
 nlohmann::json sceneNode::serializer(ecs::component *comp) {
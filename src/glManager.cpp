@@ -1,6 +1,7 @@
 #include <grend/glManager.hpp>
 #include <grend/sceneModel.hpp>
 #include <grend/logger.hpp>
+#include <grend/textureCache.hpp>
 
 #include <SDL.h>
 #include <string.h>
@@ -8,6 +9,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include <fstream>
 #include <iostream>
@@ -25,7 +27,14 @@ static std::set<GLenum> featureCache;
 static Vao::ptr currentVao;
 static GLenum   currentFaceOrder;
 
-static std::map<uint32_t, Texture::weakptr>           textureCache;
+// hashTexture() -> uploaded texture, with the data it was uploaded from to
+// check that hash matches really are the same texture
+struct textureCacheEntry {
+	textureData::weakptr source;
+	Texture::weakptr     texture;
+};
+
+static std::unordered_map<uint64_t, textureCacheEntry> textureCache;
 
 static bool enabled_float_buffers = false;
 static bool enabled_halffloat_buffers = false;
@@ -135,70 +144,28 @@ Texture::ptr Framebuffer::attach(GLenum attachment,
 	return texture;
 }
 
-static inline uint32_t dumbhash(const std::vector<uint8_t>& pixels) {
-	uint32_t ret = 1543;
-
-	unsigned sample_offset;
-	unsigned tag = 0;
-	unsigned sq = sqrt(pixels.size()/4 /* assume RGBA */);
-
-	// choose sample offsets to keep sample rate roughly consistent
-	// between different texture sizes, smaller textures need smaller offsets
-	// `tag` encodes the texture size in the upper two bits of the hash
-	if (sq <= 256) {
-		sample_offset = 593;
-		tag = 0;
-
-	} else if (sq <= 512) {
-		sample_offset = 1031;
-		tag = 1;
-
-	} else if (sq <= 2048) {
-		sample_offset = 4159;
-		tag = 2;
-
-	} else {
-		sample_offset = 8101;
-		tag = 3;
-	}
-
-	for (unsigned i = 0; i < pixels.size(); i += sample_offset) {
-		ret = ((ret << 7) + ret + pixels[i]);
-	}
-
-	return (tag << 30) | (ret & ((1 << 30) - 1));
-}
-
 Texture::ptr texcache(textureData::ptr tex) {
 	if (!tex || !tex->loaded()) {
 		return nullptr;
 	}
 
-	// 0 is an invalid hash
-	uint32_t hash = 0;
+	uint64_t hash = tex->hash();
+	auto it = textureCache.find(hash);
 
-	if (auto *pixels = std::get_if<std::vector<uint8_t>>(&tex->pixels)) {
-		hash = dumbhash(*pixels);
-		auto it = textureCache.find(hash);
+	if (it != textureCache.end()) {
+		auto source  = it->second.source.lock();
+		auto observe = it->second.texture.lock();
 
-		if (it != textureCache.end()) {
-			if (auto observe = it->second.lock()) {
-				//static const unsigned sizes[4] = {256, 512, 2048, 4096};
-				//logfmt("texture cache hit: %08x (%uK)\n", hash, sizes[hash >> 30]);
-				return observe;
-			}
+		// textures loaded through textureFileCache are deduplicated, so
+		// the same object is the common case
+		if (source && observe && (source == tex || sameTexture(*source, *tex))) {
+			return observe;
 		}
-
-		// TODO: hashing for other pixel formats
-
 	}
 
 	Texture::ptr ret = genTexture();
 	ret->buffer(tex);
-
-	if (hash) {
-		textureCache[hash] = ret;
-	}
+	textureCache[hash] = {tex, ret};
 
 	return ret;
 }
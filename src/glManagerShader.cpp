@@ -1,6 +1,7 @@
 #include <grend/glManager.hpp>
 #include <grend/glmIncludes.hpp>
 #include <grend/shaderPreprocess.hpp>
+#include <grend/shaderPack.hpp>
 #include <grend/utility.hpp>
 #include <grend/glslParser.hpp>
 #include <grend/glslObject.hpp>
@@ -13,6 +14,8 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <cstdio>
+#include <stdlib.h>
 
 namespace grendx {
 
@@ -20,36 +23,34 @@ Shader::Shader(GLuint o)
 	: Obj(o, Obj::type::Shader) { }
 
 bool Shader::load(std::string filename, const Shader::parameters& options) {
-	LogFmt("loading shader: {}", filename);
+	LogCatFmt(logcat::render, Debug, "loading shader: {}", filename);
 
-	std::string source    = load_file(filename);
-	std::string processed = preprocessShader(source, options);
+	auto result = preprocessShaderFile(filename, options);
 
-	const char *temp = processed.c_str();
-	int compiled;
-
-	if (source.empty()) {
+	if (!result->good) {
 		LogFmt("{}: Source file is empty, couldn't load!", filename);
 		return false;
 	}
 
-	try {
-		//auto t = glslObject(source);
-		//auto t = parseGlsl(source);
-		//dump_tokens_tree(t);
+	processed       = result;
+	filepath        = filename;
+	compiledOptions = options;
+	return true;
+}
 
-		/*
-		if (!t.empty()) {
-			LogInfo("Parsed shader successfully");
-		} else {
-			LogInfo("Couldn't parse shader.");
-		}
-		*/
+bool Shader::compile(void) {
+	if (!processed) {
+		return false;
+	}
 
-	} catch (std::exception& e) {
-		LogErrorFmt("Exception, couldn't parse shader: {}", e.what());
+	if (compiledHash == processed->hash) {
+		// already compiled this source
+		return true;
 	}
 
+	const char *temp = processed->source.c_str();
+	int compiled;
+
 	glShaderSource(obj, 1, (const GLchar**)&temp, 0);
 	DO_ERROR_CHECK();
 	glCompileShader(obj);
@@ -64,18 +65,18 @@ bool Shader::load(std::string filename, const Shader::parameters& options) {
 		glGetShaderInfoLog(obj, max_length, &max_length, shader_log);
 
 		LogErrorFmt("BIGERROR: compiliing the processed shader: ");
-		LogErrorFmt("@ {}", filename);
+		LogErrorFmt("@ {}", filepath);
 		LogErrorFmt("{}", shader_log);
 		LogErrorFmt("SOURCE: ----------------------------------");
-		LogErrorFmt("{}", processed);
+		LogErrorFmt("{}", processed->source);
+		delete[] shader_log;
 
-	} else {
-		// only store this if the shader is in a good state
-		filepath = filename;
-		compiledOptions = options;
+		compiledHash = 0;
+		return false;
 	}
 
-	return compiled;
+	compiledHash = processed->hash;
+	return true;
 }
 
 Shader::parameters mergeOpts(const std::initializer_list<Shader::parameters>& opts) {
@@ -99,6 +100,19 @@ bool Shader::reload(void) {
 	return false;
 }
 
+bool Shader::unpack(void) {
+	// only packed shaders have reflection info
+	if (filepath.empty() || !processed || !processed->reflection) {
+		return false;
+	}
+
+	if (!shaderSources().unpack(filepath, shaderDefineHeader(compiledOptions))) {
+		return false;
+	}
+
+	return reload();
+}
+
 Program::ptr loadProgram(std::string vert,
                          std::string frag,
                          const Shader::parameters& opts)
@@ -118,18 +132,256 @@ Program::ptr loadProgram(std::string vert,
 	return prog;
 }
 
+// program binaries aren't available on gles2 or webgl
+#if GLSL_VERSION >= 300 && !defined(__EMSCRIPTEN__)
+#define HAVE_PROGRAM_BINARY
+#endif
+
+#if defined(HAVE_PROGRAM_BINARY)
+namespace {
+	struct programBinaryHeader {
+		enum : uint32_t { MAGIC = 0x42504752 /* "GRPB" */ };
+
+		uint32_t magic;
+		uint32_t format;
+		uint64_t key;
+		uint64_t length;
+	};
+
+	// directory for cached program binaries, empty if caching is disabled,
+	// can be set with the GREND_SHADER_CACHE environment variable
+	// (set to an empty string to disable)
+	const std::string& programCacheDir(void) {
+		static std::string dir = [] () -> std::string {
+			if (const char *env = getenv("GREND_SHADER_CACHE")) {
+				std::string ret = env;
+				return (ret.empty() || ret.back() == '/')? ret : ret + "/";
+			}
+
+			char *pref = SDL_GetPrefPath("grend", "shader-cache");
+			if (!pref) return "";
+
+			std::string ret = pref;
+			SDL_free(pref);
+			return ret;
+		}();
+
+		return dir;
+	}
+
+	bool programBinarySupported(void) {
+		static bool supported = [] () {
+#if GLSL_VERSION >= 330
+			// core profiles go through glew, need 4.1 or the extension
+			if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) {
+				return false;
+			}
+#endif
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			return formats > 0 && !programCacheDir().empty();
+		}();
+
+		return supported;
+	}
+
+	// binaries are only valid for the driver that produced them
+	uint64_t driverHash(void) {
+		static uint64_t hash = [] () {
+			uint64_t h = shaderHashSeed;
+
+			for (GLenum e : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+				if (auto str = (const char *)glGetString(e)) {
+					h = hashShaderString(str, h);
+				}
+			}
+
+			return h;
+		}();
+
+		return hash;
+	}
+
+	std::string programCachePath(uint64_t key) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%016llx.bin", (unsigned long long)key);
+		return programCacheDir() + buf;
+	}
+
+	bool loadProgramBinary(GLuint obj, uint64_t key) {
+		std::ifstream ifs(programCachePath(key), std::ios::binary);
+		programBinaryHeader header;
+
+		if (!ifs.read((char*)&header, sizeof(header))
+		    || header.magic != programBinaryHeader::MAGIC
+		    || header.key != key)
+		{
+			return false;
+		}
+
+		std::vector<char> data(header.length);
+		if (!ifs.read(data.data(), data.size())) {
+			return false;
+		}
+
+		glProgramBinary(obj, header.format, data.data(), data.size());
+
+		// fails if the driver rejects the binary, the caller
+		// falls back to compiling
+		GLint status = GL_FALSE;
+		glGetProgramiv(obj, GL_LINK_STATUS, &status);
+		return status == GL_TRUE;
+	}
+
+	void storeProgramBinary(GLuint obj, uint64_t key) {
+		GLint length = 0;
+		glGetProgramiv(obj, GL_PROGRAM_BINARY_LENGTH, &length);
+
+		if (length <= 0) {
+			return;
+		}
+
+		std::vector<char> data(length);
+		GLenum format;
+		glGetProgramBinary(obj, length, &length, &format, data.data());
+		DO_ERROR_CHECK();
+
+		programBinaryHeader header = {
+			.magic  = programBinaryHeader::MAGIC,
+			.format = format,
+			.key    = key,
+			.length = (uint64_t)length,
+		};
+
+		// write then rename, so other processes never see partial files
+		std::string path = programCachePath(key);
+		std::string temp = path + ".tmp";
+
+		{
+			std::ofstream ofs(temp, std::ios::binary);
+			ofs.write((char*)&header, sizeof(header));
+			ofs.write(data.data(), length);
+
+			if (!ofs) {
+				LogCatFmt(logcat::render, Warning,
+				          "Couldn't write program binary to {}", temp);
+				return;
+			}
+		}
+
+		std::rename(temp.c_str(), path.c_str());
+	}
+}
+#endif
+
 bool Program::link(void) {
+#if defined(HAVE_PROGRAM_BINARY)
+	uint64_t key = 0;
+
+	if (vertex && fragment && vertex->processed && fragment->processed
+	    && programBinarySupported())
+	{
+		key = driverHash();
+		key = hashShaderString(std::to_string(vertex->processed->hash), key);
+		key = hashShaderString(std::to_string(fragment->processed->hash), key);
+
+		// attribute bindings are baked into the binary
+		for (auto& [attr, location] : attributes) {
+			key = hashShaderString(attr + "=" + std::to_string(location), key);
+		}
+
+		if (loadProgramBinary(obj, key)) {
+			// same lookups as a freshly linked program
+			linked = true;
+			prefetchUniforms();
+			return linked;
+		}
+
+		glProgramParameteri(obj, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+#endif
+
+	if (vertex && fragment) {
+		// errors are logged by compile(), linking will fail
+		vertex->compile();
+		fragment->compile();
+	}
+
 	glLinkProgram(obj);
 	glGetProgramiv(obj, GL_LINK_STATUS, &linked);
 
+	// stripping packed shaders can break them in ways shaderComp doesn't
+	// catch, try the full sources before giving up
+	if (!linked && vertex && fragment) {
+		bool unpackedVert = vertex->unpack();
+		bool unpackedFrag = fragment->unpack();
+
+		if (unpackedVert || unpackedFrag) {
+			LogCatFmt(logcat::render, Warning,
+			          "Packed shaders {} + {} failed, retrying with the full source",
+			          vertex->filepath, fragment->filepath);
+
+			vertex->compile();
+			fragment->compile();
+			glLinkProgram(obj);
+			glGetProgramiv(obj, GL_LINK_STATUS, &linked);
+
+#if defined(HAVE_PROGRAM_BINARY)
+			// sources changed, the binary can't be stored under the old key
+			key = 0;
+#endif
+		}
+	}
+
 	if (!linked) {
 		std::string err = (std::string)"error linking program: " + log();
 		LogErrorFmt("{}", err);
 	}
 
+#if defined(HAVE_PROGRAM_BINARY)
+	if (linked && key != 0) {
+		storeProgramBinary(obj, key);
+	}
+#endif
+
+	if (linked) {
+		prefetchUniforms();
+	}
+
 	return linked;
 }
 
+void Program::prefetchUniforms(void) {
+	reflectedUniforms.clear();
+
+	// need reflection info for every stage, otherwise there's no way to know
+	// whether a name is missing
+	for (auto& shader : {vertex, fragment}) {
+		if (!shader || !shader->processed || !shader->processed->reflection) {
+			return;
+		}
+	}
+
+	for (auto& shader : {vertex, fragment}) {
+		auto& refl = *shader->processed->reflection;
+
+		for (auto& u : refl.uniforms) {
+			if (reflectedUniforms.insert(u.name).second) {
+				uniforms[u.name] = glGetUniformLocation(obj, u.name.c_str());
+			}
+		}
+
+		for (auto& b : refl.blocks) {
+			lookupUniformBlock(b.name);
+
+			// members of blocks without an instance name look like globals
+			for (auto& m : b.members) {
+				reflectedUniforms.insert(m.name);
+			}
+		}
+	}
+}
+
 std::string Program::log(void) {
 	int max_length;
 	char *prog_log;
@@ -291,6 +543,20 @@ GLint Program::lookup(std::string uniform) {
 		return it->second;
 	}
 
+	if (!reflectedUniforms.empty()) {
+		// array elements and struct members, eg. "lights[2].position"
+		auto base = uniform.substr(0, uniform.find_first_of("[."));
+
+		if (!reflectedUniforms.count(base)) {
+			// cached below, so this is only logged once per name
+			LogCatFmt(logcat::render, Debug,
+			          "{} + {}: no uniform {} in reflection info, skipping",
+			          vertex? vertex->filepath : "", fragment? fragment->filepath : "",
+			          uniform);
+			return uniforms[uniform] = -1;
+		}
+	}
+
 	return uniforms[uniform] = glGetUniformLocation(obj, uniform.c_str());
 }
 
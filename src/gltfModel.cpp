@@ -2,6 +2,10 @@
 #include <grend/utility.hpp>
 #include <grend/animation.hpp>
 #include <grend/logger.hpp>
+#include <grend/profile.hpp>
+#include <grend/jobQueue.hpp>
+#include <grend/meshOptimizer.hpp>
+#include <grend/textureCache.hpp>
 #include <grend/ecs/materialComponent.hpp>
 #include <grend/ecs/bufferComponent.hpp>
 #include <grend/ecs/animationController.hpp>
@@ -18,8 +22,11 @@
 #include <fstream>
 #include <sstream>
 #include <optional>
+#include <numeric>
+#include <utility>
 
 #include <stdint.h>
+#include <string.h>
 
 // TODO: still need to clean this code up a bit
 
@@ -27,15 +34,56 @@ using namespace grendx;
 
 class gltfModel {
 	public:
-		gltfModel(tinygltf::Model& mod, std::string fname)
-			: data(mod), filename(fname) {};
+		gltfModel(tinygltf::Model mod, std::string fname)
+			: data(std::move(mod)), filename(std::move(fname)) {};
 		tinygltf::Model data;
 		std::string filename;
 
-		std::map<int, textureData::weakptr> texcache;
-		std::map<int, material::weakptr>    matcache;
+		// textures are held for the whole import, since image data
+		// can be moved into them (see imageUsers)
+		std::map<int, textureData::ptr>  texcache;
+		std::map<int, material::weakptr> matcache;
+		// number of textures using each image
+		std::vector<unsigned> imageUsers;
+
+		// (stage, nanoseconds), logged once the import is done
+		std::vector<std::pair<const char*, uint64_t>> timings;
+};
+
+// adds the time from construction to finish() (or destruction) to the
+// import's timings
+class importStage {
+	public:
+		importStage(gltfModel& _gltf, const char *_name)
+			: gltf(_gltf), name(_name), start(profile::now()) {};
+		~importStage() { finish(); }
+
+		void finish(void) {
+			if (name) {
+				gltf.timings.push_back({name, profile::now() - start});
+				name = nullptr;
+			}
+		}
+
+	private:
+		gltfModel& gltf;
+		const char *name;
+		uint64_t start;
 };
 
+static void logImportTimings(const gltfModel& gltf) {
+	uint64_t total = 0;
+	std::string stages;
+
+	for (auto& [name, ns] : gltf.timings) {
+		stages += std::format("{}{}: {:.2f}ms", stages.empty()? "" : ", ", name, ns/1e6);
+		total  += ns;
+	}
+
+	LogCatFmt(logcat::loader, Info, "GLTF > imported {} in {:.2f}ms ({})",
+	          gltf.filename, total/1e6, stages);
+}
+
 namespace grendx {
 // XXX: ...
 modelMap load_gltf_models(gltfModel& gltf);
@@ -117,7 +165,7 @@ static tinygltf::Texture& gltf_texture(gltfModel& gltf, size_t idx) {
 }
 
 static tinygltf::Image& gltf_image(gltfModel& gltf, size_t idx) {
-	check_index(gltf.data.textures, idx);
+	check_index(gltf.data.images, idx);
 	return gltf.data.images[idx];
 }
 
@@ -171,13 +219,32 @@ static size_t gltf_buff_element_size(int component, int type) {
 	return size_component * size_type;
 }
 
-static void *gltf_load_accessor(gltfModel& gltf, int idx) {
+// bounds-checked, strided view of an accessor's elements in the loaded buffer
+struct accessorView {
+	uint8_t *data = nullptr;
+	size_t count = 0;
+	size_t stride = 0;
+	size_t elementSize = 0;
+
+	bool packed(void) const {
+		return stride == elementSize;
+	}
+
+	// elements aren't necessarily aligned, so copy rather than cast
+	template <typename T>
+	T get(size_t i) const {
+		T ret {};
+		memcpy(&ret, data + i*stride, std::min(sizeof(T), elementSize));
+		return ret;
+	}
+};
+
+static accessorView gltf_accessor_view(gltfModel& gltf, int idx) {
 	check_index(gltf.data.accessors, idx);
 	auto& acc = gltf.data.accessors[idx];
 
 	size_t elem_size =
 		gltf_buff_element_size(acc.componentType, acc.type);
-	size_t buff_size = acc.count * elem_size;
 	assert_nonzero(elem_size);
 
 	check_index(gltf.data.bufferViews, acc.bufferView);
@@ -185,67 +252,104 @@ static void *gltf_load_accessor(gltfModel& gltf, int idx) {
 	check_index(gltf.data.buffers, view.buffer);
 	auto& buffer = gltf.data.buffers[view.buffer];
 
-	check_index(buffer.data,
-			view.byteOffset + acc.byteOffset + buff_size - 1);
-	return static_cast<void*>(buffer.data.data() + (view.byteOffset + acc.byteOffset));
-};
+	size_t offset = view.byteOffset + acc.byteOffset;
+	size_t stride = view.byteStride? view.byteStride : elem_size;
 
+	if (acc.count > 0) {
+		// last byte of the last element
+		check_index(buffer.data, offset + (acc.count - 1)*stride + elem_size - 1);
+	}
+
+	return {buffer.data.data() + offset, acc.count, stride, elem_size};
+}
+
+// appends accessor elements to vec, one memcpy if the accessor is tightly
+// packed and matches T's layout
 template<typename T>
 static void gltf_unpack_buffer(gltfModel& gltf,
                                int accessor,
                                std::vector<T>& vec)
 {
-	check_index(gltf.data.accessors, accessor);
-	auto& acc = gltf.data.accessors[accessor];
-	check_index(gltf.data.bufferViews, acc.bufferView);
-	auto& view = gltf.data.bufferViews[acc.bufferView];
+	auto view = gltf_accessor_view(gltf, accessor);
+	size_t base = vec.size();
+	vec.resize(base + view.count);
 
-	uint8_t *datas = static_cast<uint8_t*>(gltf_load_accessor(gltf, accessor));
-	size_t emsz = view.byteStride
-		? view.byteStride
-		: gltf_buff_element_size(acc.componentType, acc.type);
+	if (view.packed() && view.elementSize == sizeof(T)) {
+		memcpy(vec.data() + base, view.data, view.count * sizeof(T));
 
-	for (unsigned i = 0; i < acc.count; i++) {
-		T *em = reinterpret_cast<T*>(datas + i*emsz);
-		vec.push_back(*em);
+	} else {
+		for (size_t i = 0; i < view.count; i++) {
+			vec[base + i] = view.get<T>(i);
+		}
 	}
 }
 
 template<typename T>
 static accessorIterator<T>
 gltf_buffer_iterator(gltfModel& gltf, int accessor) {
+	auto view = gltf_accessor_view(gltf, accessor);
+	return accessorIterator<T>(view.data, view.count, view.stride);
+}
+
+// appends element indices, offset by the number of vertices already in
+// the model, widening 8/16 bit indices
+static void gltf_unpack_indices(gltfModel& gltf,
+                                int accessor,
+                                std::vector<GLuint>& vec,
+                                GLuint offset)
+{
 	check_index(gltf.data.accessors, accessor);
 	auto& acc = gltf.data.accessors[accessor];
-	check_index(gltf.data.bufferViews, acc.bufferView);
-	auto& view = gltf.data.bufferViews[acc.bufferView];
+	assert_type(acc.type, TINYGLTF_TYPE_SCALAR);
+
+	auto view = gltf_accessor_view(gltf, accessor);
+	size_t base = vec.size();
 
-	uint8_t *datas = static_cast<uint8_t*>(gltf_load_accessor(gltf, accessor));
-	size_t emsz = view.byteStride
-		? view.byteStride
-		: gltf_buff_element_size(acc.componentType, acc.type);
+	switch (acc.componentType) {
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			gltf_unpack_buffer(gltf, accessor, vec);
+
+			if (offset) {
+				for (size_t i = base; i < vec.size(); i++) {
+					vec[i] += offset;
+				}
+			}
+			break;
 
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			vec.resize(base + view.count);
+			for (size_t i = 0; i < view.count; i++) {
+				vec[base + i] = view.get<GLushort>(i) + offset;
+			}
+			break;
 
-	return accessorIterator<T>(datas, acc.count, emsz);
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			vec.resize(base + view.count);
+			for (size_t i = 0; i < view.count; i++) {
+				vec[base + i] = view.data[i*view.stride] + offset;
+			}
+			break;
+
+		default:
+			assert_type(acc.componentType, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT);
+			break;
+	}
 }
 
-static void gltf_unpack_ushort_to_uint(gltfModel& gltf,
-                                       int accessor,
-                                       std::vector<GLuint>& vec)
+// copies a float accessor into one field of each vertex, the accessor
+// must have already been type-checked
+template <typename T>
+static void gltf_unpack_attribute(gltfModel& gltf,
+                                  int accessor,
+                                  sceneModel::vertex *verts,
+                                  size_t count,
+                                  T sceneModel::vertex::*field)
 {
-	check_index(gltf.data.accessors, accessor);
-	auto& acc = gltf.data.accessors[accessor];
-	check_index(gltf.data.bufferViews, acc.bufferView);
-	auto& view = gltf.data.bufferViews[acc.bufferView];
+	auto view = gltf_accessor_view(gltf, accessor);
+	size_t n = std::min(view.count, count);
 
-	uint8_t *datas = static_cast<uint8_t*>(gltf_load_accessor(gltf, accessor));
-	size_t emsz = view.byteStride
-		? view.byteStride
-		: gltf_buff_element_size(acc.componentType, acc.type);
-
-	for (unsigned i = 0; i < acc.count; i++) {
-		//T *em = reinterpret_cast<T*>(datas + i*emsz);
-		GLushort *em = reinterpret_cast<GLushort*>(datas + i*emsz);
-		vec.push_back((GLuint)*em);
+	for (size_t i = 0; i < n; i++) {
+		memcpy(&(verts[i].*field), view.data + i*view.stride, sizeof(T));
 	}
 }
 
@@ -271,7 +375,9 @@ gltf_accessor_aabb(tinygltf::Accessor& acc) {
 }
 
 // TODO: make this a generic function, .obj loader needs this too
-void gltf_load_external(gltfModel& gltf, textureData::ptr tex, std::string uri)
+textureData::ptr gltf_load_external(gltfModel& gltf,
+                                    std::string uri,
+                                    const textureSampler& sampler)
 {
 	std::string dir  = dirnameStr(gltf.filename);
 	std::string texname = dir + "/" + uri;
@@ -280,7 +386,8 @@ void gltf_load_external(gltfModel& gltf, textureData::ptr tex, std::string uri)
 	std::string pkmname = texname + ".pkm";
 
 	// TODO: remove this function
-	tex->load_texture(texname);
+	// shared with every other use of the file with the same sampler settings
+	return textureFiles().load(texname, false, sampler);
 
 	/*
 	uint8_t *px = nullptr;
@@ -317,69 +424,44 @@ void gltf_load_external(gltfModel& gltf, textureData::ptr tex, std::string uri)
 static textureData::ptr gltf_load_texture(gltfModel& gltf, int tex_idx) {
 	textureData::ptr ret;
 
-	if (gltf.texcache.count(tex_idx) && (ret = gltf.texcache[tex_idx].lock())) {
-		return ret;
+	if (auto it = gltf.texcache.find(tex_idx); it != gltf.texcache.end()) {
+		return it->second;
 	}
 
-	gltf.texcache[tex_idx] = ret = std::make_shared<textureData>();
-
 	auto& tex = gltf_texture(gltf, tex_idx);
-
-	if (tex.source >= 0) {
-		auto& img = gltf_image(gltf, tex.source);
-
-		LogFmt("        + texture image source: {}, {}x{}: {}",
-		       img.uri, img.width, img.height, img.component);
-
-		if (img.component < 0 || img.height < 0 || img.width < 0) {
-			// external image, do checks for compressed formats, etc
-			gltf_load_external(gltf, ret, img.uri);
-
-		} else {
-			// TODO: does tinygltf handle component sizes other than 8 bit uints?
-			std::vector<uint8_t> px;
-
-			px.insert(px.end(), img.image.begin(), img.image.end());
-
-			ret->pixels   = std::move(px);
-			ret->width    = img.width;
-			ret->height   = img.height;
-			ret->channels = img.component;
-			ret->size     = ret->width * ret->height * ret->channels;
-		}
-	}
+	textureSampler sampler;
 
 	if (tex.sampler >= 0) {
-		auto& sampler = gltf_sampler(gltf, tex.sampler);
+		auto& gsampler = gltf_sampler(gltf, tex.sampler);
 
-		switch (sampler.minFilter) {
+		switch (gsampler.minFilter) {
 			case TINYGLTF_TEXTURE_FILTER_NEAREST:
-				ret->minFilter = textureData::filter::Nearest;
+				sampler.minFilter = textureData::filter::Nearest;
 				break;
 			case TINYGLTF_TEXTURE_FILTER_LINEAR:
-				ret->minFilter = textureData::filter::Linear;
+				sampler.minFilter = textureData::filter::Linear;
 				break;
 			case TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST:
-				ret->minFilter = textureData::filter::NearestMipmapNearest;
+				sampler.minFilter = textureData::filter::NearestMipmapNearest;
 				break;
 			case TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_LINEAR:
-				ret->minFilter = textureData::filter::NearestMipmapLinear;
+				sampler.minFilter = textureData::filter::NearestMipmapLinear;
 				break;
 			case TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST:
-				ret->minFilter = textureData::filter::LinearMipmapNearest;
+				sampler.minFilter = textureData::filter::LinearMipmapNearest;
 				break;
 			case TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR:
-				ret->minFilter = textureData::filter::LinearMipmapLinear;
+				sampler.minFilter = textureData::filter::LinearMipmapLinear;
 				break;
 			default: break;
 		}
 
-		switch (sampler.magFilter) {
+		switch (gsampler.magFilter) {
 			case TINYGLTF_TEXTURE_FILTER_NEAREST:
-				ret->magFilter = textureData::filter::Nearest;
+				sampler.magFilter = textureData::filter::Nearest;
 				break;
 			case TINYGLTF_TEXTURE_FILTER_LINEAR:
-				ret->magFilter = textureData::filter::Linear;
+				sampler.magFilter = textureData::filter::Linear;
 				break;
 			default: break;
 		}
@@ -387,6 +469,46 @@ static textureData::ptr gltf_load_texture(gltfModel& gltf, int tex_idx) {
 		// TODO: wrap
 	}
 
+	if (tex.source >= 0) {
+		auto& img = gltf_image(gltf, tex.source);
+
+		LogCatFmt(logcat::loader, Debug, "        + texture image source: {}, {}x{}: {}",
+		          img.uri, img.width, img.height, img.component);
+
+		if (img.component < 0 || img.height < 0 || img.width < 0) {
+			// external image, do checks for compressed formats, etc
+			gltf.texcache[tex_idx] = ret = gltf_load_external(gltf, img.uri, sampler);
+			return ret;
+		}
+	}
+
+	gltf.texcache[tex_idx] = ret = std::make_shared<textureData>();
+
+	if (tex.source >= 0) {
+		auto& img = gltf_image(gltf, tex.source);
+
+		// TODO: does tinygltf handle component sizes other than 8 bit uints?
+		if (gltf.imageUsers[tex.source] == 1) {
+			// nothing else needs the decoded image
+			ret->pixels = std::move(img.image);
+
+		} else {
+			ret->pixels = std::vector<uint8_t>(img.image.begin(), img.image.end());
+		}
+
+		ret->width    = img.width;
+		ret->height   = img.height;
+		ret->channels = img.component;
+		ret->size     = ret->width * ret->height * ret->channels;
+	}
+
+	ret->minFilter = sampler.minFilter;
+	ret->magFilter = sampler.magFilter;
+	ret->wrapS     = sampler.wrapS;
+	ret->wrapT     = sampler.wrapT;
+
+	// share identical images with other models
+	gltf.texcache[tex_idx] = ret = textureFiles().intern(ret);
 	return ret;
 }
 
@@ -457,8 +579,8 @@ static material::ptr gltf_load_material(gltfModel& gltf, int material_idx) {
 textureData::ptr load_gltf_lightmap(gltfModel& gltf) {
 	for (auto& img : gltf.data.images) {
 		if (img.name.find("grendLightmap") != std::string::npos) {
-			LogFmt("have lightmap: name: {}, uri: {} ({})",
-					img.name, img.uri, img.mimeType);
+			LogCatFmt(logcat::loader, Debug, "have lightmap: name: {}, uri: {} ({})",
+			          img.name, img.uri, img.mimeType);
 
 			textureData::ptr ret = std::make_shared<textureData>();
 
@@ -482,14 +604,28 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 	auto ecs = engine::Resolve<ecs::entityManager>();
 
 	modelMap ret;
+	std::vector<sceneModel::ptr> models;
+
+	// images only used by one texture are moved out of the gltf data
+	// rather than copied, see gltf_load_texture()
+	gltf.imageUsers.assign(gltf.data.images.size(), 0);
+	for (auto& tex : gltf.data.textures) {
+		if (tex.source >= 0 && size_t(tex.source) < gltf.imageUsers.size()) {
+			gltf.imageUsers[tex.source]++;
+		}
+	}
+
 	textureData::ptr lightmap = load_gltf_lightmap(gltf);
+	importStage meshStage(gltf, "meshes");
 
 	for (auto& mesh : gltf.data.meshes) {
+		GREND_PROFILE_ZONE("gltf: mesh");
 		sceneModel::ptr curModel = ecs->construct<sceneModel>();
 		auto vertBuf = curModel->attach<ecs::bufferComponent<sceneModel::vertex>>();
 		auto& verts = vertBuf->data;
 
 		ret[mesh.name] = curModel;
+		models.push_back(curModel);
 
 		/*
 		todo << " GLTF > have mesh " << mesh.name << std::endl;
@@ -521,6 +657,12 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 				}
 			}
 
+			if (auto it = modmesh->extraProperties.find("occluder");
+			    it != modmesh->extraProperties.end())
+			{
+				modmesh->occluder = it->second != 0.f;
+			}
+
 			if (prim.material >= 0) {
 				auto mat     = gltf_load_material(gltf, prim.material);
 				auto matcomp = modmesh->attach<ecs::materialComponent>(*mat.get());
@@ -574,49 +716,47 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 					"without position information");
 			}
 
-			if (elements >= 0) {
-				check_index(gltf.data.accessors, elements);
-
-				auto& acc = gltf.data.accessors[elements];
-				assert_type(acc.type, TINYGLTF_TYPE_SCALAR);
+			size_t vsize  = verts.size();
+			auto  faceBuf = modmesh->attach<ecs::bufferComponent<sceneMesh::faceType>>();
+			auto& submesh = faceBuf->data;
 
-				size_t vsize = verts.size();
-				auto  faceBuf = modmesh->attach<ecs::bufferComponent<sceneMesh::faceType>>();
-				auto& submesh = faceBuf->data;
-
-				if (acc.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-					gltf_unpack_ushort_to_uint(gltf, elements, submesh);
-				} else if (acc.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
-					gltf_unpack_buffer(gltf, elements, submesh);
-				} else {
-					assert_type(acc.componentType, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT);
-				}
+			check_index(gltf.data.accessors, position);
+			auto& posAcc = gltf.data.accessors[position];
+			assert_type(posAcc.type, TINYGLTF_TYPE_VEC3);
+			assert_type(posAcc.componentType, TINYGLTF_COMPONENT_TYPE_FLOAT);
 
+			if (elements >= 0) {
 				// adjust element indices for vertices already in the model
 				// (model element indices are per-model, seems gltf is per-primitive)
-				for (auto& face : submesh) {
-					face += vsize;
-				}
+				gltf_unpack_indices(gltf, elements, submesh, vsize);
 
 			} else {
 				// identity-mapped indices
-				// todo << "        generating indices..." << std::endl;
-				auto& acc = gltf.data.accessors[position];
-				auto  faceBuf = modmesh->get<ecs::bufferComponent<sceneMesh::faceType>>();
-				auto& submesh = faceBuf->data;
-				size_t vsize = verts.size();
-
-				for (size_t i = 0; i < acc.count; i++) {
-					submesh.push_back(i + vsize);
-				}
+				submesh.resize(posAcc.count);
+				std::iota(submesh.begin(), submesh.end(), vsize);
+			}
+
+			if (auto box = gltf_accessor_aabb(posAcc)) {
+				curModel->haveAABB = true;
+				modmesh->boundingBox = *box;
 			}
 
-			accessorIterator<usvec4>    colorIt;
-			accessorIterator<glm::vec3> positionIt;
-			accessorIterator<glm::vec3> normalIt;
-			accessorIterator<glm::vec4> tangentIt;
-			accessorIterator<glm::vec2> uvIt;
-			accessorIterator<glm::vec2> litIt;
+			// vertices are filled in one attribute at a time, anything
+			// missing keeps these values
+			size_t count = posAcc.count;
+			sceneModel::vertex blank = {
+				.position = glm::vec3(0),
+				.normal   = glm::vec3(0),
+				.tangent  = glm::vec4(0),
+				.color    = glm::vec3(1),
+				.uv       = glm::vec2(0),
+				.lightmap = glm::vec2(0),
+			};
+
+			verts.resize(vsize + count, blank);
+			sceneModel::vertex *out = verts.data() + vsize;
+
+			gltf_unpack_attribute(gltf, position, out, count, &sceneModel::vertex::position);
 
 			if (normals >= 0) {
 				check_index(gltf.data.accessors, normals);
@@ -625,28 +765,23 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 				assert_type(acc.type, TINYGLTF_TYPE_VEC3);
 				assert_type(acc.componentType, TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-				//gltf_unpack_buffer(gltf, normals, curModel->normals);
-				normalIt = gltf_buffer_iterator<glm::vec3>(gltf, normals);
+				gltf_unpack_attribute(gltf, normals, out, count, &sceneModel::vertex::normal);
 				curModel->haveNormals = true;
 			}
 
 			if (tangents >= 0) {
 				check_index(gltf.data.accessors, tangents);
-				// todo << "        have tangents... " << tangents << std::endl;
 
 				auto& acc = gltf.data.accessors[tangents];
 				assert_type(acc.type, TINYGLTF_TYPE_VEC4);
 				assert_type(acc.componentType, TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-				//gltf_unpack_buffer(gltf, tangents, curModel->tangents);
-				// TODO: tangent is vec4!
-				tangentIt = gltf_buffer_iterator<glm::vec4>(gltf, tangents);
+				gltf_unpack_attribute(gltf, tangents, out, count, &sceneModel::vertex::tangent);
 				curModel->haveTangents = true;
 			}
 
 			if (colors >= 0) {
 				check_index(gltf.data.accessors, colors);
-				// todo << "        have colors... " << colors << std::endl;
 
 				auto& acc = gltf.data.accessors[colors];
 				// TODO: also vec3
@@ -654,25 +789,16 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 				// TODO: need to handle float and byte types
 				assert_type(acc.componentType, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
 
-				//gltf_unpack_buffer(gltf, colors, curModel->colors);
-				colorIt = gltf_buffer_iterator<usvec4>(gltf, colors);
-				curModel->haveColors = true;
-			}
-
-			if (position >= 0) {
-				check_index(gltf.data.accessors, position);
+				auto view = gltf_accessor_view(gltf, colors);
+				size_t n  = std::min(view.count, count);
 
-				auto& acc = gltf.data.accessors[position];
-				assert_type(acc.type, TINYGLTF_TYPE_VEC3);
-				assert_type(acc.componentType, TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-				//gltf_unpack_buffer(gltf, position, curModel->vertices);
-				positionIt = gltf_buffer_iterator<glm::vec3>(gltf, position);
-
-				if (auto box = gltf_accessor_aabb(acc)) {
-					curModel->haveAABB = true;
-					modmesh->boundingBox = *box;
+				for (size_t k = 0; k < n; k++) {
+					// XXX
+					usvec4 c = view.get<usvec4>(k);
+					out[k].color = glm::vec3(c.x, c.y, c.z) / 65536.f;
 				}
+
+				curModel->haveColors = true;
 			}
 
 			if (texcoord >= 0) {
@@ -682,8 +808,7 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 				assert_type(acc.type, TINYGLTF_TYPE_VEC2);
 				assert_type(acc.componentType, TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-				//gltf_unpack_buffer(gltf, texcoord, curModel->texcoords);
-				uvIt = gltf_buffer_iterator<glm::vec2>(gltf, texcoord);
+				gltf_unpack_attribute(gltf, texcoord, out, count, &sceneModel::vertex::uv);
 				curModel->haveTexcoords = true;
 			}
 
@@ -694,33 +819,10 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 				assert_type(acc.type, TINYGLTF_TYPE_VEC2);
 				assert_type(acc.componentType, TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-				//gltf_unpack_buffer(gltf, lightmap, curModel->lightmap);
-				litIt = gltf_buffer_iterator<glm::vec2>(gltf, lightmap);
+				gltf_unpack_attribute(gltf, lightmap, out, count, &sceneModel::vertex::lightmap);
 				curModel->haveLightmap = true;
 			}
 
-			for (; !positionIt.atEnd(); positionIt++) {
-				sceneModel::vertex vert;
-
-				vert.position = *positionIt;
-				if (!normalIt.atEnd())  {vert.normal   = *normalIt;  normalIt++;};
-				if (!tangentIt.atEnd()) {vert.tangent  = *tangentIt; tangentIt++;};
-				if (!colorIt.atEnd())   {
-					// XXX
-					auto it = *colorIt;
-					glm::vec4 c(it.x, it.y, it.z, it.w);
-					c = c / 65536.f;
-					vert.color = c;
-					colorIt++;
-				} else {
-					vert.color = glm::vec4(1.f);
-				}
-				if (!uvIt.atEnd())      {vert.uv       = *uvIt;      uvIt++;};
-				if (!litIt.atEnd())     {vert.lightmap = *litIt;     litIt++;};
-
-				verts.push_back(vert);
-			}
-
 			accessorIterator<usvec4> jointItShort;
 			accessorIterator<ubvec4> jointItByte;
 			unsigned jointType = 0;
@@ -780,7 +882,17 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 			}
 		}
 
-		// generate anything not included
+	}
+
+	meshStage.finish();
+	importStage genStage(gltf, "generate");
+
+	// generate anything not included, models don't share any data so
+	// this can be spread across the job workers
+	auto generate = [&] (size_t i) {
+		GREND_PROFILE_ZONE("gltf: generate attributes");
+		auto& curModel = models[i];
+
 		if (!curModel->haveNormals) {
 			curModel->genNormals();
 		}
@@ -797,6 +909,13 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 		//       just calling this all the time for now
 		curModel->genAABBs();
 
+		if (meshOptimizeEnabled()) {
+			curModel->optimizeMeshes();
+		}
+
+		// built after optimizing, since that reorders indices
+		curModel->buildBVHs();
+
 		/*
 		if (!curModel->haveAABB) {
 			curModel->genAABBs();
@@ -805,6 +924,12 @@ grendx::modelMap grendx::load_gltf_models(gltfModel& gltf) {
 			curModel->boundingSphere = AABBToBSphere(curModel->boundingBox);
 		}
 		*/
+	};
+
+	if (auto jobs = engine::Services().tryResolve<jobQueue>()) {
+		jobs->parallelFor(models.size(), generate);
+	} else {
+		parallelFor(models.size(), generate);
 	}
 
 	return ret;
@@ -953,7 +1078,7 @@ static void load_gltf_node_light(gltfModel& gltf,
 	auto it  = node.extensions.find("KHR_lights_punctual");
 
 	if (it != node.extensions.end()) {
-		LogInfo(" GLTF > have punctual light!");
+		LogCatFmt(logcat::loader, Debug, " GLTF > have punctual light!");
 
 		if (!it->second.IsObject() || !it->second.Has("light")) {
 			LogInfo(" GLTF > don't have light object");
@@ -974,7 +1099,7 @@ static void load_gltf_node_light(gltfModel& gltf,
 		}
 
 		auto& light = gltf.data.lights[idx];
-		LogFmt(" GLTF > node light! {}: {}", light.name, light.type);
+		LogCatFmt(logcat::loader, Debug, " GLTF > node light! {}: {}", light.name, light.type);
 
 		if (light.type == "point") {
 			sceneLightPoint::ptr point = ecs->construct<sceneLightPoint>();
@@ -1197,6 +1322,9 @@ load_gltf_scene_nodes(std::string filename,
 }
 
 static std::optional<gltfModel> open_gltf_model(std::string filename) {
+	GREND_PROFILE_FUNCTION();
+	uint64_t start = profile::now();
+
 	// TODO: parse extension, handle binary format
 	tinygltf::TinyGLTF loader;
 	tinygltf::Model gltf;
@@ -1227,13 +1355,18 @@ static std::optional<gltfModel> open_gltf_model(std::string filename) {
 		LogWarnFmt("/!\\ WARNING: {}", err);
 	}
 
-	return gltfModel(gltf, filename);
+	// buffers and images can be large, don't copy them
+	std::optional<gltfModel> ret(std::in_place, std::move(gltf), filename);
+	ret->timings.push_back({"parse", profile::now() - start});
+	return ret;
 }
 
 grendx::modelMap grendx::load_gltf_models(std::string filename) {
+	GREND_PROFILE_FUNCTION();
 	if (auto gltf = open_gltf_model(filename)) {
 		auto models = load_gltf_models(*gltf);
-		LogInfo("GLTF > loaded a thing successfully");
+		LogCatFmt(logcat::loader, Debug, "GLTF > loaded a thing successfully");
+		logImportTimings(*gltf);
 		// todo << " GLTF > loaded a thing successfully" << std::endl;
 
 		return models;
@@ -1246,14 +1379,22 @@ grendx::modelMap grendx::load_gltf_models(std::string filename) {
 // TODO: return optional
 std::pair<grendx::sceneNode::ptr, grendx::modelMap>
 grendx::load_gltf_scene(std::string filename) {
-	LogFmt("Opening gltf scene {}...", filename);
+	GREND_PROFILE_FUNCTION();
+	LogCatFmt(logcat::loader, Info, "Opening gltf scene {}...", filename);
 
 	if (auto gltf = open_gltf_model(filename)) {
-		LogFmt("Loading gltf scene {}...", filename);
+		LogCatFmt(logcat::loader, Debug, "Loading gltf scene {}...", filename);
 		grendx::modelMap models = load_gltf_models(*gltf);
-		LogFmt("Loading gltf scene nodes {}...", filename);
-		sceneNode::ptr ret = load_gltf_scene_nodes(filename, *gltf, models);
-		LogFmt("done loading {}", filename);
+		LogCatFmt(logcat::loader, Debug, "Loading gltf scene nodes {}...", filename);
+		sceneNode::ptr ret;
+
+		{
+			importStage stage(*gltf, "nodes");
+			ret = load_gltf_scene_nodes(filename, *gltf, models);
+		}
+
+		LogCatFmt(logcat::loader, Info, "done loading {}", filename);
+		logImportTimings(*gltf);
 		return {ret, models};
 
 	} else {
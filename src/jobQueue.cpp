@@ -1,5 +1,9 @@
 #include <grend/jobQueue.hpp>
 #include <grend/logger.hpp>
+#include <grend/profile.hpp>
+
+#include <algorithm>
+#include <atomic>
 
 using namespace grendx;
 
@@ -17,12 +21,17 @@ jobQueue::jobQueue(unsigned concurrency) {
 }
 
 jobQueue::~jobQueue() {
-	/*
+	// workers finish whatever's still queued, then exit
+	{
+		std::lock_guard<std::mutex> g(mtx);
+		running = false;
+	}
+
+	waiters.notify_all();
+
 	for (auto& thr : workers) {
-		// detached threads should be stopped once jobQueue is deleted, I think
-		thr.detach();
+		thr.join();
 	}
-	*/
 }
 
 std::future<bool> jobQueue::addAsync(std::function<bool()> job) {
@@ -60,6 +69,7 @@ void jobQueue::runDeferred(void) {
 	std::lock_guard<std::mutex> g(mtx);
 
 	for (auto& job : deferredJobs) {
+		GREND_PROFILE_ZONE("Deferred job");
 		job();
 	}
 
@@ -72,6 +82,7 @@ bool jobQueue::runSingleDeferred(void) {
 
 	if (!deferredJobs.empty()) {
 		auto& job = deferredJobs.front();
+		GREND_PROFILE_ZONE("Deferred job");
 		job();
 
 		deferredJobs.pop_front();
@@ -81,14 +92,60 @@ bool jobQueue::runSingleDeferred(void) {
 	return ran;
 }
 
+void jobQueue::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+	if (count == 0) {
+		return;
+	}
+
+	// shared since helper jobs can start after this returns, they'll find
+	// nothing left to claim and exit without touching fn
+	struct loopState {
+		const std::function<void(size_t)> *fn;
+		size_t count;
+		std::atomic<size_t> next = 0;
+		std::atomic<size_t> done = 0;
+		std::mutex mtx;
+		std::condition_variable finished;
+	};
+
+	auto state   = std::make_shared<loopState>();
+	state->fn    = &fn;
+	state->count = count;
+
+	auto work = [state] () {
+		size_t ran = 0;
+
+		for (size_t i; (i = state->next.fetch_add(1)) < state->count; ran++) {
+			(*state->fn)(i);
+		}
+
+		if (ran && state->done.fetch_add(ran) + ran == state->count) {
+			std::lock_guard<std::mutex> g(state->mtx);
+			state->finished.notify_all();
+		}
+
+		return true;
+	};
+
+	size_t helpers = std::min(workers.size(), count - 1);
+	for (size_t i = 0; i < helpers; i++) {
+		addAsync(work);
+	}
+
+	work();
+
+	std::unique_lock<std::mutex> lock(state->mtx);
+	state->finished.wait(lock, [&] { return state->done == count; });
+}
+
 void jobQueue::worker(void) {
-	// TODO: loop condition
-	while (running) {
-		auto job = getAsync();
+	profile::setThreadName("job worker");
+
+	// getAsync() returns an empty task once the queue is shutting down
+	for (auto job = getAsync(); job.valid(); job = getAsync()) {
+		GREND_PROFILE_ZONE("Async job");
 		job();
 	}
-
-	std::terminate();
 }
 
 #include <iostream>
@@ -103,7 +160,11 @@ std::packaged_task<bool()> jobQueue::getAsync(void) {
 		       std::hash<std::thread::id>{}(std::this_thread::get_id()));
 			   */
 
-		waiters.wait(slock, [this]{ return !asyncJobs.empty(); });
+		waiters.wait(slock, [this]{ return !running || !asyncJobs.empty(); });
+	}
+
+	if (asyncJobs.empty()) {
+		return {};
 	}
 
 	/*
@@ -0,0 +1,116 @@
+#include <grend/lodSelector.hpp>
+
+#include <algorithm>
+#include <math.h>
+
+using namespace grendx;
+
+lodSelector::~lodSelector() {};
+
+float grendx::lodPixelScale(float fovyDegrees, unsigned viewHeight, float distance) {
+	float halfAngle = glm::radians(fovyDegrees) * 0.5f;
+	return viewHeight / (2.f * tanf(halfAngle) * std::max(distance, 1e-3f));
+}
+
+unsigned grendx::selectLod(const float *errors, size_t levels,
+                           float threshold, int previous, float hysteresis)
+{
+	if (levels == 0) {
+		return 0;
+	}
+
+	if (previous < 0 || size_t(previous) >= levels) {
+		unsigned level = 0;
+
+		while (level + 1 < levels && errors[level + 1] <= threshold) {
+			level++;
+		}
+
+		return level;
+	}
+
+	// only go coarser once clearly under the threshold, and only go finer
+	// once clearly over it
+	unsigned level = previous;
+	float coarser = threshold * (1.f - hysteresis);
+	float finer   = threshold * (1.f + hysteresis);
+
+	while (level + 1 < levels && errors[level + 1] <= coarser) {
+		level++;
+	}
+
+	while (level > 0 && errors[level] > finer) {
+		level--;
+	}
+
+	return level;
+}
+
+// instances are identified by mesh and a stable instance ID, so moving
+// objects keep their hysteresis state
+static uint64_t instanceKey(const void *mesh, uint64_t instance, lodPass pass) {
+	uint64_t h = reinterpret_cast<uintptr_t>(mesh);
+	h ^= size_t(pass) * 0x9e3779b97f4a7c15ull;
+	h = (h ^ instance) * 0x100000001b3ull;
+	h ^= h >> 29;
+
+	return h;
+}
+
+unsigned lodSelector::select(const void *mesh,
+                             uint64_t instance,
+                             lodPass pass,
+                             const float *errors,
+                             size_t levels,
+                             float pixelScale)
+{
+	if (!settings.enabled || levels < 2) {
+		return 0;
+	}
+
+	float threshold = settings.pixelError;
+	switch (pass) {
+		case lodPass::Shadow: threshold *= settings.shadowBias; break;
+		case lodPass::Probe:  threshold *= settings.probeBias;  break;
+		default: break;
+	}
+
+	// compare in world units rather than converting every level's error
+	threshold /= std::max(pixelScale, 1e-6f);
+
+	auto [it, added] = instances.try_emplace(instanceKey(mesh, instance, pass),
+	                                         instanceState {frame, 0});
+	int previous = added? -1 : it->second.level;
+
+	unsigned level = selectLod(errors, levels, threshold, previous, settings.hysteresis);
+	it->second.level     = level;
+	it->second.lastFrame = frame;
+
+	return level;
+}
+
+void lodSelector::addTriangles(lodPass pass, size_t selected, size_t full) {
+	auto& s = current[size_t(pass)];
+	s.meshes++;
+	s.triangles     += selected;
+	s.fullTriangles += full;
+}
+
+void lodSelector::newFrame(void) {
+	for (size_t i = 0; i < size_t(lodPass::Count); i++) {
+		lastFrame[i] = current[i];
+		current[i]   = {};
+	}
+
+	frame++;
+
+	// forget instances that haven't been drawn in a while, every so often
+	// so this doesn't walk the whole map every frame
+	constexpr uint32_t expireFrames = 256;
+
+	if (frame % 64 == 0) {
+		std::erase_if(instances, [&] (const auto& ent) {
+			return frame - ent.second.lastFrame > expireFrames;
+		});
+	}
+}
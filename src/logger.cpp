@@ -1,31 +1,357 @@
 #include <grend/logger.hpp>
 #include <grend/sdlContext.hpp>
+
 #include <list>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <stdlib.h>
 
 using namespace grendx;
 
-static std::list<LogCallbackFunc> callbacks;
+static std::vector<logCategory*>& categories(void) {
+	static std::vector<logCategory*> ret;
+	return ret;
+}
+
+static bool parseLevel(std::string_view str, LogType& out) {
+	if      (str == "debug")                     out = LogType::Debug;
+	else if (str == "info")                      out = LogType::Info;
+	else if (str == "warning" || str == "warn")  out = LogType::Warning;
+	else if (str == "error")                     out = LogType::Error;
+	else return false;
+
+	return true;
+}
+
+// apply a "category=level,..." spec, to one category or all of them
+static void applySpec(std::string_view spec, logCategory *only = nullptr) {
+	while (!spec.empty()) {
+		size_t end   = spec.find(',');
+		auto   entry = spec.substr(0, end);
+		size_t eq    = entry.find('=');
+
+		spec = (end == std::string_view::npos)? "" : spec.substr(end + 1);
+
+		LogType level;
+		if (eq == std::string_view::npos || !parseLevel(entry.substr(eq + 1), level)) {
+			continue;
+		}
+
+		auto name = entry.substr(0, eq);
+
+		for (auto cat : categories()) {
+			if ((!only || cat == only) && (name == "*" || name == cat->name)) {
+				cat->setLevel(level);
+			}
+		}
+	}
+}
 
-static void dispatch(LogType type, const std::string& message) {
-	SDL_Log("%s", message.c_str());
+logCategory::logCategory(const char *_name, enum LogType _level)
+	: name(_name), level(_level)
+{
+	categories().push_back(this);
 
-	for (auto& f : callbacks) {
-		f(type, message);
+	if (const char *env = getenv("GREND_LOG")) {
+		applySpec(env, this);
 	}
 }
 
+namespace grendx::logcat {
+	logCategory general("general");
+	logCategory ecs("ecs");
+	logCategory loader("loader");
+	logCategory render("render");
+	logCategory physics("physics");
+	logCategory audio("audio");
+	logCategory editor("editor");
+}
+
+namespace {
+
+// bounded multi-producer queue (Vyukov style), each slot has a sequence
+// number that tells producers and the consumer whose turn it is
+struct logSlot {
+	logRecord rec;
+	std::atomic<size_t> sequence;
+	size_t position;
+};
+
+class logState {
+	public:
+		enum { capacity = 4096 };
+
+		logState() {
+			for (size_t i = 0; i < capacity; i++) {
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+#if !defined(__EMSCRIPTEN__)
+			threaded = true;
+			writer = std::thread(&logState::worker, this);
+#endif
+		}
+
+		~logState() {
+			if (writer.joinable()) {
+				running = false;
+				writer.join();
+			}
+
+			threaded = false;
+			drain();
+		}
+
+		logRecord *reserve(LogType type) {
+			size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+			for (;;) {
+				logSlot& slot = slots[pos & (capacity - 1)];
+				size_t seq = slot.sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+				if (diff == 0) {
+					if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+					                                     std::memory_order_relaxed))
+					{
+						slot.position = pos;
+						return &slot.rec;
+					}
+
+				} else if (diff < 0) {
+					// full, errors wait for space rather than being dropped
+					// (unless this is the writer, which would never make space)
+					if (type < LogType::Error || !threaded || onWriter) {
+						dropped.fetch_add(1, std::memory_order_relaxed);
+						return nullptr;
+					}
+
+					std::this_thread::yield();
+					pos = enqueuePos.load(std::memory_order_relaxed);
+
+				} else {
+					pos = enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		void commit(logRecord *rec) {
+			logSlot *slot = reinterpret_cast<logSlot*>(rec);
+			slot->sequence.store(slot->position + 1, std::memory_order_release);
+
+			if (!threaded) {
+				drain();
+			}
+		}
+
+		// consumer side, returns the number of messages written
+		size_t drain(void) {
+			// recursive so that callbacks can log when running synchronously
+			std::lock_guard<std::recursive_mutex> lock(consumerMutex);
+			std::string message;
+			size_t count = 0;
+
+			for (;; count++) {
+				logSlot& slot = slots[dequeuePos & (capacity - 1)];
+				size_t seq = slot.sequence.load(std::memory_order_acquire);
+
+				if (seq != dequeuePos + 1) {
+					break;
+				}
+
+				LogType type = slot.rec.type;
+				slot.rec.formatter(slot.rec, message);
+
+				// release the slot before writing, in case callbacks log something
+				slot.sequence.store(dequeuePos + capacity, std::memory_order_release);
+				dequeuePos++;
+
+				write(type, message);
+				consumed.store(dequeuePos, std::memory_order_release);
+			}
+
+			uint64_t drops = dropped.load(std::memory_order_relaxed);
+			if (drops != reportedDrops) {
+				uint64_t lost = drops - reportedDrops;
+				reportedDrops = drops;
+				write(LogType::Warning,
+				      std::format("({} log messages dropped, queue full)", lost));
+			}
+
+			return count;
+		}
+
+		void flush(void) {
+			size_t target = enqueuePos.load(std::memory_order_acquire);
+
+			while (consumed.load(std::memory_order_acquire) < target) {
+				if (drain() == 0) {
+					// slots reserved but not committed yet
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		// called with consumerMutex held
+		void write(LogType type, const std::string& msg) {
+			if (console) {
+				SDL_Log("%s", msg.c_str());
+			}
+
+			for (auto& f : callbacks) {
+				f(type, msg);
+			}
+		}
+
+		void worker(void) {
+			onWriter = true;
+
+			while (running) {
+				if (drain() == 0) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				}
+			}
+		}
+
+		logSlot slots[capacity];
+		alignas(64) std::atomic<size_t> enqueuePos = 0;
+		alignas(64) std::atomic<size_t> consumed = 0;
+		std::atomic<uint64_t> dropped = 0;
+
+		std::atomic<unsigned> rateLimit = 50;
+		std::atomic<bool> console = true;
+
+		// consumer state
+		std::recursive_mutex consumerMutex;
+		size_t dequeuePos = 0;
+		uint64_t reportedDrops = 0;
+		std::list<LogCallbackFunc> callbacks;
+
+		std::atomic<bool> running = true;
+		bool threaded = false;
+		std::thread writer;
+
+		static inline thread_local bool onWriter = false;
+};
+
+// namespace
+}
+
+static logState& state(void) {
+	static logState ret;
+	return ret;
+}
+
+static uint64_t milliseconds(void) {
+	auto t = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(t).count();
+}
+
+logRecord *logging::reserve(LogType type) {
+	return state().reserve(type);
+}
+
+void logging::commit(logRecord *rec) {
+	state().commit(rec);
+}
+
+bool logging::allow(logSite& site, uint32_t& suppressed) {
+	unsigned limit = state().rateLimit.load(std::memory_order_relaxed);
+
+	if (limit == 0) {
+		return true;
+	}
+
+	uint64_t now    = milliseconds();
+	uint64_t window = site.window.load(std::memory_order_relaxed);
+
+	if (now - window >= 1000
+	    && site.window.compare_exchange_strong(window, now,
+	                                           std::memory_order_relaxed))
+	{
+		site.count.store(0, std::memory_order_relaxed);
+		suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+	}
+
+	if (site.count.fetch_add(1, std::memory_order_relaxed) >= limit) {
+		site.suppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	return true;
+}
+
+// queue a preformatted message, without rate limiting
+static void push(const logCategory& cat, LogType type, std::string&& message) {
+	if (type < GREND_LOG_LEVEL || !cat.enabled(type)) {
+		return;
+	}
+
+	using Tuple = std::tuple<std::string>;
+	logRecord *rec = state().reserve(type);
+	if (!rec) return;
+
+	new (rec->storage) Tuple(std::move(message));
+	rec->type      = type;
+	rec->category  = &cat;
+	rec->format    = "{}";
+	rec->formatter = logging::formatRecord<Tuple>;
+	state().commit(rec);
+}
+
+void logging::reportSuppressed(const logCategory& cat,
+                               LogType type,
+                               uint32_t count)
+{
+	push(cat, type, std::format("({} similar messages suppressed)", count));
+}
+
+void grendx::LogDebug(const std::string& message) {
+	push(logcat::general, LogType::Debug, std::string(message));
+}
+
 void grendx::LogInfo(const std::string& message) {
-	dispatch(LogType::Info, message);
+	push(logcat::general, LogType::Info, std::string(message));
 }
 
 void grendx::LogWarn(const std::string& message) {
-	dispatch(LogType::Warning, message);
+	push(logcat::general, LogType::Warning, std::string(message));
 }
 
 void grendx::LogError(const std::string& message) {
-	dispatch(LogType::Error, message);
+	push(logcat::general, LogType::Error, std::string(message));
 }
 
 void grendx::LogCallback(LogCallbackFunc callback) {
-	callbacks.push_back(callback);
+	auto& s = state();
+	std::lock_guard<std::recursive_mutex> lock(s.consumerMutex);
+	s.callbacks.push_back(callback);
+}
+
+void grendx::LogConfigure(const std::string& spec) {
+	applySpec(spec);
+}
+
+logCategory *grendx::LogFindCategory(std::string_view name) {
+	for (auto cat : categories()) {
+		if (name == cat->name) {
+			return cat;
+		}
+	}
+
+	return nullptr;
+}
+
+void grendx::LogSetRateLimit(unsigned perSecond) {
+	state().rateLimit.store(perSecond, std::memory_order_relaxed);
+}
+
+void grendx::LogConsoleOutput(bool enabled) {
+	state().console.store(enabled, std::memory_order_relaxed);
+}
+
+void grendx::LogFlush(void) {
+	state().flush();
 }
@@ -0,0 +1,105 @@
+#include <grend/mappedFile.hpp>
+#include <grend/logger.hpp>
+
+#include <fstream>
+#include <utility>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#define HAVE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace grendx;
+
+mappedFile& mappedFile::operator=(mappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+
+		ptr      = std::exchange(other.ptr, nullptr);
+		length   = std::exchange(other.length, 0);
+		isOpen   = std::exchange(other.isOpen, false);
+		isMapped = std::exchange(other.isMapped, false);
+		buffer   = std::move(other.buffer);
+	}
+
+	return *this;
+}
+
+bool mappedFile::open(const std::string& path) {
+	close();
+
+#if defined(HAVE_MMAP)
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		length = st.st_size;
+		isOpen = true;
+
+		// can't map zero-length files, nothing to map anyway
+		if (length > 0) {
+			void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+			if (addr != MAP_FAILED) {
+				ptr      = static_cast<const char*>(addr);
+				isMapped = true;
+				// parsers read front to back
+				madvise(addr, length, MADV_SEQUENTIAL);
+
+			} else {
+				LogCatFmt(logcat::loader, Debug,
+				          "Couldn't map {}, reading it instead", path);
+				length = 0;
+				isOpen = false;
+			}
+		}
+	}
+
+	::close(fd);
+
+	if (isOpen) {
+		return true;
+	}
+#endif
+
+	std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+	if (!ifs.good()) {
+		return false;
+	}
+
+	auto end = ifs.tellg();
+	ifs.seekg(0);
+
+	if (end < 0) {
+		return false;
+	}
+
+	buffer.resize(static_cast<size_t>(end));
+	ifs.read(buffer.data(), buffer.size());
+
+	ptr    = buffer.data();
+	length = ifs.gcount();
+	isOpen = true;
+	return true;
+}
+
+void mappedFile::close(void) {
+#if defined(HAVE_MMAP)
+	if (isMapped) {
+		munmap(const_cast<char*>(ptr), length);
+	}
+#endif
+
+	buffer.clear();
+	buffer.shrink_to_fit();
+	ptr      = nullptr;
+	length   = 0;
+	isOpen   = false;
+	isMapped = false;
+}
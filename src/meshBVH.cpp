@@ -0,0 +1,271 @@
+#include <grend/meshBVH.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <float.h>
+
+using namespace grendx;
+
+static inline float boxArea(const AABB& box) {
+	glm::vec3 d = box.max - box.min;
+	return d.x*d.y + d.y*d.z + d.z*d.x;
+}
+
+static inline AABB emptyBox(void) {
+	return {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+}
+
+static inline void growBox(AABB& box, const AABB& other) {
+	box.min = glm::min(box.min, other.min);
+	box.max = glm::max(box.max, other.max);
+}
+
+namespace {
+struct bvhBuilder {
+	static constexpr unsigned bins = 12;
+	// past this depth splits are at the median, which bounds the total
+	// depth to this plus log2 of the primitive count
+	static constexpr unsigned sahDepth = bvhTree::maxDepth - 34;
+
+	const std::vector<AABB>& boxes;
+	std::vector<glm::vec3> centroids;
+	bvhTree& tree;
+	unsigned maxLeaf;
+
+	void build(uint32_t begin, uint32_t end, unsigned depth) {
+		uint32_t index = tree.nodes.size();
+		tree.nodes.push_back({emptyBox(), begin, end - begin});
+
+		AABB box = emptyBox(), cbox = emptyBox();
+
+		for (uint32_t i = begin; i < end; i++) {
+			uint32_t p = tree.order[i];
+			growBox(box, boxes[p]);
+			growBox(cbox, {centroids[p], centroids[p]});
+		}
+
+		tree.nodes[index].box = box;
+
+		if (end - begin <= maxLeaf) {
+			return;
+		}
+
+		uint32_t mid = (depth < sahDepth)? sahSplit(begin, end, box, cbox) : begin;
+
+		if (mid == begin || mid == end) {
+			// no useful split, or too deep, split at the median of the
+			// longest axis
+			glm::vec3 ext = cbox.max - cbox.min;
+			int axis = (ext.x > ext.y && ext.x > ext.z)? 0 : (ext.y > ext.z)? 1 : 2;
+			mid = begin + (end - begin)/2;
+
+			std::nth_element(tree.order.begin() + begin,
+			                 tree.order.begin() + mid,
+			                 tree.order.begin() + end,
+				[&] (uint32_t a, uint32_t b) {
+					return centroids[a][axis] < centroids[b][axis];
+				});
+		}
+
+		tree.nodes[index].count = 0;
+		build(begin, mid, depth + 1);
+		tree.nodes[index].first = tree.nodes.size();
+		build(mid, end, depth + 1);
+	}
+
+	// partitions by the cheapest binned split, returns the partition point
+	uint32_t sahSplit(uint32_t begin, uint32_t end, const AABB& box, const AABB& cbox) {
+		float bestCost = boxArea(box) * (end - begin);
+		int bestAxis = -1;
+		unsigned bestBin = 0;
+
+		for (int axis = 0; axis < 3; axis++) {
+			float lo = cbox.min[axis], hi = cbox.max[axis];
+
+			if (hi - lo <= 0) {
+				continue;
+			}
+
+			AABB     binBox[bins];
+			uint32_t binCount[bins] = {};
+			float scale = bins / (hi - lo);
+
+			for (unsigned b = 0; b < bins; b++) {
+				binBox[b] = emptyBox();
+			}
+
+			for (uint32_t i = begin; i < end; i++) {
+				uint32_t p = tree.order[i];
+				unsigned b = std::min(bins - 1, unsigned((centroids[p][axis] - lo) * scale));
+				binCount[b]++;
+				growBox(binBox[b], boxes[p]);
+			}
+
+			// sweep from the right, then evaluate splits from the left
+			float rightArea[bins];
+			uint32_t rightCount[bins];
+			AABB acc = emptyBox();
+			uint32_t count = 0;
+
+			for (unsigned b = bins - 1; b > 0; b--) {
+				growBox(acc, binBox[b]);
+				count += binCount[b];
+				rightArea[b]  = count? boxArea(acc) : 0;
+				rightCount[b] = count;
+			}
+
+			acc = emptyBox();
+			count = 0;
+
+			for (unsigned b = 0; b < bins - 1; b++) {
+				growBox(acc, binBox[b]);
+				count += binCount[b];
+
+				if (count == 0 || rightCount[b + 1] == 0) {
+					continue;
+				}
+
+				float cost = boxArea(acc)*count + rightArea[b + 1]*rightCount[b + 1];
+
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin  = b;
+				}
+			}
+		}
+
+		if (bestAxis < 0) {
+			return begin;
+		}
+
+		float lo = cbox.min[bestAxis];
+		float scale = bins / (cbox.max[bestAxis] - lo);
+
+		auto it = std::partition(tree.order.begin() + begin,
+		                         tree.order.begin() + end,
+			[&] (uint32_t p) {
+				unsigned b = std::min(bins - 1,
+				                      unsigned((centroids[p][bestAxis] - lo) * scale));
+				return b <= bestBin;
+			});
+
+		return it - tree.order.begin();
+	}
+};
+}
+
+void bvhTree::build(const std::vector<AABB>& boxes, unsigned maxLeaf) {
+	nodes.clear();
+	order.resize(boxes.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	if (boxes.empty()) {
+		return;
+	}
+
+	bvhBuilder builder = {boxes, {}, *this, std::max(1u, maxLeaf)};
+	builder.centroids.reserve(boxes.size());
+
+	for (auto& box : boxes) {
+		builder.centroids.push_back((box.min + box.max) * 0.5f);
+	}
+
+	nodes.reserve(2*boxes.size() / builder.maxLeaf + 1);
+	builder.build(0, boxes.size(), 0);
+}
+
+meshBVH::meshBVH(const float *positions, size_t stride, size_t vertexCount,
+                 const uint32_t *indices, size_t indexCount)
+{
+	auto vert = [&] (uint32_t i) {
+		const float *p = reinterpret_cast<const float*>(
+			reinterpret_cast<const uint8_t*>(positions) + i*stride);
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+
+	std::vector<AABB>     boxes;
+	std::vector<uint32_t> tris;
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+
+		if (a >= vertexCount || b >= vertexCount || c >= vertexCount) {
+			continue;
+		}
+
+		glm::vec3 pa = vert(a), pb = vert(b), pc = vert(c);
+		boxes.push_back({glm::min(pa, glm::min(pb, pc)), glm::max(pa, glm::max(pb, pc))});
+		tris.push_back(i / 3);
+	}
+
+	tree.build(boxes);
+
+	if (!tree.nodes.empty()) {
+		box = tree.nodes[0].box;
+	}
+
+	// triangles in leaf order, so leaves read contiguous data
+	size_t n = tree.order.size();
+	v0.resize(n);
+	e1.resize(n);
+	e2.resize(n);
+	triIndex.resize(n);
+
+	for (size_t k = 0; k < n; k++) {
+		uint32_t t = tris[tree.order[k]];
+		glm::vec3 pa = vert(indices[3*t]);
+
+		v0[k] = pa;
+		e1[k] = vert(indices[3*t + 1]) - pa;
+		e2[k] = vert(indices[3*t + 2]) - pa;
+		triIndex[k] = t;
+	}
+}
+
+bool meshBVH::raycast(const glm::vec3& origin,
+                      const glm::vec3& dir,
+                      float maxDist,
+                      meshHit& out) const
+{
+	float tmax = maxDist;
+	bool hit = false;
+
+	tree.traverse(origin, dir, tmax, [&] (uint32_t k) {
+		// Möller-Trumbore, both sides
+		glm::vec3 pvec = glm::cross(dir, e2[k]);
+		float det = glm::dot(e1[k], pvec);
+
+		if (det == 0.f) {
+			return FLT_MAX;
+		}
+
+		float inv = 1.f / det;
+		glm::vec3 tvec = origin - v0[k];
+		float u = glm::dot(tvec, pvec) * inv;
+
+		if (u < 0.f || u > 1.f) {
+			return FLT_MAX;
+		}
+
+		glm::vec3 qvec = glm::cross(tvec, e1[k]);
+		float v = glm::dot(dir, qvec) * inv;
+
+		if (v < 0.f || u + v > 1.f) {
+			return FLT_MAX;
+		}
+
+		float t = glm::dot(e2[k], qvec) * inv;
+
+		if (t < 0.f || t >= tmax) {
+			return FLT_MAX;
+		}
+
+		glm::vec3 normal = glm::cross(e1[k], e2[k]);
+		out = {t, triIndex[k], u, v, (det > 0)? normal : -normal};
+		hit = true;
+		return t;
+	});
+
+	return hit;
+}
@@ -0,0 +1,765 @@
+#include <grend/meshOptimizer.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace grendx;
+
+namespace {
+
+struct vec3f {
+	float x, y, z;
+
+	vec3f operator-(const vec3f& o) const { return {x - o.x, y - o.y, z - o.z}; }
+	vec3f operator+(const vec3f& o) const { return {x + o.x, y + o.y, z + o.z}; }
+	vec3f operator*(float s) const { return {x*s, y*s, z*s}; }
+
+	float dot(const vec3f& o) const { return x*o.x + y*o.y + z*o.z; }
+	float length(void) const { return sqrtf(dot(*this)); }
+
+	vec3f cross(const vec3f& o) const {
+		return {y*o.z - z*o.y, z*o.x - x*o.z, x*o.y - y*o.x};
+	}
+};
+
+static inline vec3f loadPosition(const float *positions, size_t stride, size_t i) {
+	const float *p = reinterpret_cast<const float*>(
+		reinterpret_cast<const uint8_t*>(positions) + i*stride);
+	return {p[0], p[1], p[2]};
+}
+
+// FIFO cache simulation, timestamps are bumped on misses only, so a vertex
+// is in the cache if fewer than cacheSize misses happened since it was added
+class fifoCache {
+	public:
+		fifoCache(size_t vertexCount, unsigned size)
+			: timestamps(vertexCount, 0), cacheSize(size), time(size + 1) {}
+
+		unsigned access(uint32_t v) {
+			if (time - timestamps[v] > cacheSize) {
+				timestamps[v] = time++;
+				return 1;
+			}
+
+			return 0;
+		}
+
+		unsigned triangle(const uint32_t *tri) {
+			return access(tri[0]) + access(tri[1]) + access(tri[2]);
+		}
+
+		// every vertex misses after this
+		void flush(void) {
+			time += cacheSize + 1;
+		}
+
+	private:
+		std::vector<uint32_t> timestamps;
+		unsigned cacheSize;
+		uint32_t time;
+};
+
+// vertex -> triangles adjacency in CSR form
+struct triangleAdjacency {
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> triangles;
+
+	triangleAdjacency(const uint32_t *indices, size_t indexCount, size_t vertexCount)
+		: offsets(vertexCount + 1, 0),
+		  counts(vertexCount, 0),
+		  triangles(indexCount)
+	{
+		for (size_t i = 0; i < indexCount; i++) {
+			counts[indices[i]]++;
+		}
+
+		for (size_t v = 0; v < vertexCount; v++) {
+			offsets[v + 1] = offsets[v] + counts[v];
+		}
+
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; i++) {
+			triangles[cursor[indices[i]]++] = i / 3;
+		}
+	}
+
+	const uint32_t *begin(uint32_t v) const { return triangles.data() + offsets[v]; }
+	const uint32_t *end(uint32_t v)   const { return begin(v) + counts[v]; }
+};
+
+}
+
+bool grendx::meshOptimizeEnabled(void) {
+	static bool enabled = [] {
+		const char *env = getenv("GREND_MESH_OPTIMIZE");
+		return !(env && strcmp(env, "0") == 0);
+	}();
+
+	return enabled;
+}
+
+float grendx::computeACMR(const uint32_t *indices, size_t indexCount,
+                          size_t vertexCount, unsigned cacheSize)
+{
+	size_t faces = indexCount / 3;
+	if (faces == 0) {
+		return 0;
+	}
+
+	fifoCache cache(vertexCount, cacheSize);
+	size_t misses = 0;
+
+	for (size_t i = 0; i < faces*3; i += 3) {
+		misses += cache.triangle(indices + i);
+	}
+
+	return float(misses) / faces;
+}
+
+// scoring constants from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+enum { forsythCacheSize = 32 };
+
+static float forsythScore(int cachePos, uint32_t remaining) {
+	if (remaining == 0) {
+		return -1.f;
+	}
+
+	float score = 0.f;
+
+	if (cachePos >= 0) {
+		if (cachePos < 3) {
+			// vertices of the last triangle, fixed score so that the next
+			// triangle doesn't trivially reuse the same edge
+			score = 0.75f;
+
+		} else {
+			float scale = 1.f / (forsythCacheSize - 3);
+			score = powf(1.f - (cachePos - 3)*scale, 1.5f);
+		}
+	}
+
+	// boost vertices with few triangles left, gets rid of lone triangles
+	// that would otherwise cost a full miss later
+	return score + 2.f / sqrtf(remaining);
+}
+
+void grendx::optimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount) {
+	size_t faceCount = indexCount / 3;
+	if (faceCount < 2) {
+		return;
+	}
+
+	triangleAdjacency adj(indices, faceCount*3, vertexCount);
+	// live triangles are kept at the front of each vertex's list
+	std::vector<uint32_t>& live = adj.counts;
+
+	std::vector<int>   cachePos(vertexCount, -1);
+	std::vector<float> vertScore(vertexCount);
+	std::vector<float> triScore(faceCount);
+	std::vector<uint8_t> emitted(faceCount, 0);
+	std::vector<uint32_t> out;
+	out.reserve(faceCount*3);
+
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertScore[v] = forsythScore(-1, live[v]);
+	}
+
+	int best = 0;
+	for (size_t t = 0; t < faceCount; t++) {
+		const uint32_t *tri = indices + t*3;
+		triScore[t] = vertScore[tri[0]] + vertScore[tri[1]] + vertScore[tri[2]];
+
+		if (triScore[t] > triScore[best]) {
+			best = t;
+		}
+	}
+
+	uint32_t cache[forsythCacheSize + 3];
+	unsigned cacheCount = 0;
+	size_t cursor = 0;
+
+	while (out.size() < faceCount*3) {
+		if (best < 0) {
+			// dead end, continue with the next unemitted triangle in
+			// input order, which is usually somewhere nearby
+			while (emitted[cursor]) cursor++;
+			best = cursor;
+		}
+
+		const uint32_t *tri = indices + best*3;
+		emitted[best] = 1;
+		out.insert(out.end(), tri, tri + 3);
+
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = tri[k];
+			uint32_t *list = adj.triangles.data() + adj.offsets[v];
+
+			for (uint32_t i = 0; i < live[v]; i++) {
+				if (list[i] == uint32_t(best)) {
+					std::swap(list[i], list[live[v] - 1]);
+					live[v]--;
+					break;
+				}
+			}
+		}
+
+		// new LRU order: this triangle's vertices, then the rest of the
+		// old cache, anything past the end falls out
+		uint32_t next[forsythCacheSize + 3];
+		unsigned nextCount = 0;
+
+		for (int k = 0; k < 3; k++) {
+			if (std::find(next, next + nextCount, tri[k]) == next + nextCount) {
+				next[nextCount++] = tri[k];
+			}
+		}
+
+		for (unsigned i = 0; i < cacheCount; i++) {
+			uint32_t v = cache[i];
+
+			if (std::find(next, next + nextCount, v) != next + nextCount) {
+				continue;
+			}
+
+			if (nextCount < forsythCacheSize) {
+				next[nextCount++] = v;
+
+			} else {
+				// evicted, still needs its score updated
+				cachePos[v]  = -1;
+				vertScore[v] = forsythScore(-1, live[v]);
+			}
+		}
+
+		memcpy(cache, next, nextCount * sizeof(uint32_t));
+		cacheCount = nextCount;
+
+		for (unsigned i = 0; i < cacheCount; i++) {
+			cachePos[cache[i]]  = i;
+			vertScore[cache[i]] = forsythScore(i, live[cache[i]]);
+		}
+
+		// only triangles touching the cache change score, pick the best
+		best = -1;
+		float bestScore = -1.f;
+
+		for (unsigned i = 0; i < cacheCount; i++) {
+			uint32_t v = cache[i];
+
+			for (auto it = adj.begin(v); it != adj.begin(v) + live[v]; it++) {
+				const uint32_t *t = indices + (*it)*3;
+				float s = vertScore[t[0]] + vertScore[t[1]] + vertScore[t[2]];
+				triScore[*it] = s;
+
+				if (s > bestScore) {
+					bestScore = s;
+					best = *it;
+				}
+			}
+		}
+	}
+
+	memcpy(indices, out.data(), out.size() * sizeof(uint32_t));
+}
+
+void grendx::optimizeOverdraw(uint32_t *indices, size_t indexCount,
+                              const float *positions, size_t vertexCount,
+                              size_t vertexStride, float threshold)
+{
+	size_t faceCount = indexCount / 3;
+	if (faceCount < 2) {
+		return;
+	}
+
+	// hard boundaries: triangles where every vertex misses start a new
+	// patch, reordering those can't make the cache any worse
+	std::vector<size_t> hard;
+	{
+		fifoCache cache(vertexCount, 16);
+
+		for (size_t t = 0; t < faceCount; t++) {
+			if (cache.triangle(indices + t*3) == 3 || t == 0) {
+				hard.push_back(t);
+			}
+		}
+
+		hard.push_back(faceCount);
+	}
+
+	// soft boundaries: split patches further wherever the running ACMR is
+	// already within threshold of the whole patch's
+	std::vector<size_t> clusters;
+	fifoCache cache(vertexCount, 16);
+
+	for (size_t h = 0; h + 1 < hard.size(); h++) {
+		size_t start = hard[h], end = hard[h + 1];
+		size_t patchMisses = 0;
+
+		cache.flush();
+		for (size_t t = start; t < end; t++) {
+			patchMisses += cache.triangle(indices + t*3);
+		}
+
+		float limit = threshold * float(patchMisses) / (end - start);
+		size_t clusterStart = start, misses = 0;
+
+		cache.flush();
+		clusters.push_back(start);
+
+		for (size_t t = start; t < end; t++) {
+			misses += cache.triangle(indices + t*3);
+
+			if (t + 1 < end && misses <= limit * (t - clusterStart + 1)) {
+				clusters.push_back(t + 1);
+				clusterStart = t + 1;
+				misses = 0;
+				cache.flush();
+			}
+		}
+	}
+
+	clusters.push_back(faceCount);
+
+	// sort clusters by how much they face away from the mesh center
+	vec3f meshCenter = {0, 0, 0};
+	for (size_t i = 0; i < faceCount*3; i++) {
+		meshCenter = meshCenter + loadPosition(positions, vertexStride, indices[i]);
+	}
+	meshCenter = meshCenter * (1.f / (faceCount*3));
+
+	size_t numClusters = clusters.size() - 1;
+	std::vector<float> sortKey(numClusters);
+
+	for (size_t c = 0; c < numClusters; c++) {
+		vec3f center = {0, 0, 0};
+		vec3f normal = {0, 0, 0};
+		float area   = 0;
+
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+			const uint32_t *tri = indices + t*3;
+			vec3f a = loadPosition(positions, vertexStride, tri[0]);
+			vec3f b = loadPosition(positions, vertexStride, tri[1]);
+			vec3f d = loadPosition(positions, vertexStride, tri[2]);
+
+			// length is twice the triangle area
+			vec3f n  = (b - a).cross(d - a);
+			float ta = n.length();
+
+			center = center + (a + b + d) * (ta / 3.f);
+			normal = normal + n;
+			area  += ta;
+		}
+
+		float nlen = normal.length();
+
+		if (area > 0 && nlen > 0) {
+			center = center * (1.f / area);
+			sortKey[c] = (center - meshCenter).dot(normal * (1.f / nlen));
+		} else {
+			sortKey[c] = 0;
+		}
+	}
+
+	std::vector<uint32_t> order(numClusters);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+		[&] (uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<uint32_t> out;
+	out.reserve(faceCount*3);
+
+	for (uint32_t c : order) {
+		out.insert(out.end(), indices + clusters[c]*3, indices + clusters[c + 1]*3);
+	}
+
+	memcpy(indices, out.data(), out.size() * sizeof(uint32_t));
+}
+
+std::vector<uint32_t> grendx::vertexFetchRemap(const uint32_t *indices, size_t indexCount,
+                                               size_t vertexCount)
+{
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	uint32_t next = 0;
+
+	for (size_t i = 0; i < indexCount; i++) {
+		if (remap[indices[i]] == UINT32_MAX) {
+			remap[indices[i]] = next++;
+		}
+	}
+
+	for (auto& r : remap) {
+		if (r == UINT32_MAX) {
+			r = next++;
+		}
+	}
+
+	return remap;
+}
+
+void grendx::remapIndices(uint32_t *indices, size_t indexCount,
+                          const std::vector<uint32_t>& remap)
+{
+	for (size_t i = 0; i < indexCount; i++) {
+		indices[i] = remap[indices[i]];
+	}
+}
+
+float grendx::meshExtent(const float *positions, size_t vertexCount, size_t vertexStride) {
+	if (vertexCount == 0) {
+		return 0;
+	}
+
+	vec3f lo = loadPosition(positions, vertexStride, 0);
+	vec3f hi = lo;
+
+	for (size_t i = 1; i < vertexCount; i++) {
+		vec3f p = loadPosition(positions, vertexStride, i);
+		lo = {std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z)};
+		hi = {std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z)};
+	}
+
+	return std::max({hi.x - lo.x, hi.y - lo.y, hi.z - lo.z});
+}
+
+namespace {
+
+// symmetric plane quadric, error(p) = p'Ap + 2b'p + c, weighted by area so
+// error/weight is the mean squared distance to the accumulated planes
+struct quadric {
+	double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+	double b0 = 0, b1 = 0, b2 = 0;
+	double c = 0;
+	double weight = 0;
+
+	static quadric plane(const vec3f& n, float d, double w) {
+		quadric q;
+		q.a00 = w*n.x*n.x; q.a01 = w*n.x*n.y; q.a02 = w*n.x*n.z;
+		q.a11 = w*n.y*n.y; q.a12 = w*n.y*n.z; q.a22 = w*n.z*n.z;
+		q.b0  = w*n.x*d;   q.b1  = w*n.y*d;   q.b2  = w*n.z*d;
+		q.c   = w*d*d;
+		q.weight = w;
+		return q;
+	}
+
+	quadric& operator+=(const quadric& o) {
+		a00 += o.a00; a01 += o.a01; a02 += o.a02;
+		a11 += o.a11; a12 += o.a12; a22 += o.a22;
+		b0  += o.b0;  b1  += o.b1;  b2  += o.b2;
+		c   += o.c;
+		weight += o.weight;
+		return *this;
+	}
+
+	double error(const vec3f& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double e = a00*x*x + a11*y*y + a22*z*z
+		         + 2*(a01*x*y + a02*x*z + a12*y*z)
+		         + 2*(b0*x + b1*y + b2*z)
+		         + c;
+
+		return (weight > 0)? std::max(0.0, e) / weight : 0.0;
+	}
+};
+
+enum vertexKind : uint8_t {
+	Manifold,
+	Border,
+	Locked,
+};
+
+struct collapse {
+	uint32_t from;
+	uint32_t to;
+	float    error;
+};
+
+static inline uint64_t edgeKey(uint32_t a, uint32_t b) {
+	return (a < b)
+		? (uint64_t(a) << 32) | b
+		: (uint64_t(b) << 32) | a;
+}
+
+}
+
+size_t grendx::simplifyMesh(uint32_t *dest,
+                            const uint32_t *indices, size_t indexCount,
+                            const float *positions, const float *texcoords,
+                            size_t vertexCount, size_t vertexStride,
+                            size_t targetIndexCount, float targetError,
+                            float *resultError)
+{
+	if (resultError) *resultError = 0;
+
+	// positions normalized to the unit cube, so errors are relative
+	float extent = meshExtent(positions, vertexCount, vertexStride);
+	float scale  = (extent > 0)? 1.f / extent : 1.f;
+	std::vector<vec3f> pos(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++) {
+		pos[i] = loadPosition(positions, vertexStride, i) * scale;
+	}
+
+	// weld vertices that differ only in attributes other than texcoords,
+	// and find UV seams (same position, different texcoords)
+	struct weldKey {
+		float p[3];
+		float uv[2];
+
+		bool operator==(const weldKey& o) const { return memcmp(this, &o, sizeof(*this)) == 0; }
+	};
+
+	struct weldHash {
+		size_t operator()(const weldKey& k) const {
+			uint32_t words[5];
+			memcpy(words, &k, sizeof(words));
+
+			uint64_t h = 0xcbf29ce484222325ull;
+			for (uint32_t w : words) {
+				h = (h ^ w) * 0x100000001b3ull;
+			}
+
+			return h;
+		}
+	};
+
+	std::vector<uint32_t> weld(vertexCount);
+	std::vector<uint8_t>  kind(vertexCount, Manifold);
+	{
+		std::unordered_map<weldKey, uint32_t, weldHash> welded;
+		std::unordered_map<weldKey, uint32_t, weldHash> positionOnly;
+		welded.reserve(vertexCount);
+		positionOnly.reserve(vertexCount);
+
+		for (size_t i = 0; i < vertexCount; i++) {
+			weldKey k = {};
+			// +0.f turns -0.f into 0.f so they compare equal bitwise
+			k.p[0] = pos[i].x + 0.f;
+			k.p[1] = pos[i].y + 0.f;
+			k.p[2] = pos[i].z + 0.f;
+
+			uint32_t byPosition = positionOnly.try_emplace(k, i).first->second;
+
+			if (texcoords) {
+				const float *uv = reinterpret_cast<const float*>(
+					reinterpret_cast<const uint8_t*>(texcoords) + i*vertexStride);
+				k.uv[0] = uv[0] + 0.f;
+				k.uv[1] = uv[1] + 0.f;
+			}
+
+			weld[i] = welded.try_emplace(k, i).first->second;
+
+			if (weld[i] != byPosition) {
+				// seam, lock every welded vertex at this position
+				kind[weld[i]]     = Locked;
+				kind[byPosition]  = Locked;
+			}
+		}
+
+		// locks found after the first welded vertex at a position
+		// also need to apply to the others
+		for (size_t i = 0; i < vertexCount; i++) {
+			weldKey k = {};
+			k.p[0] = pos[i].x + 0.f;
+			k.p[1] = pos[i].y + 0.f;
+			k.p[2] = pos[i].z + 0.f;
+
+			if (kind[positionOnly[k]] == Locked) {
+				kind[weld[i]] = Locked;
+			}
+		}
+	}
+
+	std::vector<uint32_t> tris;
+	tris.reserve(indexCount);
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t a = weld[indices[i]], b = weld[indices[i+1]], c = weld[indices[i+2]];
+
+		if (a != b && b != c && a != c) {
+			tris.insert(tris.end(), {a, b, c});
+		}
+	}
+
+	// classify edges, border edges have one triangle, non-manifold more than 2
+	std::unordered_map<uint64_t, uint32_t> edgeCounts;
+	edgeCounts.reserve(tris.size());
+
+	for (size_t i = 0; i < tris.size(); i += 3) {
+		for (int k = 0; k < 3; k++) {
+			edgeCounts[edgeKey(tris[i + k], tris[i + (k+1)%3])]++;
+		}
+	}
+
+	for (auto& [key, count] : edgeCounts) {
+		uint32_t a = key >> 32, b = key & 0xffffffff;
+
+		if (count > 2) {
+			kind[a] = kind[b] = Locked;
+
+		} else if (count == 1) {
+			if (kind[a] == Manifold) kind[a] = Border;
+			if (kind[b] == Manifold) kind[b] = Border;
+		}
+	}
+
+	// accumulate quadrics, border edges get an extra perpendicular plane
+	// so they don't pull inwards
+	std::vector<quadric> quadrics(vertexCount);
+
+	for (size_t i = 0; i < tris.size(); i += 3) {
+		const uint32_t *t = &tris[i];
+		vec3f n = (pos[t[1]] - pos[t[0]]).cross(pos[t[2]] - pos[t[0]]);
+		float len = n.length();
+
+		if (len == 0) continue;
+
+		n = n * (1.f / len);
+		quadric q = quadric::plane(n, -n.dot(pos[t[0]]), len * 0.5);
+
+		for (int k = 0; k < 3; k++) {
+			quadrics[t[k]] += q;
+
+			uint32_t a = t[k], b = t[(k+1)%3];
+			if (edgeCounts[edgeKey(a, b)] == 1) {
+				vec3f edge = pos[b] - pos[a];
+				float elen = edge.length();
+				vec3f en   = edge.cross(n);
+				float enl  = en.length();
+
+				if (enl > 0) {
+					en = en * (1.f / enl);
+					// heavily weighted, moving borders is very noticeable
+					quadric bq = quadric::plane(en, -en.dot(pos[a]), elen * elen * 10.0);
+					quadrics[a] += bq;
+					quadrics[b] += bq;
+				}
+			}
+		}
+	}
+
+	auto canCollapse = [&] (uint32_t from, uint32_t to) {
+		switch (kind[from]) {
+			case Manifold: return true;
+			case Border:   return edgeCounts[edgeKey(from, to)] == 1;
+			default:       return false;
+		}
+	};
+
+	double maxError = 0;
+	double errorLimit = double(targetError) * targetError;
+	std::vector<uint32_t> collapseTo(vertexCount);
+	std::vector<uint8_t>  touched(vertexCount);
+	std::vector<collapse> candidates;
+
+	while (tris.size() > targetIndexCount) {
+		triangleAdjacency adj(tris.data(), tris.size(), vertexCount);
+		candidates.clear();
+
+		for (size_t i = 0; i < tris.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				uint32_t a = tris[i + k], b = tris[i + (k+1)%3];
+
+				for (auto [from, to] : {std::pair {a, b}, std::pair {b, a}}) {
+					if (canCollapse(from, to)) {
+						quadric q = quadrics[from];
+						q += quadrics[to];
+						candidates.push_back({from, to, float(q.error(pos[to]))});
+					}
+				}
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(),
+			[] (const collapse& a, const collapse& b) { return a.error < b.error; });
+
+		std::iota(collapseTo.begin(), collapseTo.end(), 0);
+		std::fill(touched.begin(), touched.end(), 0);
+
+		// each collapse removes about two triangles, don't overshoot
+		size_t removable = (tris.size() - targetIndexCount) / 3;
+		size_t removed = 0, collapses = 0;
+
+		for (auto& c : candidates) {
+			if (removed >= removable || c.error > errorLimit) {
+				break;
+			}
+
+			if (touched[c.from] || touched[c.to]) {
+				continue;
+			}
+
+			// reject collapses that would flip (or nearly flip) a triangle
+			bool flips = false;
+			size_t shared = 0;
+
+			for (auto it = adj.begin(c.from); it != adj.end(c.from); it++) {
+				const uint32_t *t = &tris[*it * 3];
+
+				if (t[0] == c.to || t[1] == c.to || t[2] == c.to) {
+					shared++;
+					continue;
+				}
+
+				vec3f p[3], q[3];
+				for (int k = 0; k < 3; k++) {
+					p[k] = pos[t[k]];
+					q[k] = (t[k] == c.from)? pos[c.to] : p[k];
+				}
+
+				vec3f n0 = (p[1] - p[0]).cross(p[2] - p[0]);
+				vec3f n1 = (q[1] - q[0]).cross(q[2] - q[0]);
+
+				if (n0.dot(n1) <= 0.25f * n0.length() * n1.length()) {
+					flips = true;
+					break;
+				}
+			}
+
+			if (flips) {
+				continue;
+			}
+
+			// lock the whole neighbourhood, flip checks assume none of
+			// these move in the same pass
+			for (auto it = adj.begin(c.from); it != adj.end(c.from); it++) {
+				const uint32_t *t = &tris[*it * 3];
+				touched[t[0]] = touched[t[1]] = touched[t[2]] = 1;
+			}
+
+			collapseTo[c.from] = c.to;
+			quadrics[c.to] += quadrics[c.from];
+			maxError = std::max(maxError, double(c.error));
+			removed += shared;
+			collapses++;
+		}
+
+		if (collapses == 0) {
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < tris.size(); i += 3) {
+			uint32_t a = collapseTo[tris[i]];
+			uint32_t b = collapseTo[tris[i+1]];
+			uint32_t c = collapseTo[tris[i+2]];
+
+			if (a != b && b != c && a != c) {
+				tris[write++] = a;
+				tris[write++] = b;
+				tris[write++] = c;
+			}
+		}
+
+		tris.resize(write);
+	}
+
+	if (resultError) *resultError = sqrt(maxError);
+
+	memcpy(dest, tris.data(), tris.size() * sizeof(uint32_t));
+	return tris.size();
+}
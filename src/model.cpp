@@ -1,6 +1,9 @@
 #include <grend/sceneModel.hpp>
 #include <grend/utility.hpp>
 #include <grend/logger.hpp>
+#include <grend/meshOptimizer.hpp>
+#include <grend/meshBVH.hpp>
+#include <grend/profile.hpp>
 #include <grend/ecs/bufferComponent.hpp>
 
 #include <stb/stb_image.h>
@@ -14,6 +17,7 @@
 #include <fstream>
 #include <sstream>
 #include <optional>
+#include <algorithm>
 
 #include <stdint.h>
 
@@ -42,6 +46,8 @@ nlohmann::json sceneMesh::serializer(component *comp) {
 			{"center", {sph_cen.x, sph_cen.y, sph_cen.z}},
 			{"extent", sph_ex},
 	    }},
+
+		{"occluder", mesh->occluder},
 	};
 }
 
@@ -74,6 +80,7 @@ void sceneMesh::deserializer(component *comp, nlohmann::json j) {
 
 	mesh->boundingBox    = { .min = aabb_min,   .max = aabb_max };
 	mesh->boundingSphere = { .center = sph_cen, .extent = sph_ex };
+	mesh->occluder       = j.value("occluder", false);
 }
 
 nlohmann::json sceneModel::serializer(component *comp) {
@@ -287,5 +294,200 @@ void sceneModel::genTangents(void) {
 	}
 }
 
+sceneModel::optimizeStats sceneModel::optimizeMeshes(unsigned maxLods) {
+	static_assert(sizeof(sceneMesh::faceType) == sizeof(uint32_t));
+	GREND_PROFILE_FUNCTION();
+
+	optimizeStats stats;
+	auto vertBuf = this->get<ecs::bufferComponent<sceneModel::vertex>>();
+
+	if (!vertBuf || vertBuf->data.empty()) {
+		return stats;
+	}
+
+	auto& verts = vertBuf->data;
+	const float *positions = &verts[0].position.x;
+	const float *texcoords = &verts[0].uv.x;
+	size_t stride = sizeof(sceneModel::vertex);
+	// simplification errors are relative to this
+	float extent = meshExtent(positions, verts.size(), stride);
+
+	std::vector<sceneMesh::ptr> meshes;
+	size_t faceCount = 0;
+	float missesBefore = 0, missesAfter = 0;
+
+	for (auto link : nodes()) {
+		auto ptr = link->getRef();
+
+		if (ptr->type != sceneNode::objType::Mesh) {
+			continue;
+		}
+		sceneMesh::ptr mesh = ref_cast<sceneMesh>(ptr);
+
+		auto faceBuf = mesh->get<ecs::bufferComponent<sceneMesh::faceType>>();
+		if (!faceBuf)
+			continue;
+
+		auto& faces = faceBuf->data;
+		bool valid = std::all_of(faces.begin(), faces.end(),
+			[&] (auto idx) { return idx < verts.size(); });
+
+		if (!valid) {
+			// vertex remapping needs every index to be valid, leave the
+			// model as-is
+			LogError(" > invalid face index! (optimizeMeshes())");
+			return stats;
+		}
+
+		meshes.push_back(mesh);
+	}
+
+	for (auto& mesh : meshes) {
+		auto& faces = mesh->get<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+		uint32_t *indices = reinterpret_cast<uint32_t*>(faces.data());
+		size_t tris = faces.size() / 3;
+
+		float acmrBefore = computeACMR(indices, faces.size(), verts.size());
+		std::vector<sceneMesh::faceType> original = faces;
+
+		optimizeVertexCache(indices, faces.size(), verts.size());
+		optimizeOverdraw(indices, faces.size(), positions, verts.size(), stride);
+		float acmrAfter = computeACMR(indices, faces.size(), verts.size());
+
+		// input that's already well ordered can come out slightly worse
+		// after the overdraw pass, keep it as-is then
+		if (acmrAfter > acmrBefore) {
+			faces.swap(original);
+			indices   = reinterpret_cast<uint32_t*>(faces.data());
+			acmrAfter = acmrBefore;
+		}
+
+		missesBefore += tris * acmrBefore;
+		missesAfter  += tris * acmrAfter;
+		faceCount    += tris;
+
+		// each level halves the previous one
+		const std::vector<sceneMesh::faceType> *prev = &faces;
+		mesh->lods.clear();
+
+		for (unsigned k = 0; k < maxLods; k++) {
+			// not worth a level for tiny meshes
+			if (prev->size() < 3*64) {
+				break;
+			}
+
+			sceneMesh::lodLevel level;
+			level.indices.resize(prev->size());
+			uint32_t *dest = reinterpret_cast<uint32_t*>(level.indices.data());
+			const uint32_t *src = reinterpret_cast<const uint32_t*>(prev->data());
+			float err = 0;
+
+			size_t count = simplifyMesh(dest, src, prev->size(),
+			                            positions, haveTexcoords? texcoords : nullptr,
+			                            verts.size(), stride,
+			                            prev->size() / 2, 0.01f * (1 << k), &err);
+
+			// stuck on locked vertices or the error limit
+			if (count > prev->size() * 9 / 10) {
+				break;
+			}
+
+			level.indices.resize(count);
+			optimizeVertexCache(dest, count, verts.size());
+
+			// errors accumulate across levels, store the upper bound
+			float prevError = mesh->lods.empty()? 0.f : mesh->lods.back().error;
+			level.error = prevError + err * extent;
+
+			mesh->lods.push_back(std::move(level));
+			prev = &mesh->lods.back().indices;
+		}
+
+		stats.lodLevels = std::max(stats.lodLevels, mesh->lods.size());
+	}
+
+	// one remap for all meshes, since they share the vertex buffer
+	std::vector<uint32_t> allIndices;
+	allIndices.reserve(faceCount * 3);
+
+	for (auto& mesh : meshes) {
+		auto& faces = mesh->get<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+		allIndices.insert(allIndices.end(), faces.begin(), faces.end());
+	}
+
+	auto remap = vertexFetchRemap(allIndices.data(), allIndices.size(), verts.size());
+	remapVertices(verts, remap);
+
+	if (auto jointBuf = this->get<ecs::bufferComponent<sceneModel::jointWeights>>()) {
+		if (jointBuf->data.size() == remap.size()) {
+			remapVertices(jointBuf->data, remap);
+		}
+	}
+
+	for (auto& mesh : meshes) {
+		auto& faces = mesh->get<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+		remapIndices(reinterpret_cast<uint32_t*>(faces.data()), faces.size(), remap);
+
+		for (auto& level : mesh->lods) {
+			remapIndices(reinterpret_cast<uint32_t*>(level.indices.data()),
+			             level.indices.size(), remap);
+		}
+	}
+
+	if (faceCount > 0) {
+		stats.acmrBefore = missesBefore / faceCount;
+		stats.acmrAfter  = missesAfter  / faceCount;
+	}
+
+	LogCatFmt(logcat::loader, Debug,
+	          " > optimized {} meshes, ACMR {:.3f} -> {:.3f}, {} LOD levels",
+	          meshes.size(), stats.acmrBefore, stats.acmrAfter, stats.lodLevels);
+
+	return stats;
+}
+
+void sceneModel::buildBVHs(void) {
+	static_assert(sizeof(sceneMesh::faceType) == sizeof(uint32_t));
+	GREND_PROFILE_FUNCTION();
+
+	auto vertBuf = this->get<ecs::bufferComponent<sceneModel::vertex>>();
+
+	if (!vertBuf || vertBuf->data.empty()) {
+		return;
+	}
+
+	auto& verts = vertBuf->data;
+
+	for (auto link : nodes()) {
+		auto ptr = link->getRef();
+
+		if (ptr->type != sceneNode::objType::Mesh) {
+			continue;
+		}
+		sceneMesh::ptr mesh = ref_cast<sceneMesh>(ptr);
+
+		if (mesh->bvh) {
+			continue;
+		}
+
+		const std::vector<sceneMesh::faceType> *faces = nullptr;
+
+		if (mesh->sharedIndices) {
+			faces = &mesh->sharedIndices->indices;
+		} else if (auto faceBuf = mesh->get<ecs::bufferComponent<sceneMesh::faceType>>()) {
+			faces = &faceBuf->data;
+		}
+
+		if (!faces || faces->empty()) {
+			continue;
+		}
+
+		// out of range indices are skipped by meshBVH
+		mesh->bvh = std::make_shared<meshBVH>(
+			&verts[0].position.x, sizeof(sceneModel::vertex), verts.size(),
+			reinterpret_cast<const uint32_t*>(faces->data()), faces->size());
+	}
+}
+
 // namespace grendx
 }
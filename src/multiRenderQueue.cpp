@@ -34,10 +34,11 @@ void grendx::cullQueue(multiRenderQueue& renque,
                        camera::ptr       cam,
                        unsigned          width,
                        unsigned          height,
-                       float             lightext)
+                       float             lightext,
+                       lodPass           pass)
 {
 	for (auto& [id, que] : renque.queues) {
-		cullQueue(que, cam, width, height, lightext);
+		cullQueue(que, cam, width, height, lightext, pass);
 	}
 }
 
@@ -1,7 +1,11 @@
 #include <grend/sceneModel.hpp>
+#include <grend/objParser.hpp>
+#include <grend/meshOptimizer.hpp>
+#include <grend/mappedFile.hpp>
 #include <grend/utility.hpp>
 #include <grend/logger.hpp>
-#include <grend/textureData.hpp>
+#include <grend/profile.hpp>
+#include <grend/textureCache.hpp>
 #include <grend/ecs/materialComponent.hpp>
 #include <grend/ecs/bufferComponent.hpp>
 
@@ -9,17 +13,17 @@
 #include <map>
 #include <string>
 #include <exception>
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <optional>
+#include <type_traits>
 
 #include <stdint.h>
 
 namespace grendx {
 
 std::map<std::string, material::ptr>
-load_materials(sceneModel::ptr model, std::string filename);
+load_materials(std::string filename);
+
+// textures in .mtl files are stored upside-down relative to GL
+static const bool flipVertically = true;
 
 static std::string base_dir(std::string filename) {
 	std::size_t found = filename.rfind("/");
@@ -32,155 +36,68 @@ static std::string base_dir(std::string filename) {
 }
 
 sceneModel::ptr load_object(std::string filename) {
+	GREND_PROFILE_FUNCTION();
 	auto ecs = engine::Resolve<ecs::entityManager>();
 
-	LogFmt(" > loading ", filename);
-	std::ifstream input(filename);
-	std::string line;
-	std::string mesh_name = "default";
-	std::string mesh_material = "(null)";
-	std::string current_mesh_name = mesh_name + ":" + mesh_material;
-	sceneMesh::ptr current_mesh = nullptr;
-	std::vector<sceneMesh::faceType>* curFaces = nullptr;
-
-	std::vector<glm::vec3> vertbuf = {};
-	std::vector<glm::vec3> normbuf = {};
-	std::vector<glm::vec2> texbuf = {};
+	LogCatFmt(logcat::loader, Info, " > loading {}", filename);
+
+	objData data;
 	std::map<std::string, material::ptr> materials;
 	std::map<std::string, unsigned> matMeshCount;
 
-	if (!input.good()) {
+	if (!parseObjFile(filename, data)) {
 		// TODO: exception
-		LogErrorFmt(" ! couldn't load object from ", filename);
+		LogCatFmt(logcat::loader, Error, " ! couldn't load object from {}", filename);
 		return nullptr;
 	}
 
+	for (auto& lib : data.materialLibs) {
+		std::string temp = base_dir(filename) + lib;
+		LogCatFmt(logcat::loader, Debug, " > using material {}", temp);
+		auto mats = load_materials(temp);
+		materials.insert(mats.begin(), mats.end());
+	}
+
 	sceneModel::ptr ret = ecs->construct<sceneModel>();
+	ret->haveNormals   = data.haveNormals;
+	ret->haveTexcoords = data.haveTexcoords;
 
 	auto  vertBuf = ret->attach<ecs::bufferComponent<sceneModel::vertex>>();
 	auto& verts   = vertBuf->data;
 
-	// TODO: split this into a seperate parse function
-	while (std::getline(input, line)) {
-		eraseChars(line, "\r");
-		auto statement = split_string(line);
-
-		if (statement.size() < 2)
-			continue;
-
-		if (statement[0] == "o") {
-			LogFmt(" > have submesh {}", statement[1]);
-
-			// TODO: should current_mesh just be defined at the top
-			//       of this loop?
-			mesh_name = statement[1];
-			current_mesh_name = mesh_name + ":(null)";
-			current_mesh = ecs->construct<sceneMesh>();
-
-			auto faceBuf = current_mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>();
-			curFaces = &faceBuf->data;
-			//setNode(current_mesh_name, ret, current_mesh);
-		}
-
-		else if (statement[0] == "mtllib") {
-			std::string temp = base_dir(filename) + statement[1];
-			LogFmt(" > using material {}", temp);
-			auto mats = load_materials(ret, temp);
-			materials.insert(mats.begin(), mats.end());
-		}
-
-		else if (statement[0] == "usemtl") {
-			LogFmt(" > using material {}", statement[1]);
-			current_mesh = ecs->construct<sceneMesh>();
-
-			auto faceBuf = current_mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>();
-			curFaces = &faceBuf->data;
-
-			if (auto mat = materials[statement[1]]) {
-				current_mesh->attach<ecs::materialComponent>(*mat.get());
-			}
-
-			current_mesh_name = mesh_name + ":" + statement[1];
-			current_mesh_name += ":" + std::to_string(matMeshCount[statement[1]]++);
+	verts.reserve(data.vertices.size());
+	for (auto& v : data.vertices) {
+		verts.push_back((sceneModel::vertex) {
+			.position = v.position,
+			.normal   = v.normal,
+			.color    = glm::vec3(1, 1, 1),
+			.uv       = v.uv,
+		});
+	}
 
-			setNode(current_mesh_name, ret, current_mesh);
-		}
+	static_assert(std::is_same_v<sceneMesh::faceType, uint32_t>,
+	              "objData indices are moved directly into face buffers");
 
-		else if (statement[0] == "v") {
-			glm::vec3 v = glm::vec3(std::stof(statement[1]),
-			                        std::stof(statement[2]),
-			                        std::stof(statement[3]));
-			vertbuf.push_back(v);
-		}
+	for (auto& group : data.groups) {
+		std::string matName = group.material.empty()? "(null)" : group.material;
+		sceneMesh::ptr mesh = ecs->construct<sceneMesh>();
 
-		else if (statement[0] == "f") {
-			std::size_t end = statement.size();
-
-			// TODO: XXX: we should be checking for buffer ranges here
-			auto load_face_tri = [&] (std::string& statement) {
-				glm::vec3 position(0);
-				glm::vec3 normal(0);
-				glm::vec2 texcoord(0);
-
-				auto spec = split_string(statement, '/');
-				unsigned vert_index = std::stoi(spec[0]) - 1;
-
-				position = vertbuf[vert_index];
-				//ret->vertices.push_back(vertbuf[vert_index]);
-
-				if (ret->haveTexcoords && spec.size() > 1 && !spec[1].empty()) {
-					unsigned buf_index = std::stoi(spec[1]) - 1;
-					//ret->texcoords.push_back(texbuf[buf_index]);
-					texcoord = texbuf[buf_index];
-				}
-
-				if (ret->haveNormals && spec.size() > 2 && !spec[2].empty()) {
-					//ret->normals.push_back(normbuf[std::stoi(spec[2]) - 1]);
-					normal = normbuf[std::stoi(spec[2]) - 1];
-				}
-
-				verts.push_back((sceneModel::vertex) {
-					.position = position,
-					.normal   = normal,
-					.color    = glm::vec3(1, 1, 1),
-					.uv       = texcoord,
-				});
-
-				if (!curFaces) {
-					LogError("Don't have index buffer! This shouldn't happen!");
-
-				} else {
-					curFaces->push_back(verts.size() - 1);
-				}
-			};
-
-			for (std::size_t cur = 1; cur + 2 < end; cur++) {
-				load_face_tri(statement[1]);
-
-				for (unsigned k = 1; k < 3; k++) {
-					load_face_tri(statement[cur + k]);
-				}
-			}
-		}
+		auto faceBuf  = mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>();
+		faceBuf->data = std::move(group.indices);
 
-		else if (statement[0] == "vn") {
-			glm::vec3 v = glm::vec3(std::stof(statement[1]),
-			                        std::stof(statement[2]),
-			                        std::stof(statement[3]));
-			//normals.push_back(glm::normalize(v));
-			normbuf.push_back(v);
-			ret->haveNormals = true;
+		auto it = materials.find(group.material);
+		if (it != materials.end() && it->second) {
+			mesh->attach<ecs::materialComponent>(*it->second.get());
 		}
 
-		else if (statement[0] == "vt") {
-			texbuf.push_back({std::stof(statement[1]), std::stof(statement[2])});
-			ret->haveTexcoords = true;
-		}
+		std::string meshName = group.object + ":" + matName
+			+ ":" + std::to_string(matMeshCount[matName]++);
 
+		setNode(meshName, ret, mesh);
 	}
 
 	for (auto ptr : ret->nodes()) {
-		LogFmt(" > > have mesh node {}", (*ptr)->name);
+		LogCatFmt(logcat::loader, Debug, " > > have mesh node {}", (*ptr)->name);
 	}
 
 	// TODO: check that normals size == vertices size and fill in the difference
@@ -195,15 +112,22 @@ sceneModel::ptr load_object(std::string filename) {
 	ret->genTangents();
 	ret->genAABBs();
 
+	if (meshOptimizeEnabled()) {
+		ret->optimizeMeshes();
+	}
+
+	// built after optimizing, since that reorders indices
+	ret->buildBVHs();
+
 	return ret;
 }
 
 std::map<std::string, material::ptr>
-load_materials(sceneModel::ptr model, std::string filename) {
+load_materials(std::string filename) {
+	GREND_PROFILE_FUNCTION();
+
 	std::map<std::string, material::ptr> ret;
-	std::ifstream input(filename);
-	std::string current_material = "default";
-	std::string line;
+	mappedFile input(filename);
 
 	if (!input.good()) {
 		// TODO: exception
@@ -211,115 +135,80 @@ load_materials(sceneModel::ptr model, std::string filename) {
 		return ret;
 	}
 
-	// TODO: add flag to textureData to flip images
-	//stbi_set_flip_vertically_on_load(true);
-	const bool flipVertically = true;
-
-	while (std::getline(input, line)) {
-		eraseChars(line, "\r");
-		auto statement = split_string(line);
+	std::vector<mtlMaterial> parsed;
+	parseMtl(input.view(), parsed);
 
-		if (statement.size() < 2) {
-			continue;
-		}
-
-		if (statement[0] == "newmtl") {
-			LogFmt("   - new material: {}", statement[1]);
-			current_material = statement[1];
-			ret[current_material] = std::make_shared<material>();
-		}
-
-		else if (statement[0] == "Ka") {
-			ret[current_material]->factors.ambient =
-				glm::vec4(std::stof(statement[1]),
-			              std::stof(statement[2]),
-			              std::stof(statement[3]), 1);
-		}
+	// textures are decoded in parallel once everything is parsed, maps
+	// shared between materials are only loaded once
+	std::map<std::string, std::vector<textureData::ptr*>> textures;
 
-		else if (statement[0] == "Kd") {
-			ret[current_material]->factors.diffuse =
-				glm::vec4(std::stof(statement[1]),
-			              std::stof(statement[2]),
-			              std::stof(statement[3]), 1);
+	auto addTexture = [&] (textureData::ptr& slot, const std::string& name) {
+		if (!name.empty()) {
+			textures[base_dir(filename) + name].push_back(&slot);
 		}
+	};
 
-		else if (statement[0] == "Ks") {
-			ret[current_material]->factors.specular =
-				glm::vec4(std::stof(statement[1]),
-			             std::stof(statement[2]),
-			             std::stof(statement[3]), 1);
-		}
+	for (auto& mtl : parsed) {
+		LogCatFmt(logcat::loader, Debug, "   - new material: {}", mtl.name);
+		auto mat = ret[mtl.name] = std::make_shared<material>();
 
-		else if (statement[0] == "d") {
-			ret[current_material]->factors.opacity
-				= std::stof(statement[1]);
-		}
+		if (mtl.ambient)  mat->factors.ambient  = *mtl.ambient;
+		if (mtl.diffuse)  mat->factors.diffuse  = *mtl.diffuse;
+		if (mtl.specular) mat->factors.specular = *mtl.specular;
+		if (mtl.opacity)  mat->factors.opacity  = *mtl.opacity;
 
-		else if (statement[0] == "Ns") {
-			ret[current_material]->factors.roughness =
-				1.f - std::stof(statement[1])/1000.f;
+		if (mtl.specularExponent) {
+			mat->factors.roughness = 1.f - *mtl.specularExponent/1000.f;
 		}
 
-		else if (statement[0] == "illum") {
-			unsigned illumination_model = std::stoi(statement[1]);
-
-			switch (illumination_model) {
+		if (mtl.illum) {
+			switch (*mtl.illum) {
 				/*
 				case 4:
 				case 6:
 				case 7:
 				case 9:
-					ret[current_material]->factors.blend
-						= material::blend_mode::Blend;
+					mat->factors.blend = material::blend_mode::Blend;
 					break;
 					*/
 
 				default:
-					ret[current_material]->factors.blend
-						= material::blend_mode::Opaque;
+					mat->factors.blend = material::blend_mode::Opaque;
 					break;
 			}
 		}
 
-		else if (statement[0] == "map_Kd") {
-			ret[current_material]->maps.diffuse =
-				std::make_shared<textureData>(base_dir(filename) + statement[1], flipVertically);
-		}
+		addTexture(mat->maps.diffuse,          mtl.diffuseMap);
+		// specular map
+		addTexture(mat->maps.metalRoughness,   mtl.specularMap);
+		addTexture(mat->maps.ambientOcclusion, mtl.ambientOcclusionMap);
+		addTexture(mat->maps.normal,           mtl.normalMap);
+	}
 
-		else if (statement[0] == "map_Ns") {
-			// specular map
-			ret[current_material]->maps.metalRoughness =
-				std::make_shared<textureData>(base_dir(filename) + statement[1], flipVertically);
-		}
+	std::vector<std::pair<const std::string*, const std::vector<textureData::ptr*>*>> jobs;
+	for (auto& [path, slots] : textures) {
+		jobs.push_back({&path, &slots});
+	}
 
-		else if (statement[0] == "map_ao") {
-			// ambient occlusion map (my own extension)
-			ret[current_material]->maps.ambientOcclusion =
-				std::make_shared<textureData>(base_dir(filename) + statement[1], flipVertically);
-		}
+	parallelFor(jobs.size(), [&] (size_t i) {
+		auto& [path, slots] = jobs[i];
+		textureData::ptr tex;
 
-		else if (statement[0] == "map_norm" || statement[0] == "norm") {
-			// normal map (also non-standard)
-			ret[current_material]->maps.normal =
-				std::make_shared<textureData>(base_dir(filename) + statement[1], flipVertically);
-		}
+		try {
+			tex = textureFiles().load(*path, flipVertically);
 
-		else if (statement[0] == "map_bump") {
-			// bump/height map
+		} catch (std::exception& e) {
+			// one missing texture shouldn't fail the whole model
+			LogCatFmt(logcat::loader, Error, " ! couldn't load texture {}: {}",
+			          *path, e.what());
+			return;
 		}
 
-		/*
-		else if (statement[0] == "Ke" || statement[0] == "map_Ke") {
-			model->materials[current_material].emissiveMap.
-				load_texture(base_dir(filename) + statement[1]);
+		for (auto slot : *slots) {
+			*slot = tex;
 		}
-		*/
-
-		// TODO: other light maps, attributes
-	}
+	});
 
-	// TODO: remove
-	// stbi_set_flip_vertically_on_load(false);
 	return ret;
 }
 
@@ -0,0 +1,618 @@
+#include <grend/objParser.hpp>
+#include <grend/mappedFile.hpp>
+#include <grend/utility.hpp>
+#include <grend/logger.hpp>
+#include <grend/profile.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <thread>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace grendx;
+
+namespace {
+
+// tokenizes one line in place, nothing here allocates
+struct lineCursor {
+	const char *p;
+	const char *end;
+
+	void skipSpace(void) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+			p++;
+		}
+	}
+
+	std::string_view token(void) {
+		skipSpace();
+		const char *start = p;
+
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\r') {
+			p++;
+		}
+
+		return {start, size_t(p - start)};
+	}
+
+	// last token on the line, texture statements can have options before
+	// the filename
+	std::string_view lastToken(void) {
+		std::string_view ret;
+
+		for (auto tok = token(); !tok.empty(); tok = token()) {
+			ret = tok;
+		}
+
+		return ret;
+	}
+
+	bool number(float& out) {
+		skipSpace();
+
+		if (p < end && *p == '+') {
+			p++;
+		}
+
+#if defined(__cpp_lib_to_chars)
+		auto [ptr, ec] = std::from_chars(p, end, out);
+		if (ec != std::errc()) {
+			return false;
+		}
+
+		p = ptr;
+		return true;
+
+#else
+		// no floating point from_chars, strtof needs a terminated string
+		char buf[64];
+		size_t len = std::min<size_t>(end - p, sizeof(buf) - 1);
+		memcpy(buf, p, len);
+		buf[len] = '\0';
+
+		char *last;
+		out = strtof(buf, &last);
+		p += last - buf;
+		return last != buf;
+#endif
+	}
+
+	bool number(int& out) {
+		skipSpace();
+
+		if (p < end && *p == '+') {
+			p++;
+		}
+
+		auto [ptr, ec] = std::from_chars(p, end, out);
+		if (ec != std::errc()) {
+			return false;
+		}
+
+		p = ptr;
+		return true;
+	}
+
+	template <int N>
+	bool vec(glm::vec<N, float, glm::defaultp>& out) {
+		for (int i = 0; i < N; i++) {
+			if (!number(out[i])) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+};
+
+template <typename F>
+static inline void forEachLine(std::string_view source, F&& fn) {
+	const char *p   = source.data();
+	const char *end = p + source.size();
+
+	while (p < end) {
+		const char *nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char *lineEnd = nl? nl : end;
+
+		fn(lineCursor {p, lineEnd});
+		p = lineEnd + 1;
+	}
+}
+
+enum : int32_t { noIndex = INT32_MIN };
+
+struct objCorner {
+	enum { Position, Texcoord, Normal };
+	// zero-based, noIndex if not given
+	int32_t index[3];
+
+	bool operator==(const objCorner& other) const {
+		return index[0] == other.index[0]
+		    && index[1] == other.index[1]
+		    && index[2] == other.index[2];
+	}
+};
+
+struct objCommand {
+	enum { Object, Material, Library } type;
+	// first corner after the statement
+	size_t corner;
+	// points into the source
+	std::string_view name;
+};
+
+// results for one line-aligned slice of the file, indices are absolute
+// except for negative (relative) indices, which can only be resolved once
+// the number of elements in previous chunks is known
+struct objChunk {
+	std::string_view source;
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texcoords;
+
+	// triangulated, three per triangle
+	std::vector<objCorner> corners;
+	// (corner, bitmask of relative index components)
+	std::vector<std::pair<size_t, uint8_t>> relative;
+	std::vector<objCommand> commands;
+
+	size_t badLines = 0;
+};
+
+// open addressing map from corners to vertex indices, much cheaper than
+// std::unordered_map for the millions of small keys in large meshes
+class cornerMap {
+	public:
+		cornerMap(size_t expected) {
+			size_t cap = 16;
+			while (cap < expected) cap <<= 1;
+			slots.resize(cap);
+		}
+
+		// returns the vertex for c, or stores and returns next if it's new
+		uint32_t findOrInsert(const objCorner& c, uint32_t next) {
+			if ((count + 1) * 10 > slots.size() * 7) {
+				grow();
+			}
+
+			size_t mask = slots.size() - 1;
+
+			for (size_t i = hash(c) & mask;; i = (i + 1) & mask) {
+				auto& s = slots[i];
+
+				if (s.vertex == empty) {
+					s = {c, next};
+					count++;
+					return next;
+				}
+
+				if (s.key == c) {
+					return s.vertex;
+				}
+			}
+		}
+
+	private:
+		enum : uint32_t { empty = UINT32_MAX };
+
+		struct slot {
+			objCorner key;
+			uint32_t vertex = empty;
+		};
+
+		static size_t hash(const objCorner& c) {
+			uint64_t h = uint32_t(c.index[0]) * 0x9e3779b97f4a7c15ull;
+			h ^= uint32_t(c.index[1]) * 0xc2b2ae3d27d4eb4full + (h << 6) + (h >> 2);
+			h ^= uint32_t(c.index[2]) * 0x165667b19e3779f9ull + (h << 6) + (h >> 2);
+			return h ^ (h >> 29);
+		}
+
+		void grow(void) {
+			std::vector<slot> old(slots.size() * 2);
+			std::swap(old, slots);
+			size_t mask = slots.size() - 1;
+
+			for (auto& s : old) {
+				if (s.vertex == empty) continue;
+
+				size_t i = hash(s.key) & mask;
+				while (slots[i].vertex != empty) {
+					i = (i + 1) & mask;
+				}
+
+				slots[i] = s;
+			}
+		}
+
+		std::vector<slot> slots;
+		size_t count = 0;
+};
+
+}
+
+static bool parseCorner(std::string_view tok, const objChunk& chunk,
+                        objCorner& out, uint8_t& relative)
+{
+	const char *p = tok.data();
+	const char *end = p + tok.size();
+	const size_t counts[3] = {
+		chunk.positions.size(),
+		chunk.texcoords.size(),
+		chunk.normals.size(),
+	};
+
+	out = {{noIndex, noIndex, noIndex}};
+	relative = 0;
+
+	// v, v/vt, v//vn, v/vt/vn
+	for (int k = 0; k < 3; k++) {
+		if (p < end && *p != '/') {
+			int idx;
+			auto [ptr, ec] = std::from_chars(p, end, idx);
+
+			if (ec != std::errc() || idx == 0) {
+				return false;
+			}
+
+			if (idx > 0) {
+				out.index[k] = idx - 1;
+			} else {
+				out.index[k] = int32_t(counts[k]) + idx;
+				relative |= 1 << k;
+			}
+
+			p = ptr;
+		}
+
+		if (p < end && *p == '/') {
+			p++;
+		} else {
+			break;
+		}
+	}
+
+	return p == end && out.index[objCorner::Position] != noIndex;
+}
+
+static void parseChunk(objChunk& chunk) {
+	std::vector<objCorner> face;
+	std::vector<uint8_t> faceRelative;
+
+	forEachLine(chunk.source, [&] (lineCursor line) {
+		std::string_view op = line.token();
+
+		if (op == "v") {
+			// still added if malformed, to keep the numbering intact
+			auto& v = chunk.positions.emplace_back(0);
+			chunk.badLines += !line.vec(v);
+
+		} else if (op == "vt") {
+			auto& v = chunk.texcoords.emplace_back(0);
+			chunk.badLines += !line.vec(v);
+
+		} else if (op == "vn") {
+			auto& v = chunk.normals.emplace_back(0);
+			chunk.badLines += !line.vec(v);
+
+		} else if (op == "f") {
+			face.clear();
+			faceRelative.clear();
+
+			for (auto tok = line.token(); !tok.empty(); tok = line.token()) {
+				objCorner c;
+				uint8_t rel;
+
+				if (!parseCorner(tok, chunk, c, rel)) {
+					chunk.badLines++;
+					return;
+				}
+
+				face.push_back(c);
+				faceRelative.push_back(rel);
+			}
+
+			// triangle fan
+			for (size_t i = 1; i + 1 < face.size(); i++) {
+				for (size_t k : {size_t(0), i, i + 1}) {
+					if (faceRelative[k]) {
+						chunk.relative.push_back({chunk.corners.size(), faceRelative[k]});
+					}
+
+					chunk.corners.push_back(face[k]);
+				}
+			}
+
+		} else if (op == "o" || op == "usemtl") {
+			auto name = line.token();
+
+			if (!name.empty()) {
+				chunk.commands.push_back({
+					(op == "o")? objCommand::Object : objCommand::Material,
+					chunk.corners.size(),
+					name,
+				});
+			}
+
+		} else if (op == "mtllib") {
+			for (auto name = line.token(); !name.empty(); name = line.token()) {
+				chunk.commands.push_back({objCommand::Library, chunk.corners.size(), name});
+			}
+		}
+
+		// anything else (comments, groups, smoothing, lines) is ignored
+	});
+}
+
+bool grendx::parseObj(std::string_view source, objData& out, unsigned maxThreads) {
+	GREND_PROFILE_FUNCTION();
+
+	// chunks should be big enough that starting threads doesn't dominate
+	constexpr size_t minChunkSize = 256*1024;
+
+	out = objData();
+	unsigned threads = maxThreads? maxThreads : std::max(1u, std::thread::hardware_concurrency());
+	size_t numChunks = std::clamp<size_t>(source.size() / minChunkSize, 1, threads);
+	std::vector<objChunk> chunks(numChunks);
+
+	for (size_t i = 0, start = 0; i < numChunks; i++) {
+		size_t end = source.size();
+
+		if (i + 1 < numChunks) {
+			// move boundaries up to the start of the next line
+			end = std::max(start, source.size() * (i + 1) / numChunks);
+			size_t nl = source.find('\n', end);
+			end = (nl == std::string_view::npos)? source.size() : nl + 1;
+		}
+
+		chunks[i].source = source.substr(start, end - start);
+		start = end;
+	}
+
+	parallelFor(numChunks, [&] (size_t i) { parseChunk(chunks[i]); }, threads);
+
+	// merge element lists, resolving relative indices
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texcoords;
+	size_t badLines = 0;
+
+	for (auto& chunk : chunks) {
+		const int32_t base[3] = {
+			int32_t(positions.size()),
+			int32_t(texcoords.size()),
+			int32_t(normals.size()),
+		};
+
+		for (auto& [c, rel] : chunk.relative) {
+			for (int k = 0; k < 3; k++) {
+				if (rel & (1 << k)) {
+					chunk.corners[c].index[k] += base[k];
+				}
+			}
+		}
+
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+		texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+		badLines += chunk.badLines;
+	}
+
+	out.haveNormals   = !normals.empty();
+	out.haveTexcoords = !texcoords.empty();
+
+	// split corners into groups at "o"/"usemtl" statements
+	struct span {
+		const objChunk *chunk;
+		size_t begin;
+		size_t end;
+	};
+
+	struct pendingGroup {
+		std::string_view object;
+		std::string_view material;
+		std::vector<span> spans;
+		size_t corners = 0;
+	};
+
+	std::vector<pendingGroup> groups;
+	std::string_view object = "default";
+
+	auto startGroup = [&] (std::string_view material) {
+		auto& g    = groups.emplace_back();
+		g.object   = object;
+		g.material = material;
+	};
+
+	auto addSpan = [&] (const objChunk& chunk, size_t begin, size_t end) {
+		if (begin == end) return;
+
+		if (groups.empty()) {
+			startGroup({});
+		}
+
+		groups.back().spans.push_back({&chunk, begin, end});
+		groups.back().corners += end - begin;
+	};
+
+	for (auto& chunk : chunks) {
+		size_t pos = 0;
+
+		for (auto& cmd : chunk.commands) {
+			addSpan(chunk, pos, cmd.corner);
+			pos = cmd.corner;
+
+			switch (cmd.type) {
+				case objCommand::Object:
+					object = cmd.name;
+					startGroup({});
+					break;
+
+				case objCommand::Material:
+					startGroup(cmd.name);
+					break;
+
+				case objCommand::Library:
+					out.materialLibs.emplace_back(cmd.name);
+					break;
+			}
+		}
+
+		addSpan(chunk, pos, chunk.corners.size());
+	}
+
+	// build vertices for each group in parallel, then concatenate
+	std::vector<std::vector<objData::vertex>> groupVerts(groups.size());
+	std::atomic<size_t> badIndices = 0;
+	out.groups.resize(groups.size());
+
+	parallelFor(groups.size(), [&] (size_t i) {
+		auto& src   = groups[i];
+		auto& dst   = out.groups[i];
+		auto& verts = groupVerts[i];
+		// each corner gets a vertex without normals, see objData
+		cornerMap vertexMap(out.haveNormals? src.corners / 2 : 0);
+		size_t bad = 0;
+
+		dst.object   = src.object;
+		dst.material = src.material;
+		dst.indices.reserve(src.corners);
+
+		auto inRange = [] (int32_t idx, size_t size) {
+			return idx >= 0 && size_t(idx) < size;
+		};
+
+		for (auto& s : src.spans) {
+			for (size_t c = s.begin; c + 3 <= s.end; c += 3) {
+				const objCorner *tri = &s.chunk->corners[c];
+
+				if (!inRange(tri[0].index[objCorner::Position], positions.size())
+				 || !inRange(tri[1].index[objCorner::Position], positions.size())
+				 || !inRange(tri[2].index[objCorner::Position], positions.size()))
+				{
+					bad++;
+					continue;
+				}
+
+				for (int k = 0; k < 3; k++) {
+					objCorner corner = tri[k];
+					int32_t& vt = corner.index[objCorner::Texcoord];
+					int32_t& vn = corner.index[objCorner::Normal];
+
+					// missing/invalid texcoords and normals are zeroed
+					if (vt != noIndex && !inRange(vt, texcoords.size())) { vt = noIndex; bad++; }
+					if (vn != noIndex && !inRange(vn, normals.size()))   { vn = noIndex; bad++; }
+
+					uint32_t next = verts.size();
+					uint32_t idx  = out.haveNormals? vertexMap.findOrInsert(corner, next) : next;
+
+					if (idx == next) {
+						verts.push_back({
+							.position = positions[corner.index[objCorner::Position]],
+							.normal   = (vn != noIndex)? normals[vn]   : glm::vec3(0),
+							.uv       = (vt != noIndex)? texcoords[vt] : glm::vec2(0),
+						});
+					}
+
+					dst.indices.push_back(idx);
+				}
+			}
+		}
+
+		badIndices += bad;
+	}, threads);
+
+	size_t totalVerts = 0;
+	for (auto& verts : groupVerts) {
+		totalVerts += verts.size();
+	}
+
+	out.vertices.reserve(totalVerts);
+
+	for (size_t i = 0; i < groups.size(); i++) {
+		uint32_t offset = out.vertices.size();
+
+		for (auto& idx : out.groups[i].indices) {
+			idx += offset;
+		}
+
+		out.vertices.insert(out.vertices.end(), groupVerts[i].begin(), groupVerts[i].end());
+	}
+
+	// "o"/"usemtl" without any faces following
+	out.groups.erase(std::remove_if(out.groups.begin(), out.groups.end(),
+	                                [] (auto& g) { return g.indices.empty(); }),
+	                 out.groups.end());
+
+	if (badLines || badIndices) {
+		LogCatFmt(logcat::loader, Warning,
+		          " ! skipped {} malformed statements and {} invalid indices",
+		          badLines, badIndices.load());
+	}
+
+	return !positions.empty() || !out.materialLibs.empty();
+}
+
+bool grendx::parseObjFile(const std::string& path, objData& out, unsigned maxThreads) {
+	mappedFile file(path);
+
+	if (!file.good()) {
+		return false;
+	}
+
+	return parseObj(file.view(), out, maxThreads);
+}
+
+void grendx::parseMtl(std::string_view source, std::vector<mtlMaterial>& out) {
+	auto current = [&] () -> mtlMaterial& {
+		// statements before any newmtl go to a default material
+		if (out.empty()) {
+			out.emplace_back().name = "default";
+		}
+
+		return out.back();
+	};
+
+	forEachLine(source, [&] (lineCursor line) {
+		std::string_view op = line.token();
+		glm::vec3 v;
+		float f;
+		int i;
+
+		if (op == "newmtl") {
+			if (auto name = line.token(); !name.empty()) {
+				out.emplace_back().name = name;
+			}
+		}
+
+		else if (op == "Ka" && line.vec(v)) current().ambient  = glm::vec4(v, 1);
+		else if (op == "Kd" && line.vec(v)) current().diffuse  = glm::vec4(v, 1);
+		else if (op == "Ks" && line.vec(v)) current().specular = glm::vec4(v, 1);
+		else if (op == "d"  && line.number(f)) current().opacity = f;
+		else if (op == "Ns" && line.number(f)) current().specularExponent = f;
+		else if (op == "illum" && line.number(i)) current().illum = i;
+
+		else if (op == "map_Kd") {
+			current().diffuseMap = line.lastToken();
+		}
+
+		else if (op == "map_Ns") {
+			// specular map
+			current().specularMap = line.lastToken();
+		}
+
+		else if (op == "map_ao") {
+			// ambient occlusion map (my own extension)
+			current().ambientOcclusionMap = line.lastToken();
+		}
+
+		else if (op == "map_norm" || op == "norm") {
+			// normal map (also non-standard)
+			current().normalMap = line.lastToken();
+		}
+
+		// TODO: bump/height maps, emissive, other light maps
+	});
+}
@@ -0,0 +1,353 @@
+#include <grend/occlusionBuffer.hpp>
+#include <grend/jobQueue.hpp>
+
+#include <algorithm>
+#include <math.h>
+
+using namespace grendx;
+
+// rows per band, bands are the unit of work when rasterizing in parallel
+enum { bandHeight = 8 };
+
+static inline glm::vec4 toClip(const glm::mat4& m, const float *p) {
+	// written out rather than m * vec4(p, 1), this is the hot loop when
+	// adding large occluders
+	return glm::vec4(
+		m[0][0]*p[0] + m[1][0]*p[1] + m[2][0]*p[2] + m[3][0],
+		m[0][1]*p[0] + m[1][1]*p[1] + m[2][1]*p[2] + m[3][1],
+		m[0][2]*p[0] + m[1][2]*p[1] + m[2][2]*p[2] + m[3][2],
+		m[0][3]*p[0] + m[1][3]*p[1] + m[2][3]*p[2] + m[3][3]);
+}
+
+// signed distance to the near plane (z = -w in GL clip space)
+static inline float nearDist(const glm::vec4& v) {
+	return v.z + v.w;
+}
+
+occlusionBuffer::occlusionBuffer(unsigned width, unsigned height) {
+	resize(width, height);
+}
+
+void occlusionBuffer::resize(unsigned width, unsigned height) {
+	w = std::max(1u, width);
+	h = std::max(1u, height);
+
+	levels.clear();
+	levelSizes.clear();
+
+	unsigned lw = w, lh = h;
+	while (true) {
+		levels.emplace_back(lw * lh, 1.f);
+		levelSizes.push_back({lw, lh});
+
+		if (lw == 1 && lh == 1) {
+			break;
+		}
+
+		lw = (lw + 1) / 2;
+		lh = (lh + 1) / 2;
+	}
+
+	bands.resize((h + bandHeight - 1) / bandHeight);
+	clear();
+}
+
+void occlusionBuffer::clear(void) {
+	for (auto& level : levels) {
+		std::fill(level.begin(), level.end(), 1.f);
+	}
+
+	for (auto& band : bands) {
+		band.clear();
+	}
+
+	tris.clear();
+}
+
+void occlusionBuffer::addOccluder(const glm::mat4& mvp,
+                                  const float *positions, size_t stride, size_t vertexCount,
+                                  const uint32_t *indices, size_t indexCount)
+{
+	clipVerts.resize(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++) {
+		const float *p = reinterpret_cast<const float*>(
+			reinterpret_cast<const uint8_t*>(positions) + i*stride);
+		clipVerts[i] = toClip(mvp, p);
+	}
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		if (indices[i] >= vertexCount
+		 || indices[i+1] >= vertexCount
+		 || indices[i+2] >= vertexCount)
+		{
+			continue;
+		}
+
+		glm::vec4 tri[3] = {
+			clipVerts[indices[i]],
+			clipVerts[indices[i+1]],
+			clipVerts[indices[i+2]],
+		};
+
+		float d[3] = { nearDist(tri[0]), nearDist(tri[1]), nearDist(tri[2]) };
+		unsigned inside = (d[0] >= 0) + (d[1] >= 0) + (d[2] >= 0);
+
+		if (inside == 0) {
+			continue;
+
+		} else if (inside == 3) {
+			addClipTriangle(tri);
+			continue;
+		}
+
+		// clip against the near plane, gives a triangle or a quad
+		glm::vec4 poly[4];
+		unsigned n = 0;
+
+		for (unsigned k = 0; k < 3; k++) {
+			unsigned j = (k + 1) % 3;
+
+			if (d[k] >= 0) {
+				poly[n++] = tri[k];
+			}
+
+			if ((d[k] >= 0) != (d[j] >= 0)) {
+				float t = d[k] / (d[k] - d[j]);
+				poly[n++] = tri[k] + (tri[j] - tri[k])*t;
+			}
+		}
+
+		addClipTriangle(poly);
+		if (n == 4) {
+			glm::vec4 second[3] = { poly[0], poly[2], poly[3] };
+			addClipTriangle(second);
+		}
+	}
+}
+
+void occlusionBuffer::addClipTriangle(const glm::vec4 *clip) {
+	screenTri tri;
+
+	for (unsigned k = 0; k < 3; k++) {
+		float invW = 1.f / std::max(clip[k].w, 1e-6f);
+		tri.x[k] = (clip[k].x*invW*0.5f + 0.5f) * w;
+		tri.y[k] = (clip[k].y*invW*0.5f + 0.5f) * h;
+		tri.z[k] = clip[k].z*invW*0.5f + 0.5f;
+	}
+
+	float area = (tri.x[1] - tri.x[0])*(tri.y[2] - tri.y[0])
+	           - (tri.x[2] - tri.x[0])*(tri.y[1] - tri.y[0]);
+
+	// degenerate or smaller than a sample
+	if (fabsf(area) < 1e-6f) {
+		return;
+	}
+
+	float miny = std::min({tri.y[0], tri.y[1], tri.y[2]});
+	float maxy = std::max({tri.y[0], tri.y[1], tri.y[2]});
+	float minx = std::min({tri.x[0], tri.x[1], tri.x[2]});
+	float maxx = std::max({tri.x[0], tri.x[1], tri.x[2]});
+
+	if (maxy < 0 || miny >= h || maxx < 0 || minx >= w) {
+		return;
+	}
+
+	// winding doesn't matter for occlusion, normalize to one so that
+	// rasterizing only needs to check for positive edge functions
+	if (area < 0) {
+		std::swap(tri.x[1], tri.x[2]);
+		std::swap(tri.y[1], tri.y[2]);
+		std::swap(tri.z[1], tri.z[2]);
+	}
+
+	uint32_t idx = tris.size();
+	tris.push_back(tri);
+
+	int firstBand = std::max(0, int(miny) / bandHeight);
+	int lastBand  = std::min(int(bands.size()) - 1, int(maxy) / bandHeight);
+
+	for (int b = firstBand; b <= lastBand; b++) {
+		bands[b].push_back(idx);
+	}
+}
+
+void occlusionBuffer::rasterizeBand(unsigned band) {
+	std::vector<float>& depth = levels[0];
+	int bandStart = band * bandHeight;
+	int bandEnd   = std::min<int>(bandStart + bandHeight, h);
+
+	for (uint32_t idx : bands[band]) {
+		const screenTri& t = tris[idx];
+
+		// edge functions, positive inside (counter-clockwise after the
+		// winding fixup in addClipTriangle())
+		float ea[3], eb[3], ec[3];
+		for (unsigned k = 0; k < 3; k++) {
+			unsigned j = (k + 1) % 3;
+			ea[k] = t.y[k] - t.y[j];
+			eb[k] = t.x[j] - t.x[k];
+			ec[k] = t.x[k]*t.y[j] - t.x[j]*t.y[k];
+		}
+
+		// depth plane, z(x, y) = za*x + zb*y + zc
+		float area = ec[0] + ec[1] + ec[2];
+		float invArea = 1.f / area;
+		float za = (ea[0]*t.z[2] + ea[1]*t.z[0] + ea[2]*t.z[1]) * invArea;
+		float zb = (eb[0]*t.z[2] + eb[1]*t.z[0] + eb[2]*t.z[1]) * invArea;
+		float zc = (ec[0]*t.z[2] + ec[1]*t.z[0] + ec[2]*t.z[1]) * invArea;
+
+		int x0 = std::max(0, int(floorf(std::min({t.x[0], t.x[1], t.x[2]}))));
+		int x1 = std::min(int(w) - 1, int(ceilf(std::max({t.x[0], t.x[1], t.x[2]}))));
+		int y0 = std::max(bandStart, int(floorf(std::min({t.y[0], t.y[1], t.y[2]}))));
+		int y1 = std::min(bandEnd - 1, int(ceilf(std::max({t.y[0], t.y[1], t.y[2]}))));
+
+		// edge values at the first sample of the bounding box, stepped
+		// per row, and reciprocals to solve for the span on each row
+		float e[3], inv[3];
+		for (unsigned k = 0; k < 3; k++) {
+			e[k]   = ea[k]*(x0 + 0.5f) + eb[k]*(y0 + 0.5f) + ec[k];
+			inv[k] = (ea[k] != 0)? -1.f / ea[k] : 0.f;
+		}
+
+		for (int y = y0; y <= y1; y++, e[0] += eb[0], e[1] += eb[1], e[2] += eb[2]) {
+			float sy = y + 0.5f;
+			float *row = depth.data() + y*w;
+
+			// solving each edge function for the covered span on this row
+			// leaves a plain min() loop that the compiler can vectorize
+			float lo = 0, hi = x1 - x0;
+			bool empty = false;
+
+			for (unsigned k = 0; k < 3; k++) {
+				if (ea[k] > 0) {
+					lo = std::max(lo, ceilf(e[k] * inv[k]));
+				} else if (ea[k] < 0) {
+					hi = std::min(hi, floorf(e[k] * inv[k]));
+				} else {
+					empty |= e[k] < 0;
+				}
+			}
+
+			if (empty || lo > hi) {
+				continue;
+			}
+
+			int start = x0 + int(lo), end = x0 + int(hi);
+			float z = za*(start + 0.5f) + zb*sy + zc;
+
+			for (int x = start; x <= end; x++) {
+				float d = std::max(0.f, z + za*(x - start));
+				row[x] = std::min(row[x], d);
+			}
+		}
+	}
+}
+
+void occlusionBuffer::buildPyramid(void) {
+	for (size_t k = 1; k < levels.size(); k++) {
+		auto [pw, ph] = levelSizes[k - 1];
+		auto [lw, lh] = levelSizes[k];
+		const float *src = levels[k - 1].data();
+		float *dest = levels[k].data();
+
+		for (unsigned y = 0; y < lh; y++) {
+			unsigned sy0 = 2*y, sy1 = std::min(2*y + 1, ph - 1);
+
+			for (unsigned x = 0; x < lw; x++) {
+				unsigned sx0 = 2*x, sx1 = std::min(2*x + 1, pw - 1);
+
+				dest[y*lw + x] = std::max(
+					std::max(src[sy0*pw + sx0], src[sy0*pw + sx1]),
+					std::max(src[sy1*pw + sx0], src[sy1*pw + sx1]));
+			}
+		}
+	}
+}
+
+void occlusionBuffer::rasterize(jobQueue *jobs) {
+	if (jobs && tris.size() > 64) {
+		jobs->parallelFor(bands.size(), [&] (size_t band) { rasterizeBand(band); });
+
+	} else {
+		for (unsigned band = 0; band < bands.size(); band++) {
+			rasterizeBand(band);
+		}
+	}
+
+	buildPyramid();
+}
+
+bool occlusionBuffer::testRect(glm::vec2 ndcMin, glm::vec2 ndcMax, float nearestDepth) const {
+	float fx0 = (ndcMin.x*0.5f + 0.5f) * w;
+	float fx1 = (ndcMax.x*0.5f + 0.5f) * w;
+	float fy0 = (ndcMin.y*0.5f + 0.5f) * h;
+	float fy1 = (ndcMax.y*0.5f + 0.5f) * h;
+
+	// off screen, frustum culling's job
+	if (fx1 < 0 || fy1 < 0 || fx0 >= w || fy0 >= h) {
+		return true;
+	}
+
+	int x0 = std::max(0, int(floorf(fx0)));
+	int y0 = std::max(0, int(floorf(fy0)));
+	int x1 = std::min(int(w) - 1, int(floorf(fx1)));
+	int y1 = std::min(int(h) - 1, int(floorf(fy1)));
+
+	// coarsest level where the rect covers at most 4x4 texels
+	unsigned level = 0;
+	while (level + 1 < levels.size()
+	       && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+	{
+		level++;
+	}
+
+	unsigned lw = levelSizes[level].first;
+	const float *depths = levels[level].data();
+
+	for (int y = y0 >> level; y <= (y1 >> level); y++) {
+		for (int x = x0 >> level; x <= (x1 >> level); x++) {
+			if (nearestDepth <= depths[y*lw + x]) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool occlusionBuffer::testAABB(const glm::mat4& mvp, const AABB& box) const {
+	glm::vec2 lo( 1e30f,  1e30f);
+	glm::vec2 hi(-1e30f, -1e30f);
+	float nearest = 1.f;
+
+	for (unsigned i = 0; i < 8; i++) {
+		float p[3] = {
+			(i & 1)? box.max.x : box.min.x,
+			(i & 2)? box.max.y : box.min.y,
+			(i & 4)? box.max.z : box.min.z,
+		};
+
+		glm::vec4 c = toClip(mvp, p);
+
+		// crosses the near plane, assume visible
+		if (nearDist(c) <= 0 || c.w <= 1e-6f) {
+			return true;
+		}
+
+		float invW = 1.f / c.w;
+		float x = c.x*invW, y = c.y*invW;
+		lo = glm::vec2(std::min(lo.x, x), std::min(lo.y, y));
+		hi = glm::vec2(std::max(hi.x, x), std::max(hi.y, y));
+		nearest = std::min(nearest, c.z*invW*0.5f + 0.5f);
+	}
+
+	return testRect(lo, hi, nearest);
+}
+
+occlusionCuller::~occlusionCuller() {};
+
+void occlusionCuller::newFrame(void) {
+	lastFrame = current;
+	current   = {};
+}
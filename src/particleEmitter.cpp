@@ -0,0 +1,201 @@
+#include <grend/ecs/particleEmitter.hpp>
+#include <grend/jobQueue.hpp>
+#include <grend/gameMain.hpp>
+#include <grend/logger.hpp>
+
+using namespace grendx;
+
+particleEmitter::particleEmitter(ecs::regArgs t)
+	: particleEmitter(std::move(t), particleSettings()) {};
+
+particleEmitter::particleEmitter(ecs::regArgs t, const particleSettings& settings)
+	: component(ecs::doRegister(this, t)),
+	  simulation(settings)
+{
+	manager->registerInterface<ecs::updatable>(t.ent, this);
+}
+
+particleEmitter::~particleEmitter() {};
+
+void particleEmitter::update(ecs::entityManager *manager, float delta) {
+	if (paused) {
+		return;
+	}
+
+	ecs::entity *ent = manager->getEntity(this);
+	jobQueue *jobs = engine::Services().tryResolve<jobQueue>();
+
+	auto *node = dynamic_cast<sceneNode*>(ent);
+	glm::mat4 world = node? fullTranslation(sceneNode::ptr(node)) : ent->transform.getMatrix();
+
+	if (followEntity) {
+		position = extractTranslation(world);
+	}
+
+	simulation.step(delta, position, jobs);
+	unsigned count = simulation.count();
+
+	glm::vec3 bmin = simulation.boundsMin();
+	glm::vec3 bmax = simulation.boundsMax();
+	glm::vec3 center = (bmin + bmax) * 0.5f;
+	float radius = glm::length(bmax - center);
+
+	if (auto *billboards = dynamic_cast<sceneBillboardParticles*>(ent)) {
+		if (billboards->maxInstances < count) {
+			billboards->resize(count + count/2);
+		}
+
+		simulation.writeBillboards(billboards->positions.data(),
+		                           billboards->colors.data(), jobs);
+		billboards->activeInstances = count;
+		billboards->center = center;
+		billboards->radius = radius;
+		billboards->update();
+
+	} else if (auto *instances = dynamic_cast<sceneParticles*>(ent)) {
+		if (instances->maxInstances < count) {
+			instances->resize(count + count/2);
+		}
+
+		// instances are drawn relative to the node, the bounds are kept
+		// relative to it too and transformed back when culling
+		glm::mat4 toLocal = glm::inverse(world);
+		float minScale = std::min({glm::length(glm::vec3(world[0])),
+		                           glm::length(glm::vec3(world[1])),
+		                           glm::length(glm::vec3(world[2]))});
+
+		simulation.writeTransforms(instances->positions.data(), toLocal, jobs);
+		instances->activeInstances = count;
+		instances->center = applyTransform(toLocal, center);
+		instances->radius = radius / std::max(minScale, 1e-6f);
+		instances->update();
+	}
+}
+
+static nlohmann::json vecJson(const glm::vec3& v) {
+	return {v.x, v.y, v.z};
+}
+
+static nlohmann::json vecJson(const glm::vec4& v) {
+	return {v.x, v.y, v.z, v.w};
+}
+
+static glm::vec3 jsonVec(const nlohmann::json& j, const glm::vec3& def) {
+	if (!j.is_array() || j.size() != 3) return def;
+	return glm::vec3(j[0], j[1], j[2]);
+}
+
+static glm::vec4 jsonVec(const nlohmann::json& j, const glm::vec4& def) {
+	if (!j.is_array() || j.size() != 4) return def;
+	return glm::vec4(j[0], j[1], j[2], j[3]);
+}
+
+nlohmann::json particleEmitter::serializer(component *comp) {
+	auto *self = static_cast<particleEmitter*>(comp);
+	auto& s = self->simulation.settings;
+
+	nlohmann::json bursts = nlohmann::json::array();
+	nlohmann::json sizeCurve = nlohmann::json::array();
+	nlohmann::json colorCurve = nlohmann::json::array();
+
+	for (auto& b : s.bursts) {
+		bursts.push_back({
+			{"time",     b.time},
+			{"count",    b.count},
+			{"interval", b.interval},
+		});
+	}
+
+	for (auto& [t, v] : s.sizeCurve.keys) {
+		sizeCurve.push_back({t, v});
+	}
+
+	for (auto& [t, v] : s.colorCurve.keys) {
+		colorCurve.push_back({t, vecJson(v)});
+	}
+
+	return {
+		{"spawnRate",    s.spawnRate},
+		{"bursts",       bursts},
+		{"lifetimeMin",  s.lifetimeMin},
+		{"lifetimeMax",  s.lifetimeMax},
+		{"direction",    vecJson(s.direction)},
+		{"spread",       s.spread},
+		{"speedMin",     s.speedMin},
+		{"speedMax",     s.speedMax},
+		{"spawnRadius",  s.spawnRadius},
+		{"sizeMin",      s.sizeMin},
+		{"sizeMax",      s.sizeMax},
+		{"color",        vecJson(s.color)},
+		{"gravity",      vecJson(s.gravity)},
+		{"drag",         s.drag},
+		{"sizeCurve",    sizeCurve},
+		{"colorCurve",   colorCurve},
+		{"maxParticles", s.maxParticles},
+
+		{"position",     vecJson(self->position)},
+		{"followEntity", self->followEntity},
+		{"paused",       self->paused},
+	};
+}
+
+void particleEmitter::deserializer(component *comp, nlohmann::json j) {
+	auto *self = static_cast<particleEmitter*>(comp);
+	particleSettings defaults;
+	particleSettings s;
+
+	s.spawnRate    = j.value("spawnRate",    defaults.spawnRate);
+	s.lifetimeMin  = j.value("lifetimeMin",  defaults.lifetimeMin);
+	s.lifetimeMax  = j.value("lifetimeMax",  defaults.lifetimeMax);
+	s.direction    = jsonVec(j["direction"], defaults.direction);
+	s.spread       = j.value("spread",       defaults.spread);
+	s.speedMin     = j.value("speedMin",     defaults.speedMin);
+	s.speedMax     = j.value("speedMax",     defaults.speedMax);
+	s.spawnRadius  = j.value("spawnRadius",  defaults.spawnRadius);
+	s.sizeMin      = j.value("sizeMin",      defaults.sizeMin);
+	s.sizeMax      = j.value("sizeMax",      defaults.sizeMax);
+	s.color        = jsonVec(j["color"],     defaults.color);
+	s.gravity      = jsonVec(j["gravity"],   defaults.gravity);
+	s.drag         = j.value("drag",         defaults.drag);
+	s.maxParticles = j.value("maxParticles", defaults.maxParticles);
+
+	if (j["bursts"].is_array()) {
+		for (auto& b : j["bursts"]) {
+			s.bursts.push_back({
+				.time     = b.value("time", 0.f),
+				.count    = b.value("count", 0u),
+				.interval = b.value("interval", 0.f),
+			});
+		}
+	}
+
+	// curves are evaluated assuming sorted keys
+	auto sortedKeys = [] (const nlohmann::json& keys, auto& curve, auto read) {
+		if (!keys.is_array()) {
+			return;
+		}
+
+		for (auto& key : keys) {
+			if (!key.is_array() || key.size() != 2 || !key[0].is_number()) {
+				LogCatFmt(logcat::ecs, Warning, "particleEmitter: skipping malformed curve key");
+				continue;
+			}
+
+			curve.keys.push_back({key[0].get<float>(), read(key[1])});
+		}
+
+		std::stable_sort(curve.keys.begin(), curve.keys.end(),
+			[] (auto& a, auto& b) { return a.first < b.first; });
+	};
+
+	sortedKeys(j["sizeCurve"], s.sizeCurve,
+		[] (const nlohmann::json& v) { return v.is_number()? v.get<float>() : 1.f; });
+	sortedKeys(j["colorCurve"], s.colorCurve,
+		[] (const nlohmann::json& v) { return jsonVec(v, glm::vec4(1)); });
+
+	self->simulation.settings = s;
+	self->simulation.clear();
+	self->position     = jsonVec(j["position"], glm::vec3(0));
+	self->followEntity = j.value("followEntity", true);
+	self->paused       = j.value("paused", false);
+}
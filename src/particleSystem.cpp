@@ -0,0 +1,307 @@
+#include <grend/particleSystem.hpp>
+#include <grend/jobQueue.hpp>
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+using namespace grendx;
+
+particleSimulation::particleSimulation(const particleSettings& _settings,
+                                       uint32_t seed)
+	: settings(_settings),
+	  rng(seed) {};
+
+void particleSimulation::burst(unsigned count) {
+	pendingBurst += count;
+}
+
+void particleSimulation::clear(void) {
+	live = 0;
+	pendingBurst = 0;
+	spawnAccum = 0;
+	bmin = bmax = glm::vec3(0);
+}
+
+void particleSimulation::forBlocks(jobQueue *jobs,
+                                   const std::function<void(size_t, size_t)>& fn) const
+{
+	size_t blocks = (live + blockSize - 1) / blockSize;
+
+	auto block = [&] (size_t i) {
+		fn(i*blockSize, std::min(live, (i + 1)*blockSize));
+	};
+
+	if (jobs && blocks > 1) {
+		jobs->parallelFor(blocks, block);
+
+	} else {
+		for (size_t i = 0; i < blocks; i++) {
+			block(i);
+		}
+	}
+}
+
+// bursts that fired before time t
+static unsigned burstsBefore(const particleSettings::burst& b, float t) {
+	if (t <= b.time) {
+		return 0;
+	}
+
+	return (b.interval > 0)? unsigned(ceilf((t - b.time) / b.interval)) : 1;
+}
+
+void particleSimulation::spawn(size_t n,
+                               const glm::vec3& origin,
+                               blockResult& res)
+{
+	n = std::min(n, settings.maxParticles - std::min(live, settings.maxParticles));
+
+	if (n == 0) {
+		return;
+	}
+
+	size_t end = live + n;
+
+	if (px.size() < end) {
+		// grow in steps, all of the arrays at once
+		size_t cap = std::max(end, px.size() + px.size()/2);
+
+		for (auto *arr : {&px, &py, &pz, &vx, &vy, &vz, &age, &lifetime,
+		                  &startSize, &size, &r, &g, &b, &a})
+		{
+			arr->resize(cap);
+		}
+	}
+
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	glm::vec3 dir = glm::normalize(settings.direction);
+	glm::vec3 side = (fabsf(dir.y) < 0.99f)? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+	glm::vec3 tx = glm::normalize(glm::cross(side, dir));
+	glm::vec3 ty = glm::cross(dir, tx);
+
+	float startScale = settings.sizeCurve.empty()? 1.f : settings.sizeCurve.eval(0);
+	glm::vec4 color = settings.colorCurve.empty()
+		? settings.color
+		: settings.color * settings.colorCurve.eval(0);
+
+	for (size_t i = live; i < end; i++) {
+		// uniform over the spherical cap given by spread
+		float cosTheta = 1.f - unit(rng) * 2.f * settings.spread;
+		float sinTheta = sqrtf(std::max(0.f, 1.f - cosTheta*cosTheta));
+		float phi = unit(rng) * 6.2831853f;
+
+		glm::vec3 v = dir*cosTheta + (tx*cosf(phi) + ty*sinf(phi))*sinTheta;
+		float speed = glm::mix(settings.speedMin, settings.speedMax, unit(rng));
+		glm::vec3 pos = origin;
+
+		if (settings.spawnRadius > 0) {
+			glm::vec3 offset(unit(rng)*2 - 1, unit(rng)*2 - 1, unit(rng)*2 - 1);
+			pos += offset * settings.spawnRadius;
+		}
+
+		px[i] = pos.x; py[i] = pos.y; pz[i] = pos.z;
+		vx[i] = v.x*speed; vy[i] = v.y*speed; vz[i] = v.z*speed;
+
+		age[i]       = 0;
+		lifetime[i]  = glm::mix(settings.lifetimeMin, settings.lifetimeMax, unit(rng));
+		startSize[i] = glm::mix(settings.sizeMin, settings.sizeMax, unit(rng));
+		size[i]      = startSize[i] * startScale;
+
+		r[i] = color.x; g[i] = color.y; b[i] = color.z; a[i] = color.w;
+
+		res.min = glm::min(res.min, pos);
+		res.max = glm::max(res.max, pos);
+		res.maxSize = std::max(res.maxSize, size[i]);
+	}
+
+	live = end;
+}
+
+void particleSimulation::simulate(size_t begin,
+                                  size_t end,
+                                  float delta,
+                                  blockResult& res)
+{
+	float damp = expf(-settings.drag * delta);
+	float gx = settings.gravity.x*delta;
+	float gy = settings.gravity.y*delta;
+	float gz = settings.gravity.z*delta;
+
+	// separate passes over each array, so every loop is branch-free and
+	// vectorizes
+	float *__restrict vxp = vx.data(), *__restrict vyp = vy.data(), *__restrict vzp = vz.data();
+	float *__restrict pxp = px.data(), *__restrict pyp = py.data(), *__restrict pzp = pz.data();
+	float *__restrict agep = age.data();
+
+	for (size_t i = begin; i < end; i++) {
+		vxp[i] = (vxp[i] + gx) * damp;
+		vyp[i] = (vyp[i] + gy) * damp;
+		vzp[i] = (vzp[i] + gz) * damp;
+	}
+
+	for (size_t i = begin; i < end; i++) {
+		pxp[i] += vxp[i] * delta;
+		pyp[i] += vyp[i] * delta;
+		pzp[i] += vzp[i] * delta;
+		agep[i] += delta;
+	}
+
+	if (!settings.sizeCurve.empty()) {
+		for (size_t i = begin; i < end; i++) {
+			size[i] = startSize[i] * settings.sizeCurve.eval(age[i] / lifetime[i]);
+		}
+	}
+
+	if (!settings.colorCurve.empty()) {
+		for (size_t i = begin; i < end; i++) {
+			glm::vec4 c = settings.color * settings.colorCurve.eval(age[i] / lifetime[i]);
+			r[i] = c.x; g[i] = c.y; b[i] = c.z; a[i] = c.w;
+		}
+	}
+
+	// survivors are packed to the front of the block in order, step()
+	// moves the blocks together afterwards
+	float *__restrict lifep = lifetime.data();
+	size_t dead = 0;
+
+	for (size_t i = begin; i < end; i++) {
+		dead += agep[i] >= lifep[i];
+	}
+
+	if (dead > 0) {
+		float *arrays[] = {
+			pxp, pyp, pzp, vxp, vyp, vzp, agep, lifep,
+			startSize.data(), size.data(), r.data(), g.data(), b.data(), a.data()
+		};
+
+		size_t out = begin;
+		for (size_t i = begin; i < end; i++) {
+			size_t alive = agep[i] < lifep[i];
+
+			for (float *arr : arrays) {
+				arr[out] = arr[i];
+			}
+
+			out += alive;
+		}
+	}
+
+	size_t kept = end - begin - dead;
+	float *__restrict sizep = size.data();
+	float minx = FLT_MAX,  miny = FLT_MAX,  minz = FLT_MAX;
+	float maxx = -FLT_MAX, maxy = -FLT_MAX, maxz = -FLT_MAX;
+	float maxSize = 0;
+
+	for (size_t i = begin; i < begin + kept; i++) {
+		minx = std::min(minx, pxp[i]); maxx = std::max(maxx, pxp[i]);
+		miny = std::min(miny, pyp[i]); maxy = std::max(maxy, pyp[i]);
+		minz = std::min(minz, pzp[i]); maxz = std::max(maxz, pzp[i]);
+		maxSize = std::max(maxSize, sizep[i]);
+	}
+
+	res.live    = kept;
+	res.min     = glm::vec3(minx, miny, minz);
+	res.max     = glm::vec3(maxx, maxy, maxz);
+	res.maxSize = maxSize;
+}
+
+void particleSimulation::step(float delta, const glm::vec3& origin, jobQueue *jobs) {
+	size_t blocks = (live + blockSize - 1) / blockSize;
+	blockResults.resize(blocks);
+
+	forBlocks(jobs, [&] (size_t begin, size_t end) {
+		simulate(begin, end, delta, blockResults[begin / blockSize]);
+	});
+
+	blockResult total = {
+		.live    = 0,
+		.min     = glm::vec3(FLT_MAX),
+		.max     = glm::vec3(-FLT_MAX),
+		.maxSize = 0,
+	};
+
+	// move each block's survivors down after the previous block's
+	for (size_t i = 0; i < blocks; i++) {
+		auto& res = blockResults[i];
+		size_t begin = i*blockSize;
+
+		if (res.live == 0) {
+			continue;
+		}
+
+		if (total.live != begin) {
+			for (auto *arr : {&px, &py, &pz, &vx, &vy, &vz, &age, &lifetime,
+			                  &startSize, &size, &r, &g, &b, &a})
+			{
+				memmove(arr->data() + total.live, arr->data() + begin,
+				        res.live * sizeof(float));
+			}
+		}
+
+		total.live   += res.live;
+		total.min     = glm::min(total.min, res.min);
+		total.max     = glm::max(total.max, res.max);
+		total.maxSize = std::max(total.maxSize, res.maxSize);
+	}
+
+	live = total.live;
+
+	// spawned after simulating, so new particles start at the origin
+	float next = time + delta;
+	size_t n = pendingBurst;
+
+	spawnAccum += settings.spawnRate * delta;
+	n += size_t(spawnAccum);
+	spawnAccum -= floorf(spawnAccum);
+
+	for (auto& sched : settings.bursts) {
+		n += size_t(burstsBefore(sched, next) - burstsBefore(sched, time)) * sched.count;
+	}
+
+	spawn(n, origin, total);
+	pendingBurst = 0;
+	time = next;
+
+	if (live > 0) {
+		bmin = total.min - glm::vec3(total.maxSize);
+		bmax = total.max + glm::vec3(total.maxSize);
+
+	} else {
+		bmin = bmax = origin;
+	}
+}
+
+void particleSimulation::writeBillboards(glm::vec4 *positions,
+                                         glm::vec4 *colors,
+                                         jobQueue *jobs) const
+{
+	forBlocks(jobs, [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			positions[i] = glm::vec4(px[i], py[i], pz[i], size[i]);
+		}
+
+		if (colors) {
+			for (size_t i = begin; i < end; i++) {
+				colors[i] = glm::vec4(r[i], g[i], b[i], a[i]);
+			}
+		}
+	});
+}
+
+void particleSimulation::writeTransforms(glm::mat4 *transforms,
+                                         const glm::mat4& toLocal,
+                                         jobQueue *jobs) const
+{
+	forBlocks(jobs, [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			float s = size[i];
+			transforms[i] = toLocal * glm::mat4(
+				glm::vec4(s, 0, 0, 0),
+				glm::vec4(0, s, 0, 0),
+				glm::vec4(0, 0, s, 0),
+				glm::vec4(px[i], py[i], pz[i], 1));
+		}
+	});
+}
@@ -0,0 +1,112 @@
+#include <grend/physicsThread.hpp>
+#include <grend/logger.hpp>
+#include <grend/profile.hpp>
+
+#include <cmath>
+
+using namespace grendx;
+
+physicsThread::physicsThread(physics *_phys, float _stepSize, unsigned _maxSteps)
+	: stepSize(_stepSize),
+	  maxSteps(_maxSteps),
+	  phys(_phys) {}
+
+physicsThread::~physicsThread() {
+	stop();
+}
+
+void physicsThread::start(void) {
+#ifdef __EMSCRIPTEN__
+	// no threads here, update() steps on the main thread instead
+	return;
+
+#else
+	if (threadRunning || !phys) {
+		return;
+	}
+
+	phys->setAsyncStepping(true);
+	threadRunning = true;
+	thread = std::thread(&physicsThread::worker, this);
+#endif
+}
+
+void physicsThread::stop(void) {
+	if (!threadRunning) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		threadRunning = false;
+	}
+
+	waiter.notify_all();
+	thread.join();
+	phys->setAsyncStepping(false);
+}
+
+void physicsThread::update(float delta) {
+	if (threadRunning || !phys) {
+		return;
+	}
+
+	accumulator = runSteps(accumulator + delta);
+}
+
+physicsThread::statistics physicsThread::stats(void) {
+	std::lock_guard<std::mutex> lock(statsMutex);
+	return counters;
+}
+
+double physicsThread::runSteps(double accumulated) {
+	unsigned steps = 0;
+
+	while (accumulated >= stepSize && steps < maxSteps) {
+		GREND_PROFILE_ZONE("Physics step");
+		auto begin = std::chrono::steady_clock::now();
+		phys->stepSimulation(stepSize);
+		auto end = std::chrono::steady_clock::now();
+
+		accumulated -= stepSize;
+		steps++;
+
+		std::lock_guard<std::mutex> lock(statsMutex);
+		std::chrono::duration<float> secs = end - begin;
+		counters.steps++;
+		counters.lastStepTime = secs.count();
+	}
+
+	if (accumulated >= stepSize) {
+		// can't keep up, drop whole steps rather than trying to catch up
+		std::lock_guard<std::mutex> lock(statsMutex);
+		counters.overruns++;
+		accumulated = std::fmod(accumulated, (double)stepSize);
+	}
+
+	return accumulated;
+}
+
+void physicsThread::worker(void) {
+	using clock = std::chrono::steady_clock;
+	profile::setThreadName("physics");
+
+	auto last = clock::now();
+	double accumulated = 0.0;
+
+	std::unique_lock<std::mutex> lock(mtx);
+
+	while (threadRunning) {
+		auto now = clock::now();
+		std::chrono::duration<double> elapsed = now - last;
+		last = now;
+
+		lock.unlock();
+		accumulated = runSteps(accumulated + elapsed.count());
+		lock.lock();
+
+		// sleep until the next step is due, or until stopped
+		std::chrono::duration<double> remaining(stepSize - accumulated);
+		waiter.wait_for(lock, remaining, [this] { return !threadRunning; });
+	}
+}
@@ -74,10 +74,13 @@ playerView::playerView() : gameView() {
 static glm::vec3 lastvel = glm::vec3(0);
 
 void playerView::logic(float delta) {
-	auto phys = Resolve<physics>();
-	phys->stepSimulation(1.f/60.f);
-	// TODO: reimplement
-	//phys->stepSimulation(1.f/game->frame_timer.last());
+	if (!physStepper) {
+		physStepper = std::make_shared<physicsThread>(Resolve<physics>());
+		physStepper->start();
+	}
+
+	// no-op while the stepping thread is running, steps here otherwise
+	physStepper->update(delta);
 	cam->updatePosition(delta);
 }
 
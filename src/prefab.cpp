@@ -0,0 +1,404 @@
+#include <grend/prefab.hpp>
+#include <grend/sceneHierarchy.hpp>
+#include <grend/logger.hpp>
+#include <grend/profile.hpp>
+#include <grend/ecs/bufferComponent.hpp>
+#include <grend/ecs/materialComponent.hpp>
+
+using namespace grendx;
+
+static constexpr uint32_t none = sceneHierarchy::none;
+
+static bool isInstanced(const sceneNode *node) {
+	switch (node->type) {
+		case sceneNode::objType::None:
+		case sceneNode::objType::Skin:
+		// carry shadow maps and probe state, and are tracked by pointer
+		// in shadowCache and probeScheduler
+		case sceneNode::objType::Light:
+		case sceneNode::objType::ReflectionProbe:
+		case sceneNode::objType::IrradianceProbe:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+// new light with from's settings, shadow maps aren't copied
+static sceneLight *copyLight(ecs::entityManager *manager, const sceneLight *from) {
+	sceneLight *ret;
+
+	switch (from->lightType) {
+		case sceneLight::lightTypes::Point:
+			{
+				auto *light = manager->construct<sceneLightPoint>();
+				light->radius = static_cast<const sceneLightPoint*>(from)->radius;
+				ret = light;
+			}
+			break;
+
+		case sceneLight::lightTypes::Spot:
+			{
+				auto *light = manager->construct<sceneLightSpot>();
+				auto *spot  = static_cast<const sceneLightSpot*>(from);
+				light->radius = spot->radius;
+				light->angle  = spot->angle;
+				ret = light;
+			}
+			break;
+
+		case sceneLight::lightTypes::Directional:
+			ret = manager->construct<sceneLightDirectional>();
+			break;
+
+		default:
+			ret = manager->construct<sceneLight>(from->lightType);
+			break;
+	}
+
+	ret->diffuse       = from->diffuse;
+	ret->intensity     = from->intensity;
+	ret->casts_shadows = from->casts_shadows;
+	ret->is_static     = from->is_static;
+	return ret;
+}
+
+// new node of the template's type, lights and probes get the settings of
+// the source node but none of its rendered state
+static sceneNode *constructNode(ecs::entityManager *manager,
+                                sceneNode::objType type,
+                                const sceneNode *settings)
+{
+	switch (type) {
+		case sceneNode::objType::Skin:
+			return manager->construct<sceneSkin>();
+
+		case sceneNode::objType::Light:
+			return copyLight(manager, static_cast<const sceneLight*>(settings));
+
+		case sceneNode::objType::ReflectionProbe:
+			{
+				auto *from  = static_cast<const sceneReflectionProbe*>(settings);
+				auto *probe = manager->construct<sceneReflectionProbe>();
+				probe->boundingBox = from->boundingBox;
+				probe->is_static   = from->is_static;
+				return probe;
+			}
+
+		case sceneNode::objType::IrradianceProbe:
+			{
+				auto *from  = static_cast<const sceneIrradianceProbe*>(settings);
+				auto *probe = manager->construct<sceneIrradianceProbe>();
+				probe->boundingBox = from->boundingBox;
+				probe->is_static   = from->is_static;
+				return probe;
+			}
+
+		default:
+			return manager->construct<sceneNode>();
+	}
+}
+
+prefab::prefab(sceneNode::ptr source) {
+	GREND_PROFILE_FUNCTION();
+
+	const sceneHierarchy& hierarchy = source->flatten();
+	const auto& entries = hierarchy.entries;
+	// hierarchy index -> template index
+	std::vector<uint32_t> remap(entries.size(), none);
+	std::vector<std::pair<uint32_t, sceneSkin*>> skins;
+	uint32_t rootParent = none;
+
+	nodes.reserve(entries.size() + 1);
+
+	if (!isInstanced(source.getPtr())) {
+		// instances always get a plain root of their own, so they can be
+		// placed independently
+		templateNode root;
+		root.parent = none;
+		root.type   = sceneNode::objType::None;
+		root.name   = source->name;
+		nodes.push_back(std::move(root));
+		rootParent = 0;
+	}
+
+	for (uint32_t i = 0; i < entries.size();) {
+		const auto& ent = entries[i];
+		sceneNode *node = ent.node;
+
+		templateNode tmp;
+		tmp.parent = (ent.parent == none)? rootParent : remap[ent.parent];
+		tmp.type   = node->type;
+		tmp.name   = node->name;
+		remap[i]   = nodes.size();
+
+		if (!isInstanced(node)) {
+			// whole subtree is shared
+			tmp.shared = node;
+			shared.insert(node);
+			sharedCount++;
+			nodes.push_back(std::move(tmp));
+			i = ent.end;
+			continue;
+		}
+
+		tmp.defaultTransform = node->transform.hasDefaultTransform();
+		tmp.origTransform    = node->transform.getOrig();
+		tmp.transform        = node->transform.getTRS();
+		tmp.visible          = node->visible;
+		tmp.animChannel      = node->animChannel;
+		tmp.extraProperties  = node->extraProperties;
+
+		if (node->type != sceneNode::objType::None
+		    && node->type != sceneNode::objType::Skin)
+		{
+			tmp.settings = node;
+		}
+
+		if (node->type == sceneNode::objType::Skin) {
+			skins.push_back({nodes.size(), static_cast<sceneSkin*>(node)});
+		}
+
+		nodes.push_back(std::move(tmp));
+		i++;
+	}
+
+	// joints can only be resolved once every node has an index
+	for (auto& [idx, skin] : skins) {
+		auto& tmp = nodes[idx];
+		tmp.inverseBind    = skin->inverseBind;
+		tmp.skinTransforms = skin->transforms;
+
+		for (auto& joint : skin->joints) {
+			uint32_t h = hierarchy.indexOf(joint.getPtr());
+			uint32_t t = (h == none)? none : remap[h];
+
+			// joints in shared subtrees are shared too, same as joints
+			// outside of the prefab
+			if (t != none && nodes[t].shared) {
+				t = none;
+			}
+
+			tmp.joints.push_back(t);
+			tmp.externalJoints.push_back((t == none)? joint.getPtr() : nullptr);
+		}
+	}
+}
+
+void prefab::instantiate(ecs::entityManager *manager,
+                         size_t count,
+                         std::vector<sceneNode::ptr>& out)
+{
+	GREND_PROFILE_FUNCTION();
+
+	// reused across instances, one slot per template node
+	std::vector<sceneNode*> created(nodes.size());
+	out.reserve(out.size() + count);
+
+	for (size_t k = 0; k < count; k++) {
+		for (uint32_t i = 0; i < nodes.size(); i++) {
+			const templateNode& tmp = nodes[i];
+			sceneNode *node;
+
+			if (tmp.shared) {
+				node = tmp.shared;
+
+			} else {
+				node = constructNode(manager, tmp.type, tmp.settings);
+				node->name = tmp.name;
+
+				if (!tmp.defaultTransform) {
+					// XXX: two set transforms to ensure origTransform is the same
+					node->transform.set(tmp.origTransform);
+					node->transform.set(tmp.transform);
+				}
+
+				node->visible         = tmp.visible;
+				node->animChannel     = tmp.animChannel;
+				node->extraProperties = tmp.extraProperties;
+			}
+
+			created[i] = node;
+
+			if (tmp.parent != none) {
+				sceneNode *parent = created[tmp.parent];
+				parent->attach<ecs::link<sceneNode>>(node);
+
+				// shared nodes keep their original parent
+				if (!tmp.shared) {
+					node->parent = parent;
+				}
+			}
+		}
+
+		// parents come first, so every joint exists by now
+		for (uint32_t i = 0; i < nodes.size(); i++) {
+			const templateNode& tmp = nodes[i];
+
+			if (tmp.type != sceneNode::objType::Skin || tmp.shared) {
+				continue;
+			}
+
+			auto *skin = static_cast<sceneSkin*>(created[i]);
+			skin->inverseBind = tmp.inverseBind;
+			skin->transforms  = tmp.skinTransforms;
+			skin->joints.resize(tmp.joints.size());
+
+			for (size_t j = 0; j < tmp.joints.size(); j++) {
+				skin->joints[j] = (tmp.joints[j] == none)
+					? tmp.externalJoints[j]
+					: created[tmp.joints[j]];
+			}
+		}
+
+		out.push_back(created[0]);
+	}
+}
+
+sceneNode::ptr prefab::instantiate(ecs::entityManager *manager) {
+	std::vector<sceneNode::ptr> ret;
+	instantiate(manager, 1, ret);
+	return ret[0];
+}
+
+void prefab::release(ecs::entityManager *manager, sceneNode::ptr instance) {
+	if (!instance) {
+		return;
+	}
+
+	const auto& entries = instance->flatten().entries;
+
+	for (uint32_t i = 0; i < entries.size();) {
+		sceneNode *node = entries[i].node;
+
+		if (shared.count(node)) {
+			i = entries[i].end;
+			continue;
+		}
+
+		if (node->type == sceneNode::objType::IrradianceProbe) {
+			// created along with the probe
+			manager->remove(static_cast<sceneIrradianceProbe*>(node)->source);
+		}
+
+		manager->remove(node);
+		i++;
+	}
+}
+
+template <typename T>
+static void copyBuffer(ecs::entity *from, ecs::entity *to) {
+	if (auto buf = from->get<ecs::bufferComponent<T>>()) {
+		to->attach<ecs::bufferComponent<T>>()->data = buf->data;
+	}
+}
+
+static void copyNodeState(sceneNode *from, sceneNode *to) {
+	if (!from->transform.hasDefaultTransform()) {
+		// XXX: two set transforms to ensure origTransform is the same
+		to->transform.set(from->transform.getOrig());
+		to->transform.set(from->transform.getTRS());
+	}
+
+	to->name            = from->name;
+	to->visible         = from->visible;
+	to->animChannel     = from->animChannel;
+	to->extraProperties = from->extraProperties;
+}
+
+static sceneModel::ptr copyModel(ecs::entityManager *manager, sceneModel::ptr model) {
+	sceneModel::ptr ret = manager->construct<sceneModel>();
+	copyNodeState(model.getPtr(), ret.getPtr());
+
+	ret->compiled      = model->compiled;
+	ret->comped_model  = model->comped_model;
+	ret->haveNormals   = model->haveNormals;
+	ret->haveColors    = model->haveColors;
+	ret->haveTangents  = model->haveTangents;
+	ret->haveTexcoords = model->haveTexcoords;
+	ret->haveLightmap  = model->haveLightmap;
+	ret->haveJoints    = model->haveJoints;
+	ret->haveAABB      = model->haveAABB;
+
+	copyBuffer<sceneModel::vertex>(model.getPtr(), ret.getPtr());
+	copyBuffer<sceneModel::jointWeights>(model.getPtr(), ret.getPtr());
+
+	for (auto link : model->nodes()) {
+		auto ptr = link->getRef();
+
+		if (ptr->type != sceneNode::objType::Mesh) {
+			continue;
+		}
+
+		sceneMesh::ptr mesh = ref_cast<sceneMesh>(ptr);
+		sceneMesh::ptr copy = manager->construct<sceneMesh>();
+		copyNodeState(mesh.getPtr(), copy.getPtr());
+
+		copy->compiled       = mesh->compiled;
+		copy->comped_mesh    = mesh->comped_mesh;
+		copy->boundingBox    = mesh->boundingBox;
+		copy->boundingSphere = mesh->boundingSphere;
+		copy->lods           = mesh->lods;
+		copy->occluder       = mesh->occluder;
+		copy->sharedIndices  = mesh->sharedIndices;
+		copy->bvh            = mesh->bvh;
+
+		copyBuffer<sceneMesh::faceType>(mesh.getPtr(), copy.getPtr());
+
+		if (auto mat = mesh->get<ecs::materialComponent>()) {
+			copy->attach<ecs::materialComponent>(mat->mat);
+		}
+
+		setNode(mesh->name, ret, copy);
+	}
+
+	return ret;
+}
+
+sceneNode::ptr prefab::makeUnique(sceneNode::ptr instance, sceneNode::ptr node) {
+	if (!instance || !node) {
+		return nullptr;
+	}
+
+	if (!shared.count(node.getPtr())) {
+		// already unique
+		return node;
+	}
+
+	if (node->type != sceneNode::objType::Model) {
+		LogErrorFmt("prefab: can't make a unique copy of {}", node->idString());
+		return nullptr;
+	}
+
+	auto& hierarchy = instance->flatten();
+	uint32_t idx = hierarchy.indexOf(node.getPtr());
+
+	if (idx == none || hierarchy.entries[idx].parent == none) {
+		return nullptr;
+	}
+
+	sceneNode::ptr parent = hierarchy.entries[hierarchy.entries[idx].parent].node;
+	auto manager = node->manager;
+	auto copy = copyModel(manager, ref_cast<sceneModel>(node));
+
+	for (auto *link : parent->nodes()) {
+		if (link->getRef() == node) {
+			manager->unregisterComponent(parent.getPtr(), link);
+			break;
+		}
+	}
+
+	parent->attach<ecs::link<sceneNode>>(copy.getPtr());
+	copy->parent = parent;
+
+	return copy;
+}
+
+size_t prefab::instancedNodes(void) const {
+	return nodes.size() - sharedCount;
+}
+
+size_t prefab::sharedNodes(void) const {
+	return sharedCount;
+}
@@ -0,0 +1,163 @@
+#include <grend/probeScheduler.hpp>
+
+#include <algorithm>
+
+using namespace grendx;
+
+probeScheduler::~probeScheduler() {};
+
+void probeScheduler::request(const void *probe,
+                             const glm::vec3& position,
+                             unsigned steps,
+                             bool urgent)
+{
+	if (steps == 0) {
+		return;
+	}
+
+	auto [it, added] = tasks.try_emplace(probe, task {
+		.probe          = probe,
+		.position       = position,
+		.steps          = steps,
+		.progress       = 0,
+		.firstRequested = frame,
+		.lastRequested  = frame,
+		.urgent         = urgent,
+		.priority       = 0,
+	});
+
+	if (!added) {
+		auto& t = it->second;
+		t.position      = position;
+		t.lastRequested = frame;
+		t.urgent        = t.urgent || urgent;
+
+		// step count changed mid-update (ie. settings changed), start over
+		if (t.steps != steps) {
+			t.steps    = steps;
+			t.progress = 0;
+		}
+	}
+}
+
+bool probeScheduler::inProgress(const void *probe) const {
+	auto it = tasks.find(probe);
+	return it != tasks.end()
+	    && it->second.progress > 0
+	    && it->second.progress < it->second.steps;
+}
+
+float probeScheduler::priority(const task& t, const glm::vec3& viewPos) const {
+	auto it = lastCompleted.find(t.probe);
+	uint32_t since = (it != lastCompleted.end())? it->second : t.firstRequested;
+
+	float age  = float(frame - since + 1);
+	float dist = glm::distance(t.position, viewPos);
+
+	return age / (1.f + dist / std::max(settings.distanceScale, 1e-3f));
+}
+
+void probeScheduler::schedule(const glm::vec3& viewPos) {
+	order.clear();
+	cursor = 0;
+
+	for (auto& [_, t] : tasks) {
+		t.priority = priority(t, viewPos);
+		order.push_back(&t);
+	}
+
+	std::sort(order.begin(), order.end(),
+		[] (const task *a, const task *b) {
+			if (a->urgent != b->urgent) {
+				return a->urgent;
+			}
+
+			// finish updates that are underway before starting new ones
+			if ((a->progress > 0) != (b->progress > 0)) {
+				return a->progress > 0;
+			}
+
+			return a->priority > b->priority;
+		});
+}
+
+bool probeScheduler::next(step& out) {
+	if (stepsRun > 0) {
+		if (stepsRun >= settings.stepBudget) {
+			return false;
+		}
+
+		if (settings.timeBudget > 0 && timeUsed >= settings.timeBudget * 1e6) {
+			return false;
+		}
+	}
+
+	while (cursor < order.size() && order[cursor]->progress >= order[cursor]->steps) {
+		cursor++;
+	}
+
+	if (cursor >= order.size()) {
+		return false;
+	}
+
+	task& t = *order[cursor];
+	out = {t.probe, t.progress, t.steps};
+	return true;
+}
+
+void probeScheduler::finished(const step& s, uint64_t ns) {
+	stepsRun++;
+	timeUsed += ns;
+	current.steps++;
+	current.stepTime += ns;
+
+	auto it = tasks.find(s.probe);
+	if (it == tasks.end()) {
+		return;
+	}
+
+	auto& t = it->second;
+	t.progress = std::max(t.progress, s.index + 1);
+
+	if (t.progress < t.steps) {
+		return;
+	}
+
+	unsigned latency = frame - t.firstRequested;
+	current.completed++;
+	current.maxLatency = std::max(current.maxLatency, latency);
+	latencySum += latency;
+	current.avgLatency = float(latencySum) / current.completed;
+	worst = std::max(worst, latency);
+
+	lastCompleted[s.probe] = frame;
+	// completed tasks are dropped in newFrame(), next() skips them until
+	// then, and order keeps pointing at valid tasks
+}
+
+void probeScheduler::newFrame(void) {
+	// probes that weren't requested this frame left the queue, or don't
+	// need an update anymore
+	std::erase_if(tasks, [&] (const auto& ent) {
+		return ent.second.lastRequested != frame
+		    || ent.second.progress >= ent.second.steps;
+	});
+
+	current.pending = tasks.size();
+	lastFrame  = current;
+	current    = {};
+	latencySum = 0;
+	stepsRun   = 0;
+	timeUsed   = 0;
+	order.clear();
+	cursor = 0;
+	frame++;
+
+	constexpr uint32_t expireFrames = 4096;
+
+	if (frame % 64 == 0) {
+		std::erase_if(lastCompleted, [&] (const auto& ent) {
+			return frame - ent.second > expireFrames;
+		});
+	}
+}
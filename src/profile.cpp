@@ -0,0 +1,302 @@
+#include <grend/profile.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+using namespace grendx;
+using namespace grendx::profile;
+
+// thread buffers are never freed, threads which exit just leave
+// an idle buffer behind
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<threadBuffer>> registry;
+
+static std::vector<frameRecord> history(120);
+static size_t historyPos = 0;
+static size_t historyCount = 0;
+static uint64_t frameCounter = 0;
+static uint64_t frameBegin = 0;
+static const uint64_t epoch = now();
+
+// tick -> nanosecond conversion, refined every frame as more time passes
+static const uint64_t tickBase = ticks();
+static const uint64_t nsBase   = now();
+static double nsPerTick = 1.0;
+
+static void calibrate(void) {
+	uint64_t dticks = ticks() - tickBase;
+	uint64_t dns    = now() - nsBase;
+
+	// need a reasonable interval for a stable estimate
+	if (dticks > 0 && dns > 1000000) {
+		nsPerTick = (double)dns / (double)dticks;
+	}
+}
+
+static inline uint64_t toNanoseconds(uint64_t t) {
+	return nsBase + (int64_t)(((int64_t)t - (int64_t)tickBase) * nsPerTick);
+}
+
+threadBuffer *grendx::profile::registerThread(void) {
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	auto buf = std::make_unique<threadBuffer>();
+	buf->id = registry.size();
+
+	threadBuffer *ret = buf.get();
+	registry.push_back(std::move(buf));
+	return ret;
+}
+
+void grendx::profile::setThreadName(const char *name) {
+	localBuffer().name = name;
+}
+
+void grendx::profile::startGroup(const char *name) {
+	threadBuffer& buf = localBuffer();
+
+	if (buf.depth < threadBuffer::maxGroupDepth) {
+		buf.groups[buf.depth] = {name, ticks()};
+	}
+
+	buf.depth++;
+}
+
+void grendx::profile::endGroup(void) {
+	threadBuffer& buf = localBuffer();
+
+	if (buf.depth == 0) {
+		// unbalanced endGroup(), ignore it
+		return;
+	}
+
+	buf.depth--;
+
+	if (buf.depth < threadBuffer::maxGroupDepth) {
+		auto& g = buf.groups[buf.depth];
+		buf.push({g.name, g.begin, ticks(), buf.id, buf.depth});
+	}
+}
+
+void grendx::profile::newFrame(void) {
+	frameBegin = now();
+}
+
+void grendx::profile::endFrame(void) {
+	frameRecord& rec = history[historyPos];
+
+	rec.index = frameCounter++;
+	rec.begin = frameBegin;
+	rec.end   = now();
+	rec.mainThread = localBuffer().id;
+	rec.events.clear();
+	calibrate();
+
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		for (auto& buf : registry) {
+			buf->drain([&] (const event& ev) {
+				rec.events.push_back(ev);
+				rec.events.back().begin = toNanoseconds(ev.begin);
+				rec.events.back().end   = toNanoseconds(ev.end);
+			});
+		}
+	}
+
+	historyPos = (historyPos + 1) % history.size();
+	historyCount = std::min(historyCount + 1, history.size());
+}
+
+size_t grendx::profile::historySize(void) {
+	return historyCount;
+}
+
+const frameRecord *grendx::profile::getHistory(size_t framesAgo) {
+	if (framesAgo >= historyCount) {
+		return nullptr;
+	}
+
+	size_t idx = (historyPos + history.size() - 1 - framesAgo) % history.size();
+	return &history[idx];
+}
+
+void grendx::profile::setHistoryLength(size_t frames) {
+	if (frames == 0 || frames == history.size()) {
+		return;
+	}
+
+	history.clear();
+	history.resize(frames);
+	historyPos = 0;
+	historyCount = 0;
+}
+
+std::vector<zoneStats> grendx::profile::aggregate(const frameRecord& frame) {
+	std::vector<zoneStats> ret;
+
+	for (auto& ev : frame.events) {
+		// names are static, comparing pointers is enough in the common case,
+		// compare contents as well in case the same literal isn't merged
+		auto it = std::find_if(ret.begin(), ret.end(),
+			[&] (const zoneStats& s) {
+				return s.name == ev.name || std::string_view(s.name) == ev.name;
+			});
+
+		double secs = (ev.end - ev.begin) / 1e9;
+
+		if (it == ret.end()) {
+			ret.push_back({ev.name, 1, secs, secs});
+
+		} else {
+			it->calls++;
+			it->total += secs;
+			it->longest = std::max(it->longest, secs);
+		}
+	}
+
+	std::sort(ret.begin(), ret.end(),
+		[] (const zoneStats& a, const zoneStats& b) {
+			return a.total > b.total;
+		});
+
+	return ret;
+}
+
+std::vector<std::string> grendx::profile::threadNames(void) {
+	std::lock_guard<std::mutex> lock(registryMutex);
+	std::vector<std::string> ret;
+
+	for (auto& buf : registry) {
+		ret.push_back(buf->name.load());
+	}
+
+	return ret;
+}
+
+uint64_t grendx::profile::droppedEvents(void) {
+	std::lock_guard<std::mutex> lock(registryMutex);
+	uint64_t ret = 0;
+
+	for (auto& buf : registry) {
+		ret += buf->dropped;
+	}
+
+	return ret;
+}
+
+static void writeEscaped(std::ofstream& out, const char *str) {
+	for (const char *s = str; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			out << '\\';
+		}
+
+		out << *s;
+	}
+}
+
+static void writeEvent(std::ofstream& out, const char *name,
+                       uint64_t begin, uint64_t end, uint32_t thread)
+{
+	out << "{\"name\":\"";
+	writeEscaped(out, name);
+	out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+	    << ",\"ts\":"  << (begin - epoch) / 1000.0
+	    << ",\"dur\":" << (end - begin) / 1000.0
+	    << "}";
+}
+
+bool grendx::profile::exportChromeTrace(const std::string& path) {
+	std::ofstream out(path);
+
+	if (!out.good()) {
+		return false;
+	}
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	auto names = threadNames();
+	for (unsigned i = 0; i < names.size(); i++) {
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+		    << ",\"args\":{\"name\":\"";
+		writeEscaped(out, names[i].c_str());
+		out << "\"}},\n";
+	}
+
+	bool first = true;
+	// oldest to newest
+	for (size_t i = historyCount; i > 0; i--) {
+		const frameRecord *frame = getHistory(i - 1);
+
+		if (!first) out << ",\n";
+		first = false;
+
+		writeEvent(out, "frame", frame->begin, frame->end, frame->mainThread);
+
+		for (auto& ev : frame->events) {
+			out << ",\n";
+			writeEvent(out, ev.name, ev.begin, ev.end, ev.thread);
+		}
+	}
+
+	out << "\n]}\n";
+	return out.good();
+}
+
+group grendx::profile::buildTree(const frameRecord& frame) {
+	group root;
+	root.seconds = frame.duration();
+	root.calls = 1;
+
+	std::vector<event> events = frame.events;
+	std::sort(events.begin(), events.end(),
+		[] (const event& a, const event& b) {
+			if (a.thread != b.thread) return a.thread < b.thread;
+			if (a.begin  != b.begin)  return a.begin < b.begin;
+			return a.depth < b.depth;
+		});
+
+	auto names = threadNames();
+	std::vector<group*> stack;
+	uint32_t curThread = ~0u;
+
+	for (auto& ev : events) {
+		if (ev.thread != curThread) {
+			curThread = ev.thread;
+			stack.clear();
+
+			if (curThread == frame.mainThread) {
+				stack.push_back(&root);
+
+			} else {
+				std::string name = "[" + ((curThread < names.size())
+					? names[curThread]
+					: std::to_string(curThread)) + "]";
+				stack.push_back(&root.subgroups[name]);
+			}
+		}
+
+		// depth 0 is directly under the thread root
+		stack.resize(std::min<size_t>(stack.size(), ev.depth + 1));
+
+		group& g = stack.back()->subgroups[ev.name];
+		g.seconds += (ev.end - ev.begin) / 1e9;
+		g.calls++;
+		stack.push_back(&g);
+	}
+
+	// thread root time is the sum of its top-level zones
+	for (auto& [name, sub] : root.subgroups) {
+		if (name.front() == '[') {
+			sub.calls = 1;
+
+			for (auto& [_, g] : sub.subgroups) {
+				sub.seconds += g.seconds;
+			}
+		}
+	}
+
+	return root;
+}
@@ -114,7 +114,7 @@ void quadtree::free(node_id id) {
 		parent->unlink_subnode(ptr);
 		delete ptr;
 
-		ptr = ptr->parent;
+		ptr = parent;
 	}
 
 	assert(ptr != nullptr);
@@ -251,7 +251,8 @@ unsigned quadtree::node::get_max_free(void) {
 	unsigned ret = 0;
 
 	if (is_leaf()) {
-		return 0;
+		// leaves are allocations, except the root of an empty tree
+		return parent? 0 : size / 2;
 	}
 
 	for (unsigned i = 0; i < 4; i++) {
@@ -0,0 +1,162 @@
+#include <grend/raycast.hpp>
+#include <grend/renderQueue.hpp>
+#include <grend/profile.hpp>
+#include <grend/ecs/sceneComponent.hpp>
+
+using namespace grendx;
+
+void raycastScene::add(sceneNode::ptr node,
+                       ecs::entity *owner,
+                       const glm::mat4& transform,
+                       uint32_t id)
+{
+	addRec(node, nullptr, owner, transform, id);
+	dirty = true;
+}
+
+void raycastScene::addEntities(ecs::entityManager *manager) {
+	for (auto [ent, _] : manager->search<ecs::sceneComponent>()) {
+		for (auto scene : ent->getAll<ecs::sceneComponent>()) {
+			add(scene->getNode(), ent, ent->transform.getMatrix());
+		}
+	}
+}
+
+void raycastScene::clear(void) {
+	meshes.clear();
+	tree.nodes.clear();
+	tree.order.clear();
+	dirty = false;
+}
+
+void raycastScene::addRec(sceneNode::ptr node,
+                          sceneModel *model,
+                          ecs::entity *owner,
+                          const glm::mat4& transform,
+                          uint32_t id)
+{
+	if (!node || !node->visible) {
+		return;
+	}
+
+	glm::mat4 adjTrans;
+	bool inverted;
+	getNodeTransform(node, transform, false, adjTrans, inverted);
+
+	// same as the editor's click IDs, see buildClickableRec()
+	if (node->has<ecs::sceneComponent>()) {
+		owner = node.getPtr();
+	}
+
+	switch (node->type) {
+		case sceneNode::objType::Model:
+			model = ref_cast<sceneModel>(node).getPtr();
+			model->buildBVHs();
+			break;
+
+		case sceneNode::objType::Mesh:
+			{
+				sceneMesh::ptr mesh = ref_cast<sceneMesh>(node);
+
+				if (model && mesh->bvh && mesh->bvh->triangles() > 0) {
+					meshes.push_back({
+						adjTrans,
+						glm::inverse(adjTrans),
+						mesh,
+						mesh->bvh,
+						owner,
+						id
+					});
+				}
+			}
+			break;
+
+		case sceneNode::objType::Particles:
+		case sceneNode::objType::BillboardParticles:
+			return;
+
+		default:
+			break;
+	}
+
+	for (auto link : node->nodes()) {
+		addRec(link->getRef(), model, owner, adjTrans, id);
+	}
+}
+
+void raycastScene::build(void) {
+	GREND_PROFILE_FUNCTION();
+
+	std::vector<AABB> boxes;
+	boxes.reserve(meshes.size());
+
+	for (auto& inst : meshes) {
+		const AABB& box = inst.bvh->bounds();
+		AABB world = {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+
+		for (unsigned i = 0; i < 8; i++) {
+			glm::vec3 corner((i & 1)? box.max.x : box.min.x,
+			                 (i & 2)? box.max.y : box.min.y,
+			                 (i & 4)? box.max.z : box.min.z);
+			glm::vec3 p = glm::vec3(inst.transform * glm::vec4(corner, 1));
+
+			world.min = glm::min(world.min, p);
+			world.max = glm::max(world.max, p);
+		}
+
+		boxes.push_back(world);
+	}
+
+	// instances are few compared to triangles, and each leaf test is a
+	// full mesh traversal, so keep leaves small
+	tree.build(boxes, 1);
+	dirty = false;
+}
+
+bool raycastScene::raycast(const glm::vec3& origin,
+                           const glm::vec3& dir,
+                           raycastHit& out,
+                           float maxDist)
+{
+	if (dirty) {
+		build();
+	}
+
+	float len = glm::length(dir);
+	if (len == 0.f) {
+		return false;
+	}
+
+	glm::vec3 ndir = dir / len;
+	float tmax = maxDist;
+	bool hit = false;
+
+	tree.traverse(origin, ndir, tmax, [&] (uint32_t k) {
+		const instance& inst = meshes[tree.order[k]];
+
+		// the local direction isn't normalized, so distances in object
+		// space are the same as in world space
+		glm::vec3 localOrigin = glm::vec3(inst.inverse * glm::vec4(origin, 1));
+		glm::vec3 localDir    = glm::mat3(inst.inverse) * ndir;
+		meshHit mhit;
+
+		if (!inst.bvh->raycast(localOrigin, localDir, tmax, mhit)) {
+			return FLT_MAX;
+		}
+
+		glm::vec3 normal = glm::transpose(glm::mat3(inst.inverse)) * mhit.normal;
+
+		out.entity   = inst.entity;
+		out.mesh     = inst.mesh;
+		out.id       = inst.id;
+		out.triangle = mhit.triangle;
+		out.distance = mhit.distance;
+		out.point    = origin + ndir*mhit.distance;
+		out.normal   = glm::normalize(normal);
+		hit = true;
+
+		return mhit.distance;
+	});
+
+	return hit;
+}
@@ -1,6 +1,12 @@
 #include <grend/engine.hpp>
 #include <grend/utility.hpp>
 #include <grend/textureAtlas.hpp>
+#include <grend/jobQueue.hpp>
+#include <grend/profile.hpp>
+#include <grend/shadowCache.hpp>
+#include <grend/probeScheduler.hpp>
+#include <grend/ecs/bufferComponent.hpp>
+#include <algorithm>
 #include <math.h>
 
 using namespace grendx;
@@ -27,6 +33,13 @@ void grendx::getNodeTransform(sceneNode::ptr obj,
 	outTrans    = temp;
 }
 
+uint64_t grendx::instancePath(uint64_t parent, const sceneNode *node) {
+	uint64_t h = (parent ^ reinterpret_cast<uintptr_t>(node)) * 0x9e3779b97f4a7c15ull;
+	h ^= h >> 32;
+	// never 0, that's used for "unknown"
+	return h | 1;
+}
+
 void renderQueue::add(sceneNode::ptr obj,
                       uint32_t renderID,
                       glm::mat4 trans,
@@ -34,22 +47,45 @@ void renderQueue::add(sceneNode::ptr obj,
 {
 	if (!obj) return;
 
-	glm::mat4 adjTrans;
-	bool adjInvert;
+	struct nodeState {
+		glm::mat4 transform;
+		bool inverted;
+		uint64_t path;
+	};
 
-	getNodeTransform(obj, trans, inverted, adjTrans, adjInvert);
+	// walk the flattened tree in order rather than recursing through links,
+	// parents always come before children so their state is already known
+	const auto& entries = obj->flatten().entries;
+	static thread_local std::vector<nodeState> states;
+	states.resize(entries.size());
 
-	if (addNode(obj, renderID, adjTrans, adjInvert)) {
-		for (auto ptr : obj->nodes()) {
-			add(ptr->getRef(), renderID, adjTrans, adjInvert);
+	for (uint32_t i = 0; i < entries.size();) {
+		const auto& ent = entries[i];
+		auto& state = states[i];
+
+		if (ent.parent == sceneHierarchy::none) {
+			getNodeTransform(ent.node, trans, inverted,
+			                 state.transform, state.inverted);
+			state.path = instancePath(0, ent.node);
+		} else {
+			const auto& p = states[ent.parent];
+			getNodeTransform(ent.node, p.transform, p.inverted,
+			                 state.transform, state.inverted);
+			state.path = instancePath(p.path, ent.node);
 		}
+
+		// skip the subtree if the node was handled (or hidden)
+		i = addNode(ent.node, renderID, state.transform, state.inverted, state.path)
+			? i + 1
+			: ent.end;
 	}
 }
 
 bool renderQueue::addNode(sceneNode::ptr obj,
                           uint32_t renderID,
                           glm::mat4 trans,
-                          bool inverted)
+                          bool inverted,
+                          uint64_t instance)
 {
 	bool ret = false;
 
@@ -69,7 +105,7 @@ bool renderQueue::addNode(sceneNode::ptr obj,
 
 	if (obj->type == sceneNode::objType::Mesh) {
 		// TODO: addMesh()
-		addMesh(obj, renderID, trans, inverted);
+		addMesh(obj, renderID, trans, inverted, instance);
 
 	} else if (obj->type == sceneNode::objType::Light) {
 		sceneLight::ptr light = ref_cast<sceneLight>(obj);
@@ -87,13 +123,16 @@ bool renderQueue::addNode(sceneNode::ptr obj,
 		irradProbes.push_back({trans, center, inverted, probe});
 	}
 
+	static const uint32_t skinID = internName("skin");
+	static const uint32_t meshID = internName("mesh");
+
 	if (obj->type == sceneNode::objType::None
-	    && obj->hasNode("skin")
-	    && obj->hasNode("mesh"))
+	    && obj->hasNode(skinID)
+	    && obj->hasNode(meshID))
 	{
-		auto node = obj->getNode("skin");
+		auto node = obj->getNode(skinID);
 		auto s = ref_cast<sceneSkin>(node);
-		addSkinned(obj->getNode("mesh"), s, renderID, trans, inverted);
+		addSkinned(obj->getNode(meshID), s, renderID, trans, inverted);
 
 	} else if (obj->type == sceneNode::objType::Particles) {
 		auto p = ref_cast<sceneParticles>(obj);
@@ -129,7 +168,8 @@ void renderQueue::add(renderQueue& other) {
 void renderQueue::addMesh(sceneNode::ptr obj,
                           uint32_t renderID,
                           const glm::mat4& trans,
-                          bool inverted)
+                          bool inverted,
+                          uint64_t instance)
 {
 	sceneMesh::ptr mesh = ref_cast<sceneMesh>(obj);
 
@@ -143,6 +183,7 @@ void renderQueue::addMesh(sceneNode::ptr obj,
 			mesh,
 			renderID
 		};
+		entry.instance = instance;
 
 		switch (mesh->comped_mesh->blend) {
 			case material::blend_mode::Blend:
@@ -254,11 +295,28 @@ void renderQueue::addBillboards(sceneNode::ptr obj,
 void grendx::updateLights(renderContext *rctx,
                           renderQueue& que)
 {
-	// TODO: should probably apply the transform to light position
+	std::vector<renderQueue::queueEnt<sceneLight::ptr>*> shadowLights;
+	shadowLights.reserve(que.lights.size());
+
 	for (auto& light : que.lights) {
-		if (!light.data->casts_shadows) {
-			continue;
+		if (light.data->casts_shadows) {
+			shadowLights.push_back(&light);
 		}
+	}
+
+	// with a per-frame shadow budget, lights that have gone longest without
+	// an update get it first
+	if (auto cache = engine::Services().tryResolve<shadowCache>()) {
+		std::stable_sort(shadowLights.begin(), shadowLights.end(),
+			[&] (auto *a, auto *b) {
+				return cache->lastUpdate(a->data.getPtr())
+				     < cache->lastUpdate(b->data.getPtr());
+			});
+	}
+
+	// TODO: should probably apply the transform to light position
+	for (auto *lightp : shadowLights) {
+		auto& light = *lightp;
 
 		if (light.data->lightType == sceneLight::lightTypes::Point) {
 			// TODO: check against view frustum to see if this light is visible,
@@ -292,10 +350,27 @@ void grendx::updateLights(renderContext *rctx,
 	}
 }
 
-void grendx::updateReflections(renderContext *rctx, renderQueue& que) {
+// keeps live and in-progress probe nodes from being evicted
+static void refreshNodes(quadtree& tree, quadtree::node_id *ids, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		if (tree.valid(ids[i])) {
+			ids[i] = tree.refresh(ids[i]);
+		}
+	}
+}
+
+void grendx::updateReflections(renderContext *rctx,
+                               renderQueue& que,
+                               camera::ptr cam)
+{
 	auto& reftree = rctx->atlases.reflections->tree;
 	auto& radtree = rctx->atlases.irradiance->tree;
 
+	auto sched = engine::Services().tryResolve<probeScheduler>();
+	if (sched && !sched->settings.enabled) {
+		sched = nullptr;
+	}
+
 	for (auto& probe : que.probes) {
 		// allocate from reflection atlas for top level reflections
 		for (unsigned i = 0; i < 6; i++) {
@@ -319,7 +394,23 @@ void grendx::updateReflections(renderContext *rctx, renderQueue& que) {
 		}
 
 		probe.data->have_convolved = true;
-		drawReflectionProbe(que, probe.data, probe.transform, rctx);
+
+		if (!sched) {
+			drawReflectionProbe(que, probe.data, probe.transform, rctx);
+			continue;
+		}
+
+		auto *ptr = probe.data.getPtr();
+		refreshNodes(reftree, probe.data->faces[0], 6);
+		refreshNodes(reftree, probe.data->updateFaces[0], 6);
+		refreshNodes(radtree, &probe.data->faces[1][0], 4*6);
+		refreshNodes(radtree, &probe.data->updateFaces[1][0], 4*6);
+
+		if (!(probe.data->is_static && probe.data->have_map) || sched->inProgress(ptr)) {
+			sched->request(ptr, extractTranslation(probe.transform),
+			               reflectionProbeSteps(probe.data),
+			               !probe.data->have_map);
+		}
 	}
 
 	for (auto& radprobe : que.irradProbes) {
@@ -338,7 +429,58 @@ void grendx::updateReflections(renderContext *rctx, renderQueue& que) {
 		}
 
 		radprobe.data->source->have_convolved = false;
-		drawIrradianceProbe(que, radprobe.data, radprobe.transform, rctx);
+
+		if (!sched) {
+			drawIrradianceProbe(que, radprobe.data, radprobe.transform, rctx);
+			continue;
+		}
+
+		auto *ptr = radprobe.data.getPtr();
+		refreshNodes(radtree, radprobe.data->faces, 6);
+		refreshNodes(radtree, radprobe.data->updateFaces, 6);
+		refreshNodes(reftree, radprobe.data->source->faces[0], 6);
+		refreshNodes(reftree, radprobe.data->source->updateFaces[0], 6);
+
+		if (!(radprobe.data->is_static && radprobe.data->have_map) || sched->inProgress(ptr)) {
+			sched->request(ptr, extractTranslation(radprobe.transform),
+			               irradianceProbeSteps(radprobe.data),
+			               !radprobe.data->have_map);
+		}
+	}
+
+	if (!sched) {
+		return;
+	}
+
+	// probes are identified by pointer in the scheduler, find queue
+	// entries by the same pointer
+	std::unordered_map<const void*, size_t> refIndex, radIndex;
+
+	for (size_t i = 0; i < que.probes.size(); i++) {
+		refIndex[que.probes[i].data.getPtr()] = i;
+	}
+
+	for (size_t i = 0; i < que.irradProbes.size(); i++) {
+		radIndex[que.irradProbes[i].data.getPtr()] = i;
+	}
+
+	sched->schedule(cam? cam->position() : glm::vec3(0));
+	probeScheduler::step st;
+
+	// step times only cover command submission, the GPU runs behind
+	while (sched->next(st)) {
+		uint64_t start = profile::now();
+
+		if (auto it = refIndex.find(st.probe); it != refIndex.end()) {
+			auto& probe = que.probes[it->second];
+			drawReflectionProbeStep(que, probe.data, probe.transform, rctx, st.index);
+
+		} else if (auto it = radIndex.find(st.probe); it != radIndex.end()) {
+			auto& radprobe = que.irradProbes[it->second];
+			drawIrradianceProbeStep(que, radprobe.data, radprobe.transform, rctx, st.index);
+		}
+
+		sched->finished(st, profile::now() - start);
 	}
 }
 
@@ -431,7 +573,8 @@ void grendx::cullQueue(renderQueue& queue,
                        camera::ptr cam,
                        unsigned width,
                        unsigned height,
-                       float lightext)
+                       float lightext,
+                       lodPass pass)
 {
 	// TODO: reserve a vector containing indexes and cull on that,
 	//       then copy indexes into the final output vector,
@@ -523,9 +666,14 @@ void grendx::cullQueue(renderQueue& queue,
 	{
 		auto& [_, trans, __, particles, ___] = *it;
 
+		// bounds are relative to the particle node, trans is its world matrix
+		float scale = std::max({glm::length(glm::vec3(trans[0])),
+		                        glm::length(glm::vec3(trans[1])),
+		                        glm::length(glm::vec3(trans[2]))});
+
 		BSphere sphere = {
-			.center = extractTranslation(trans),
-			.extent = particles->radius,
+			.center = applyTransform(trans, particles->center),
+			.extent = particles->radius * scale,
 		};
 
 		if (cam->sphereInFrustum(sphere)) {
@@ -533,6 +681,219 @@ void grendx::cullQueue(renderQueue& queue,
 		}
 	}
 	queue.instancedMeshes = tempInstanced;
+
+	std::vector<std::tuple<glm::mat4, bool,
+	                       sceneBillboardParticles::ptr,
+	                       sceneMesh::ptr>> tempBillboards;
+
+	tempBillboards.reserve(queue.billboardMeshes.size());
+	for (auto& ent : queue.billboardMeshes) {
+		auto& particles = std::get<2>(ent);
+
+		// billboard positions are already in world space
+		BSphere sphere = {
+			.center = particles->center,
+			.extent = particles->radius,
+		};
+
+		if (cam->sphereInFrustum(sphere)) {
+			tempBillboards.push_back(ent);
+		}
+	}
+	queue.billboardMeshes = tempBillboards;
+
+	if (auto occl = engine::Services().tryResolve<occlusionCuller>()) {
+		occlusionCullQueue(queue, cam, *occl, pass);
+	}
+
+	if (auto lods = engine::Services().tryResolve<lodSelector>()) {
+		selectLods(queue, cam, height, *lods, pass);
+	}
+}
+
+void grendx::occlusionCullQueue(renderQueue& queue,
+                                camera::ptr cam,
+                                occlusionCuller& culler,
+                                lodPass pass)
+{
+	auto& settings = culler.settings;
+
+	// occluder selection assumes a perspective projection
+	if (!settings.enabled || !settings.passes[size_t(pass)]
+	    || cam->project() != camera::projection::Perspective)
+	{
+		return;
+	}
+
+	GREND_PROFILE_FUNCTION();
+	uint64_t start = profile::now();
+
+	struct candidate {
+		size_t index;
+		float  size;
+	};
+
+	// biggest on screen first, until the triangle budget runs out
+	std::vector<candidate> candidates;
+	const glm::vec3& campos = cam->position();
+	float tanHalf = tanf(glm::radians(cam->fovy()) * 0.5f);
+
+	for (size_t i = 0; i < queue.meshes.size(); i++) {
+		auto& ent = queue.meshes[i];
+
+		if (!ent.data->occluder) {
+			continue;
+		}
+
+		BSphere sphere = ent.transform * ent.data->boundingSphere;
+		float dist = std::max(glm::distance(campos, sphere.center), 1e-3f);
+		float size = sphere.extent / (dist * tanHalf);
+
+		if (size >= settings.minOccluderSize) {
+			candidates.push_back({i, size});
+		}
+	}
+
+	if (candidates.empty()) {
+		return;
+	}
+
+	std::sort(candidates.begin(), candidates.end(),
+		[] (const candidate& a, const candidate& b) { return a.size > b.size; });
+
+	glm::mat4 viewProj = cam->viewProjTransform();
+	auto& buffer = culler.buffer;
+	auto& stats  = culler.current;
+	std::vector<bool> isOccluder(queue.meshes.size(), false);
+	size_t passTriangles = 0;
+
+	buffer.clear();
+
+	for (auto& c : candidates) {
+		auto& ent  = queue.meshes[c.index];
+		auto& mesh = ent.data;
+
+		// vertices are in the model the mesh belongs to
+		auto parent = mesh->parent;
+		if (!parent || parent->type != sceneNode::objType::Model) {
+			continue;
+		}
+
+		sceneModel::ptr model = ref_cast<sceneModel>(parent);
+
+		auto vertBuf = model->get<ecs::bufferComponent<sceneModel::vertex>>();
+		auto faceBuf = mesh->get<ecs::bufferComponent<sceneMesh::faceType>>();
+
+		if (!vertBuf || !faceBuf || vertBuf->data.empty()) {
+			continue;
+		}
+
+		// full detail, simplified LODs can bulge out past the real surface
+		// and hide things that are actually visible
+		auto& faces = faceBuf->data;
+		size_t triangles = faces.size() / 3;
+
+		// budget is per pass, shadow faces culled earlier in the frame
+		// shouldn't eat into the main view's occluders. Smaller occluders
+		// after this one might still fit.
+		if (passTriangles + triangles > settings.maxOccluderTriangles) {
+			continue;
+		}
+
+		auto& verts = vertBuf->data;
+		buffer.addOccluder(viewProj * ent.transform,
+		                   &verts[0].position.x, sizeof(sceneModel::vertex), verts.size(),
+		                   reinterpret_cast<const uint32_t*>(faces.data()), faces.size());
+
+		isOccluder[c.index] = true;
+		passTriangles += triangles;
+		stats.occluders++;
+	}
+
+	stats.occluderTriangles += passTriangles;
+	buffer.rasterize(engine::Services().tryResolve<jobQueue>());
+
+	uint64_t rasterized = profile::now();
+	stats.rasterizeTime += rasterized - start;
+	stats.passes++;
+
+	auto doCull = [&] (renderQueue::MeshQ& que, const std::vector<bool> *skip) {
+		size_t write = 0;
+
+		for (size_t i = 0; i < que.size(); i++) {
+			auto& ent = que[i];
+			bool visible = (skip && (*skip)[i])
+				|| buffer.testAABB(viewProj * ent.transform, ent.data->boundingBox);
+
+			stats.tested++;
+			stats.culled += !visible;
+
+			if (visible) {
+				if (write != i) que[write] = std::move(ent);
+				write++;
+			}
+		}
+
+		que.resize(write);
+	};
+
+	doCull(queue.meshes,       &isOccluder);
+	doCull(queue.meshesMasked, nullptr);
+	doCull(queue.meshesBlend,  nullptr);
+
+	stats.testTime += profile::now() - rasterized;
+}
+
+void grendx::selectLods(renderQueue& queue,
+                        camera::ptr cam,
+                        unsigned height,
+                        lodSelector& lods,
+                        lodPass pass)
+{
+	const glm::vec3& campos = cam->position();
+	bool ortho = cam->project() == camera::projection::Orthographic;
+
+	auto doSelect = [&] (renderQueue::MeshQ& que) {
+		for (auto& ent : que) {
+			auto& comped = ent.data->comped_mesh;
+			auto& ranges = comped->lods;
+			ent.lod = 0;
+
+			if (ranges.empty()) {
+				continue;
+			}
+
+			// errors are in object space, scale by the largest axis
+			glm::mat3 m(ent.transform);
+			float scale = std::max({glm::length(m[0]), glm::length(m[1]), glm::length(m[2])});
+			BSphere sphere = ent.transform * ent.data->boundingSphere;
+
+			// nearest point of the bounding sphere, conservative for
+			// large meshes
+			float dist = glm::distance(campos, sphere.center) - sphere.extent;
+			float pixelScale = ortho
+				? 1.f / cam->scale()
+				: lodPixelScale(cam->fovy(), height, dist);
+
+			if (dist > 0 || ortho) {
+				float errors[16];
+				size_t levels = std::min(ranges.size(), size_t(16));
+
+				for (size_t i = 0; i < levels; i++) {
+					errors[i] = ranges[i].error;
+				}
+
+				ent.lod = lods.select(ent.data.getPtr(), ent.instance, pass,
+				                      errors, levels, pixelScale * scale);
+			}
+
+			lods.addTriangles(pass, ranges[ent.lod].count / 3, ranges[0].count / 3);
+		}
+	};
+
+	doSelect(queue.meshes);
+	doSelect(queue.meshesBlend);
+	doSelect(queue.meshesMasked);
 }
 
 void grendx::batchQueue(renderQueue& queue) {
@@ -572,11 +933,12 @@ void grendx::batchQueue(renderQueue& queue) {
 
 		auto& batch = batches[mesh];
 
-		if (batch->activeInstances < batch->maxInstances) {
-			// TODO: if more than 256 meshes, add new instance buffer
-			batch->positions[batch->activeInstances] = trans;
-			batch->activeInstances++;
+		if (batch->activeInstances == batch->maxInstances) {
+			batch->resize(2*batch->maxInstances);
 		}
+
+		batch->positions[batch->activeInstances] = trans;
+		batch->activeInstances++;
 	}
 
 	for (auto& [mesh, particles] : batches) {
@@ -611,7 +973,8 @@ static void drawMesh(const renderOptions& flags,
                      const glm::mat4& transform,
                      bool inverted,
                      uint32_t renderID,
-                     sceneMesh::ptr mesh)
+                     sceneMesh::ptr mesh,
+                     unsigned lod = 0)
 {
 	/*
 	if (fb != nullptr && hasFlag(flags.features, renderFlags::StencilTest)) {
@@ -646,9 +1009,17 @@ static void drawMesh(const renderOptions& flags,
 	glLineWidth(2.0);
 	enable(GL_LINE_SMOOTH);
 	*/
-	glDrawElements(GL_TRIANGLES,
-	               mesh->comped_mesh->elements->currentSize / 4 /* sizeof uint */,
-	               GL_UNSIGNED_INT, 0);
+	auto& lods = mesh->comped_mesh->lods;
+
+	if (lod < lods.size()) {
+		glDrawElements(GL_TRIANGLES, lods[lod].count, GL_UNSIGNED_INT,
+		               (void*)(lods[lod].offset * sizeof(GLuint)));
+
+	} else {
+		glDrawElements(GL_TRIANGLES,
+		               mesh->comped_mesh->elements->currentSize / 4 /* sizeof uint */,
+		               GL_UNSIGNED_INT, 0);
+	}
 	DO_ERROR_CHECK();
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
@@ -706,13 +1077,17 @@ static void drawMeshInstanced(const renderOptions& flags,
 
 #if GLSL_VERSION >= 140
 	particles->syncBuffer();
-	program->setUniformBlock("instanceTransforms", particles->ubuffer,
-	                         UBO_INSTANCE_TRANSFORMS);
-	glDrawElementsInstanced(
-		GL_TRIANGLES,
-		mesh->comped_mesh->elements->currentSize / 4 /* sizeof uint */,
-		GL_UNSIGNED_INT, 0, particles->activeInstances);
-	DO_ERROR_CHECK();
+
+	// one draw per uniform buffer worth of instances
+	for (unsigned i = 0; unsigned count = particles->bufferInstances(i); i++) {
+		program->setUniformBlock("instanceTransforms", particles->ubuffers[i],
+		                         UBO_INSTANCE_TRANSFORMS);
+		glDrawElementsInstanced(
+			GL_TRIANGLES,
+			mesh->comped_mesh->elements->currentSize / 4 /* sizeof uint */,
+			GL_UNSIGNED_INT, 0, count);
+		DO_ERROR_CHECK();
+	}
 
 #else
 	for (unsigned i = 0; i < particles->activeInstances; i++) {
@@ -753,13 +1128,16 @@ static void drawBillboards(const renderOptions& flags,
 
 #if GLSL_VERSION >= 140
 	particles->syncBuffer();
-	program->setUniformBlock("billboardPositions", particles->ubuffer,
-	                         UBO_INSTANCE_TRANSFORMS);
-	glDrawElementsInstanced(
-		GL_TRIANGLES,
-		mesh->comped_mesh->elements->currentSize / 4 /* sizeof uint */,
-		GL_UNSIGNED_INT, 0, particles->activeInstances);
-	DO_ERROR_CHECK();
+
+	for (unsigned i = 0; unsigned count = particles->bufferInstances(i); i++) {
+		program->setUniformBlock("billboardPositions", particles->ubuffers[i],
+		                         UBO_INSTANCE_TRANSFORMS);
+		glDrawElementsInstanced(
+			GL_TRIANGLES,
+			mesh->comped_mesh->elements->currentSize / 4 /* sizeof uint */,
+			GL_UNSIGNED_INT, 0, count);
+		DO_ERROR_CHECK();
+	}
 
 #else
 	for (unsigned i = 0; i < particles->activeInstances; i++) {
@@ -874,7 +1252,7 @@ unsigned grendx::flush(renderQueue& que,
 
 			trySetIrradProbe(que, rctx, options, skinnedProg, mesh.center);
 			drawMesh(options, nullptr, skinnedProg, mesh.transform,
-			         mesh.inverted, mesh.renderID, mesh.data);
+			         mesh.inverted, mesh.renderID, mesh.data, mesh.lod);
 		}
 	}
 
@@ -883,7 +1261,7 @@ unsigned grendx::flush(renderQueue& que,
 	for (auto& mesh : que.meshes) {
 		trySetIrradProbe(que, rctx, options, mainProg, mesh.center);
 		drawMesh(options, nullptr, mainProg, mesh.transform,
-		         mesh.inverted, mesh.renderID, mesh.data);
+		         mesh.inverted, mesh.renderID, mesh.data, mesh.lod);
 		drawnMeshes++;
 	}
 
@@ -941,7 +1319,7 @@ unsigned grendx::flush(renderQueue& que,
 
 			trySetIrradProbe(que, rctx, options, skinnedProg, mesh.center);
 			drawMesh(options, fb, skinnedProg, mesh.transform,
-			         mesh.inverted, mesh.renderID, mesh.data);
+			         mesh.inverted, mesh.renderID, mesh.data, mesh.lod);
 			drawnMeshes++;
 		}
 
@@ -953,7 +1331,7 @@ unsigned grendx::flush(renderQueue& que,
 	for (auto& mesh : que.meshes) {
 		trySetIrradProbe(que, rctx, options, mainProg, mesh.center);
 		drawMesh(options, fb, mainProg, mesh.transform,
-		         mesh.inverted, mesh.renderID, mesh.data);
+		         mesh.inverted, mesh.renderID, mesh.data, mesh.lod);
 		drawnMeshes++;
 	}
 
@@ -961,7 +1339,7 @@ unsigned grendx::flush(renderQueue& que,
 	for (auto& mesh : que.meshesMasked) {
 		trySetIrradProbe(que, rctx, options, maskedMain, mesh.center);
 		drawMesh(options, fb, maskedMain, mesh.transform,
-		         mesh.inverted, mesh.renderID, mesh.data);
+		         mesh.inverted, mesh.renderID, mesh.data, mesh.lod);
 		drawnMeshes++;
 	}
 
@@ -972,7 +1350,7 @@ unsigned grendx::flush(renderQueue& que,
 		for (auto& mesh : que.meshesBlend) {
 			trySetIrradProbe(que, rctx, options, blendMain, mesh.center);
 			drawMesh(options, fb, blendMain, mesh.transform,
-			         mesh.inverted, mesh.renderID, mesh.data);
+			         mesh.inverted, mesh.renderID, mesh.data, mesh.lod);
 			drawnMeshes++;
 		}
 
@@ -982,7 +1360,7 @@ unsigned grendx::flush(renderQueue& que,
 		for (auto& mesh : que.meshesBlend) {
 			trySetIrradProbe(que, rctx, options, mainProg, mesh.center);
 			drawMesh(options, fb, mainProg, mesh.transform,
-			         mesh.inverted, mesh.renderID, mesh.data);
+			         mesh.inverted, mesh.renderID, mesh.data, mesh.lod);
 			drawnMeshes++;
 		}
 		disable(GL_BLEND);
@@ -1002,7 +1380,7 @@ unsigned grendx::flush(renderQueue& que,
 		for (auto& mesh : que.meshesBlend) {
 			trySetIrradProbe(que, rctx, options, flags.mainShader, mesh.center);
 			drawMesh(options, fb, flags.mainShader, mesh.transform,
-					 mesh.inverted, mesh.renderID, mesh.data);
+					 mesh.inverted, mesh.renderID, mesh.data, mesh.lod);
 			drawnMeshes++;
 		}
 		disable(GL_BLEND);
@@ -1026,6 +1404,11 @@ unsigned grendx::flush(renderQueue& que,
 	glDepthMask(GL_FALSE);
 
 	for (auto& [transform, inverted, particleSystem, mesh] : que.billboardMeshes) {
+		// billboard positions are in world space
+		if (particleSystem->depthSort) {
+			particleSystem->sortByDepth(cam->position());
+		}
+
 		trySetIrradProbe(que, rctx, options, billboardProg,
 		                 extractTranslation(transform));
 		drawBillboards(options, fb, billboardProg,
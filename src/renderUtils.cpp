@@ -97,7 +97,7 @@ void grendx::drawMultiQueue(multiRenderQueue& que,
 	}
 
 	updateLights(rend, hax);
-	updateReflections(rend, hax);
+	updateReflections(rend, hax, cam);
 	buildTilemap(hax.lights, cam, rend);
 	updateReflectionProbe(rend, hax, cam);
 
@@ -188,7 +188,8 @@ void buildClickableRec(clickableEntities& clicks,
                        renderQueue& que,
                        uint32_t renderID,
                        glm::mat4 trans,
-                       bool inverted)
+                       bool inverted,
+                       uint64_t path)
 {
 	using namespace grendx;
 	using namespace ecs;
@@ -197,6 +198,7 @@ void buildClickableRec(clickableEntities& clicks,
 
 	glm::mat4 adjTrans;
 	bool adjInverted;
+	uint64_t adjPath = instancePath(path, obj.getPtr());
 
 	getNodeTransform(obj, trans, inverted, adjTrans, adjInverted);
 
@@ -204,14 +206,15 @@ void buildClickableRec(clickableEntities& clicks,
 		renderID = clicks.add(obj.getPtr());
 	}
 
-	if (que.addNode(obj, renderID, adjTrans, adjInverted)) {
+	if (que.addNode(obj, renderID, adjTrans, adjInverted, adjPath)) {
 		for (auto ptr : obj->nodes()) {
 			buildClickableRec(clicks,
 			                  ptr->getRef(),
 			                  que,
 			                  renderID,
 			                  adjTrans,
-			                  adjInverted);
+			                  adjInverted,
+			                  adjPath);
 		}
 	}
 }
@@ -220,7 +223,7 @@ void grendx::buildClickableImports(clickableEntities& clicks,
                                    sceneNode::ptr obj,
                                    renderQueue& que)
 {
-	buildClickableRec(clicks, obj, que, 0, glm::mat4(1), false);
+	buildClickableRec(clicks, obj, que, 0, glm::mat4(1), false, 0);
 }
 
 void grendx::setPostUniforms(renderPostChain::ptr post,
@@ -4,12 +4,16 @@
 #include <grend/sceneModel.hpp>
 #include <grend/utility.hpp>
 #include <grend/logger.hpp>
+#include <grend/shaderPreprocess.hpp>
+#include <grend/textureCache.hpp>
 
 #include <vector>
 #include <map>
 #include <iostream>
 #include <algorithm>
 #include <array>
+#include <string.h>
+#include <stdlib.h>
 
 using namespace grendx;
 
@@ -21,7 +25,9 @@ void renderContext::applySettings(const renderSettings& newsettings) {
 
 	atlases = renderAtlases(settings.reflectionAtlasSize,
 	                        settings.shadowAtlasSize,
-	                        settings.lightProbeAtlasSize);
+	                        settings.lightProbeAtlasSize,
+	                        1024,
+	                        settings.staticShadowAtlasSize);
 
 	unsigned adjX = settings.targetResX * settings.scaleX;
 	unsigned adjY = settings.targetResY * settings.scaleY;
@@ -112,21 +118,21 @@ renderContext::renderContext(SDLContext& ctx, const renderSettings& _settings) {
 	default_material.factors.refract_idx = 1.5,
 
 	default_material.maps.diffuse
-		= std::make_shared<textureData>(GR_PREFIX "assets/tex/white.png"),
+		= textureFiles().load(GR_PREFIX "assets/tex/white.png"),
 	default_material.maps.metalRoughness
-		= std::make_shared<textureData>(GR_PREFIX "assets/tex/white.png"),
+		= textureFiles().load(GR_PREFIX "assets/tex/white.png"),
 	default_material.maps.normal
-		= std::make_shared<textureData>(GR_PREFIX "assets/tex/lightblue-normal.png"),
+		= textureFiles().load(GR_PREFIX "assets/tex/lightblue-normal.png"),
 	default_material.maps.ambientOcclusion
-		= std::make_shared<textureData>(GR_PREFIX "assets/tex/white.png"),
+		= textureFiles().load(GR_PREFIX "assets/tex/white.png"),
 	/*
 	default_material.maps.emissive
-		= std::make_shared<textureData>(GR_PREFIX "assets/tex/black.png"),
+		= textureFiles().load(GR_PREFIX "assets/tex/black.png"),
 		*/
 	default_material.maps.emissive
-		= std::make_shared<textureData>(GR_PREFIX "assets/tex/white.png"),
+		= textureFiles().load(GR_PREFIX "assets/tex/white.png"),
 	default_material.maps.lightmap
-		= std::make_shared<textureData>(GR_PREFIX "assets/tex/black.png"),
+		= textureFiles().load(GR_PREFIX "assets/tex/black.png"),
 
 	default_compiledMat = matcache(&default_material);
 
@@ -134,6 +140,33 @@ renderContext::renderContext(SDLContext& ctx, const renderSettings& _settings) {
 	LogInfo("Initialized render context");
 }
 
+// options for each blend mode variant, in renderFlags variant order
+static Shader::parameters variantOptions(unsigned i) {
+	using R = renderFlags;
+
+	return {
+		{"BLEND_MODE_OPAQUE",          (GLint)(i == R::Opaque)},
+		{"BLEND_MODE_DITHERED_BLEND",  (GLint)(i == R::DitheredBlend)},
+		{"BLEND_MODE_MASKED",          (GLint)(i == R::Masked)},
+	};
+}
+
+// every (source, options) pair that loadShaderToFlags() will load
+static void flagsShaderFiles(std::vector<shaderFileOptions>& out,
+                             const std::string& fragPath,
+                             const std::array<std::string, renderFlags::MaxShaders>& verts,
+                             const Shader::parameters& opts)
+{
+	for (unsigned i = 0; i < renderFlags::MaxVariants; i++) {
+		auto usr = mergeOpts({opts, variantOptions(i)});
+
+		out.push_back({fragPath, usr});
+		for (auto& vert : verts) {
+			out.push_back({vert, usr});
+		}
+	}
+}
+
 renderFlags grendx::loadShaderToFlags(std::string fragPath,
                                       std::string mainVertex,
                                       std::string skinnedVertex,
@@ -143,25 +176,20 @@ renderFlags grendx::loadShaderToFlags(std::string fragPath,
 {
 	renderFlags ret;
 
-	LogFmt("Loading shaders for fragment shader {}", fragPath);
+	LogCatFmt(logcat::render, Debug, "Loading shaders for fragment shader {}", fragPath);
 
 	using R = renderFlags;
 
-	static const std::array<std::string, R::MaxVariants> modestrs = {
-		"opaque",
-		"blend",
-		"masked",
-	};
+	// preprocess everything up front on worker threads, these are cache
+	// hits if loadShaders() already did a batch with these files
+	std::vector<shaderFileOptions> files;
+	flagsShaderFiles(files, fragPath,
+	                 {mainVertex, skinnedVertex, instancedVertex, billboardVertex},
+	                 opts);
+	preprocessShaderFiles(files);
 
 	for (unsigned i = 0; i < R::MaxVariants; i++) {
-		const std::string str = modestrs[i];
-		Shader::parameters usropts = {
-			{"BLEND_MODE_OPAQUE",          (GLint)(i == R::Opaque)},
-			{"BLEND_MODE_DITHERED_BLEND",  (GLint)(i == R::DitheredBlend)},
-			{"BLEND_MODE_MASKED",          (GLint)(i == R::Masked)},
-		};
-		//{"BLEND_MODE_OPAQUE" + modestrs[i], 1}};
-		auto usr = mergeOpts({opts, usropts});
+		auto usr = mergeOpts({opts, variantOptions(i)});
 		auto& var = ret.variants[i];
 
 		var.shaders[R::Main]      = loadProgram(mainVertex,      fragPath, usr);
@@ -197,37 +225,58 @@ renderFlags grendx::loadShaderToFlags(std::string fragPath,
 	return ret;
 }
 
-renderFlags grendx::loadLightingShader(std::string fragmentPath,
-                                       const Shader::parameters& options)
+static const std::array<std::string, renderFlags::MaxShaders> lightingVertices = {
+	GR_PREFIX "shaders/baked/pixel-shading.vert",
+	GR_PREFIX "shaders/baked/pixel-shading-skinned.vert",
+	GR_PREFIX "shaders/baked/pixel-shading-instanced.vert",
+	GR_PREFIX "shaders/baked/pixel-shading-billboard.vert",
+};
+
+static const std::array<std::string, renderFlags::MaxShaders> vertexLightingVertices = {
+	GR_PREFIX "shaders/baked/vertex-shading.vert",
+	GR_PREFIX "shaders/baked/vertex-shading-skinned.vert",
+	GR_PREFIX "shaders/baked/vertex-shading-instanced.vert",
+	GR_PREFIX "shaders/baked/vertex-shading-billboard.vert",
+};
+
+// TODO: rename
+static const std::array<std::string, renderFlags::MaxShaders> probeVertices = {
+	GR_PREFIX "shaders/baked/ref_probe.vert",
+	GR_PREFIX "shaders/baked/ref_probe-skinned.vert",
+	GR_PREFIX "shaders/baked/ref_probe-instanced.vert",
+	GR_PREFIX "shaders/baked/ref_probe-billboard.vert",
+};
+
+static const char *postVertex = GR_PREFIX "shaders/baked/postprocess.vert";
+
+static renderFlags loadFlags(const std::string& fragmentPath,
+                             const std::array<std::string, renderFlags::MaxShaders>& verts,
+                             const Shader::parameters& options)
 {
 	return loadShaderToFlags(fragmentPath,
-		GR_PREFIX "shaders/baked/pixel-shading.vert",
-		GR_PREFIX "shaders/baked/pixel-shading-skinned.vert",
-		GR_PREFIX "shaders/baked/pixel-shading-instanced.vert",
-		GR_PREFIX "shaders/baked/pixel-shading-billboard.vert",
+		verts[renderFlags::Main],
+		verts[renderFlags::Skinned],
+		verts[renderFlags::Instanced],
+		verts[renderFlags::Billboard],
 		options);
 }
 
+renderFlags grendx::loadLightingShader(std::string fragmentPath,
+                                       const Shader::parameters& options)
+{
+	return loadFlags(fragmentPath, lightingVertices, options);
+}
+
 renderFlags grendx::loadProbeShader(std::string fragmentPath,
                                     const Shader::parameters& options)
 {
-	return loadShaderToFlags(fragmentPath,
-		// TODO: rename
-		GR_PREFIX "shaders/baked/ref_probe.vert",
-		GR_PREFIX "shaders/baked/ref_probe-skinned.vert",
-		GR_PREFIX "shaders/baked/ref_probe-instanced.vert",
-		GR_PREFIX "shaders/baked/ref_probe-billboard.vert",
-		options);
+	return loadFlags(fragmentPath, probeVertices, options);
 }
 
 Program::ptr grendx::loadPostShader(std::string fragmentPath,
                                     const Shader::parameters& options)
 {
-	Program::ptr ret = loadProgram(
-		GR_PREFIX "shaders/baked/postprocess.vert",
-		fragmentPath,
-		options
-	);
+	Program::ptr ret = loadProgram(postVertex, fragmentPath, options);
 
 	ret->attribute("v_position", VAO_QUAD_VERTICES);
 	ret->attribute("v_texcoord", VAO_QUAD_TEXCOORDS);
@@ -236,62 +285,98 @@ Program::ptr grendx::loadPostShader(std::string fragmentPath,
 	return ret;
 }
 
+struct flagsShader {
+	enum { Lighting, Probe } target;
+	const char *name;
+	std::string fragment;
+	const std::array<std::string, renderFlags::MaxShaders>& vertices;
+};
+
+static const flagsShader flagShaders[] = {
+	{flagsShader::Lighting, "pixel-metalroughness",
+	 GR_PREFIX "shaders/baked/pixel-shading-metal-roughness-pbr.frag", lightingVertices},
+	{flagsShader::Lighting, "pixel-matcap",
+	 GR_PREFIX "shaders/baked/pixel-shading-matcap.frag", lightingVertices},
+	{flagsShader::Lighting, "pixel-normal",
+	 GR_PREFIX "shaders/baked/normals.frag", lightingVertices},
+	{flagsShader::Lighting, "vertex-metalroughness",
+	 GR_PREFIX "shaders/baked/vertex-shading.frag", vertexLightingVertices},
+	{flagsShader::Lighting, "pixel-blinn-phong",
+	 GR_PREFIX "shaders/baked/pixel-shading.frag", lightingVertices},
+	{flagsShader::Lighting, "unshaded",
+	 GR_PREFIX "shaders/baked/unshaded.frag", lightingVertices},
+	{flagsShader::Lighting, "constant-color",
+	 GR_PREFIX "shaders/baked/constant-color.frag", lightingVertices},
+	{flagsShader::Probe, "refprobe",
+	 GR_PREFIX "shaders/baked/ref_probe.frag", probeVertices},
+	{flagsShader::Probe, "shadow",
+	 GR_PREFIX "shaders/baked/depth.frag", probeVertices},
+};
+
+static const char *postNames[] = {
+	"tonemap", "psaa", "irradiance-convolve",
+	"specular-convolve", "quadtest", "fog-depth",
+};
+
+std::vector<shaderFileOptions> grendx::engineShaderFiles(const Shader::parameters& opts) {
+	std::vector<shaderFileOptions> files;
+
+	for (auto& shader : flagShaders) {
+		flagsShaderFiles(files, shader.fragment, shader.vertices, opts);
+	}
+
+	files.push_back({postVertex, opts});
+	for (auto name : postNames) {
+		files.push_back({GR_PREFIX "shaders/baked/" + std::string(name) + ".frag", opts});
+	}
+
+	files.push_back({GR_PREFIX "shaders/baked/ref_probe_debug.vert",  opts});
+	files.push_back({GR_PREFIX "shaders/baked/ref_probe_debug.frag",  opts});
+	files.push_back({GR_PREFIX "shaders/baked/irrad_probe_debug.frag", opts});
+
+	return files;
+}
+
 void renderContext::loadShaders(void) {
 	LogInfo("Loading shaders");
 
-	lightingShaders["pixel-metalroughness"] =
-		loadLightingShader(
-			GR_PREFIX "shaders/baked/pixel-shading-metal-roughness-pbr.frag",
-			globalShaderOptions);
-
-	lightingShaders["pixel-matcap"] =
-		loadLightingShader(
-			GR_PREFIX "shaders/baked/pixel-shading-matcap.frag",
-			globalShaderOptions);
-
-	lightingShaders["pixel-normal"] =
-		loadLightingShader(
-			GR_PREFIX "shaders/baked/normals.frag",
-			globalShaderOptions);
-
-	lightingShaders["vertex-metalroughness"] =
-		loadShaderToFlags(GR_PREFIX "shaders/baked/vertex-shading.frag",
-			GR_PREFIX "shaders/baked/vertex-shading.vert",
-			GR_PREFIX "shaders/baked/vertex-shading-skinned.vert",
-			GR_PREFIX "shaders/baked/vertex-shading-instanced.vert",
-			GR_PREFIX "shaders/baked/vertex-shading-billboard.vert",
-			globalShaderOptions);
+	// packed shaders built by shaderComp --pack, if available, skips
+	// preprocessing entirely. GREND_SHADER_PACK=0 to use the sources.
+	static bool packLoaded = false;
+	const char *usePack = getenv("GREND_SHADER_PACK");
+	auto files = engineShaderFiles(globalShaderOptions);
+
+	if (!packLoaded && !(usePack && strcmp(usePack, "0") == 0)) {
+		packLoaded = shaderSources().loadPack(GR_PREFIX "shaders/baked/engine.pack");
+
+		// pack keys include the option defines, a pack built with other
+		// options loads fine but never matches anything
+		if (packLoaded && !files.empty()
+		    && !shaderSources().isPacked(files[0].first,
+		                                 shaderDefineHeader(files[0].second)))
+		{
+			LogCatFmt(logcat::render, Warning,
+			          "engine.pack wasn't built with the current shader options, "
+			          "rebuild it with GREND_SHADER_PACK_OPTIONS set to match");
+		}
+	}
+
+	// preprocess every shader source in one parallel batch, compiling and
+	// linking has to happen here on the main thread
+	preprocessShaderFiles(files);
+
+	for (auto& shader : flagShaders) {
+		auto& target = (shader.target == flagsShader::Lighting)
+			? lightingShaders
+			: probeShaders;
+
+		target[shader.name] =
+			loadFlags(shader.fragment, shader.vertices, globalShaderOptions);
+	}
 
 	lightingShaders["main"] = lightingShaders["pixel-metalroughness"];
 
-	lightingShaders["pixel-blinn-phong"] =
-		loadLightingShader(
-			GR_PREFIX "shaders/baked/pixel-shading.frag",
-			globalShaderOptions);
-
-	lightingShaders["unshaded"] = 
-		loadLightingShader(
-			GR_PREFIX "shaders/baked/unshaded.frag",
-			globalShaderOptions);
-
-	lightingShaders["constant-color"] =
-		loadLightingShader(
-			GR_PREFIX "shaders/baked/constant-color.frag",
-			globalShaderOptions);
-
-	probeShaders["refprobe"] =
-		loadProbeShader(
-			GR_PREFIX "shaders/baked/ref_probe.frag",
-			globalShaderOptions);
-
-	probeShaders["shadow"] =
-		loadProbeShader(
-			GR_PREFIX "shaders/baked/depth.frag",
-			globalShaderOptions);
-
-	for (auto& name : {"tonemap", "psaa", "irradiance-convolve",
-	                    "specular-convolve", "quadtest", "fog-depth"})
-	{
+	for (auto name : postNames) {
 		postShaders[name] =
 			loadPostShader(
 				GR_PREFIX "shaders/baked/" + std::string(name) + ".frag",
@@ -4,6 +4,7 @@
 #include <grend/textureAtlas.hpp>
 #include <grend/timers.hpp>
 #include <grend/logger.hpp>
+#include <grend/shadowCache.hpp>
 
 using namespace grendx;
 
@@ -31,7 +32,226 @@ static const glm::vec3 cube_up[] = {
 	{ 0,  1,  0},
 };
 
-// TODO: minimize duplicated code with drawReflectionProbe
+// queues the meshes that could cast shadows onto anything within the light's
+// radius, so faces only cull the few meshes near the light rather than the
+// entire frame queue. Meshes that haven't moved in a while go in
+// staticCasters, if there's a cache to track that.
+static void gatherShadowCasters(renderQueue& queue,
+                                const BSphere& bounds,
+                                shadowCache *cache,
+                                renderQueue& staticCasters,
+                                renderQueue& dynamicCasters)
+{
+	auto inRadius = [&] (auto& ent) {
+		BSphere sphere = ent.transform * ent.data->boundingSphere;
+		return glm::distance(sphere.center, bounds.center)
+		       < sphere.extent + bounds.extent;
+	};
+
+	for (auto& ent : queue.meshes) {
+		if (!inRadius(ent)) {
+			continue;
+		}
+
+		if (cache && cache->isStatic(ent.data.getPtr(), ent.transform)) {
+			staticCasters.meshes.push_back(ent);
+		} else {
+			dynamicCasters.meshes.push_back(ent);
+		}
+	}
+
+	// skinned meshes are assumed to be animated, always dynamic
+	for (auto& [skin, skmeshes] : queue.skinnedMeshes) {
+		for (auto& ent : skmeshes) {
+			if (inRadius(ent)) {
+				dynamicCasters.skinnedMeshes[skin].push_back(ent);
+			}
+		}
+	}
+
+	if (cache) {
+		cache->current.lights++;
+		cache->current.staticCasters += staticCasters.meshes.size();
+		cache->current.casters += staticCasters.meshes.size()
+		                          + dynamicCasters.meshes.size();
+	}
+}
+
+// order-independent signature of the casters that are visible from the
+// face camera, seeded with the camera transform so that moving the light
+// changes it too
+static uint64_t shadowSignature(renderQueue& casters,
+                                camera::ptr cam,
+                                uint32_t frame,
+                                size_t& count)
+{
+	uint64_t sig = shadowCasterHash(nullptr, cam->viewProjTransform());
+	count = 0;
+
+	for (auto& ent : casters.meshes) {
+		if (cam->sphereInFrustum(ent.transform * ent.data->boundingSphere)) {
+			sig += shadowCasterHash(ent.data.getPtr(), ent.transform);
+			count++;
+		}
+	}
+
+	for (auto& [skin, skmeshes] : casters.skinnedMeshes) {
+		for (auto& ent : skmeshes) {
+			if (cam->sphereInFrustum(ent.transform * ent.data->boundingSphere)) {
+				// poses aren't tracked, so faces with skinned meshes
+				// are redrawn every frame
+				sig += shadowCasterHash(ent.data.getPtr(), ent.transform) + frame;
+				count++;
+			}
+		}
+	}
+
+	return sig;
+}
+
+static void drawShadowCasters(renderQueue& casters,
+                              camera::ptr cam,
+                              unsigned size,
+                              renderContext *rctx,
+                              const renderFlags& flags,
+                              const renderOptions& opts)
+{
+	renderQueue porque = casters;
+
+	cullQueue(porque, cam, size, size, rctx->lightThreshold, lodPass::Shadow);
+	sortQueue(porque, cam);
+	flush(porque, cam, size, size, rctx, flags, opts);
+}
+
+// redraws one shadow map face if anything visible from it changed, static
+// casters are drawn into the static atlas and copied in before drawing
+// the dynamic ones. Returns false if the face couldn't be drawn.
+static bool updateShadowFace(quadtree::node_id id,
+                             camera::ptr cam,
+                             renderQueue& staticCasters,
+                             renderQueue& dynamicCasters,
+                             shadowCache *cache,
+                             shadowCache::faceState *state,
+                             bool force,
+                             renderContext *rctx,
+                             const renderFlags& flags,
+                             const renderOptions& opts)
+{
+	auto& shadows = rctx->atlases.shadows;
+	auto& statics = rctx->atlases.staticShadows;
+
+	// TODO: texture atlas should have some tree wrappers, just for
+	//       clean encapsulation...
+	quadinfo info = shadows->tree.info(id);
+	if (!info.valid) {
+		return false;
+	}
+
+	cam->setViewport(info.size, info.size);
+
+	if (!cache || !state) {
+		if (!shadows->bind_atlas_fb(id)) {
+			return false;
+		}
+
+		glClear(GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
+		drawShadowCasters(dynamicCasters, cam, info.size, rctx, flags, opts);
+		return true;
+	}
+
+	size_t staticCount, dynamicCount;
+	uint64_t staticSig  = shadowSignature(staticCasters,  cam, cache->frameNumber(), staticCount);
+	uint64_t dynamicSig = shadowSignature(dynamicCasters, cam, cache->frameNumber(), dynamicCount);
+
+	bool haveStatic = statics && staticCount > 0;
+	bool needStatic = false;
+
+	if (haveStatic) {
+		// refresh atlas cache time, same as the live shadow maps
+		state->staticMap = statics->tree.refresh(state->staticMap);
+		quadinfo sinfo   = statics->tree.info(state->staticMap);
+
+		needStatic = !sinfo.valid
+		          || sinfo.size != info.size
+		          || state->staticSig != staticSig;
+	}
+
+	bool usable = state->drawn && state->liveMap == id;
+	bool stale  = force || needStatic || !usable
+	           || state->staticSig  != staticSig
+	           || state->dynamicSig != dynamicSig;
+
+	if (!stale) {
+		cache->current.facesSkipped++;
+		return true;
+	}
+
+	if (!cache->takeBudget(usable)) {
+		// keep the old map for now, still stale next frame
+		cache->current.facesDeferred++;
+		return true;
+	}
+
+	GREND_PROFILE_ZONE("Shadow face");
+
+	if (needStatic) {
+		if (statics->tree.info(state->staticMap).size != info.size) {
+			statics->tree.free(state->staticMap);
+			state->staticMap = 0;
+		}
+
+		if (!statics->tree.valid(state->staticMap)) {
+			state->staticMap = statics->tree.alloc(info.size);
+		}
+
+		if (statics->tree.valid(state->staticMap)
+		    && statics->bind_atlas_fb(state->staticMap))
+		{
+			glClear(GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
+			drawShadowCasters(staticCasters, cam, info.size, rctx, flags, opts);
+			cache->current.staticDrawn++;
+
+		} else {
+			// no room in the static atlas, draw everything into the live map
+			haveStatic = false;
+		}
+	}
+
+	if (!shadows->bind_atlas_fb(id)) {
+		return false;
+	}
+
+	if (haveStatic) {
+		quadinfo sinfo = statics->tree.info(state->staticMap);
+
+		// scissor is still set to the destination from binding
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, statics->framebuffer->obj);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadows->framebuffer->obj);
+		glBlitFramebuffer(sinfo.x, sinfo.y, sinfo.x + sinfo.size, sinfo.y + sinfo.size,
+		                  info.x,  info.y,  info.x  + info.size,  info.y  + info.size,
+		                  GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+		shadows->framebuffer->bind();
+
+	} else {
+		glClear(GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
+
+		if (staticCount > 0) {
+			drawShadowCasters(staticCasters, cam, info.size, rctx, flags, opts);
+		}
+	}
+
+	drawShadowCasters(dynamicCasters, cam, info.size, rctx, flags, opts);
+	DO_ERROR_CHECK();
+
+	state->liveMap    = id;
+	state->staticSig  = staticSig;
+	state->dynamicSig = dynamicSig;
+	state->drawn      = true;
+	cache->current.facesDrawn++;
+
+	return true;
+}
+
 void grendx::drawShadowCubeMap(renderQueue& queue,
                                sceneLightPoint::ptr light,
                                glm::mat4& transform,
@@ -52,7 +272,7 @@ void grendx::drawShadowCubeMap(renderQueue& queue,
 		return;
 	}
 
-	profile::startGroup("shadow cubemap : " + light->idString());
+	GREND_PROFILE_ZONE("Shadow cubemap");
 
 	enable(GL_SCISSOR_TEST);
 	enable(GL_DEPTH_TEST);
@@ -68,39 +288,45 @@ void grendx::drawShadowCubeMap(renderQueue& queue,
 	renderOptions opts;
 	opts.features |= renderOptions::Features::Shadowmap;
 
-	// TODO: 'cull radius' function for queues to avoid reprocessing the
-	//       entire render queue 6 times
-	// TODO: could also split queue culling into multiple threads, if it's
-	//       still a problem after culling by radius
-	for (unsigned i = 0; i < 6; i++) {
-		if (!rctx->atlases.shadows->bind_atlas_fb(light->shadowmap[i])) {
-			LogError("drawShadowCubeMap(): couldn't bind shadow framebuffer");
-			continue;
-		}
+	auto cache = engine::Services().tryResolve<shadowCache>();
+	shadowCache::lightState *state = nullptr;
+
+	if (cache && cache->settings.enabled) {
+		// keyed by the base pointer, same as updateLights()
+		state = &cache->light(static_cast<sceneLight*>(light.getPtr()),
+		                      rctx->atlases.shadows.get());
+	} else {
+		cache = nullptr;
+	}
 
-		// TODO: this might result in shader recompilation?
-		//       need all clear bits I think, test later
-		glClear(GL_DEPTH_BUFFER_BIT);
+	BSphere bounds = {
+		.center = extractTranslation(transform),
+		.extent = light->extent(rctx->lightThreshold),
+	};
 
-		renderQueue porque = queue;
-		// TODO: texture atlas should have some tree wrappers, just for
-		//       clean encapsulation...
-		quadinfo info = rctx->atlases.shadows->tree.info(light->shadowmap[i]);
+	renderQueue staticCasters, dynamicCasters;
+	gatherShadowCasters(queue, bounds, cache, staticCasters, dynamicCasters);
 
+	// TODO: could also split face culling into multiple threads
+	for (unsigned i = 0; i < 6; i++) {
 		cam->setDirection(cube_dirs[i], cube_up[i]);
-		cam->setViewport(info.size, info.size);
 
-		cullQueue(porque, cam, info.size, info.size, rctx->lightThreshold);
-		sortQueue(porque, cam);
+		if (!updateShadowFace(light->shadowmap[i], cam,
+		                      staticCasters, dynamicCasters,
+		                      cache, state? &state->faces[i] : nullptr,
+		                      !light->have_map, rctx, flags, opts))
+		{
+			LogError("drawShadowCubeMap(): couldn't bind shadow framebuffer");
+		}
+	}
 
-		flush(porque, cam, info.size, info.size, rctx, flags, opts);
+	if (state) {
+		state->lastUpdate = cache->frameNumber();
 	}
 
 	light->have_map = true;
-	profile::endGroup();
 }
 
-// TODO: minimize duplicated code with drawReflectionProbe
 void grendx::drawSpotlightShadow(renderQueue& queue,
                                  sceneLightSpot::ptr light,
                                  glm::mat4& transform,
@@ -118,7 +344,7 @@ void grendx::drawSpotlightShadow(renderQueue& queue,
 		return;
 	}
 
-	profile::startGroup(light->idString());
+	GREND_PROFILE_ZONE("Spotlight shadow");
 
 	enable(GL_SCISSOR_TEST);
 	enable(GL_DEPTH_TEST);
@@ -126,59 +352,69 @@ void grendx::drawSpotlightShadow(renderQueue& queue,
 	glDepthFunc(GL_LESS);
 
 	camera::ptr cam = camera::ptr(new camera());
-	profile::startGroup("Set flags, bind");
-	cam->setPosition(extractTranslation(transform));
-	//cam->setFovx(360.f*acos(light->angle)/M_PI);
-	cam->setFovx(2.f*180.f*acosf(light->angle)/M_PI);
-	//cam->setFovx(90);
-	// TODO: configurable/dynamic far plane
-	//cam->setFar(light->extent(rctx->lightThreshold));
-	cam->setFar(50);
-
 	renderFlags flags = rctx->probeShaders["shadow"];
 	renderOptions opts;
-	opts.features |= renderOptions::Shadowmap;
 
-	if (!rctx->atlases.shadows->bind_atlas_fb(light->shadowmap)) {
-		LogError("drawSpotlightShadow(): couldn't bind shadow framebuffer");
-		return;
+	auto cache = engine::Services().tryResolve<shadowCache>();
+	shadowCache::lightState *state = nullptr;
+
+	if (cache && cache->settings.enabled) {
+		state = &cache->light(static_cast<sceneLight*>(light.getPtr()),
+		                      rctx->atlases.shadows.get());
+	} else {
+		cache = nullptr;
 	}
-	profile::endGroup();
 
-	profile::startGroup("Clear");
-	// TODO: this might result in shader recompilation?
-	glClear(GL_DEPTH_BUFFER_BIT|GL_STENCIL_BUFFER_BIT);
-	profile::endGroup();
+	renderQueue staticCasters, dynamicCasters;
 
-	profile::startGroup("Build queue");
-	renderQueue porque = queue;
-	// TODO: texture atlas should have some tree wrappers, just for
-	//       clean encapsulation...
-	quadinfo info = rctx->atlases.shadows->tree.info(light->shadowmap);
-	glm::vec3 dir = glm::mat3(transform) * glm::vec3(0, 0, -1);
-	glm::vec3 up  = glm::mat3(transform) * glm::vec3(0, 1, 0);
+	{
+		GREND_PROFILE_ZONE("Set flags, gather casters");
+		cam->setPosition(extractTranslation(transform));
+		//cam->setFovx(360.f*acos(light->angle)/M_PI);
+		cam->setFovx(2.f*180.f*acosf(light->angle)/M_PI);
+		//cam->setFovx(90);
+		// TODO: configurable/dynamic far plane
+		//cam->setFar(light->extent(rctx->lightThreshold));
+		cam->setFar(50);
 
-	cam->setDirection(dir, up);
-	cam->setViewport(info.size, info.size);
-	profile::endGroup();
+		glm::vec3 dir = glm::mat3(transform) * glm::vec3(0, 0, -1);
+		glm::vec3 up  = glm::mat3(transform) * glm::vec3(0, 1, 0);
+		cam->setDirection(dir, up);
 
-	profile::startGroup("Cull + Sort");
-	cullQueue(porque, cam, info.size, info.size, rctx->lightThreshold);
-	sortQueue(porque, cam);
-	renderQueue& newque = porque;
-	profile::endGroup();
+		opts.features |= renderOptions::Shadowmap;
+
+		BSphere bounds = {
+			.center = extractTranslation(transform),
+			.extent = light->extent(rctx->lightThreshold),
+		};
+
+		gatherShadowCasters(queue, bounds, cache, staticCasters, dynamicCasters);
+	}
 
-	profile::startGroup("Draw");
-	flush(newque, cam, info.size, info.size, rctx, flags, opts);
-	profile::endGroup();
+	{
+		GREND_PROFILE_ZONE("Draw");
+
+		if (!updateShadowFace(light->shadowmap, cam,
+		                      staticCasters, dynamicCasters,
+		                      cache, state? &state->faces[0] : nullptr,
+		                      !light->have_map, rctx, flags, opts))
+		{
+			LogError("drawSpotlightShadow(): couldn't bind shadow framebuffer");
+			return;
+		}
+	}
 	DO_ERROR_CHECK();
 
+	if (state) {
+		state->lastUpdate = cache->frameNumber();
+	}
+
 	light->have_map = true;
 	light->shadowproj = cam->viewProjTransform();
-	profile::endGroup();
 }
 
-static void convoluteReflectionProbeMips(sceneReflectionProbe::ptr probe,
+static void convoluteReflectionProbeMips(quadtree::node_id source[6],
+                                         quadtree::node_id dest[6],
                                          renderContext *rctx,
                                          unsigned level)
 {
@@ -194,23 +430,22 @@ static void convoluteReflectionProbeMips(sceneReflectionProbe::ptr probe,
 
 	for (unsigned i = 0; i < 6; i++) {
 		glm::vec3 facevec =
-			rctx->atlases.reflections->tex_vector(probe->faces[0][i]);
+			rctx->atlases.reflections->tex_vector(source[i]);
 		std::string sloc = "cubeface["+std::to_string(i)+"]";
 		convolve->set(sloc, facevec);
 	}
 
 	for (unsigned i = 0; i < 6; i++) {
 		// note: irradiance, not reflection atlas
-		probe->faces[level][i] =
-			rctx->atlases.irradiance->tree.refresh(probe->faces[level][i]);
+		dest[i] = rctx->atlases.irradiance->tree.refresh(dest[i]);
 	}
 
 	for (unsigned i = 0; i < 6; i++) {
-		quadinfo info = rctx->atlases.irradiance->tree.info(probe->faces[level][i]);
+		quadinfo info = rctx->atlases.irradiance->tree.info(dest[i]);
 		quadinfo sourceinfo =
-			rctx->atlases.reflections->tree.info(probe->faces[0][i]);
+			rctx->atlases.reflections->tree.info(source[i]);
 
-		if (!rctx->atlases.irradiance->bind_atlas_fb(probe->faces[level][i])) {
+		if (!rctx->atlases.irradiance->bind_atlas_fb(dest[i])) {
 			LogError("convoluteReflectionProbeMips(): couldn't bind probe framebuffer");
 			continue;
 		}
@@ -233,36 +468,61 @@ static void convoluteReflectionProbeMips(sceneReflectionProbe::ptr probe,
 	}
 }
 
-void grendx::drawReflectionProbe(renderQueue& queue,
-                                 sceneReflectionProbe::ptr probe,
-                                 glm::mat4& transform,
-                                 renderContext *rctx)
+static void convoluteIrradiance(quadtree::node_id source[6],
+                                quadtree::node_id dest[6],
+                                renderContext *rctx)
 {
-	// refresh top level reflection probe to keep/reallocate it
+	Program::ptr convolve = rctx->postShaders["irradiance-convolve"];
+	convolve->bind();
+
+	glActiveTexture(TEX_GL_REFLECTIONS);
+	rctx->atlases.reflections->color_tex->bind();
+	convolve->set("reflection_atlas", TEXU_REFLECTIONS);
+	DO_ERROR_CHECK();
+
 	for (unsigned i = 0; i < 6; i++) {
-		probe->faces[0][i] =
-			rctx->atlases.reflections->tree.refresh(probe->faces[0][i]);
+		glm::vec3 facevec =
+			rctx->atlases.reflections->tex_vector(source[i]);
+		std::string sloc = "cubeface["+std::to_string(i)+"]";
+		convolve->set(sloc, facevec);
 	}
 
-	if (probe->is_static && probe->have_map) {
-		// static probe already rendered, nothing to do
-		return;
-	}
+	for (unsigned i = 0; i < 6; i++) {
+		quadinfo info = rctx->atlases.irradiance->tree.info(dest[i]);
+		quadinfo sourceinfo =
+			rctx->atlases.reflections->tree.info(source[i]);
 
-	// TODO: check for updates inside some radius, return if none
+		if (!rctx->atlases.irradiance->bind_atlas_fb(dest[i])) {
+			LogError("drawIrradianceProbe(): couldn't bind probe framebuffer");
+			continue;
+		}
 
+		bindVao(getScreenquadVao());
+		glClearColor(0.0, 0.0, 0.0, 1.0);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glDepthMask(GL_FALSE);
+		disable(GL_DEPTH_TEST);
+		DO_ERROR_CHECK();
+
+		convolve->set("currentFace", int(i));
+		convolve->set("screen_x", float(info.size));
+		convolve->set("screen_y", float(info.size));
+		convolve->set("rend_x", float(sourceinfo.size));
+		convolve->set("rend_y", float(sourceinfo.size));
+		convolve->set("exposure", 1.f);
+
+		drawScreenquad();
+	}
+}
+
+static void bindReflectionShaders(renderQueue& queue, renderContext *rctx) {
 	enable(GL_SCISSOR_TEST);
 	enable(GL_DEPTH_TEST);
 	glDepthMask(GL_TRUE);
 	glDepthFunc(GL_LESS);
 	DO_ERROR_CHECK();
 
-	camera::ptr cam = camera::ptr(new camera());
-	cam->setPosition(extractTranslation(transform));
-	cam->setFovx(90);
-
 	const renderFlags& flags = rctx->probeShaders["refprobe"];
-	const renderOptions opts;
 
 	glActiveTexture(TEX_GL_SHADOWS);
 	rctx->atlases.shadows->depth_tex->bind();
@@ -276,32 +536,75 @@ void grendx::drawReflectionProbe(renderQueue& queue,
 	}
 
 	DO_ERROR_CHECK();
+}
 
-	for (unsigned i = 0; i < 6; i++) {
-		if (!rctx->atlases.reflections->bind_atlas_fb(probe->faces[0][i])) {
-			LogError("drawReflectionProbe(): couldn't bind probe framebuffer");
-			continue;
-		}
+// draws one cube face of a probe into the given reflection atlas node,
+// expects bindReflectionShaders() to have been called
+static void drawReflectionFace(renderQueue& queue,
+                               quadtree::node_id target,
+                               unsigned face,
+                               glm::mat4& transform,
+                               renderContext *rctx)
+{
+	if (!rctx->atlases.reflections->bind_atlas_fb(target)) {
+		LogError("drawReflectionProbe(): couldn't bind probe framebuffer");
+		return;
+	}
 
-		glClearColor(0.0, 0.0, 0.0, 1.0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	const renderFlags& flags = rctx->probeShaders["refprobe"];
+	const renderOptions opts;
 
-		renderQueue porque = queue;
-		quadinfo info = rctx->atlases.reflections->tree.info(probe->faces[0][i]);
-		cam->setDirection(cube_dirs[i], cube_up[i]);
-		cam->setViewport(info.size, info.size);
-		DO_ERROR_CHECK();
+	camera::ptr cam = camera::ptr(new camera());
+	cam->setPosition(extractTranslation(transform));
+	cam->setFovx(90);
 
-		flush(porque, cam, info.size, info.size, rctx, flags, opts);
-		DO_ERROR_CHECK();
+	glClearColor(0.0, 0.0, 0.0, 1.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		rctx->defaultSkybox->draw(cam, info.size, info.size);
-		DO_ERROR_CHECK();
+	renderQueue porque = queue;
+	quadinfo info = rctx->atlases.reflections->tree.info(target);
+	cam->setDirection(cube_dirs[face], cube_up[face]);
+	cam->setViewport(info.size, info.size);
+	DO_ERROR_CHECK();
+
+	// not culled, but still worth using coarser meshes
+	if (auto lods = engine::Services().tryResolve<lodSelector>()) {
+		selectLods(porque, cam, info.size, *lods, lodPass::Probe);
+	}
+
+	flush(porque, cam, info.size, info.size, rctx, flags, opts);
+	DO_ERROR_CHECK();
+
+	rctx->defaultSkybox->draw(cam, info.size, info.size);
+	DO_ERROR_CHECK();
+}
+
+void grendx::drawReflectionProbe(renderQueue& queue,
+                                 sceneReflectionProbe::ptr probe,
+                                 glm::mat4& transform,
+                                 renderContext *rctx)
+{
+	// refresh top level reflection probe to keep/reallocate it
+	for (unsigned i = 0; i < 6; i++) {
+		probe->faces[0][i] =
+			rctx->atlases.reflections->tree.refresh(probe->faces[0][i]);
+	}
+
+	if (probe->is_static && probe->have_map) {
+		// static probe already rendered, nothing to do
+		return;
+	}
+
+	// TODO: check for updates inside some radius, return if none
+	bindReflectionShaders(queue, rctx);
+
+	for (unsigned i = 0; i < 6; i++) {
+		drawReflectionFace(queue, probe->faces[0][i], i, transform, rctx);
 	}
 
 	if (probe->have_convolved) {
 		for (unsigned k = 1; k < 5; k++) {
-			convoluteReflectionProbeMips(probe, rctx, k);
+			convoluteReflectionProbeMips(probe->faces[0], probe->faces[k], rctx, k);
 		}
 	}
 
@@ -332,48 +635,126 @@ void grendx::drawIrradianceProbe(renderQueue& queue,
 	}
 
 	// TODO: check for updates inside some radius, return if none
-	Program::ptr convolve = rctx->postShaders["irradiance-convolve"];
-	convolve->bind();
+	convoluteIrradiance(probe->source->faces[0], probe->faces, rctx);
 
-	glActiveTexture(TEX_GL_REFLECTIONS);
-	rctx->atlases.reflections->color_tex->bind();
-	convolve->set("reflection_atlas", TEXU_REFLECTIONS);
-	DO_ERROR_CHECK();
+	puts("rendered irradiance probe");
+	probe->have_map = true;
+}
 
-	for (unsigned i = 0; i < 6; i++) {
-		glm::vec3 facevec =
-			rctx->atlases.reflections->tex_vector(probe->source->faces[0][i]);
-		std::string sloc = "cubeface["+std::to_string(i)+"]";
-		convolve->set(sloc, facevec);
+// (re)allocates a node for an update with the same size as the live node
+static quadtree::node_id allocUpdateNode(quadtree& tree,
+                                         quadtree::node_id id,
+                                         quadtree::node_id live)
+{
+	quadinfo liveinfo = tree.info(live);
+
+	if (tree.valid(id) && tree.info(id).size == liveinfo.size) {
+		return tree.refresh(id);
 	}
 
+	tree.free(id);
+	return liveinfo.valid? tree.alloc(liveinfo.size) : 0;
+}
+
+// frees the live nodes and replaces them with the finished update
+static void swapUpdateNodes(quadtree& tree,
+                            quadtree::node_id live[6],
+                            quadtree::node_id update[6])
+{
 	for (unsigned i = 0; i < 6; i++) {
-		quadinfo info = rctx->atlases.irradiance->tree.info(probe->faces[i]);
-		quadinfo sourceinfo =
-			rctx->atlases.reflections->tree.info(probe->source->faces[0][i]);
+		tree.free(live[i]);
+		live[i]   = update[i];
+		update[i] = 0;
+	}
+}
 
-		if (!rctx->atlases.irradiance->bind_atlas_fb(probe->faces[i])) {
-			LogError("drawIrradianceProbe(): couldn't bind probe framebuffer");
-			continue;
+unsigned grendx::reflectionProbeSteps(sceneReflectionProbe::ptr probe) {
+	// 6 faces, then a pass for each convolved level
+	return probe->have_convolved? 10 : 6;
+}
+
+unsigned grendx::irradianceProbeSteps(sceneIrradianceProbe::ptr probe) {
+	// 6 source faces, then the irradiance convolution
+	return 7;
+}
+
+bool grendx::drawReflectionProbeStep(renderQueue& queue,
+                                     sceneReflectionProbe::ptr probe,
+                                     glm::mat4& transform,
+                                     renderContext *rctx,
+                                     unsigned step)
+{
+	auto& reftree = rctx->atlases.reflections->tree;
+	auto& radtree = rctx->atlases.irradiance->tree;
+
+	if (step < 6) {
+		GREND_PROFILE_ZONE("Reflection probe face");
+		auto& target = probe->updateFaces[0][step];
+
+		target = allocUpdateNode(reftree, target, probe->faces[0][step]);
+		bindReflectionShaders(queue, rctx);
+		drawReflectionFace(queue, target, step, transform, rctx);
+
+	} else {
+		GREND_PROFILE_ZONE("Reflection probe convolution");
+		unsigned k = step - 5;
+
+		for (unsigned i = 0; i < 6; i++) {
+			probe->updateFaces[k][i] =
+				allocUpdateNode(radtree, probe->updateFaces[k][i], probe->faces[k][i]);
 		}
 
-		bindVao(getScreenquadVao());
-		glClearColor(0.0, 0.0, 0.0, 1.0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glDepthMask(GL_FALSE);
-		disable(GL_DEPTH_TEST);
-		DO_ERROR_CHECK();
+		convoluteReflectionProbeMips(probe->updateFaces[0], probe->updateFaces[k], rctx, k);
+	}
 
-		convolve->set("currentFace", int(i));
-		convolve->set("screen_x", float(info.size));
-		convolve->set("screen_y", float(info.size));
-		convolve->set("rend_x", float(sourceinfo.size));
-		convolve->set("rend_y", float(sourceinfo.size));
-		convolve->set("exposure", 1.f);
+	if (step + 1 < reflectionProbeSteps(probe)) {
+		return false;
+	}
 
-		drawScreenquad();
+	swapUpdateNodes(reftree, probe->faces[0], probe->updateFaces[0]);
+
+	if (probe->have_convolved) {
+		for (unsigned k = 1; k < 5; k++) {
+			swapUpdateNodes(radtree, probe->faces[k], probe->updateFaces[k]);
+		}
 	}
 
-	puts("rendered irradiance probe");
 	probe->have_map = true;
+	return true;
+}
+
+bool grendx::drawIrradianceProbeStep(renderQueue& queue,
+                                     sceneIrradianceProbe::ptr probe,
+                                     glm::mat4& transform,
+                                     renderContext *rctx,
+                                     unsigned step)
+{
+	auto& reftree = rctx->atlases.reflections->tree;
+	auto& radtree = rctx->atlases.irradiance->tree;
+	auto *source  = probe->source;
+
+	if (step < 6) {
+		GREND_PROFILE_ZONE("Irradiance probe face");
+		auto& target = source->updateFaces[0][step];
+
+		target = allocUpdateNode(reftree, target, source->faces[0][step]);
+		bindReflectionShaders(queue, rctx);
+		drawReflectionFace(queue, target, step, transform, rctx);
+		return false;
+	}
+
+	GREND_PROFILE_ZONE("Irradiance probe convolution");
+
+	for (unsigned i = 0; i < 6; i++) {
+		probe->updateFaces[i] =
+			allocUpdateNode(radtree, probe->updateFaces[i], probe->faces[i]);
+	}
+
+	convoluteIrradiance(source->updateFaces[0], probe->updateFaces, rctx);
+
+	swapUpdateNodes(reftree, source->faces[0], source->updateFaces[0]);
+	swapUpdateNodes(radtree, probe->faces, probe->updateFaces);
+	source->have_map = true;
+	probe->have_map  = true;
+	return true;
 }
@@ -0,0 +1,795 @@
+#include <grend/replication.hpp>
+#include <grend/logger.hpp>
+#include <grend/profile.hpp>
+#include <grend/utility.hpp>
+
+#include <algorithm>
+
+using namespace grendx;
+
+// key functions for rtti
+ecs::replicated::~replicated() {}
+byteTransport::~byteTransport() {}
+
+enum : uint8_t {
+	packetSnapshot = 1,
+	packetAck      = 2,
+};
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back(uint8_t(value) | 0x80);
+		value >>= 7;
+	}
+
+	out.push_back(uint8_t(value));
+}
+
+// deltas are mostly small in either direction
+static uint32_t zigzag(int32_t value) {
+	return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+	return int32_t((value >> 1) ^ -(value & 1));
+}
+
+// wrapping arithmetic, so any pair of fields has a delta
+static int32_t fieldDelta(int32_t value, int32_t base) {
+	return int32_t(uint32_t(value) - uint32_t(base));
+}
+
+static int32_t applyFieldDelta(int32_t base, int32_t delta) {
+	return int32_t(uint32_t(base) + uint32_t(delta));
+}
+
+// bounds checked, any read past the end clears ok and returns 0
+struct packetReader {
+	const uint8_t *p;
+	const uint8_t *end;
+	bool ok = true;
+
+	packetReader(const std::vector<uint8_t>& packet)
+		: p(packet.data()), end(packet.data() + packet.size()) {}
+
+	uint8_t byte(void) {
+		if (p == end) {
+			ok = false;
+			return 0;
+		}
+
+		return *p++;
+	}
+
+	uint64_t varint(void) {
+		uint64_t ret = 0;
+
+		for (unsigned shift = 0; shift < 64; shift += 7) {
+			uint8_t b = byte();
+			ret |= uint64_t(b & 0x7f) << shift;
+
+			if (!(b & 0x80)) {
+				return ret;
+			}
+		}
+
+		ok = false;
+		return 0;
+	}
+};
+
+bool replicationSchema::add(const codec& c) {
+	if (codecs.size() >= maxTypes || totalFields + c.fields > maxFields) {
+		LogErrorFmt("replication: can't add {}, too many replicated fields",
+		            demangle(c.type));
+		return false;
+	}
+
+	codecs.push_back(c);
+	totalFields += c.fields;
+	return true;
+}
+
+unsigned replicationSchema::fieldCount(uint32_t typeMask) const {
+	unsigned ret = transformFields;
+
+	for (unsigned i = 0; i < codecs.size(); i++) {
+		if (typeMask & (1u << i)) {
+			ret += codecs[i].fields;
+		}
+	}
+
+	return ret;
+}
+
+// smallest three, the largest component is dropped and rebuilt from the
+// others, which are within +-1/sqrt(2), 10 bits each plus 2 for the index
+static int32_t packRotation(const glm::quat& rot) {
+	glm::quat q = glm::normalize(rot);
+	float c[4] = {q.x, q.y, q.z, q.w};
+	unsigned largest = 0;
+
+	for (unsigned i = 1; i < 4; i++) {
+		if (fabsf(c[i]) > fabsf(c[largest])) {
+			largest = i;
+		}
+	}
+
+	float sign = (c[largest] < 0)? -1.f : 1.f;
+	uint32_t ret = largest << 30;
+	unsigned shift = 20;
+
+	for (unsigned i = 0; i < 4; i++) {
+		if (i == largest) continue;
+
+		float v = c[i] * sign * float(M_SQRT2);
+		long  k = lroundf((v*0.5f + 0.5f) * 1023.f);
+		ret |= uint32_t(std::clamp(k, 0l, 1023l)) << shift;
+		shift -= 10;
+	}
+
+	return int32_t(ret);
+}
+
+static glm::quat unpackRotation(int32_t packed) {
+	uint32_t bits = uint32_t(packed);
+	unsigned largest = bits >> 30;
+	unsigned shift = 20;
+	float c[4];
+	float sum = 0;
+
+	for (unsigned i = 0; i < 4; i++) {
+		if (i == largest) continue;
+
+		float v = ((bits >> shift) & 1023) / 1023.f;
+		c[i] = (v*2.f - 1.f) * float(M_SQRT1_2);
+		sum += c[i]*c[i];
+		shift -= 10;
+	}
+
+	c[largest] = sqrtf(std::max(0.f, 1.f - sum));
+	return glm::normalize(glm::quat(c[3], c[0], c[1], c[2]));
+}
+
+void replicationSchema::writeTransform(const TRS& transform, int32_t *fields) const {
+	fields[0] = quantize(transform.position.x, positionSteps);
+	fields[1] = quantize(transform.position.y, positionSteps);
+	fields[2] = quantize(transform.position.z, positionSteps);
+	fields[3] = packRotation(transform.rotation);
+	fields[4] = quantize(transform.scale.x, scaleSteps);
+	fields[5] = quantize(transform.scale.y, scaleSteps);
+	fields[6] = quantize(transform.scale.z, scaleSteps);
+}
+
+TRS replicationSchema::readTransform(const int32_t *fields) const {
+	TRS ret;
+	ret.position = {
+		dequantize(fields[0], positionSteps),
+		dequantize(fields[1], positionSteps),
+		dequantize(fields[2], positionSteps),
+	};
+	ret.rotation = unpackRotation(fields[3]);
+	ret.scale = {
+		dequantize(fields[4], scaleSteps),
+		dequantize(fields[5], scaleSteps),
+		dequantize(fields[6], scaleSteps),
+	};
+
+	return ret;
+}
+
+void netSnapshot::clear(void) {
+	tick = 0;
+	ids.clear();
+	typeMasks.clear();
+	offsets.clear();
+	fields.clear();
+}
+
+ptrdiff_t netSnapshot::find(uint32_t id) const {
+	auto it = std::lower_bound(ids.begin(), ids.end(), id);
+	return (it != ids.end() && *it == id)? it - ids.begin() : -1;
+}
+
+void netDelta::clear(void) {
+	tick = baseTick = 0;
+	entries.clear();
+	values.clear();
+	removed.clear();
+}
+
+void grendx::makeDelta(const replicationSchema& schema,
+                       const netSnapshot& cur,
+                       const netSnapshot *base,
+                       netDelta& out)
+{
+	out.clear();
+	out.tick     = cur.tick;
+	out.baseTick = base? base->tick : 0;
+
+	size_t nb = base? base->ids.size() : 0;
+	size_t i = 0, j = 0;
+
+	// both sides are sorted by ID, so this is a merge
+	while (i < cur.ids.size() || j < nb) {
+		uint32_t cid = (i < cur.ids.size())? cur.ids[i] : UINT32_MAX;
+		uint32_t bid = (j < nb)? base->ids[j] : UINT32_MAX;
+
+		if (bid < cid) {
+			out.removed.push_back(bid);
+			j++;
+			continue;
+		}
+
+		const int32_t *baseFields = nullptr;
+
+		if (bid == cid) {
+			if (base->typeMasks[j] == cur.typeMasks[i]) {
+				baseFields = base->get(j);
+			}
+
+			j++;
+		}
+
+		const int32_t *fields = cur.get(i);
+		unsigned n = schema.fieldCount(cur.typeMasks[i]);
+		uint32_t start = out.values.size();
+		uint64_t changed = 0;
+
+		for (unsigned k = 0; k < n; k++) {
+			int32_t delta = fieldDelta(fields[k], baseFields? baseFields[k] : 0);
+
+			if (delta != 0) {
+				changed |= uint64_t(1) << k;
+				out.values.push_back(delta);
+			}
+		}
+
+		if (baseFields && !changed) {
+			// same as the baseline, nothing to send
+			i++;
+			continue;
+		}
+
+		out.entries.push_back({
+			cur.ids[i],
+			cur.typeMasks[i],
+			baseFields == nullptr,
+			changed,
+			start
+		});
+
+		i++;
+	}
+}
+
+// IDs are sorted and start at 1, so deltas between them are never 0 and
+// 0 can end lists
+void grendx::writeDelta(const netDelta& delta, std::vector<uint8_t>& out) {
+	out.clear();
+	out.push_back(packetSnapshot);
+	putVarint(out, delta.tick);
+	putVarint(out, delta.baseTick);
+
+	uint32_t prev = 0;
+
+	for (auto& ent : delta.entries) {
+		putVarint(out, (uint64_t(ent.id - prev) << 1) | ent.newMask);
+		prev = ent.id;
+
+		if (ent.newMask) {
+			putVarint(out, ent.typeMask);
+		}
+
+		putVarint(out, ent.changed);
+
+		const int32_t *values = delta.values.data() + ent.start;
+		for (uint64_t bits = ent.changed; bits; bits &= bits - 1) {
+			putVarint(out, zigzag(*values++));
+		}
+	}
+
+	putVarint(out, 0);
+	prev = 0;
+
+	for (uint32_t id : delta.removed) {
+		putVarint(out, id - prev);
+		prev = id;
+	}
+
+	putVarint(out, 0);
+}
+
+bool grendx::readDelta(const std::vector<uint8_t>& packet, netDelta& out) {
+	packetReader in(packet);
+	out.clear();
+
+	if (in.byte() != packetSnapshot) {
+		return false;
+	}
+
+	out.tick     = in.varint();
+	out.baseTick = in.varint();
+
+	uint32_t prev = 0;
+
+	while (in.ok) {
+		uint64_t header = in.varint();
+		if (header == 0) break;
+
+		// IDs have to keep increasing without wrapping around, applyDelta()
+		// merges against the sorted baseline
+		uint64_t step = header >> 1;
+		if (step == 0 || step > UINT32_MAX - prev) {
+			return false;
+		}
+
+		netDelta::entry ent;
+		ent.id       = prev + uint32_t(step);
+		ent.newMask  = header & 1;
+		ent.typeMask = 0;
+
+		if (ent.newMask) {
+			uint64_t mask = in.varint();
+			if (mask > UINT32_MAX) {
+				return false;
+			}
+
+			ent.typeMask = uint32_t(mask);
+		}
+
+		ent.changed  = in.varint();
+		ent.start    = out.values.size();
+		prev = ent.id;
+
+		for (uint64_t bits = ent.changed; bits && in.ok; bits &= bits - 1) {
+			out.values.push_back(unzigzag(uint32_t(in.varint())));
+		}
+
+		out.entries.push_back(ent);
+	}
+
+	prev = 0;
+
+	while (in.ok) {
+		uint64_t delta = in.varint();
+		if (delta == 0) break;
+
+		if (delta > UINT32_MAX - prev) {
+			return false;
+		}
+
+		prev += uint32_t(delta);
+		out.removed.push_back(prev);
+	}
+
+	return in.ok && out.tick != 0;
+}
+
+bool grendx::applyDelta(const replicationSchema& schema,
+                        const netDelta& delta,
+                        const netSnapshot *base,
+                        netSnapshot& out)
+{
+	out.clear();
+	out.tick = delta.tick;
+
+	uint32_t validTypes = (schema.codecs.size() >= 32)
+		? ~0u
+		: (1u << schema.codecs.size()) - 1;
+
+	size_t nb = base? base->ids.size() : 0;
+	size_t i = 0, k = 0, r = 0;
+
+	while (i < nb || k < delta.entries.size()) {
+		uint32_t bid = (i < nb)? base->ids[i] : UINT32_MAX;
+		uint32_t eid = (k < delta.entries.size())? delta.entries[k].id : UINT32_MAX;
+
+		if (bid < eid) {
+			// not in the delta, either unchanged or removed
+			while (r < delta.removed.size() && delta.removed[r] < bid) r++;
+
+			if (r < delta.removed.size() && delta.removed[r] == bid) {
+				i++;
+				continue;
+			}
+
+			const int32_t *fields = base->get(i);
+			unsigned n = schema.fieldCount(base->typeMasks[i]);
+
+			out.ids.push_back(bid);
+			out.typeMasks.push_back(base->typeMasks[i]);
+			out.offsets.push_back(out.fields.size());
+			out.fields.insert(out.fields.end(), fields, fields + n);
+			i++;
+			continue;
+		}
+
+		const auto& ent = delta.entries[k++];
+		const int32_t *baseFields = nullptr;
+		uint32_t typeMask = ent.typeMask;
+
+		if (bid == eid) {
+			if (!ent.newMask) {
+				baseFields = base->get(i);
+				typeMask   = base->typeMasks[i];
+			}
+
+			i++;
+
+		} else if (!ent.newMask) {
+			// change to an entity the baseline doesn't have
+			return false;
+		}
+
+		unsigned n = schema.fieldCount(typeMask);
+
+		if ((typeMask & ~validTypes)
+		    || (n < 64 && (ent.changed >> n))
+		    || ent.start + __builtin_popcountll(ent.changed) > delta.values.size())
+		{
+			return false;
+		}
+
+		const int32_t *values = delta.values.data() + ent.start;
+
+		out.ids.push_back(eid);
+		out.typeMasks.push_back(typeMask);
+		out.offsets.push_back(out.fields.size());
+
+		for (unsigned f = 0; f < n; f++) {
+			int32_t value = baseFields? baseFields[f] : 0;
+
+			if (ent.changed & (uint64_t(1) << f)) {
+				value = applyFieldDelta(value, *values++);
+			}
+
+			out.fields.push_back(value);
+		}
+	}
+
+	return true;
+}
+
+std::pair<loopbackTransport::ptr, loopbackTransport::ptr>
+loopbackTransport::makePair(float loss, unsigned seed) {
+	auto a = std::make_shared<queue>();
+	auto b = std::make_shared<queue>();
+
+	return {
+		ptr(new loopbackTransport(a, b, loss, seed)),
+		ptr(new loopbackTransport(b, a, loss, seed + 1)),
+	};
+}
+
+void loopbackTransport::send(const uint8_t *data, size_t length) {
+	std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+	counters.packets++;
+	counters.bytes += length;
+
+	if (loss > 0.f && dist(rng) < loss) {
+		counters.dropped++;
+		return;
+	}
+
+	std::lock_guard lock(outgoing->mtx);
+	outgoing->packets.emplace_back(data, data + length);
+}
+
+bool loopbackTransport::receive(std::vector<uint8_t>& packet) {
+	std::lock_guard lock(incoming->mtx);
+
+	if (incoming->packets.empty()) {
+		return false;
+	}
+
+	packet.swap(incoming->packets.front());
+	incoming->packets.pop_front();
+	return true;
+}
+
+loopbackTransport::stats loopbackTransport::getStats(void) {
+	return counters;
+}
+
+replicationServer::replicationServer(replicationSchema::ptr _schema,
+                                     ecs::entityManager *_manager)
+	: schema(_schema),
+	  manager(_manager),
+	  history(historySize) {}
+
+unsigned replicationServer::addClient(byteTransport::ptr transport) {
+	unsigned id = nextClient++;
+	clients[id] = {transport, 0};
+	return id;
+}
+
+void replicationServer::removeClient(unsigned id) {
+	clients.erase(id);
+}
+
+void replicationServer::receive(void) {
+	for (auto& [_, c] : clients) {
+		while (c.transport->receive(packet)) {
+			packetReader in(packet);
+
+			if (in.byte() != packetAck) {
+				continue;
+			}
+
+			uint32_t tick = in.varint();
+
+			// acks can arrive out of order, only move forward
+			if (in.ok && tick <= tickCount && tick > c.ackedTick) {
+				c.ackedTick = tick;
+			}
+		}
+	}
+}
+
+void replicationServer::capture(netSnapshot& out) {
+	out.clear();
+	out.tick = tickCount;
+	captured.clear();
+
+	for (auto *comp : manager->getComponents<ecs::replicated>()) {
+		auto *rep = static_cast<ecs::replicated*>(comp);
+		ecs::entity *ent = manager->getEntity(comp);
+
+		if (!manager->valid(ent) || manager->condemned.count(ent)) {
+			continue;
+		}
+
+		if (rep->netID == 0) {
+			rep->netID = nextID++;
+		}
+
+		captured.push_back({rep->netID, ent});
+	}
+
+	std::sort(captured.begin(), captured.end());
+
+	for (auto& [id, ent] : captured) {
+		auto& comps = manager->getEntityComponents(ent);
+		uint32_t typeMask = 0;
+
+		for (unsigned i = 0; i < schema->codecs.size(); i++) {
+			if (comps.count(schema->codecs[i].type)) {
+				typeMask |= 1u << i;
+			}
+		}
+
+		size_t offset = out.fields.size();
+		out.ids.push_back(id);
+		out.typeMasks.push_back(typeMask);
+		out.offsets.push_back(offset);
+		out.fields.resize(offset + schema->fieldCount(typeMask));
+
+		int32_t *fields = out.fields.data() + offset;
+		schema->writeTransform(ent->transform.getTRS(), fields);
+		fields += replicationSchema::transformFields;
+
+		for (unsigned i = 0; i < schema->codecs.size(); i++) {
+			if (typeMask & (1u << i)) {
+				auto& codec = schema->codecs[i];
+				codec.write(comps.find(codec.type)->second, fields);
+				fields += codec.fields;
+			}
+		}
+	}
+}
+
+void replicationServer::tick(void) {
+	GREND_PROFILE_FUNCTION();
+
+	tickCount++;
+	netSnapshot& cur = history[tickCount % historySize];
+	capture(cur);
+
+	counters.ticks++;
+	counters.entities += cur.ids.size();
+
+	for (auto& [_, c] : clients) {
+		const netSnapshot *base = nullptr;
+
+		if (c.ackedTick && tickCount - c.ackedTick < historySize) {
+			auto& snap = history[c.ackedTick % historySize];
+
+			if (snap.tick == c.ackedTick) {
+				base = &snap;
+			}
+		}
+
+		if (!base) {
+			counters.fullSnapshots++;
+		}
+
+		makeDelta(*schema, cur, base, delta);
+		writeDelta(delta, packet);
+		c.transport->send(packet.data(), packet.size());
+
+		counters.packets++;
+		counters.bytes += packet.size();
+	}
+}
+
+replicationClient::replicationClient(replicationSchema::ptr _schema,
+                                     ecs::entityManager *_manager,
+                                     byteTransport::ptr _transport)
+	: schema(_schema),
+	  manager(_manager),
+	  transport(_transport),
+	  history(historySize) {}
+
+void replicationClient::receive(void) {
+	GREND_PROFILE_FUNCTION();
+
+	uint32_t prevLatest = latest;
+	bool received = false;
+
+	while (transport->receive(packet)) {
+		counters.packets++;
+		received = true;
+
+		if (!readDelta(packet, delta)) {
+			counters.invalid++;
+			continue;
+		}
+
+		if (delta.tick <= latest) {
+			counters.ignored++;
+			continue;
+		}
+
+		const netSnapshot *base = nullptr;
+
+		if (delta.baseTick) {
+			auto& snap = history[delta.baseTick % historySize];
+
+			if (snap.tick != delta.baseTick) {
+				counters.missingBaseline++;
+				continue;
+			}
+
+			base = &snap;
+		}
+
+		if (!applyDelta(*schema, delta, base, decoded)) {
+			counters.invalid++;
+			continue;
+		}
+
+		// decoded separately since the baseline could be in the same slot
+		std::swap(history[delta.tick % historySize], decoded);
+		latest = delta.tick;
+	}
+
+	if (latest != prevLatest) {
+		apply(history[latest % historySize]);
+		counters.applied++;
+	}
+
+	if (received && latest) {
+		// acked every time something arrives, acks get lost too
+		packet.clear();
+		packet.push_back(packetAck);
+		putVarint(packet, latest);
+		transport->send(packet.data(), packet.size());
+	}
+}
+
+void replicationClient::apply(const netSnapshot& snap) {
+	for (size_t i = 0; i < snap.ids.size(); i++) {
+		uint32_t id = snap.ids[i];
+		auto it = entities.find(id);
+
+		if (it == entities.end()) {
+			ecs::entity *ent = spawn
+				? spawn(manager, id)
+				: manager->construct<ecs::entity>();
+
+			if (!ent) {
+				continue;
+			}
+
+			if (auto rep = ent->get<ecs::replicated>()) {
+				rep->netID = id;
+			} else {
+				ent->attach<ecs::replicated>(id);
+			}
+
+			it = entities.emplace(id, remote {ent}).first;
+		}
+
+		remote& rem = it->second;
+		rem.seen = snap.tick;
+
+		if (!manager->valid(rem.ent)) {
+			continue;
+		}
+
+		const int32_t *fields = snap.get(i);
+		TRS transform = schema->readTransform(fields);
+
+		if (rem.count == bufferSize) {
+			std::move(rem.samples + 1, rem.samples + bufferSize, rem.samples);
+			rem.count--;
+
+		} else if (rem.count == 0) {
+			// nothing to interpolate from yet
+			rem.ent->transform.set(transform);
+		}
+
+		rem.samples[rem.count++] = {snap.tick, transform};
+
+		auto& comps = manager->getEntityComponents(rem.ent);
+		fields += replicationSchema::transformFields;
+
+		for (unsigned k = 0; k < schema->codecs.size(); k++) {
+			if (!(snap.typeMasks[i] & (1u << k))) {
+				continue;
+			}
+
+			auto& codec = schema->codecs[k];
+			auto found  = comps.find(codec.type);
+			ecs::component *comp = (found != comps.end())
+				? found->second
+				: codec.attach(rem.ent);
+
+			codec.read(comp, fields);
+			fields += codec.fields;
+		}
+	}
+
+	// anything not in the latest snapshot is gone on the server
+	std::erase_if(entities, [&] (auto& it) {
+		auto& [_, rem] = it;
+
+		if (rem.seen != snap.tick) {
+			manager->remove(rem.ent);
+			return true;
+		}
+
+		return false;
+	});
+}
+
+void replicationClient::interpolate(float tick) {
+	for (auto& [_, rem] : entities) {
+		if (rem.count == 0 || !manager->valid(rem.ent)) {
+			continue;
+		}
+
+		const auto *s = rem.samples;
+		unsigned n = rem.count;
+		TRS transform;
+
+		if (tick <= s[0].tick) {
+			transform = s[0].transform;
+
+		} else if (tick >= s[n - 1].tick) {
+			// no extrapolation, hold the newest state
+			transform = s[n - 1].transform;
+
+		} else {
+			unsigned k = 0;
+			while (k + 2 < n && s[k + 1].tick <= tick) k++;
+
+			const TRS& a = s[k].transform;
+			const TRS& b = s[k + 1].transform;
+			float amount = (tick - s[k].tick) / float(s[k + 1].tick - s[k].tick);
+
+			transform.position = glm::mix(a.position, b.position, amount);
+			transform.rotation = glm::slerp(a.rotation, b.rotation, amount);
+			transform.scale    = glm::mix(a.scale, b.scale, amount);
+		}
+
+		rem.ent->transform.set(transform);
+	}
+}
+
+ecs::entity *replicationClient::find(uint32_t netID) {
+	auto it = entities.find(netID);
+	return (it != entities.end())? it->second.ent : nullptr;
+}
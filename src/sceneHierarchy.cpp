@@ -0,0 +1,108 @@
+#include <grend/sceneHierarchy.hpp>
+#include <grend/sceneNode.hpp>
+
+#include <shared_mutex>
+#include <mutex>
+#include <string>
+
+using namespace grendx;
+
+namespace {
+	// ids are indexes into the name list, plus one
+	struct nameTable {
+		std::shared_mutex mtx;
+		std::unordered_map<std::string, uint32_t> ids;
+	};
+
+	nameTable& names(void) {
+		static nameTable ret;
+		return ret;
+	}
+}
+
+uint32_t grendx::findInternedName(std::string_view name) {
+	auto& table = names();
+	std::shared_lock lock(table.mtx);
+
+	// TODO: heterogeneous lookup to avoid the temporary string
+	auto it = table.ids.find(std::string(name));
+	return (it == table.ids.end())? 0 : it->second;
+}
+
+uint32_t grendx::internName(std::string_view name) {
+	if (uint32_t id = findInternedName(name)) {
+		return id;
+	}
+
+	auto& table = names();
+	std::unique_lock lock(table.mtx);
+
+	auto [it, _] = table.ids.try_emplace(std::string(name), table.ids.size() + 1);
+	return it->second;
+}
+
+void sceneHierarchy::build(sceneNode *root) {
+	entries.clear();
+	indices.clear();
+
+	if (!root) {
+		return;
+	}
+
+	// explicit stack rather than recursion, children are pushed in reverse
+	// so they come out in link order
+	struct pending {
+		sceneNode *node;
+		uint32_t parent;
+	};
+
+	std::vector<pending> stack = {{root, none}};
+	std::vector<uint32_t> lastChild;
+	std::vector<sceneNode*> children;
+
+	while (!stack.empty()) {
+		auto [node, parent] = stack.back();
+		stack.pop_back();
+
+		uint32_t idx = entries.size();
+		entries.push_back({node, parent, none, none, none});
+		lastChild.push_back(none);
+		indices.try_emplace(node, idx);
+
+		if (parent != none) {
+			if (entries[parent].firstChild == none) {
+				entries[parent].firstChild = idx;
+			} else {
+				entries[lastChild[parent]].nextSibling = idx;
+			}
+
+			lastChild[parent] = idx;
+		}
+
+		children.clear();
+		for (auto link : node->nodes()) {
+			if (auto ptr = link->getRef()) {
+				children.push_back(ptr.getPtr());
+			}
+		}
+
+		for (auto it = children.rbegin(); it != children.rend(); it++) {
+			stack.push_back({*it, idx});
+		}
+	}
+
+	// in depth-first order a subtree ends at the next sibling, or where
+	// the parent's subtree ends, parents always have lower indices
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		auto& ent = entries[i];
+
+		ent.end = (ent.nextSibling != none)? ent.nextSibling
+		        : (ent.parent != none)?      entries[ent.parent].end
+		        : entries.size();
+	}
+}
+
+uint32_t sceneHierarchy::indexOf(sceneNode *node) const {
+	auto it = indices.find(node);
+	return (it == indices.end())? none : it->second;
+}
@@ -14,6 +14,8 @@
 #include <grend/ecs/animationController.hpp>
 #include <grend/ecs/materialComponent.hpp>
 #include <grend/ecs/bufferComponent.hpp>
+#include <grend/ecs/voxelVolume.hpp>
+#include <grend/ecs/particleEmitter.hpp>
 
 using namespace grendx;
 using namespace grendx::ecs;
@@ -50,6 +52,8 @@ void grendx::ecs::addDefaultFactories(void) {
 
 	factories->add<animationController>();
 	factories->add<materialComponent>();
+	factories->add<voxelVolume>();
+	factories->add<particleEmitter>();
 
 	factories->add<bufferComponent<sceneModel::vertex>>();
 	factories->add<bufferComponent<sceneModel::jointWeights>>();
@@ -80,6 +84,8 @@ void grendx::ecs::addDefaultEditors(void) {
 
 	editor->add<animationController>();
 	editor->add<materialComponent>();
+	editor->add<voxelVolume>();
+	editor->add<particleEmitter>();
 
 	editor->add<bufferComponent<sceneModel::vertex>>();
 	editor->add<bufferComponent<sceneModel::jointWeights>>();
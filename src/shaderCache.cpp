@@ -0,0 +1,312 @@
+#include <grend-config.h>
+
+#include <grend/shaderCache.hpp>
+#include <grend/shaderPack.hpp>
+#include <grend/logger.hpp>
+#include <grend/utility.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sys/stat.h>
+
+using namespace grendx;
+
+shaderSourceCache& grendx::shaderSources(void) {
+	static shaderSourceCache ret(GR_PREFIX "shaders/");
+	return ret;
+}
+
+static bool fileStat(const std::string& path, time_t& mtime, int64_t& size) {
+	struct stat st;
+
+	if (stat(path.c_str(), &st) != 0) {
+		return false;
+	}
+
+	mtime = st.st_mtime;
+	size  = st.st_size;
+	return true;
+}
+
+static std::string_view extractInclude(std::string_view pathspec) {
+	// TODO: handle quoted paths
+	size_t begin = pathspec.find('<');
+	size_t end   = pathspec.find('>');
+
+	if (begin == std::string::npos || end == std::string::npos || end < begin) {
+		LogCatFmt(logcat::render, Error,
+		          "Error: Invalid include specification! {}", pathspec);
+		return {};
+	}
+
+	return pathspec.substr(begin + 1, end - begin - 1);
+}
+
+std::shared_ptr<const std::string>
+shaderSourceCache::load(const std::string& path,
+                        preprocessedShader::dependency& dep)
+{
+	dep = {path, 0, -1};
+
+	if (!fileStat(path, dep.mtime, dep.size)) {
+		static auto empty = std::make_shared<const std::string>();
+		return empty;
+	}
+
+	{
+		std::shared_lock lock(filesMtx);
+		auto it = files.find(path);
+
+		if (it != files.end()
+		    && it->second.mtime == dep.mtime
+		    && it->second.size == dep.size)
+		{
+			return it->second.contents;
+		}
+	}
+
+	std::ifstream ifs(path, std::ios::binary);
+	auto contents = std::make_shared<const std::string>(
+		std::istreambuf_iterator<char>(ifs),
+		std::istreambuf_iterator<char>());
+
+	std::unique_lock lock(filesMtx);
+	files[path] = {dep.mtime, dep.size, contents};
+	return contents;
+}
+
+bool shaderSourceCache::stale(const preprocessedShader& shader) {
+	for (auto& dep : shader.dependencies) {
+		time_t mtime = 0;
+		int64_t size = -1;
+
+		// files that didn't exist are stored with size -1, so this also
+		// catches them being created
+		fileStat(dep.path, mtime, size);
+
+		if (mtime != dep.mtime || size != dep.size) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void shaderSourceCache::process(std::string_view source,
+                                std::string& out,
+                                std::vector<std::string>& included,
+                                std::vector<preprocessedShader::dependency>& deps)
+{
+	while (!source.empty()) {
+		size_t nl = source.find('\n');
+		std::string_view line = source.substr(0, nl);
+		source = (nl == std::string_view::npos)? "" : source.substr(nl + 1);
+
+		if (line.find("#include") != std::string_view::npos) {
+			auto path = extractInclude(line);
+
+			if (path.empty()) {
+				out += "/* Invalid include specification! */\n";
+				continue;
+			}
+
+			if (std::find(included.begin(), included.end(), path) != included.end()) {
+				out += "// (already seen) include from ";
+				out += path;
+				out += '\n';
+				continue;
+			}
+
+			included.emplace_back(path);
+			// TODO: need to be able to specify paths to search for shaders in
+			auto& dep = deps.emplace_back();
+			auto contents = load(includePath + std::string(path), dep);
+
+			out += "// include from ";
+			out += path;
+			out += '\n';
+			out.reserve(out.size() + contents->size());
+			process(*contents, out, included, deps);
+
+		} else if (line.find("#pragma") != std::string_view::npos) {
+			// strip pragmas, just in case, they're leftovers from
+			// the old preprocessor setup
+			continue;
+
+		} else {
+			out += line;
+			out += '\n';
+		}
+	}
+}
+
+preprocessedShader::ptr
+shaderSourceCache::preprocessSource(const std::string& source,
+                                    const std::string& header)
+{
+	auto ret = std::make_shared<preprocessedShader>();
+	std::vector<std::string> included;
+
+	ret->source.reserve(header.size() + source.size());
+	ret->source += header;
+	process(source, ret->source, included, ret->dependencies);
+
+	ret->hash = hashShaderString(ret->source);
+	ret->good = true;
+	return ret;
+}
+
+std::string shaderSourceCache::key(const std::string& path, const std::string& header) {
+	std::string ret;
+	ret.reserve(path.size() + header.size() + 1);
+	ret += path;
+	ret += '\0';
+	ret += header;
+	return ret;
+}
+
+bool shaderSourceCache::packStale(const preprocessedShader& shader,
+                                  std::vector<preprocessedShader::dependency>& current)
+{
+	for (auto& dep : shader.dependencies) {
+		auto& cur = current.emplace_back();
+		auto contents = load(dep.path, cur);
+
+		// size is -1 if the file isn't there, use the packed version
+		if (cur.size >= 0
+		    && (cur.size != dep.size || hashShaderString(*contents) != dep.hash))
+		{
+			LogCatFmt(logcat::render, Info,
+			          "{} changed since it was packed, using the source", dep.path);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+preprocessedShader::ptr shaderSourceCache::findFresh(const std::string& k) {
+	preprocessedShader::ptr pack;
+
+	{
+		std::shared_lock lock(resultsMtx);
+		auto it = results.find(k);
+
+		if (it != results.end() && !stale(*it->second)) {
+			return it->second;
+		}
+
+		auto pit = packed.find(k);
+		if (pit == packed.end()) {
+			return nullptr;
+		}
+
+		pack = pit->second;
+	}
+
+	std::vector<preprocessedShader::dependency> current;
+	if (packStale(*pack, current)) {
+		std::unique_lock lock(resultsMtx);
+		packed.erase(k);
+		return nullptr;
+	}
+
+	// cache as a normal result with the installed files' mtimes, so later
+	// lookups only need to stat them
+	auto ret = std::make_shared<preprocessedShader>(*pack);
+	ret->dependencies = std::move(current);
+
+	std::unique_lock lock(resultsMtx);
+	results[k] = ret;
+	return ret;
+}
+
+preprocessedShader::ptr
+shaderSourceCache::preprocess(const std::string& path,
+                              const std::string& header)
+{
+	std::string k = key(path, header);
+
+	if (auto cached = findFresh(k)) {
+		return cached;
+	}
+
+	preprocessedShader::dependency dep;
+	auto source = load(path, dep);
+
+	auto ret = std::make_shared<preprocessedShader>();
+	std::vector<std::string> included;
+
+	ret->dependencies.push_back(dep);
+	ret->source.reserve(header.size() + source->size());
+	ret->source += header;
+	process(*source, ret->source, included, ret->dependencies);
+
+	ret->hash = hashShaderString(ret->source);
+	ret->good = !source->empty();
+
+	std::unique_lock lock(resultsMtx);
+	results[k] = ret;
+	return ret;
+}
+
+void shaderSourceCache::preprocessBatch(const std::vector<std::pair<std::string, std::string>>& jobs) {
+	// only start threads for results that aren't already cached
+	std::vector<const std::pair<std::string, std::string>*> pending;
+
+	for (auto& job : jobs) {
+		if (!findFresh(key(job.first, job.second))) {
+			pending.push_back(&job);
+		}
+	}
+
+	parallelFor(pending.size(), [&] (size_t i) {
+		preprocess(pending[i]->first, pending[i]->second);
+	});
+}
+
+void shaderSourceCache::clear(void) {
+	std::unique_lock flock(filesMtx);
+	std::unique_lock rlock(resultsMtx);
+
+	files.clear();
+	results.clear();
+	packed.clear();
+}
+
+bool shaderSourceCache::loadPack(const std::string& path) {
+	shaderPackEntries entries;
+
+	if (!readShaderPack(path, entries)) {
+		return false;
+	}
+
+	std::unique_lock lock(resultsMtx);
+	for (auto& [k, shader] : entries) {
+		packed[k] = shader;
+	}
+
+	LogCatFmt(logcat::render, Info, "Loaded {} packed shaders from {}",
+	          entries.size(), path);
+	return true;
+}
+
+bool shaderSourceCache::isPacked(const std::string& path, const std::string& header) {
+	std::shared_lock lock(resultsMtx);
+	return packed.count(key(path, header));
+}
+
+bool shaderSourceCache::unpack(const std::string& path, const std::string& header) {
+	std::string k = key(path, header);
+	std::unique_lock lock(resultsMtx);
+
+	if (!packed.erase(k)) {
+		return false;
+	}
+
+	// might be holding the packed version
+	results.erase(k);
+	return true;
+}
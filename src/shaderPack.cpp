@@ -0,0 +1,778 @@
+#include <grend/shaderPack.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <set>
+#include <unordered_set>
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace grendx;
+
+namespace {
+
+static bool isIdentStart(char c) {
+	return isalpha((unsigned char)c) || c == '_';
+}
+
+static bool isIdentChar(char c) {
+	return isalnum((unsigned char)c) || c == '_';
+}
+
+static std::string_view trim(std::string_view str) {
+	while (!str.empty() && isspace((unsigned char)str.front())) str.remove_prefix(1);
+	while (!str.empty() && isspace((unsigned char)str.back()))  str.remove_suffix(1);
+	return str;
+}
+
+// #if expression evaluator, handles the subset of the C preprocessor
+// grammar that shows up in shaders (no function-like macros)
+class conditionEvaluator {
+	public:
+		conditionEvaluator(const std::unordered_map<std::string, std::string>& defs,
+		                   std::string_view expr, unsigned depth = 0)
+			: defines(defs), str(expr), depth(depth) {}
+
+		std::optional<long> evaluate(void) {
+			auto ret = binary(0);
+			skipSpace();
+			return (pos == str.size())? ret : std::nullopt;
+		}
+
+	private:
+		const std::unordered_map<std::string, std::string>& defines;
+		std::string_view str;
+		size_t pos = 0;
+		unsigned depth;
+
+		void skipSpace(void) {
+			while (pos < str.size() && isspace((unsigned char)str[pos])) pos++;
+		}
+
+		bool accept(std::string_view tok) {
+			skipSpace();
+			if (str.substr(pos, tok.size()) == tok) {
+				pos += tok.size();
+				return true;
+			}
+			return false;
+		}
+
+		std::string_view identifier(void) {
+			skipSpace();
+			size_t start = pos;
+			if (pos < str.size() && isIdentStart(str[pos])) {
+				while (pos < str.size() && isIdentChar(str[pos])) pos++;
+			}
+			return str.substr(start, pos - start);
+		}
+
+		std::optional<long> primary(void) {
+			skipSpace();
+			if (pos >= str.size()) return std::nullopt;
+
+			if (accept("(")) {
+				auto ret = binary(0);
+				return accept(")")? ret : std::nullopt;
+			}
+
+			if (accept("!")) { auto v = primary(); return v? std::optional<long>(!*v) : v; }
+			if (accept("~")) { auto v = primary(); return v? std::optional<long>(~*v) : v; }
+			if (accept("-")) { auto v = primary(); return v? std::optional<long>(-*v) : v; }
+			if (accept("+")) { return primary(); }
+
+			if (isdigit((unsigned char)str[pos])) {
+				const char *begin = str.data() + pos;
+				char *end;
+				long ret = strtol(begin, &end, 0);
+				pos += end - begin;
+				// unsigned/long suffixes
+				while (pos < str.size() && strchr("uUlL", str[pos])) pos++;
+				return ret;
+			}
+
+			auto name = identifier();
+			if (name.empty()) return std::nullopt;
+
+			if (name == "defined") {
+				bool paren = accept("(");
+				auto arg = identifier();
+				if (arg.empty() || (paren && !accept(")"))) return std::nullopt;
+				return defines.count(std::string(arg))? 1 : 0;
+			}
+
+			auto it = defines.find(std::string(name));
+			if (it == defines.end()) {
+				// undefined identifiers are 0, same as cpp
+				return 0;
+			}
+
+			if (depth > 16) return std::nullopt;
+			return conditionEvaluator(defines, it->second, depth + 1).evaluate();
+		}
+
+		struct op {
+			const char *tok;
+			int prec;
+		};
+
+		std::optional<long> binary(int minPrec) {
+			// longer operators first so eg. "<=" isn't read as "<"
+			static const op ops[] = {
+				{"||", 1}, {"&&", 2}, {"==", 6}, {"!=", 6},
+				{"<=", 7}, {">=", 7}, {"<<", 8}, {">>", 8},
+				{"|", 3}, {"^", 4}, {"&", 5}, {"<", 7}, {">", 7},
+				{"+", 9}, {"-", 9}, {"*", 10}, {"/", 10}, {"%", 10},
+			};
+
+			auto lhs = primary();
+
+			while (lhs) {
+				skipSpace();
+				const op *found = nullptr;
+
+				for (auto& o : ops) {
+					if (str.substr(pos, strlen(o.tok)) == o.tok) {
+						found = &o;
+						break;
+					}
+				}
+
+				if (!found || found->prec < minPrec) {
+					break;
+				}
+
+				pos += strlen(found->tok);
+				auto rhs = binary(found->prec + 1);
+				if (!rhs) return std::nullopt;
+
+				long a = *lhs, b = *rhs;
+				std::string_view t = found->tok;
+
+				if      (t == "||") lhs = a || b;
+				else if (t == "&&") lhs = a && b;
+				else if (t == "==") lhs = a == b;
+				else if (t == "!=") lhs = a != b;
+				else if (t == "<=") lhs = a <= b;
+				else if (t == ">=") lhs = a >= b;
+				else if (t == "<<") lhs = a << b;
+				else if (t == ">>") lhs = a >> b;
+				else if (t == "|")  lhs = a | b;
+				else if (t == "^")  lhs = a ^ b;
+				else if (t == "&")  lhs = a & b;
+				else if (t == "<")  lhs = a < b;
+				else if (t == ">")  lhs = a > b;
+				else if (t == "+")  lhs = a + b;
+				else if (t == "-")  lhs = a - b;
+				else if (t == "*")  lhs = a * b;
+				else if (t == "/")  lhs = b? std::optional<long>(a / b) : std::nullopt;
+				else if (t == "%")  lhs = b? std::optional<long>(a % b) : std::nullopt;
+			}
+
+			return lhs;
+		}
+};
+
+struct condState {
+	bool active;   // lines in this branch are emitted
+	bool taken;    // some branch of this conditional was taken
+	bool parent;   // enclosing block is active
+};
+
+// token in the stripping pass, only identifiers and punctuation matter
+struct token {
+	std::string_view text;
+	size_t offset;
+};
+
+static void tokenize(std::string_view src, std::vector<token>& out) {
+	size_t i = 0;
+	bool lineStart = true;
+
+	while (i < src.size()) {
+		char c = src[i];
+
+		if (c == '\n') { lineStart = true; i++; continue; }
+		if (isspace((unsigned char)c)) { i++; continue; }
+
+		if (c == '/' && i + 1 < src.size() && src[i+1] == '/') {
+			while (i < src.size() && src[i] != '\n') i++;
+			continue;
+		}
+
+		if (c == '/' && i + 1 < src.size() && src[i+1] == '*') {
+			size_t end = src.find("*/", i + 2);
+			i = (end == std::string_view::npos)? src.size() : end + 2;
+			continue;
+		}
+
+		if (c == '#' && lineStart) {
+			// directives are emitted as single tokens
+			size_t end = src.find('\n', i);
+			end = (end == std::string_view::npos)? src.size() : end;
+			out.push_back({src.substr(i, end - i), i});
+			i = end;
+			continue;
+		}
+
+		lineStart = false;
+		size_t start = i;
+
+		if (isIdentStart(c)) {
+			while (i < src.size() && isIdentChar(src[i])) i++;
+		} else if (isdigit((unsigned char)c) || (c == '.' && i + 1 < src.size()
+		                                          && isdigit((unsigned char)src[i+1])))
+		{
+			while (i < src.size() && (isIdentChar(src[i]) || src[i] == '.')) i++;
+		} else {
+			i++;
+		}
+
+		out.push_back({src.substr(start, i - start), start});
+	}
+}
+
+// top level declaration or function definition
+struct shaderItem {
+	enum kind { Directive, Function, Uniform, UniformBlock, Other } type;
+	size_t begin, end;         // byte range in the source
+	size_t firstTok, lastTok;  // token range, inclusive
+	std::vector<std::string> names;
+	bool keep = false;
+};
+
+static bool isQualifier(std::string_view tok) {
+	return tok == "lowp" || tok == "mediump" || tok == "highp"
+	    || tok == "flat" || tok == "smooth" || tok == "invariant";
+}
+
+// "type name [N]" sequences, ending at any of the stop tokens
+static size_t parseDeclarator(const std::vector<token>& toks, size_t i, size_t end,
+                              std::string& name, unsigned& arraySize)
+{
+	arraySize = 0;
+	name.clear();
+
+	if (i <= end && isIdentStart(toks[i].text[0])) {
+		name = toks[i++].text;
+	}
+
+	if (i + 2 <= end && toks[i].text == "[") {
+		arraySize = atoi(std::string(toks[i + 1].text).c_str());
+		while (i <= end && toks[i].text != "]") i++;
+		i++;
+	}
+
+	return i;
+}
+
+static void reflectUniform(const std::vector<token>& toks,
+                           shaderItem& item,
+                           shaderReflection& refl)
+{
+	size_t i = item.firstTok;
+
+	// skip layout(...) and "uniform"
+	if (toks[i].text == "layout") {
+		while (i <= item.lastTok && toks[i].text != ")") i++;
+		i++;
+	}
+
+	i++;
+	while (i <= item.lastTok && isQualifier(toks[i].text)) i++;
+
+	if (item.type == shaderItem::UniformBlock) {
+		shaderReflection::block blk;
+		blk.name = toks[i].text;
+		item.names.push_back(blk.name);
+
+		// skip block name and '{'
+		i += 2;
+
+		while (i <= item.lastTok && toks[i].text != "}") {
+			while (i <= item.lastTok && (isQualifier(toks[i].text)
+			                             || toks[i].text == "layout"))
+			{
+				if (toks[i].text == "layout") {
+					while (i <= item.lastTok && toks[i].text != ")") i++;
+				}
+				i++;
+			}
+
+			std::string type(toks[i++].text);
+
+			for (;;) {
+				shaderReflection::uniform u;
+				u.type = type;
+				i = parseDeclarator(toks, i, item.lastTok, u.name, u.arraySize);
+				item.names.push_back(u.name);
+				blk.members.push_back(std::move(u));
+
+				if (i <= item.lastTok && toks[i].text == ",") {
+					i++;
+					continue;
+				}
+
+				break;
+			}
+
+			// ';'
+			i++;
+		}
+
+		// instance name, if any
+		if (i + 1 <= item.lastTok && isIdentStart(toks[i + 1].text[0])) {
+			blk.instance = toks[i + 1].text;
+			item.names.push_back(blk.instance);
+		}
+
+		refl.blocks.push_back(std::move(blk));
+
+	} else {
+		std::string type(toks[i++].text);
+
+		for (;;) {
+			shaderReflection::uniform u;
+			u.type = type;
+			i = parseDeclarator(toks, i, item.lastTok, u.name, u.arraySize);
+
+			// skip initializers
+			while (i <= item.lastTok && toks[i].text != "," && toks[i].text != ";") i++;
+
+			item.names.push_back(u.name);
+			refl.uniforms.push_back(std::move(u));
+
+			if (i <= item.lastTok && toks[i].text == ",") {
+				i++;
+				continue;
+			}
+
+			break;
+		}
+	}
+}
+
+// namespace
+}
+
+bool grendx::resolveShaderConditionals(std::string_view source, std::string& out) {
+	std::unordered_map<std::string, std::string> defines;
+	std::vector<condState> stack;
+	std::string ret;
+	ret.reserve(source.size());
+
+	auto active = [&] () { return stack.empty() || stack.back().active; };
+
+	while (!source.empty()) {
+		size_t nl = source.find('\n');
+		std::string_view line = source.substr(0, nl);
+		source = (nl == std::string_view::npos)? "" : source.substr(nl + 1);
+
+		std::string_view t = trim(line);
+
+		if (t.empty() || t[0] != '#') {
+			if (active()) {
+				ret += line;
+				ret += '\n';
+			}
+			continue;
+		}
+
+		t = trim(t.substr(1));
+		size_t split = 0;
+		while (split < t.size() && isIdentChar(t[split])) split++;
+
+		std::string_view directive = t.substr(0, split);
+		std::string_view rest = trim(t.substr(split));
+
+		auto eval = [&] (std::string_view expr) -> std::optional<bool> {
+			auto v = conditionEvaluator(defines, expr).evaluate();
+			return v? std::optional<bool>(*v != 0) : std::nullopt;
+		};
+
+		if (directive == "if" || directive == "ifdef" || directive == "ifndef") {
+			bool parent = active();
+			std::optional<bool> cond;
+
+			if (directive == "if") {
+				cond = parent? eval(rest) : std::optional<bool>(false);
+			} else {
+				bool def = defines.count(std::string(trim(rest)));
+				cond = (directive == "ifdef")? def : !def;
+			}
+
+			if (!cond) return false;
+			stack.push_back({parent && *cond, parent && *cond, parent});
+
+		} else if (directive == "elif") {
+			if (stack.empty()) return false;
+			auto& top = stack.back();
+
+			if (top.taken || !top.parent) {
+				top.active = false;
+
+			} else {
+				auto cond = eval(rest);
+				if (!cond) return false;
+				top.active = *cond;
+				top.taken  = *cond;
+			}
+
+		} else if (directive == "else") {
+			if (stack.empty()) return false;
+			auto& top = stack.back();
+			top.active = top.parent && !top.taken;
+			top.taken  = true;
+
+		} else if (directive == "endif") {
+			if (stack.empty()) return false;
+			stack.pop_back();
+
+		} else if (active()) {
+			if (directive == "define") {
+				size_t n = 0;
+				while (n < rest.size() && isIdentChar(rest[n])) n++;
+
+				std::string name(rest.substr(0, n));
+				// function-like macros can't be evaluated in conditions,
+				// just note that they're defined
+				bool function = n < rest.size() && rest[n] == '(';
+				defines[name] = function? "" : std::string(trim(rest.substr(n)));
+
+			} else if (directive == "undef") {
+				defines.erase(std::string(rest));
+			}
+
+			ret += line;
+			ret += '\n';
+		}
+	}
+
+	if (!stack.empty()) {
+		return false;
+	}
+
+	out = std::move(ret);
+	return true;
+}
+
+std::string grendx::stripShader(std::string_view source, shaderReflection& reflection) {
+	std::vector<token> toks;
+	std::vector<shaderItem> items;
+	tokenize(source, toks);
+
+	// split into top level items
+	for (size_t i = 0; i < toks.size();) {
+		shaderItem item = {};
+		item.firstTok = i;
+		item.begin    = toks[i].offset;
+
+		if (toks[i].text[0] == '#') {
+			item.type    = shaderItem::Directive;
+			item.lastTok = i;
+			item.end     = toks[i].offset + toks[i].text.size();
+			item.keep    = true;
+			items.push_back(item);
+			i++;
+			continue;
+		}
+
+		int depth = 0;
+		bool isUniform = false;
+		bool isFunction = false;
+		bool hasBraces = false;
+		size_t j = i;
+
+		for (; j < toks.size(); j++) {
+			auto t = toks[j].text;
+
+			if (t == "uniform" && depth == 0) {
+				isUniform = true;
+
+			} else if (t == "(" || t == "[") {
+				depth++;
+
+			} else if (t == ")" || t == "]") {
+				depth--;
+
+			} else if (t == "{") {
+				if (depth == 0 && !hasBraces && j > i && toks[j - 1].text == ")"
+				    && !isUniform)
+				{
+					isFunction = true;
+				}
+
+				hasBraces = true;
+				depth++;
+
+			} else if (t == "}") {
+				depth--;
+				if (depth == 0 && isFunction) break;
+
+			} else if (t == ";" && depth == 0) {
+				break;
+			}
+		}
+
+		j = std::min(j, toks.size() - 1);
+		item.lastTok = j;
+		item.end     = toks[j].offset + toks[j].text.size();
+
+		if (isFunction || (!isUniform && !hasBraces && toks[j].text == ";"
+		                   && std::any_of(toks.begin() + i, toks.begin() + j,
+		                                  [] (auto& t) { return t.text == "("; })
+		                   && std::none_of(toks.begin() + i, toks.begin() + j,
+		                                   [] (auto& t) { return t.text == "="; })))
+		{
+			// definition or prototype, name is the identifier before the
+			// first paren
+			item.type = shaderItem::Function;
+
+			for (size_t k = i; k + 1 <= j; k++) {
+				if (toks[k + 1].text == "(") {
+					item.names.emplace_back(toks[k].text);
+					break;
+				}
+			}
+
+		} else if (isUniform) {
+			item.type = hasBraces? shaderItem::UniformBlock : shaderItem::Uniform;
+
+		} else {
+			item.type = shaderItem::Other;
+			item.keep = true;
+		}
+
+		items.push_back(std::move(item));
+		i = j + 1;
+	}
+
+	// functions by name (overloads share a name)
+	std::unordered_map<std::string_view, std::vector<size_t>> functions;
+	for (size_t k = 0; k < items.size(); k++) {
+		if (items[k].type == shaderItem::Function && !items[k].names.empty()) {
+			functions[items[k].names[0]].push_back(k);
+		}
+	}
+
+	// everything that isn't a function or a uniform is a root, along with main()
+	std::vector<size_t> worklist;
+	std::unordered_set<std::string_view> referenced;
+
+	for (size_t k = 0; k < items.size(); k++) {
+		if (items[k].keep) worklist.push_back(k);
+	}
+
+	for (size_t k : functions["main"]) {
+		items[k].keep = true;
+		worklist.push_back(k);
+	}
+
+	while (!worklist.empty()) {
+		auto& item = items[worklist.back()];
+		worklist.pop_back();
+
+		for (size_t t = item.firstTok; t <= item.lastTok; t++) {
+			auto text = toks[t].text;
+			if (!isIdentStart(text[0]) || !referenced.insert(text).second) {
+				continue;
+			}
+
+			auto it = functions.find(text);
+			if (it == functions.end()) continue;
+
+			for (size_t k : it->second) {
+				if (!items[k].keep) {
+					items[k].keep = true;
+					worklist.push_back(k);
+				}
+			}
+		}
+	}
+
+	// keep uniforms that are referenced by anything that's left
+	for (auto& item : items) {
+		if (item.type != shaderItem::Uniform && item.type != shaderItem::UniformBlock) {
+			continue;
+		}
+
+		shaderReflection temp;
+		reflectUniform(toks, item, temp);
+
+		item.keep = std::any_of(item.names.begin(), item.names.end(),
+			[&] (auto& name) { return referenced.count(name); });
+
+		if (item.keep) {
+			for (auto& u : temp.uniforms) reflection.uniforms.push_back(std::move(u));
+			for (auto& b : temp.blocks)   reflection.blocks.push_back(std::move(b));
+		}
+	}
+
+	// copy everything except the removed items, keeps original formatting
+	std::string ret;
+	ret.reserve(source.size());
+	size_t last = 0;
+
+	for (auto& item : items) {
+		if (!item.keep) {
+			ret += source.substr(last, item.begin - last);
+			last = item.end;
+		}
+	}
+
+	ret += source.substr(last);
+	return ret;
+}
+
+// archive format, native byte order since packs are built for the target:
+//   "GRSP" u32 version, u32 count, then count entries of
+//   str key, u64 hash, str source, reflection, u32 count, then count
+//   dependencies of str path, u64 size, u64 content hash
+// strings are a u32 length followed by the data
+enum : uint32_t {
+	PACK_MAGIC   = 0x50535247, // "GRSP"
+	PACK_VERSION = 2,
+};
+
+namespace {
+	struct packWriter {
+		std::ofstream& out;
+
+		void u32(uint32_t v) { out.write((char*)&v, sizeof(v)); }
+		void u64(uint64_t v) { out.write((char*)&v, sizeof(v)); }
+		void str(std::string_view s) { u32(s.size()); out.write(s.data(), s.size()); }
+
+		void uniform(const shaderReflection::uniform& u) {
+			str(u.type);
+			str(u.name);
+			u32(u.arraySize);
+		}
+	};
+
+	struct packReader {
+		std::ifstream& in;
+
+		uint32_t u32(void) { uint32_t v = 0; in.read((char*)&v, sizeof(v)); return v; }
+		uint64_t u64(void) { uint64_t v = 0; in.read((char*)&v, sizeof(v)); return v; }
+
+		std::string str(void) {
+			uint32_t len = u32();
+			// sanity check, avoid giant allocations from corrupt files
+			if (!in || len > (64u << 20)) {
+				in.setstate(std::ios::failbit);
+				return "";
+			}
+
+			std::string ret(len, '\0');
+			in.read(ret.data(), len);
+			return ret;
+		}
+
+		shaderReflection::uniform uniform(void) {
+			shaderReflection::uniform u;
+			u.type = str();
+			u.name = str();
+			u.arraySize = u32();
+			return u;
+		}
+	};
+}
+
+bool grendx::writeShaderPack(const std::string& path, const shaderPackEntries& entries) {
+	std::ofstream ofs(path, std::ios::binary);
+	packWriter w = {ofs};
+
+	w.u32(PACK_MAGIC);
+	w.u32(PACK_VERSION);
+	w.u32(entries.size());
+
+	for (auto& [key, shader] : entries) {
+		static const shaderReflection empty;
+		auto& refl = shader->reflection? *shader->reflection : empty;
+
+		w.str(key);
+		w.u64(shader->hash);
+		w.str(shader->source);
+
+		w.u32(refl.uniforms.size());
+		for (auto& u : refl.uniforms) {
+			w.uniform(u);
+		}
+
+		w.u32(refl.blocks.size());
+		for (auto& b : refl.blocks) {
+			w.str(b.name);
+			w.str(b.instance);
+			w.u32(b.members.size());
+
+			for (auto& u : b.members) {
+				w.uniform(u);
+			}
+		}
+
+		w.u32(shader->dependencies.size());
+		for (auto& dep : shader->dependencies) {
+			w.str(dep.path);
+			w.u64(dep.size);
+			w.u64(dep.hash);
+		}
+	}
+
+	return !!ofs;
+}
+
+bool grendx::readShaderPack(const std::string& path, shaderPackEntries& entries) {
+	std::ifstream ifs(path, std::ios::binary);
+	packReader r = {ifs};
+
+	if (!ifs || r.u32() != PACK_MAGIC || r.u32() != PACK_VERSION) {
+		return false;
+	}
+
+	uint32_t count = r.u32();
+
+	for (uint32_t i = 0; i < count && ifs; i++) {
+		auto shader = std::make_shared<preprocessedShader>();
+		auto refl   = std::make_shared<shaderReflection>();
+
+		std::string key = r.str();
+		shader->hash   = r.u64();
+		shader->source = r.str();
+		shader->good   = true;
+
+		uint32_t numUniforms = r.u32();
+		for (uint32_t k = 0; k < numUniforms && ifs; k++) {
+			refl->uniforms.push_back(r.uniform());
+		}
+
+		uint32_t numBlocks = r.u32();
+		for (uint32_t k = 0; k < numBlocks && ifs; k++) {
+			shaderReflection::block b;
+			b.name     = r.str();
+			b.instance = r.str();
+
+			uint32_t numMembers = r.u32();
+			for (uint32_t m = 0; m < numMembers && ifs; m++) {
+				b.members.push_back(r.uniform());
+			}
+
+			refl->blocks.push_back(std::move(b));
+		}
+
+		uint32_t numDeps = r.u32();
+		for (uint32_t k = 0; k < numDeps && ifs; k++) {
+			auto& dep = shader->dependencies.emplace_back();
+			dep.path  = r.str();
+			dep.mtime = 0;
+			dep.size  = int64_t(r.u64());
+			dep.hash  = r.u64();
+		}
+
+		shader->reflection = refl;
+		entries.push_back({key, shader});
+	}
+
+	return !!ifs;
+}
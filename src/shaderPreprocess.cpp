@@ -6,113 +6,60 @@
 #include <grend/utility.hpp>
 #include <grend/logger.hpp>
 
-#include <sstream>
-#include <exception>
+#include <algorithm>
 
 using namespace grendx;
 
-static std::string extractInclude(std::string pathspec) {
-	// TODO: handle quoted paths
-	size_t begin = pathspec.find('<');
-	size_t end   = pathspec.find('>');
+std::string grendx::shaderDefineHeader(const Shader::parameters& opts) {
+	std::string ret;
+	ret.reserve(256);
 
-	if (begin == std::string::npos || end == std::string::npos || end < begin) {
-		LogErrorFmt("Error: Invalid include specification! ", pathspec);
-		return "/* Invalid include specification! */\n";
-	}
-
-	return pathspec.substr(begin + 1, end - begin - 1);
-}
-
-static std::string preprocess(std::string& sourcestr,
-                              std::set<std::string>& included);
+	ret += "#version " GLSL_STRING "\n";
+	ret += "#define GLSL_VERSION " + std::to_string(GLSL_VERSION) + "\n";
+	ret += "#define MAX_LIGHTS " + std::to_string(MAX_LIGHTS) + "\n";
+	ret += "\n";
 
-static std::string preprocessInclude(std::string& path,
-                                     std::set<std::string>& included)
-{
-
-	if (!included.count(path)) {
-		// TODO: need to be able to specify paths to search for shaders in
-		std::string fullpath = GR_PREFIX + std::string("shaders/") + path;
-		std::string source = load_file(fullpath);
-		included.insert(path);
+	for (auto& [key, value] : opts) {
+		std::string def = key;
+		std::transform(def.begin(), def.end(), def.begin(), toupper);
 
-		std::string note = "// include from " + path + "\n";
-		return note + preprocess(source, included);
+		ret += "#define ";
+		ret += def;
+		ret += ' ';
 
-	} else {
-		return "// (already seen) include from " + path + "\n";
-	}
-}
+		if (std::holds_alternative<GLint>(value)) {
+			ret += std::to_string(std::get<GLint>(value));
+		}
 
-static std::string preprocess(std::string& sourcestr,
-                              std::set<std::string>& included)
-{
-	std::stringstream source(sourcestr);
-	std::string processed;
-	
-	std::string line;
-	while (std::getline(source, line)) {
-		size_t inc = line.find("#include");
-		size_t prag = line.find("#pragma");
-		//size_t directive = line.find("#");
-
-		if (inc != std::string::npos) {
-			auto path = extractInclude(line);
-			processed += preprocessInclude(path, included);
-
-		} else if (prag != std::string::npos) {
-			// strip pragmas, just in case, they're leftovers from
-			// the old preprocessor setup
-			continue;
-
-			/*
-		} else if (directive != std::string::npos) {
-			// remove leading spaces, if any
-			processed += line.substr(directive) + "\n";
-			*/
-
-		} else {
-			processed += line + "\n";
-			continue;
+		else if (std::holds_alternative<GLfloat>(value)) {
+			ret += std::to_string(std::get<GLfloat>(value));
 		}
+
+		ret += '\n';
 	}
 
-	return processed;
+	return ret;
 }
 
 std::string grendx::preprocessShader(std::string& source,
                                      const Shader::parameters& opts)
 {
-	std::string version = std::string("#version ") + GLSL_STRING + "\n";
-
-	std::string defines =
-		"#define GLSL_VERSION " + std::to_string(GLSL_VERSION) + "\n" +
-		"#define MAX_LIGHTS " + std::to_string(MAX_LIGHTS) + "\n" +
-		"\n";
-
-	std::string optstr = "";
-	for (auto& [key, value] : opts) {
-		std::string def = key;
-
-		std::transform(def.begin(), def.end(), def.begin(), toupper);
-		std::string pref = "#define " + def + " ";
+	return shaderSources().preprocessSource(source, shaderDefineHeader(opts))->source;
+}
 
-		if (std::holds_alternative<GLint>(value)) {
-			pref += std::to_string(std::get<GLint>(value));
-		}
+preprocessedShader::ptr grendx::preprocessShaderFile(const std::string& path,
+                                                     const Shader::parameters& opts)
+{
+	return shaderSources().preprocess(path, shaderDefineHeader(opts));
+}
 
-		else if (std::holds_alternative<GLfloat>(value)) {
-			pref += std::to_string(std::get<GLfloat>(value));
-		}
+void grendx::preprocessShaderFiles(const std::vector<shaderFileOptions>& files) {
+	std::vector<std::pair<std::string, std::string>> jobs;
+	jobs.reserve(files.size());
 
-		pref += "\n";
-		optstr += pref;
+	for (auto& [path, opts] : files) {
+		jobs.push_back({path, shaderDefineHeader(opts)});
 	}
 
-	std::set<std::string> includes;
-	std::string processed = preprocess(source, includes);
-
-	std::string full = version + defines + optstr + processed;
-	return full;
+	shaderSources().preprocessBatch(jobs);
 }
@@ -0,0 +1,107 @@
+#include <grend/shadowCache.hpp>
+
+#include <string.h>
+#include <math.h>
+
+using namespace grendx;
+
+shadowCache::~shadowCache() {};
+
+static inline uint64_t mix(uint64_t h, uint64_t v) {
+	return (h ^ v) * 0x100000001b3ull;
+}
+
+uint64_t grendx::shadowCasterHash(const void *mesh, const glm::mat4& transform) {
+	uint64_t h = 0xcbf29ce484222325ull ^ reinterpret_cast<uintptr_t>(mesh);
+	const float *m = glm::value_ptr(transform);
+
+	for (unsigned i = 0; i < 16; i++) {
+		uint32_t bits;
+		memcpy(&bits, m + i, sizeof(bits));
+		h = mix(h, bits);
+	}
+
+	// final avalanche, signatures are sums of these
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return h;
+}
+
+// instances are identified by mesh and position, quantized so that the key
+// is stable for still objects. Objects that move across cells get new keys,
+// so they're never still long enough to be static.
+static uint64_t instanceKey(const void *mesh, const glm::mat4& transform) {
+	constexpr float cellSize = 0.25f;
+
+	uint64_t h = reinterpret_cast<uintptr_t>(mesh);
+
+	for (int i = 0; i < 3; i++) {
+		int64_t cell = int64_t(floorf(transform[3][i] / cellSize));
+		h = mix(h, uint64_t(cell));
+	}
+
+	return h;
+}
+
+shadowCache::lightState& shadowCache::light(const void *light, const void *atlas) {
+	if (atlas != currentAtlas) {
+		// node ids are only meaningful for the atlas they came from
+		lights.clear();
+		currentAtlas = atlas;
+	}
+
+	auto& state = lights[light];
+	state.lastSeen = frame;
+	return state;
+}
+
+uint32_t shadowCache::lastUpdate(const void *light) const {
+	auto it = lights.find(light);
+	return (it == lights.end())? 0 : it->second.lastUpdate;
+}
+
+bool shadowCache::isStatic(const void *mesh, const glm::mat4& transform) {
+	uint64_t hash = shadowCasterHash(mesh, transform);
+	auto [it, added] = casters.try_emplace(instanceKey(mesh, transform),
+	                                       casterState {hash, frame, frame});
+	auto& c = it->second;
+
+	if (!added && c.hash != hash) {
+		c.hash       = hash;
+		c.stillSince = frame;
+	}
+
+	c.lastSeen = frame;
+	return frame - c.stillSince >= settings.staticFrames;
+}
+
+bool shadowCache::takeBudget(bool optional) {
+	if (optional && budgetUsed >= settings.faceBudget) {
+		return false;
+	}
+
+	budgetUsed++;
+	return true;
+}
+
+void shadowCache::newFrame(void) {
+	lastFrame  = current;
+	current    = {};
+	budgetUsed = 0;
+	frame++;
+
+	// forget lights and casters that haven't been seen in a while, every
+	// so often so this doesn't walk the maps every frame
+	constexpr uint32_t expireFrames = 256;
+
+	if (frame % 64 == 0) {
+		std::erase_if(lights, [&] (const auto& ent) {
+			return frame - ent.second.lastSeen > expireFrames;
+		});
+
+		std::erase_if(casters, [&] (const auto& ent) {
+			return frame - ent.second.lastSeen > expireFrames;
+		});
+	}
+}
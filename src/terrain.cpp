@@ -0,0 +1,475 @@
+#include <grend/terrain.hpp>
+#include <grend/jobQueue.hpp>
+#include <grend/gameMain.hpp>
+#include <grend/ecs/ecs.hpp>
+#include <grend/ecs/bufferComponent.hpp>
+
+#include <algorithm>
+#include <unordered_set>
+#include <math.h>
+
+using namespace grendx;
+
+static inline float chunkExtent(const terrainSettings& settings, unsigned level) {
+	return settings.chunkSize * float(1u << level);
+}
+
+size_t grendx::terrainChunkVertices(const terrainSettings& settings) {
+	size_t side = settings.chunkQuads + 1;
+	return side*side + 4*side;
+}
+
+// vertex index of skirt vertex k along edge e, edges go around the chunk as
+// -z, +x, +z, -x
+static inline sceneMesh::faceType skirtIndex(unsigned q, unsigned edge, unsigned k) {
+	unsigned side = q + 1;
+	return side*side + edge*side + k;
+}
+
+// grid vertex index of point k along edge e
+static inline sceneMesh::faceType edgeIndex(unsigned q, unsigned edge, unsigned k) {
+	unsigned side = q + 1;
+
+	switch (edge) {
+		case 0:  return k;
+		case 1:  return k*side + q;
+		case 2:  return q*side + k;
+		default: return k*side;
+	}
+}
+
+void grendx::terrainChunkIndices(const terrainSettings& settings,
+                                 std::vector<sceneMesh::faceType>& out)
+{
+	unsigned q    = settings.chunkQuads;
+	unsigned side = q + 1;
+
+	out.clear();
+	// grid, plus both windings of the skirt so it doesn't matter which way
+	// it's seen from
+	out.reserve(q*q*6 + 4*q*12);
+
+	for (unsigned j = 0; j < q; j++) {
+		for (unsigned i = 0; i < q; i++) {
+			sceneMesh::faceType a = j*side + i;
+			sceneMesh::faceType b = a + 1;
+			sceneMesh::faceType c = a + side;
+			sceneMesh::faceType d = c + 1;
+
+			// counter-clockwise seen from above
+			out.insert(out.end(), {a, c, b, b, c, d});
+		}
+	}
+
+	for (unsigned e = 0; e < 4; e++) {
+		for (unsigned k = 0; k < q; k++) {
+			sceneMesh::faceType g0 = edgeIndex(q, e, k);
+			sceneMesh::faceType g1 = edgeIndex(q, e, k + 1);
+			sceneMesh::faceType s0 = skirtIndex(q, e, k);
+			sceneMesh::faceType s1 = skirtIndex(q, e, k + 1);
+
+			out.insert(out.end(), {g0, s0, g1, g1, s0, s1});
+			out.insert(out.end(), {g0, g1, s0, g1, s1, s0});
+		}
+	}
+}
+
+void grendx::generateTerrainChunk(const terrainSettings& settings,
+                                  heightFunction func,
+                                  const terrainChunkKey& key,
+                                  terrainChunkData& out)
+{
+	unsigned q    = settings.chunkQuads;
+	unsigned side = q + 1;
+	// heights with a one sample border, so normals match across chunks
+	unsigned pad  = q + 3;
+
+	float size = chunkExtent(settings, key.level);
+	float step = size / q;
+	float skirt = settings.skirtDepth * float(1u << key.level);
+
+	out.key    = key;
+	out.origin = glm::vec3(key.x * size, 0, key.y * size);
+
+	std::vector<float> heights(pad * pad);
+
+	for (unsigned j = 0; j < pad; j++) {
+		for (unsigned i = 0; i < pad; i++) {
+			float x = out.origin.x + (float(i) - 1.f)*step;
+			float z = out.origin.z + (float(j) - 1.f)*step;
+			heights[j*pad + i] = func(x, z);
+		}
+	}
+
+	auto height = [&] (int i, int j) {
+		return heights[(j + 1)*pad + (i + 1)];
+	};
+
+	auto& verts = out.vertices;
+	verts.resize(terrainChunkVertices(settings));
+
+	float ymin = height(0, 0), ymax = ymin;
+
+	for (unsigned j = 0; j < side; j++) {
+		for (unsigned i = 0; i < side; i++) {
+			float h  = height(i, j);
+			float dx = height(i + 1, j) - height(i - 1, j);
+			float dz = height(i, j + 1) - height(i, j - 1);
+
+			glm::vec3 pos(i*step, h, j*step);
+			glm::vec3 tangent = glm::normalize(glm::vec3(2*step, dx, 0));
+
+			verts[j*side + i] = {
+				.position = pos,
+				.normal   = glm::normalize(glm::vec3(-dx, 2*step, -dz)),
+				.tangent  = glm::vec4(tangent, 1.f),
+				.color    = glm::vec3(1),
+				.uv       = glm::vec2(out.origin.x + pos.x, out.origin.z + pos.z)
+				            * settings.uvScale,
+				.lightmap = glm::vec2(0),
+			};
+
+			ymin = std::min(ymin, h);
+			ymax = std::max(ymax, h);
+		}
+	}
+
+	for (unsigned e = 0; e < 4; e++) {
+		for (unsigned k = 0; k < side; k++) {
+			auto& v = verts[skirtIndex(q, e, k)];
+
+			v = verts[edgeIndex(q, e, k)];
+			v.position.y -= skirt;
+		}
+	}
+
+	out.boundingBox = {
+		.min = glm::vec3(0,    ymin - skirt, 0),
+		.max = glm::vec3(size, ymax,         size),
+	};
+
+	out.boundingSphere = {
+		.center = 0.5f*(out.boundingBox.min + out.boundingBox.max),
+		.extent = 0.5f*glm::distance(out.boundingBox.min, out.boundingBox.max),
+	};
+}
+
+static float rectDistance(const glm::vec3& pos, glm::vec2 rmin, glm::vec2 rmax) {
+	// heights aren't known before generating, so only horizontal distance
+	// counts, which errs on the side of more detail
+	glm::vec2 p(pos.x, pos.z);
+	glm::vec2 d = glm::max(glm::max(rmin - p, p - rmax), glm::vec2(0));
+	return glm::length(d);
+}
+
+static void selectNode(const terrainSettings& settings,
+                       float width, float depth,
+                       const glm::vec3& viewPos,
+                       const terrainChunkKey& key,
+                       std::vector<terrainChunkKey>& out)
+{
+	float size = chunkExtent(settings, key.level);
+	glm::vec2 rmin(key.x * size, key.y * size);
+	glm::vec2 rmax = rmin + glm::vec2(size);
+
+	if (rmin.x >= width || rmin.y >= depth) {
+		return;
+	}
+
+	// use this level once outside of the next finer level's range
+	if (key.level == 0
+	    || rectDistance(viewPos, rmin, rmax)
+	       > settings.lodDistance * float(1u << (key.level - 1)))
+	{
+		out.push_back(key);
+		return;
+	}
+
+	for (int j = 0; j < 2; j++) {
+		for (int i = 0; i < 2; i++) {
+			terrainChunkKey child = {2*key.x + i, 2*key.y + j, key.level - 1};
+			selectNode(settings, width, depth, viewPos, child, out);
+		}
+	}
+}
+
+void grendx::selectTerrainChunks(const terrainSettings& settings,
+                                 float width, float depth,
+                                 const glm::vec3& viewPos,
+                                 std::vector<terrainChunkKey>& out)
+{
+	if (settings.levels == 0) {
+		return;
+	}
+
+	unsigned top  = settings.levels - 1;
+	float rootSize = chunkExtent(settings, top);
+	int nx = int(ceilf(width / rootSize));
+	int ny = int(ceilf(depth / rootSize));
+
+	for (int y = 0; y < ny; y++) {
+		for (int x = 0; x < nx; x++) {
+			selectNode(settings, width, depth, viewPos, {x, y, top}, out);
+		}
+	}
+}
+
+float grendx::terrainMorphFactor(const terrainSettings& settings,
+                                 const terrainChunkKey& key,
+                                 const glm::vec3& viewPos)
+{
+	if (key.level + 1 >= settings.levels) {
+		return 0.f;
+	}
+
+	float size = chunkExtent(settings, key.level);
+	glm::vec2 rmin(key.x * size, key.y * size);
+	float dist = rectDistance(viewPos, rmin, rmin + glm::vec2(size));
+
+	// the parent is used once it's outside this range (see selectNode()),
+	// children can be a bit further away than their parent, hence the clamp
+	float range = settings.lodDistance * float(1u << key.level);
+	float start = range * settings.morphStart;
+
+	return glm::clamp((dist - start) / std::max(range - start, 1e-3f), 0.f, 1.f);
+}
+
+terrain::terrain(float _width, float _depth, heightFunction _func,
+                 const terrainSettings& _settings)
+	: settings(_settings),
+	  width(_width),
+	  depth(_depth),
+	  func(_func)
+{
+	auto ecs = engine::Resolve<ecs::entityManager>();
+	root = ecs->construct<sceneNode>();
+
+	indices = std::make_shared<sceneMesh::sharedIndexData>();
+	terrainChunkIndices(settings, indices->indices);
+}
+
+terrain::~terrain() {
+	auto ecs = engine::Resolve<ecs::entityManager>();
+
+	for (auto& [_, c] : chunks) {
+		for (auto *link : c.model->nodes()) {
+			ecs->remove(link->getRef().getPtr());
+		}
+
+		ecs->remove(c.model.getPtr());
+	}
+
+	// pending jobs only hold their own data, they can finish on their own
+	ecs->remove(root.getPtr());
+}
+
+void terrain::addChunk(terrainChunkData& data) {
+	auto ecs = engine::Resolve<ecs::entityManager>();
+
+	sceneModel::ptr model = ecs->construct<sceneModel>();
+	sceneMesh::ptr  mesh  = ecs->construct<sceneMesh>();
+	auto vertBuf = model->attach<ecs::bufferComponent<sceneModel::vertex>>();
+
+	size_t bytes = data.vertices.size() * sizeof(sceneModel::vertex);
+	vertBuf->data = std::move(data.vertices);
+
+	mesh->sharedIndices  = indices;
+	mesh->boundingBox    = data.boundingBox;
+	mesh->boundingSphere = data.boundingSphere;
+
+	model->haveNormals = model->haveColors = model->haveTexcoords = true;
+	model->haveTangents = model->haveAABB = true;
+	model->transform.setPosition(data.origin);
+	model->visible = false;
+
+	auto& k = data.key;
+	setNode("mesh", model, mesh);
+	setNode("chunk-" + std::to_string(k.level)
+	        + "-" + std::to_string(k.x)
+	        + "-" + std::to_string(k.y), root, model);
+
+	chunks[data.key] = {model, bytes, frame};
+	memory += bytes;
+	current.generated++;
+}
+
+bool terrain::fallback(const terrainChunkKey& key, std::vector<terrainChunkKey>& out) {
+	// nearest loaded ancestor first, then children
+	terrainChunkKey k = key;
+
+	while (k.level + 1 < settings.levels) {
+		k = {k.x >> 1, k.y >> 1, k.level + 1};
+
+		if (chunks.count(k)) {
+			out.push_back(k);
+			return true;
+		}
+	}
+
+	if (key.level == 0) {
+		return false;
+	}
+
+	terrainChunkKey children[4];
+
+	for (int j = 0; j < 2; j++) {
+		for (int i = 0; i < 2; i++) {
+			terrainChunkKey child = {2*key.x + i, 2*key.y + j, key.level - 1};
+
+			if (!chunks.count(child)) {
+				return false;
+			}
+
+			children[j*2 + i] = child;
+		}
+	}
+
+	out.insert(out.end(), children, children + 4);
+	return false;
+}
+
+void terrain::evict(void) {
+	if (memory <= settings.memoryBudget) {
+		return;
+	}
+
+	std::vector<std::pair<uint32_t, terrainChunkKey>> unused;
+
+	for (auto& [key, c] : chunks) {
+		if (c.lastUsed != frame) {
+			unused.push_back({c.lastUsed, key});
+		}
+	}
+
+	std::sort(unused.begin(), unused.end(),
+		[] (const auto& a, const auto& b) { return a.first < b.first; });
+
+	auto ecs = engine::Resolve<ecs::entityManager>();
+
+	for (auto& [_, key] : unused) {
+		if (memory <= settings.memoryBudget) {
+			break;
+		}
+
+		auto it = chunks.find(key);
+		auto& c = it->second;
+
+		for (auto *link : c.model->nodes()) {
+			ecs->remove(link->getRef().getPtr());
+		}
+
+		unlink(c.model);
+		ecs->remove(c.model.getPtr());
+
+		memory -= c.bytes;
+		chunks.erase(it);
+		current.evicted++;
+	}
+}
+
+void terrain::update(const glm::vec3& viewPos, jobQueue *jobs) {
+	frame++;
+	current = {};
+
+	selected.clear();
+	selectTerrainChunks(settings, width, depth, viewPos, selected);
+
+	// finished generation jobs
+	for (auto it = pending.begin(); it != pending.end();) {
+		if (jobFinished(it->second.done)) {
+			addChunk(*it->second.data);
+			it = pending.erase(it);
+		} else {
+			it++;
+		}
+	}
+
+	std::vector<std::pair<float, terrainChunkKey>> missing;
+
+	for (auto& key : selected) {
+		if (!chunks.count(key) && !pending.count(key)) {
+			float size = chunkExtent(settings, key.level);
+			glm::vec2 rmin(key.x * size, key.y * size);
+			missing.push_back({rectDistance(viewPos, rmin, rmin + glm::vec2(size)), key});
+		}
+	}
+
+	// nearest first
+	std::sort(missing.begin(), missing.end(),
+		[] (const auto& a, const auto& b) { return a.first < b.first; });
+
+	for (auto& [_, key] : missing) {
+		if (pending.size() >= settings.maxPending) {
+			break;
+		}
+
+		auto data = std::make_shared<terrainChunkData>();
+		auto job = [s = settings, f = func, k = key, data] () {
+			generateTerrainChunk(s, f, k, *data);
+			return true;
+		};
+
+		if (jobs) {
+			pending[key] = {data, jobs->addAsync(job)};
+
+		} else {
+			job();
+			addChunk(*data);
+		}
+	}
+
+	// visibility, chunks that aren't loaded yet are covered by their
+	// nearest loaded ancestor (hiding everything else under it) or children
+	std::vector<terrainChunkKey> fallbacks;
+	std::unordered_set<terrainChunkKey, terrainChunkHash> ancestors;
+
+	for (auto& [_, c] : chunks) {
+		c.model->visible = false;
+	}
+
+	for (auto& key : selected) {
+		if (!chunks.count(key) && fallback(key, fallbacks)) {
+			ancestors.insert(fallbacks.back());
+		}
+	}
+
+	auto isCovered = [&] (terrainChunkKey k) {
+		while (!ancestors.empty() && k.level + 1 < settings.levels) {
+			k = {k.x >> 1, k.y >> 1, k.level + 1};
+
+			if (ancestors.count(k)) {
+				return true;
+			}
+		}
+
+		return false;
+	};
+
+	auto show = [&] (chunk& c) {
+		c.model->visible = true;
+		c.lastUsed = frame;
+	};
+
+	for (auto& key : selected) {
+		if (auto it = chunks.find(key); it != chunks.end()) {
+			it->second.lastUsed = frame;
+
+			if (!isCovered(key)) {
+				show(it->second);
+			}
+		}
+	}
+
+	for (auto& key : fallbacks) {
+		if (!isCovered(key)) {
+			show(chunks[key]);
+		}
+	}
+
+	evict();
+
+	current.selected = selected.size();
+	current.loaded   = chunks.size();
+	current.pending  = pending.size();
+	current.memory   = memory;
+}
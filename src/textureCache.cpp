@@ -0,0 +1,324 @@
+#include <grend/textureCache.hpp>
+#include <grend/logger.hpp>
+#include <grend/profile.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <string.h>
+#include <sys/stat.h>
+
+using namespace grendx;
+
+textureFileCache& grendx::textureFiles(void) {
+	static textureFileCache ret;
+	return ret;
+}
+
+static inline uint64_t rotl64(uint64_t x, unsigned r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+	uint64_t ret;
+	memcpy(&ret, p, sizeof(ret));
+	return ret;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+	uint32_t ret;
+	memcpy(&ret, p, sizeof(ret));
+	return ret;
+}
+
+enum : uint64_t {
+	xxPrime1 = 0x9e3779b185ebca87ull,
+	xxPrime2 = 0xc2b2ae3d27d4eb4full,
+	xxPrime3 = 0x165667b19e3779f9ull,
+	xxPrime4 = 0x85ebca77c2b2ae63ull,
+	xxPrime5 = 0x27d4eb2f165667c5ull,
+};
+
+static inline uint64_t xxRound(uint64_t acc, uint64_t input) {
+	acc += input * xxPrime2;
+	acc  = rotl64(acc, 31);
+	return acc * xxPrime1;
+}
+
+static inline uint64_t xxMerge(uint64_t acc, uint64_t val) {
+	acc ^= xxRound(0, val);
+	return acc*xxPrime1 + xxPrime4;
+}
+
+// little-endian only, same as the rest of the engine's binary formats
+uint64_t grendx::hashBytes(const void *data, size_t length, uint64_t seed) {
+	const uint8_t *p   = static_cast<const uint8_t*>(data);
+	const uint8_t *end = p + length;
+	uint64_t h;
+
+	if (length >= 32) {
+		uint64_t v1 = seed + xxPrime1 + xxPrime2;
+		uint64_t v2 = seed + xxPrime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - xxPrime1;
+
+		// four independent lanes, so the multiplies pipeline
+		for (; p + 32 <= end; p += 32) {
+			v1 = xxRound(v1, read64(p));
+			v2 = xxRound(v2, read64(p + 8));
+			v3 = xxRound(v3, read64(p + 16));
+			v4 = xxRound(v4, read64(p + 24));
+		}
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = xxMerge(h, v1);
+		h = xxMerge(h, v2);
+		h = xxMerge(h, v3);
+		h = xxMerge(h, v4);
+
+	} else {
+		h = seed + xxPrime5;
+	}
+
+	h += length;
+
+	for (; p + 8 <= end; p += 8) {
+		h ^= xxRound(0, read64(p));
+		h  = rotl64(h, 27)*xxPrime1 + xxPrime4;
+	}
+
+	if (p + 4 <= end) {
+		h ^= uint64_t(read32(p)) * xxPrime1;
+		h  = rotl64(h, 23)*xxPrime2 + xxPrime3;
+		p += 4;
+	}
+
+	for (; p < end; p++) {
+		h ^= *p * xxPrime5;
+		h  = rotl64(h, 11)*xxPrime1;
+	}
+
+	h ^= h >> 33;
+	h *= xxPrime2;
+	h ^= h >> 29;
+	h *= xxPrime3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+static std::pair<const void*, size_t> pixelBytes(const textureData& tex) {
+	return std::visit([] (auto& px) {
+		return std::pair<const void*, size_t>(px.data(), px.size() * sizeof(px[0]));
+	}, tex.pixels);
+}
+
+size_t grendx::textureBytes(const textureData& tex) {
+	return pixelBytes(tex).second;
+}
+
+// everything besides the pixels that affects the uploaded texture
+struct textureHeader {
+	int32_t width, height, channels;
+	int32_t format;
+	int32_t minFilter, magFilter;
+	int32_t wrapS, wrapT;
+	int32_t type;
+};
+
+static textureHeader makeHeader(const textureData& tex) {
+	return {
+		tex.width, tex.height, tex.channels,
+		int32_t(tex.pixels.index()),
+		tex.minFilter, tex.magFilter,
+		tex.wrapS, tex.wrapT,
+		tex.type,
+	};
+}
+
+uint64_t grendx::hashTexture(const textureData& tex) {
+	textureHeader header = makeHeader(tex);
+	auto [data, size] = pixelBytes(tex);
+
+	uint64_t seed = hashBytes(&header, sizeof(header));
+	uint64_t ret  = hashBytes(data, size, seed);
+
+	// 0 is reserved for "not hashed yet"
+	return ret? ret : 1;
+}
+
+bool grendx::sameTexture(const textureData& a, const textureData& b) {
+	textureHeader ha = makeHeader(a), hb = makeHeader(b);
+	auto [da, sa] = pixelBytes(a);
+	auto [db, sb] = pixelBytes(b);
+
+	return memcmp(&ha, &hb, sizeof(ha)) == 0
+	    && sa == sb
+	    && memcmp(da, db, sa) == 0;
+}
+
+static std::string fileKey(const std::string& path,
+                           bool flipVertical,
+                           const textureSampler& sampler)
+{
+	std::error_code ec;
+	auto canon = std::filesystem::weakly_canonical(path, ec);
+	std::string ret = ec? path : canon.string();
+
+	ret += '\0';
+	ret += flipVertical? 'f' : '-';
+	ret += char('a' + sampler.minFilter);
+	ret += char('a' + sampler.magFilter);
+	ret += char('a' + sampler.wrapS);
+	ret += char('a' + sampler.wrapT);
+	return ret;
+}
+
+textureData::ptr textureFileCache::load(const std::string& path,
+                                        bool flipVertical,
+                                        const textureSampler& sampler)
+{
+	GREND_PROFILE_FUNCTION();
+
+	struct stat st;
+	time_t  mtime = 0;
+	int64_t size  = -1;
+
+	if (stat(path.c_str(), &st) == 0) {
+		mtime = st.st_mtime;
+		size  = st.st_size;
+	}
+
+	std::string key = fileKey(path, flipVertical, sampler);
+
+	{
+		std::lock_guard lock(mtx);
+		auto it = files.find(key);
+
+		if (it != files.end()) {
+			auto& ent = it->second;
+
+			if (ent.mtime == mtime && ent.size == size) {
+				lru.splice(lru.begin(), lru, ent.lru);
+				counters.pathHits++;
+				return ent.data;
+			}
+
+			// stale, reloaded below
+			counters.bytes -= ent.bytes;
+			lru.erase(ent.lru);
+			files.erase(it);
+		}
+
+		counters.pathMisses++;
+	}
+
+	// decoded without the lock held, a racing load of the same file just
+	// ends up deduplicated below
+	textureData::ptr tex;
+
+	if (sampler == textureSampler()) {
+		tex = std::make_shared<textureData>(path, flipVertical);
+
+	} else {
+		// copied from the default settings' entry rather than decoded again
+		tex = std::make_shared<textureData>(*load(path, flipVertical));
+		tex->minFilter = sampler.minFilter;
+		tex->magFilter = sampler.magFilter;
+		tex->wrapS     = sampler.wrapS;
+		tex->wrapT     = sampler.wrapT;
+	}
+
+	std::lock_guard lock(mtx);
+	tex = internLocked(tex);
+
+	size_t bytes = textureBytes(*tex);
+
+	if (bytes > budget) {
+		// wouldn't fit even with everything else evicted
+		return tex;
+	}
+
+	if (auto it = files.find(key); it != files.end()) {
+		// another thread got here first
+		counters.bytes -= it->second.bytes;
+		lru.erase(it->second.lru);
+		files.erase(it);
+	}
+
+	lru.push_front(key);
+	files[key] = {mtime, size, tex, bytes, lru.begin()};
+	counters.bytes += bytes;
+	evict();
+
+	return tex;
+}
+
+textureData::ptr textureFileCache::intern(textureData::ptr tex) {
+	if (!tex || !tex->loaded()) {
+		return tex;
+	}
+
+	std::lock_guard lock(mtx);
+	return internLocked(tex);
+}
+
+textureData::ptr textureFileCache::internLocked(textureData::ptr tex) {
+	uint64_t hash = tex->hash();
+	auto& candidates = contents[hash];
+
+	// drop textures that have since been freed
+	candidates.erase(
+		std::remove_if(candidates.begin(), candidates.end(),
+			[] (auto& weak) { return weak.expired(); }),
+		candidates.end());
+
+	for (auto& weak : candidates) {
+		auto other = weak.lock();
+
+		if (other && (other == tex || sameTexture(*other, *tex))) {
+			counters.contentHits++;
+			return other;
+		}
+	}
+
+	if (!candidates.empty()) {
+		LogCatFmt(logcat::loader, Warning,
+		          "texture hash collision ({:016x}), not shared", hash);
+	}
+
+	candidates.push_back(tex);
+	counters.contentMisses++;
+	return tex;
+}
+
+void textureFileCache::evict(void) {
+	while (counters.bytes > budget && !lru.empty()) {
+		auto it = files.find(lru.back());
+
+		counters.bytes -= it->second.bytes;
+		counters.evictions++;
+		files.erase(it);
+		lru.pop_back();
+	}
+}
+
+void textureFileCache::setBudget(size_t budgetBytes) {
+	std::lock_guard lock(mtx);
+	budget = budgetBytes;
+	evict();
+}
+
+void textureFileCache::clear(void) {
+	std::lock_guard lock(mtx);
+	files.clear();
+	lru.clear();
+	contents.clear();
+	counters = stats();
+}
+
+textureFileCache::stats textureFileCache::getStats(void) {
+	std::lock_guard lock(mtx);
+	stats ret = counters;
+	ret.entries = files.size();
+	return ret;
+}
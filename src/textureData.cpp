@@ -1,5 +1,7 @@
 #include <grend/textureData.hpp>
+#include <grend/textureCache.hpp>
 #include <grend/logger.hpp>
+#include <grend/profile.hpp>
 
 #include <stb/stb_image.h>
 #include <stb/stb_image_write.h>
@@ -11,15 +13,18 @@ textureData::textureData(const std::string& filename, bool flipVertical) {
 }
 
 bool textureData::load_texture(const std::string& filename, bool flipVertical) {
-	stbi_set_flip_vertically_on_load(flipVertical);
+	GREND_PROFILE_FUNCTION();
+	invalidateHash();
+	// per-thread flag, textures can be loaded from several threads at once
+	stbi_set_flip_vertically_on_load_thread(flipVertical);
 
 	if (stbi_is_hdr(filename.c_str())) {
 		// load image components as floats
-		LogFmt("Loading {} (float)", filename);
+		LogCatFmt(logcat::loader, Info, "Loading {} (float)", filename);
 		float *datas = stbi_loadf(filename.c_str(), &width, &height, &channels, 0);
 
 		if (!datas) {
-			stbi_set_flip_vertically_on_load(false);
+			stbi_set_flip_vertically_on_load_thread(false);
 			throw std::logic_error("Couldn't load texture");
 			return false;
 		}
@@ -31,16 +36,16 @@ bool textureData::load_texture(const std::string& filename, bool flipVertical) {
 		this->pixels = std::move(px);
 		stbi_image_free(datas);
 
-		stbi_set_flip_vertically_on_load(false);
+		stbi_set_flip_vertically_on_load_thread(false);
 		return true;
 
 	} else if (stbi_is_16_bit(filename.c_str())) {
 		// load image components as 16 bit uints
-		LogFmt("Loading {} (16 bit)", filename);
+		LogCatFmt(logcat::loader, Info, "Loading {} (16 bit)", filename);
 		uint16_t *datas = stbi_load_16(filename.c_str(), &width, &height, &channels, 0);
 
 		if (!datas) {
-			stbi_set_flip_vertically_on_load(false);
+			stbi_set_flip_vertically_on_load_thread(false);
 			throw std::logic_error("Couldn't load texture");
 			return false;
 		}
@@ -52,17 +57,17 @@ bool textureData::load_texture(const std::string& filename, bool flipVertical) {
 		this->pixels = std::move(px);
 		stbi_image_free(datas);
 
-		stbi_set_flip_vertically_on_load(false);
+		stbi_set_flip_vertically_on_load_thread(false);
 		return true;
 
 	} else {
 		// otherwise assume components are regular 8 bit uints
 		// TODO: handle compressed textures transparently here
-		LogFmt("Loading {} (8 bit)", filename);
+		LogCatFmt(logcat::loader, Info, "Loading {} (8 bit)", filename);
 		uint8_t *datas = stbi_load(filename.c_str(), &width, &height, &channels, 0);
 
 		if (!datas) {
-			stbi_set_flip_vertically_on_load(false);
+			stbi_set_flip_vertically_on_load_thread(false);
 			throw std::logic_error("Couldn't load texture");
 			return false;
 		}
@@ -75,8 +80,34 @@ bool textureData::load_texture(const std::string& filename, bool flipVertical) {
 		this->pixels = std::move(px);
 		stbi_image_free(datas);
 
-		stbi_set_flip_vertically_on_load(false);
+		stbi_set_flip_vertically_on_load_thread(false);
 		return true;
 	}
 }
 
+textureData::hashState textureData::currentState(void) const {
+	auto [data, bytes] = std::visit([] (auto& px) {
+		return std::pair<const void*, size_t>(px.data(), px.size() * sizeof(px[0]));
+	}, pixels);
+
+	return {
+		data, bytes,
+		width, height, channels,
+		pixels.index(),
+		minFilter, magFilter,
+		wrapS, wrapT,
+		type,
+	};
+}
+
+uint64_t textureData::hash(void) const {
+	hashState state = currentState();
+
+	if (hashDirty || !(state == hashedState)) {
+		cachedHash  = hashTexture(*this);
+		hashedState = state;
+		hashDirty   = false;
+	}
+
+	return cachedHash;
+}
@@ -2,6 +2,9 @@
 #include <unordered_map>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <cxxabi.h>
 
 namespace grendx {
@@ -77,5 +80,42 @@ void eraseChars(std::string& str, std::string_view chars) {
 	}
 }
 
+void parallelFor(size_t count, const std::function<void(size_t)>& fn,
+                 unsigned maxThreads)
+{
+	if (count == 0) {
+		return;
+	}
+
+#if defined(__EMSCRIPTEN__)
+	for (size_t i = 0; i < count; i++) {
+		fn(i);
+	}
+
+#else
+	unsigned hw = maxThreads? maxThreads : std::thread::hardware_concurrency();
+	unsigned numThreads = std::clamp<size_t>(hw, 1, count);
+	std::atomic<size_t> next = 0;
+	std::vector<std::thread> workers;
+
+	auto worker = [&] () {
+		for (size_t i; (i = next.fetch_add(1)) < count;) {
+			fn(i);
+		}
+	};
+
+	// calling thread does work too
+	for (unsigned i = 1; i < numThreads; i++) {
+		workers.emplace_back(worker);
+	}
+
+	worker();
+
+	for (auto& t : workers) {
+		t.join();
+	}
+#endif
+}
+
 // namespace grendx
 }
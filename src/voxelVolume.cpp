@@ -0,0 +1,520 @@
+#include <grend/ecs/voxelVolume.hpp>
+#include <grend/ecs/bufferComponent.hpp>
+#include <grend/jobQueue.hpp>
+#include <grend/gameMain.hpp>
+#include <grend/logger.hpp>
+#include <grend/base64.h>
+
+#include <algorithm>
+#include <memory>
+#include <math.h>
+#include <stdlib.h>
+
+using namespace grendx;
+
+static inline int floorDiv(int a, int b) {
+	return (a >= 0)? a / b : -((-a + b - 1) / b);
+}
+
+static inline glm::ivec3 floorDiv(const glm::ivec3& a, int b) {
+	return {floorDiv(a.x, b), floorDiv(a.y, b), floorDiv(a.z, b)};
+}
+
+void grendx::voxelMeshChunk(const float *samples,
+                            unsigned chunkSize,
+                            float isoLevel,
+                            float voxelSize,
+                            std::vector<sceneModel::vertex>& vertices,
+                            std::vector<sceneMesh::faceType>& indices)
+{
+	const int n = chunkSize;
+	const int p = voxelPaddedSize(chunkSize);
+	// cells [-1, n) on each axis, the extra layer is shared with the
+	// neighbouring chunks so quads along the border have all four vertices
+	const int c = n + 1;
+
+	vertices.clear();
+	indices.clear();
+
+	// voxel coordinates relative to the chunk
+	auto at = [&] (int x, int y, int z) {
+		return samples[((z + 2)*p + (y + 2))*p + (x + 2)];
+	};
+
+	auto gradient = [&] (int x, int y, int z) {
+		return glm::vec3(at(x + 1, y, z) - at(x - 1, y, z),
+		                 at(x, y + 1, z) - at(x, y - 1, z),
+		                 at(x, y, z + 1) - at(x, y, z - 1));
+	};
+
+	std::vector<int32_t> cellVertex(c*c*c, -1);
+	auto cellIndex = [&] (int x, int y, int z) {
+		return ((z + 1)*c + (y + 1))*c + (x + 1);
+	};
+
+	// corner pairs for the 12 cell edges, corner i is at (i&1, i>>1&1, i>>2&1)
+	static const uint8_t edges[12][2] = {
+		{0, 1}, {2, 3}, {4, 5}, {6, 7},
+		{0, 2}, {1, 3}, {4, 6}, {5, 7},
+		{0, 4}, {1, 5}, {2, 6}, {3, 7},
+	};
+
+	for (int z = -1; z < n; z++) {
+		for (int y = -1; y < n; y++) {
+			for (int x = -1; x < n; x++) {
+				float d[8];
+				unsigned mask = 0;
+
+				for (unsigned i = 0; i < 8; i++) {
+					d[i] = at(x + (i & 1), y + (i >> 1 & 1), z + (i >> 2 & 1));
+					mask |= unsigned(d[i] >= isoLevel) << i;
+				}
+
+				if (mask == 0 || mask == 0xff) {
+					continue;
+				}
+
+				glm::vec3 pos(0), grad(0);
+				unsigned crossings = 0;
+
+				for (auto& [a, b] : edges) {
+					if (((mask >> a) ^ (mask >> b)) & 1) {
+						glm::ivec3 pa(a & 1, a >> 1 & 1, a >> 2 & 1);
+						glm::ivec3 pb(b & 1, b >> 1 & 1, b >> 2 & 1);
+						float t = (isoLevel - d[a]) / (d[b] - d[a]);
+
+						pos  += glm::mix(glm::vec3(pa), glm::vec3(pb), t);
+						grad += glm::mix(gradient(x + pa.x, y + pa.y, z + pa.z),
+						                 gradient(x + pb.x, y + pb.y, z + pb.z), t);
+						crossings++;
+					}
+				}
+
+				// density increases going into solid ground, normals
+				// point the other way
+				glm::vec3 normal = -grad;
+				float len = glm::length(normal);
+				normal = (len > 1e-6f)? normal / len : glm::vec3(0, 1, 0);
+
+				glm::vec3 side = (fabsf(normal.y) < 0.99f)
+					? glm::vec3(0, 1, 0)
+					: glm::vec3(1, 0, 0);
+				glm::vec3 tangent = glm::normalize(glm::cross(side, normal));
+				glm::vec3 local = (glm::vec3(x, y, z) + pos / float(crossings)) * voxelSize;
+
+				cellVertex[cellIndex(x, y, z)] = vertices.size();
+				vertices.push_back({
+					.position = local,
+					.normal   = normal,
+					.tangent  = glm::vec4(tangent, 1.f),
+					.color    = glm::vec3(1),
+					// planar mapping along the dominant axis
+					.uv       = (fabsf(normal.y) >= fabsf(normal.x) && fabsf(normal.y) >= fabsf(normal.z))
+						? glm::vec2(local.x, local.z)
+						: (fabsf(normal.x) >= fabsf(normal.z))
+							? glm::vec2(local.z, local.y)
+							: glm::vec2(local.x, local.y),
+					.lightmap = glm::vec2(0),
+				});
+			}
+		}
+	}
+
+	// one quad per crossing edge starting inside the chunk, between the
+	// four cells sharing it, facing from solid to empty
+	for (int z = 0; z < n; z++) {
+		for (int y = 0; y < n; y++) {
+			for (int x = 0; x < n; x++) {
+				bool solid = at(x, y, z) >= isoLevel;
+
+				for (int axis = 0; axis < 3; axis++) {
+					glm::ivec3 base(x, y, z);
+					glm::ivec3 end = base;
+					end[axis]++;
+
+					if (solid == (at(end.x, end.y, end.z) >= isoLevel)) {
+						continue;
+					}
+
+					glm::ivec3 u(0), v(0);
+					u[(axis + 1) % 3] = 1;
+					v[(axis + 2) % 3] = 1;
+
+					// counter-clockwise seen from +axis
+					glm::ivec3 cells[4] = {base - u - v, base - v, base, base - u};
+					sceneMesh::faceType q[4];
+
+					for (unsigned i = 0; i < 4; i++) {
+						q[i] = cellVertex[cellIndex(cells[i].x, cells[i].y, cells[i].z)];
+					}
+
+					if (solid) {
+						indices.insert(indices.end(), {q[0], q[1], q[2], q[0], q[2], q[3]});
+					} else {
+						indices.insert(indices.end(), {q[0], q[2], q[1], q[0], q[3], q[2]});
+					}
+				}
+			}
+		}
+	}
+}
+
+voxelVolume::voxelVolume(ecs::regArgs t)
+	: voxelVolume(std::move(t), volumeSettings()) {};
+
+voxelVolume::voxelVolume(ecs::regArgs t, const volumeSettings& _settings)
+	: component(ecs::doRegister(this, t)),
+	  settings(_settings)
+{
+	manager->registerInterface<ecs::updatable>(t.ent, this);
+}
+
+voxelVolume::~voxelVolume() {};
+
+voxelVolume::chunk& voxelVolume::getChunk(const glm::ivec3& key) {
+	auto& ch = chunks[key];
+
+	if (ch.density.empty()) {
+		size_t n = settings.chunkSize;
+		ch.density.resize(n*n*n, settings.emptyDensity);
+	}
+
+	return ch;
+}
+
+float voxelVolume::get(const glm::ivec3& voxel) const {
+	int n = settings.chunkSize;
+	glm::ivec3 key = floorDiv(voxel, n);
+	auto it = chunks.find(key);
+
+	if (it == chunks.end()) {
+		return settings.emptyDensity;
+	}
+
+	glm::ivec3 l = voxel - key*n;
+	return it->second.density[(l.z*n + l.y)*n + l.x];
+}
+
+void voxelVolume::set(const glm::ivec3& voxel, float density) {
+	int n = settings.chunkSize;
+	glm::ivec3 key = floorDiv(voxel, n);
+	glm::ivec3 l = voxel - key*n;
+
+	getChunk(key).density[(l.z*n + l.y)*n + l.x] = density;
+	markDirty(voxel, voxel);
+}
+
+void voxelVolume::fill(const glm::ivec3& min,
+                       const glm::ivec3& max,
+                       densityFunction func)
+{
+	int n = settings.chunkSize;
+	glm::ivec3 cmin = floorDiv(min, n);
+	glm::ivec3 cmax = floorDiv(max, n);
+
+	// chunk by chunk, so each one is only looked up once
+	for (int cz = cmin.z; cz <= cmax.z; cz++) {
+		for (int cy = cmin.y; cy <= cmax.y; cy++) {
+			for (int cx = cmin.x; cx <= cmax.x; cx++) {
+				glm::ivec3 key(cx, cy, cz);
+				glm::ivec3 lo = glm::max(min, key*n);
+				glm::ivec3 hi = glm::min(max, key*n + n - 1);
+				auto& density = getChunk(key).density;
+
+				for (int z = lo.z; z <= hi.z; z++) {
+					for (int y = lo.y; y <= hi.y; y++) {
+						for (int x = lo.x; x <= hi.x; x++) {
+							glm::ivec3 l = glm::ivec3(x, y, z) - key*n;
+							density[(l.z*n + l.y)*n + l.x]
+								= func(x * settings.voxelSize,
+								       y * settings.voxelSize,
+								       z * settings.voxelSize);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	markDirty(min, max);
+}
+
+void voxelVolume::addSphere(const glm::vec3& center, float radius, float amount) {
+	glm::vec3 vc = center / settings.voxelSize;
+	float vr = radius / settings.voxelSize;
+
+	glm::ivec3 min = glm::ivec3(glm::floor(vc - vr));
+	glm::ivec3 max = glm::ivec3(glm::ceil(vc + vr));
+
+	for (int z = min.z; z <= max.z; z++) {
+		for (int y = min.y; y <= max.y; y++) {
+			for (int x = min.x; x <= max.x; x++) {
+				float dist = glm::distance(glm::vec3(x, y, z), vc);
+
+				if (dist >= vr) {
+					continue;
+				}
+
+				glm::ivec3 voxel(x, y, z);
+				int n = settings.chunkSize;
+				glm::ivec3 key = floorDiv(voxel, n);
+				glm::ivec3 l = voxel - key*n;
+
+				getChunk(key).density[(l.z*n + l.y)*n + l.x]
+					+= amount * (1.f - dist / vr);
+			}
+		}
+	}
+
+	markDirty(min, max);
+}
+
+void voxelVolume::markDirty(const glm::ivec3& min, const glm::ivec3& max) {
+	// chunks sample voxels [-2, n + 1] relative to their origin
+	int n = settings.chunkSize;
+	glm::ivec3 cmin = floorDiv(min - 2, n);
+	glm::ivec3 cmax = floorDiv(max + 2, n);
+
+	for (int z = cmin.z; z <= cmax.z; z++) {
+		for (int y = cmin.y; y <= cmax.y; y++) {
+			for (int x = cmin.x; x <= cmax.x; x++) {
+				dirty.insert({x, y, z});
+			}
+		}
+	}
+}
+
+void voxelVolume::gather(const glm::ivec3& key, std::vector<float>& out) const {
+	int n = settings.chunkSize;
+	int p = voxelPaddedSize(n);
+	glm::ivec3 base = key*n - 2;
+
+	out.resize(size_t(p)*p*p);
+
+	for (int z = 0; z < p; z++) {
+		for (int y = 0; y < p; y++) {
+			float *row = out.data() + (size_t(z)*p + y)*p;
+			int x = 0;
+
+			// rows cross at most three chunks, copy a span from each
+			while (x < p) {
+				glm::ivec3 voxel = base + glm::ivec3(x, y, z);
+				glm::ivec3 ck = floorDiv(voxel, n);
+				glm::ivec3 l = voxel - ck*n;
+				int span = std::min(p - x, n - l.x);
+				auto it = chunks.find(ck);
+
+				if (it == chunks.end()) {
+					std::fill(row + x, row + x + span, settings.emptyDensity);
+				} else {
+					const float *src = it->second.density.data() + (l.z*n + l.y)*n + l.x;
+					std::copy(src, src + span, row + x);
+				}
+
+				x += span;
+			}
+		}
+	}
+}
+
+voxelVolume::chunkMesh& voxelVolume::getMesh(sceneNode *root, const glm::ivec3& key) {
+	auto& m = meshes[key];
+
+	if (!m.model) {
+		m.model = manager->construct<sceneModel>();
+		m.mesh  = manager->construct<sceneMesh>();
+
+		m.vertices = &m.model->attach<ecs::bufferComponent<sceneModel::vertex>>()->data;
+		m.indices  = &m.mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+		m.model->haveNormals = m.model->haveTangents = m.model->haveTexcoords = true;
+		m.model->haveAABB = true;
+		m.model->transform.setPosition(glm::vec3(key * int(settings.chunkSize))
+		                               * settings.voxelSize);
+
+		setNode("mesh", m.model, m.mesh);
+		setNode("chunk-" + std::to_string(key.x)
+		        + "-" + std::to_string(key.y)
+		        + "-" + std::to_string(key.z), root, m.model);
+	}
+
+	return m;
+}
+
+size_t voxelVolume::remesh(jobQueue *jobs, size_t budget) {
+	if (dirty.empty()) {
+		return 0;
+	}
+
+	auto *root = dynamic_cast<sceneNode*>(manager->getEntity(this));
+
+	if (!root) {
+		LogError("voxelVolume: attached to something that isn't a sceneNode");
+		dirty.clear();
+		return 0;
+	}
+
+	std::vector<glm::ivec3> keys;
+	size_t count = (budget == 0)? dirty.size() : std::min(budget, dirty.size());
+
+	for (auto it = dirty.begin(); keys.size() < count; it = dirty.erase(it)) {
+		keys.push_back(*it);
+	}
+
+	// entities are only created here on the main thread, workers only
+	// write into their chunk's buffers
+	std::vector<chunkMesh*> targets;
+
+	for (auto& key : keys) {
+		targets.push_back(&getMesh(root, key));
+	}
+
+	auto meshChunk = [&] (size_t i) {
+		thread_local std::vector<float> samples;
+		auto *m = targets[i];
+		auto& verts = *m->vertices;
+
+		gather(keys[i], samples);
+		voxelMeshChunk(samples.data(), settings.chunkSize, settings.isoLevel,
+		               settings.voxelSize, verts, *m->indices);
+
+		AABB box = {glm::vec3(0), glm::vec3(0)};
+
+		if (!verts.empty()) {
+			box = {verts[0].position, verts[0].position};
+
+			for (auto& v : verts) {
+				box.min = glm::min(box.min, v.position);
+				box.max = glm::max(box.max, v.position);
+			}
+		}
+
+		m->mesh->boundingBox    = box;
+		m->mesh->boundingSphere = {
+			.center = 0.5f*(box.min + box.max),
+			.extent = 0.5f*glm::distance(box.min, box.max),
+		};
+	};
+
+	if (jobs) {
+		jobs->parallelFor(keys.size(), meshChunk);
+	} else {
+		for (size_t i = 0; i < keys.size(); i++) {
+			meshChunk(i);
+		}
+	}
+
+	for (auto *m : targets) {
+		// uploaded again on the next draw
+		m->model->compiled = false;
+		m->mesh->compiled  = false;
+		m->mesh->bvh       = nullptr;
+		m->model->visible  = !m->indices->empty();
+	}
+
+	return keys.size();
+}
+
+void voxelVolume::update(ecs::entityManager *manager, float delta) {
+	auto jobs = engine::Services().tryResolve<jobQueue>();
+	remesh(jobs, settings.remeshBudget);
+}
+
+nlohmann::json voxelVolume::serializer(component *comp) {
+	auto *self = static_cast<voxelVolume*>(comp);
+	auto& s = self->settings;
+
+	nlohmann::json chunks = nlohmann::json::array();
+
+	for (auto& [key, ch] : self->chunks) {
+		bool empty = std::all_of(ch.density.begin(), ch.density.end(),
+			[&] (float d) { return d == s.emptyDensity; });
+
+		if (empty) {
+			continue;
+		}
+
+		std::unique_ptr<char, decltype(&free)> data(
+			base64_encode_binary(reinterpret_cast<const uint8_t*>(ch.density.data()),
+			                     ch.density.size() * sizeof(float), 0),
+			free);
+
+		chunks.push_back({
+			{"key",     {key.x, key.y, key.z}},
+			{"density", data.get()},
+		});
+	}
+
+	return {
+		{"chunkSize",    s.chunkSize},
+		{"voxelSize",    s.voxelSize},
+		{"isoLevel",     s.isoLevel},
+		{"emptyDensity", s.emptyDensity},
+		{"remeshBudget", s.remeshBudget},
+		{"chunks",       chunks},
+	};
+}
+
+void voxelVolume::deserializer(component *comp, nlohmann::json j) {
+	auto *self = static_cast<voxelVolume*>(comp);
+	volumeSettings defaults;
+
+	// old chunks get remeshed, to clear their meshes
+	for (auto& [key, _] : self->chunks) {
+		self->dirty.insert(key);
+	}
+
+	self->chunks.clear();
+	self->settings = {
+		.chunkSize    = j.value("chunkSize",    defaults.chunkSize),
+		.voxelSize    = j.value("voxelSize",    defaults.voxelSize),
+		.isoLevel     = j.value("isoLevel",     defaults.isoLevel),
+		.emptyDensity = j.value("emptyDensity", defaults.emptyDensity),
+		.remeshBudget = j.value("remeshBudget", defaults.remeshBudget),
+	};
+
+	if (self->settings.chunkSize == 0) {
+		LogCatFmt(logcat::ecs, Error, "voxelVolume: invalid chunk size, using {}",
+		          defaults.chunkSize);
+		self->settings.chunkSize = defaults.chunkSize;
+	}
+
+	if (!j.contains("chunks") || !j["chunks"].is_array()) {
+		return;
+	}
+
+	int n = self->settings.chunkSize;
+	size_t expected = size_t(n)*n*n * sizeof(float);
+
+	for (auto& entry : j["chunks"]) {
+		auto& key  = entry["key"];
+		auto& data = entry["density"];
+
+		if (!key.is_array() || key.size() != 3 || !data.is_string()) {
+			LogCatFmt(logcat::ecs, Warning, "voxelVolume: skipping malformed chunk");
+			continue;
+		}
+
+		const std::string& encoded = data;
+		uint8_t *buffer = nullptr;
+		size_t length = 0;
+		base64_decode_binary(encoded.c_str(), &buffer, &length);
+
+		glm::ivec3 k(key[0].get<int>(), key[1].get<int>(), key[2].get<int>());
+
+		// decoded lengths are rounded up to a multiple of 3 bytes
+		if (length < expected || length - expected >= 3) {
+			LogCatFmt(logcat::ecs, Warning,
+			          "voxelVolume: chunk ({}, {}, {}) has {} bytes of densities, "
+			          "expected {}, skipping", k.x, k.y, k.z, length, expected);
+			free(buffer);
+			continue;
+		}
+
+		auto& ch = self->chunks[k];
+		ch.density.resize(n*n*n);
+		memcpy(ch.density.data(), buffer, expected);
+		free(buffer);
+
+		self->markDirty(k*n, k*n + glm::ivec3(n - 1));
+	}
+}
@@ -0,0 +1,2056 @@
+// Headless correctness tests for engine subsystems, timing lives in
+// grend-bench. Each test is registered with ctest and runs in its own
+// process, a failing check prints what broke and exits with status 1.
+//
+// usage: grend-tests [--list] [test...]
+#include <grend/ecs/ecs.hpp>
+#include <grend/ecs/collision.hpp>
+#include <grend/ecs/link.hpp>
+#include <grend/ecs/entityList.hpp>
+#include <grend/contactStream.hpp>
+#include <grend/sceneNode.hpp>
+#include <grend/sceneHierarchy.hpp>
+#include <grend/sceneModel.hpp>
+#include <grend/compiledModel.hpp>
+#include <grend/renderQueue.hpp>
+#include <grend/camera.hpp>
+#include <grend/occlusionBuffer.hpp>
+#include <grend/probeScheduler.hpp>
+#include <grend/terrain.hpp>
+#include <grend/ecs/voxelVolume.hpp>
+#include <grend/ecs/particleEmitter.hpp>
+#include <grend/particleSystem.hpp>
+#include <grend/jobQueue.hpp>
+#include <grend/utility.hpp>
+#include <grend/raycast.hpp>
+#include <grend/textureCache.hpp>
+#include <grend/prefab.hpp>
+#include <grend/replication.hpp>
+#include <grend/meshOptimizer.hpp>
+#include <grend/ecs/bufferComponent.hpp>
+#include <grend-config.h>
+#if defined(PHYSICS_BULLET)
+#include <grend/bulletPhysics.hpp>
+#endif
+#include <stb/stb_image_write.h>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <random>
+#include <set>
+#include <span>
+#include <string>
+#include <vector>
+#include <float.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace grendx;
+
+// name of the running test, prefixed to failure messages
+static const char *currentTest = "";
+
+[[noreturn]] static void fail(const char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	fprintf(stderr, "%s: ", currentTest);
+	vfprintf(stderr, fmt, args);
+	fputc('\n', stderr);
+	va_end(args);
+	exit(1);
+}
+
+// optimizeMeshes() only reorders things, every input triangle has to come
+// out with the same vertices (up to rotation), without making the vertex
+// cache worse, and the LOD chain has to get smaller with each level
+static void testOptimizeMeshes(const char *name,
+                               const std::vector<sceneModel::vertex>& srcVerts,
+                               const std::vector<uint32_t>& srcIndices,
+                               bool expectLods)
+{
+	ecs::entityManager manager;
+	sceneModel::ptr model = manager.construct<sceneModel>();
+	sceneMesh::ptr  mesh  = manager.construct<sceneMesh>();
+	auto& verts = model->attach<ecs::bufferComponent<sceneModel::vertex>>()->data;
+	auto& faces = mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+	setNode("mesh", model, mesh);
+	model->haveTexcoords = true;
+
+	// original index in an attribute the optimizer doesn't look at, to
+	// follow vertices through the fetch remap
+	verts = srcVerts;
+	for (size_t i = 0; i < verts.size(); i++) {
+		verts[i].lightmap.x = float(i);
+	}
+
+	faces.assign(srcIndices.begin(), srcIndices.end());
+
+	// triangles as original indices, rotated so the smallest comes first
+	auto triangles = [&] (const auto& indices, bool remapped) {
+		std::vector<std::array<uint32_t, 3>> ret;
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			std::array<uint32_t, 3> t;
+
+			for (unsigned k = 0; k < 3; k++) {
+				t[k] = remapped? uint32_t(verts[indices[i + k]].lightmap.x) : indices[i + k];
+			}
+
+			while (t[0] > t[1] || t[0] > t[2]) {
+				std::rotate(t.begin(), t.begin() + 1, t.end());
+			}
+
+			ret.push_back(t);
+		}
+
+		std::sort(ret.begin(), ret.end());
+		return ret;
+	};
+
+	auto before = triangles(srcIndices, false);
+	float acmrBefore = computeACMR(srcIndices.data(), srcIndices.size(), verts.size());
+
+	model->optimizeMeshes();
+
+	if (faces.size() != srcIndices.size()) {
+		fail("%s: index count changed", name);
+	}
+
+	for (auto idx : faces) {
+		if (idx >= verts.size()) fail("%s: index out of range", name);
+	}
+
+	if (triangles(faces, true) != before) {
+		fail("%s: triangles changed", name);
+	}
+
+	// remapping vertices doesn't change cache behavior, so this can be
+	// compared against the input directly
+	float acmrAfter = computeACMR(faces.data(), faces.size(), verts.size());
+	if (acmrAfter > acmrBefore + 1e-3f) {
+		fail("%s: ACMR got worse", name);
+	}
+
+	if (expectLods && mesh->lods.empty()) {
+		fail("%s: no LOD levels generated", name);
+	}
+
+	size_t prev = faces.size();
+	for (auto& level : mesh->lods) {
+		if (level.indices.size() % 3 != 0 || level.indices.size() >= prev) {
+			fail("%s: LOD triangle counts don't decrease", name);
+		}
+
+		for (auto idx : level.indices) {
+			if (idx >= verts.size()) fail("%s: LOD index out of range", name);
+		}
+
+		prev = level.indices.size();
+	}
+}
+
+static void testMeshOptimizer(void) {
+	std::mt19937 rng(4321);
+	auto shuffled = [&] (std::vector<uint32_t> indices) {
+		for (size_t i = indices.size()/3 - 1; i > 0; i--) {
+			size_t j = std::uniform_int_distribution<size_t>(0, i)(rng);
+			std::swap_ranges(&indices[i*3], &indices[i*3 + 3], &indices[j*3]);
+		}
+
+		return indices;
+	};
+
+	// flat grid, always simplifies
+	unsigned n = 64;
+	std::vector<sceneModel::vertex> verts;
+	std::vector<uint32_t> indices;
+
+	for (unsigned y = 0; y < n; y++) {
+		for (unsigned x = 0; x < n; x++) {
+			sceneModel::vertex v = {};
+			v.position = {float(x)/(n - 1), 0, float(y)/(n - 1)};
+			v.uv = {v.position.x, v.position.z};
+			verts.push_back(v);
+		}
+	}
+
+	for (unsigned y = 0; y + 1 < n; y++) {
+		for (unsigned x = 0; x + 1 < n; x++) {
+			unsigned a = y*n + x, b = a + 1, c = a + n, d = c + 1;
+			indices.insert(indices.end(), {a, c, b, b, c, d});
+		}
+	}
+
+	testOptimizeMeshes("grid", verts, indices, true);
+	testOptimizeMeshes("shuffled grid", verts, shuffled(indices), true);
+
+	// UV sphere, with a seam and poles
+	unsigned rings = 32, segments = 48;
+	verts.clear();
+	indices.clear();
+
+	for (unsigned r = 0; r <= rings; r++) {
+		for (unsigned k = 0; k <= segments; k++) {
+			float theta = M_PI * r / rings, phi = 2*M_PI * k / segments;
+			sceneModel::vertex v = {};
+			v.position = {sinf(theta)*cosf(phi), cosf(theta), sinf(theta)*sinf(phi)};
+			v.uv = {float(k)/segments, float(r)/rings};
+			verts.push_back(v);
+		}
+	}
+
+	for (unsigned r = 0; r < rings; r++) {
+		for (unsigned k = 0; k < segments; k++) {
+			unsigned a = r*(segments + 1) + k, b = a + 1;
+			unsigned c = a + segments + 1, d = c + 1;
+
+			// skip triangles with two vertices on a pole
+			if (r > 0)         indices.insert(indices.end(), {a, c, b});
+			if (r < rings - 1) indices.insert(indices.end(), {b, c, d});
+		}
+	}
+
+	testOptimizeMeshes("sphere", verts, indices, false);
+	testOptimizeMeshes("shuffled sphere", verts, shuffled(indices), false);
+}
+
+// selectLod() thresholds and hysteresis bands, and lodSelector keeping
+// per-instance state for moving instances
+static void testLodSelection(void) {
+	// one world unit at distance 1 with a 90 degree fov covers half the view
+	if (fabsf(lodPixelScale(90.f, 1000, 1.f) - 500.f) > 0.01f) {
+		fail("wrong pixel scale");
+	}
+
+	const float errors[] = {0.f, 1.f, 2.f, 4.f};
+
+	// no previous level, coarsest level within the threshold
+	if (selectLod(errors, 4, 0.5f) != 0
+	    || selectLod(errors, 4, 1.f) != 1
+	    || selectLod(errors, 4, 2.5f) != 2
+	    || selectLod(errors, 4, 100.f) != 3
+	    || selectLod(errors, 1, 100.f) != 0)
+	{
+		fail("wrong level without hysteresis");
+	}
+
+	// with 20% hysteresis, level 2 (error 2) is kept until the threshold
+	// drops under 2/1.2, and only taken from level 1 once it's over 2/0.8
+	const float h = 0.2f;
+	struct { float threshold; int previous; unsigned expected; } cases[] = {
+		{1.9f,  2, 2}, {1.7f,  2, 2}, {1.6f, 2, 1}, {0.5f, 2, 0},
+		{2.1f,  1, 1}, {2.45f, 1, 1}, {2.6f, 1, 2}, {9.f,  0, 3},
+		// out of range previous levels are ignored
+		{2.1f,  7, 2},
+	};
+
+	for (auto& c : cases) {
+		if (selectLod(errors, 4, c.threshold, c.previous, h) != c.expected) {
+			fail("wrong level with hysteresis, threshold %g from level %d: expected %u",
+			     c.threshold, c.previous, c.expected);
+		}
+	}
+
+	lodSelector lods;
+	lods.settings.pixelError = 1.f;
+	lods.settings.hysteresis = h;
+	int mesh;
+
+	// pixel scale puts the threshold at 1/scale world units, start just over
+	// level 2's error and sweep back and forth inside the band
+	if (lods.select(&mesh, 1, lodPass::Main, errors, 4, 1/2.1f) != 2) {
+		fail("wrong initial level");
+	}
+
+	for (unsigned frame = 0; frame < 100; frame++) {
+		float threshold = (frame & 1)? 1.75f : 2.2f;
+		lods.newFrame();
+
+		if (lods.select(&mesh, 1, lodPass::Main, errors, 4, 1/threshold) != 2) {
+			fail("instance popped inside the hysteresis band");
+		}
+	}
+
+	// another instance of the same mesh has its own state
+	if (lods.select(&mesh, 2, lodPass::Main, errors, 4, 1/1.75f) != 1) {
+		fail("instances share hysteresis state");
+	}
+
+	// and so do passes, shadows use a coarser threshold
+	if (lods.select(&mesh, 1, lodPass::Shadow, errors, 4, 1/1.75f) != 3) {
+		fail("wrong shadow level");
+	}
+
+	// queue entries keep their instance IDs when moved, and differ between
+	// instances of shared nodes
+	ecs::entityManager manager;
+	sceneNode::ptr root = manager.construct<sceneNode>();
+	sceneNode::ptr a    = manager.construct<sceneNode>();
+	sceneNode::ptr b    = manager.construct<sceneNode>();
+	sceneMesh::ptr shared = manager.construct<sceneMesh>();
+	shared->comped_mesh = std::make_shared<compiledMesh>();
+	setNode("a", root, a);
+	setNode("b", root, b);
+	setNode("mesh", a, shared);
+	setNode("mesh", b, shared);
+
+	renderQueue que;
+	que.add(root);
+	a->transform.setPosition({100, 0, 0});
+	renderQueue moved;
+	moved.add(root);
+
+	if (que.meshes.size() != 2 || moved.meshes.size() != 2
+	    || que.meshes[0].instance == 0
+	    || que.meshes[0].instance == que.meshes[1].instance
+	    || que.meshes[0].instance != moved.meshes[0].instance
+	    || que.meshes[1].instance != moved.meshes[1].instance)
+	{
+		fail("unstable instance IDs");
+	}
+}
+
+// the occluder triangle budget is per pass, a main view culled after the
+// shadow faces still gets its occluders
+static void testOcclusionBudget(void) {
+	ecs::entityManager manager;
+	sceneNode::ptr  root  = manager.construct<sceneNode>();
+	sceneModel::ptr model = manager.construct<sceneModel>();
+	sceneMesh::ptr  wall  = manager.construct<sceneMesh>();
+	sceneMesh::ptr  box   = manager.construct<sceneMesh>();
+	setNode("model", root, model);
+	setNode("wall", model, wall);
+	setNode("box", model, box);
+
+	// nothing to upload, skips compileModel() in the queue
+	model->compiled = true;
+	wall->comped_mesh = box->comped_mesh = std::make_shared<compiledMesh>();
+
+	auto& verts = model->attach<ecs::bufferComponent<sceneModel::vertex>>()->data;
+	auto& faces = wall->attach<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+	unsigned n = 16;
+
+	for (unsigned y = 0; y <= n; y++) {
+		for (unsigned x = 0; x <= n; x++) {
+			sceneModel::vertex v = {};
+			v.position = {x*16.f/n - 8.f, y*4.f/n, 0};
+			verts.push_back(v);
+		}
+	}
+
+	for (unsigned y = 0; y < n; y++) {
+		for (unsigned x = 0; x < n; x++) {
+			unsigned a = y*(n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+			faces.insert(faces.end(), {a, b, c, b, d, c});
+		}
+	}
+
+	// wall in front of the camera, box hidden behind it
+	wall->occluder       = true;
+	wall->boundingBox    = {glm::vec3(-8, 0, 0), glm::vec3(8, 4, 0)};
+	wall->boundingSphere = {glm::vec3(0, 2, 0), 8.3f};
+	wall->transform.setPosition({0, 0, -10});
+	box->boundingBox     = {glm::vec3(-0.5, 0.5, -0.5), glm::vec3(0.5, 1.5, 0.5)};
+	box->boundingSphere  = {glm::vec3(0, 1, 0), 0.9f};
+	box->transform.setPosition({0, 0, -30});
+
+	auto cam = std::make_shared<camera>();
+	cam->setViewport(1280, 720);
+	cam->setPosition({0, 1, 0});
+	cam->setDirection({0, 0, -1}, {0, 1, 0});
+	cam->setFar(200.f);
+
+	occlusionCuller culler;
+	size_t wallTris = faces.size() / 3;
+	culler.settings.maxOccluderTriangles = wallTris;
+	// as if shadow faces earlier in the frame used a whole budget
+	culler.current.occluderTriangles = wallTris;
+
+	renderQueue que;
+	que.add(root);
+	occlusionCullQueue(que, cam, culler, lodPass::Main);
+
+	if (culler.current.occluders != 1
+	    || culler.current.occluderTriangles != 2*wallTris
+	    || que.meshes.size() != 1
+	    || que.meshes[0].data.getPtr() != wall.getPtr())
+	{
+		fail("skipped occluders within the pass budget");
+	}
+}
+
+// probe update ordering (urgent, then underway, then by priority) and the
+// per-frame step and time budgets
+static void testProbeScheduler(void) {
+	typedef std::vector<std::pair<const void*, unsigned>> stepList;
+
+	// runs a frame's steps, each reported as taking ns
+	auto runFrame = [] (probeScheduler& sched, const glm::vec3& viewPos, uint64_t ns) {
+		stepList ret;
+		probeScheduler::step st;
+
+		sched.schedule(viewPos);
+		while (sched.next(st)) {
+			ret.push_back({st.probe, st.index});
+			sched.finished(st, ns);
+		}
+
+		sched.newFrame();
+		return ret;
+	};
+
+	probeScheduler sched;
+	sched.settings.stepBudget = 4;
+	sched.settings.timeBudget = 0;
+	int a, b, c, d;
+
+	// urgent first even though it's farthest, then nearest first
+	sched.request(&a, {1, 0, 0},   3);
+	sched.request(&b, {100, 0, 0}, 3);
+	sched.request(&c, {200, 0, 0}, 3, true);
+
+	if (runFrame(sched, glm::vec3(0), 1000)
+	    != stepList {{&c, 0}, {&c, 1}, {&c, 2}, {&a, 0}})
+	{
+		fail("urgent or nearest probe wasn't updated first");
+	}
+
+	if (!sched.inProgress(&a) || sched.inProgress(&c) || sched.stats().completed != 1) {
+		fail("wrong progress after the first frame");
+	}
+
+	// a is underway, so it finishes before b even though b is nearer now
+	sched.request(&a, {100, 0, 0}, 3);
+	sched.request(&b, {1, 0, 0},   3);
+
+	if (runFrame(sched, glm::vec3(0), 1000)
+	    != stepList {{&a, 1}, {&a, 2}, {&b, 0}, {&b, 1}})
+	{
+		fail("update underway wasn't finished first");
+	}
+
+	sched.request(&b, {1, 0, 0}, 3);
+	sched.request(&d, {0, 0, 0}, 3);
+
+	if (runFrame(sched, glm::vec3(0), 1000)
+	    != stepList {{&b, 2}, {&d, 0}, {&d, 1}, {&d, 2}})
+	{
+		fail("update underway wasn't resumed");
+	}
+
+	// time budget, no new steps once it's used up, but always at least one
+	sched.settings.stepBudget = 100;
+	sched.settings.timeBudget = 1.f;
+
+	sched.request(&a, {0, 0, 0}, 10);
+	if (runFrame(sched, glm::vec3(0), 600000).size() != 2) {
+		fail("time budget not respected");
+	}
+
+	sched.request(&a, {0, 0, 0}, 10);
+	if (runFrame(sched, glm::vec3(0), 5000000).size() != 1) {
+		fail("no step run with the time budget exceeded");
+	}
+
+	// steady state with everything requesting updates, the step budget is
+	// used fully every frame and nothing starves
+	probeScheduler grid;
+	grid.settings.stepBudget = 6;
+	grid.settings.timeBudget = 0;
+
+	std::vector<glm::vec3> probes;
+	for (unsigned i = 0; i < 64; i++) {
+		probes.push_back({(i % 8)*4.f, 0, (i / 8)*4.f});
+	}
+
+	std::vector<unsigned> completed(probes.size(), 0);
+
+	for (unsigned frame = 0; frame < 200; frame++) {
+		for (auto& p : probes) {
+			grid.request(&p, p, 3);
+		}
+
+		auto steps = runFrame(grid, glm::vec3(0), 1000);
+		if (steps.size() != grid.settings.stepBudget) {
+			fail("step budget not used exactly");
+		}
+
+		for (auto& [probe, index] : steps) {
+			if (index == 2) {
+				completed[(const glm::vec3*)probe - probes.data()]++;
+			}
+		}
+	}
+
+	if (std::find(completed.begin(), completed.end(), 0) != completed.end()) {
+		fail("probe starved");
+	}
+}
+
+// selected chunks have to cover the whole map exactly once, with no
+// overlapping levels, and morph factors have to stay in [0, 1]
+static void testTerrainSelection(void) {
+	auto failAt = [] (const char *what, const glm::vec3& pos) {
+		fail("%s, viewed from (%g, %g, %g)", what, pos.x, pos.y, pos.z);
+	};
+
+	terrainSettings settings;
+	// not a multiple of the largest chunk size, so roots hang off the edges
+	float width = 3000, depth = 1900;
+	int cellsX = int(ceilf(width / settings.chunkSize));
+	int cellsY = int(ceilf(depth / settings.chunkSize));
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> xpos(-500.f, width + 500.f);
+	std::uniform_real_distribution<float> zpos(-500.f, depth + 500.f);
+	std::vector<glm::vec3> views = {
+		{0, 10, 0}, {width, 10, depth}, {width*0.5f, 500, depth*0.5f},
+		{-5000, 0, -5000},
+	};
+
+	for (unsigned i = 0; i < 64; i++) {
+		views.push_back({xpos(rng), 30, zpos(rng)});
+	}
+
+	std::vector<terrainChunkKey> keys;
+	// level 0 cells covered by each selected chunk
+	std::vector<unsigned> covered(cellsX * cellsY);
+
+	for (auto& view : views) {
+		keys.clear();
+		std::fill(covered.begin(), covered.end(), 0);
+		selectTerrainChunks(settings, width, depth, view, keys);
+
+		for (auto& key : keys) {
+			if (key.level >= settings.levels) {
+				failAt("level out of range", view);
+			}
+
+			int span = 1 << key.level;
+			for (int y = key.y*span; y < (key.y + 1)*span && y < cellsY; y++) {
+				for (int x = key.x*span; x < (key.x + 1)*span && x < cellsX; x++) {
+					covered[y*cellsX + x]++;
+				}
+			}
+
+			float morph = terrainMorphFactor(settings, key, view);
+			if (!(morph >= 0.f && morph <= 1.f)) {
+				failAt("morph factor out of range", view);
+			}
+
+			if (key.level == settings.levels - 1 && morph != 0.f) {
+				failAt("top level morphing", view);
+			}
+		}
+
+		for (unsigned n : covered) {
+			if (n == 0) failAt("map not covered", view);
+			if (n > 1)  failAt("overlapping chunks", view);
+		}
+
+		// the chunk under the camera is full detail, and not morphing yet
+		if (view.x >= 0 && view.x < width && view.z >= 0 && view.z < depth) {
+			terrainChunkKey under = {int(view.x / settings.chunkSize),
+			                         int(view.z / settings.chunkSize), 0};
+
+			if (std::find(keys.begin(), keys.end(), under) == keys.end()) {
+				failAt("chunk under the camera isn't level 0", view);
+			}
+
+			if (terrainMorphFactor(settings, under, view) != 0.f) {
+				failAt("chunk under the camera is morphing", view);
+			}
+		}
+	}
+
+	// morphing goes from 0 to 1 across the end of a level's range
+	terrainChunkKey key = {0, 0, 1};
+	float range = settings.lodDistance * 2;
+	float end   = 2*settings.chunkSize + range;
+
+	if (terrainMorphFactor(settings, key, {end - range*0.5f, 0, 0}) != 0.f
+	    || terrainMorphFactor(settings, key, {end, 0, 0}) != 1.f
+	    || terrainMorphFactor(settings, key, {end + 100, 0, 0}) != 1.f)
+	{
+		failAt("wrong morph factor across a level", glm::vec3(end, 0, 0));
+	}
+}
+
+// serialized densities have to come back exactly, into a volume with
+// different settings
+static void testVoxelSerialization(void) {
+	ecs::entityManager manager;
+	sceneNode::ptr root = manager.construct<sceneNode>();
+	auto *volume = root->attach<voxelVolume>();
+	int n = volume->settings.chunkSize, side = 2;
+
+	// rolling ground with a crater, spanning a few chunks
+	volume->fill({0, 0, 0}, {side*n - 1, n - 1, side*n - 1},
+		[] (float x, float y, float z) {
+			return 16.f - y + sinf(x * 0.15f) * 4.f + cosf(z * 0.11f) * 4.f;
+		});
+
+	volume->addSphere(glm::vec3(n, 16, n), 5.f, -0.5f);
+	volume->set({-5, 3, 7}, 0.25f);
+
+	sceneNode::ptr copyRoot = manager.construct<sceneNode>();
+	auto *copy = copyRoot->attach<voxelVolume>(voxelVolume::volumeSettings {
+		.chunkSize = 8,
+	});
+
+	voxelVolume::deserializer(copy, voxelVolume::serializer(volume));
+
+	if (copy->settings.chunkSize != volume->settings.chunkSize
+	    || copy->storedChunks() == 0
+	    || copy->dirtyChunks() == 0)
+	{
+		fail("settings or chunks weren't restored");
+	}
+
+	for (int z = -8; z < side*n + 8; z += 3) {
+		for (int y = -8; y < n + 8; y += 3) {
+			for (int x = -8; x < side*n + 8; x += 3) {
+				if (copy->get({x, y, z}) != volume->get({x, y, z})) {
+					fail("density at (%d, %d, %d) changed", x, y, z);
+				}
+			}
+		}
+	}
+
+	if (copy->get({-5, 3, 7}) != 0.25f) {
+		fail("density outside of the filled area changed");
+	}
+}
+
+// removal keeps survivors in order, in serial and parallel steps, and
+// bounds cover exactly the live particles
+static void testParticleBounds(void) {
+	// short, varied lifetimes over a few blocks, so every step removes
+	// particles from the middle of blocks and empties some
+	particleSettings settings;
+	settings.spawnRate   = 0;
+	settings.lifetimeMin = 0.05f;
+	settings.lifetimeMax = 0.5f;
+	settings.spawnRadius = 4.f;
+	settings.sizeCurve.keys = {{0.f, 1.f}, {1.f, 0.25f}};
+
+	jobQueue jobs;
+	particleSimulation serial(settings, 7), parallel(settings, 7);
+	unsigned spawned = 3*particleSimulation::blockSize + 123;
+	float delta = 1/30.f;
+
+	for (unsigned step = 0; step < 20; step++) {
+		size_t expected = 0;
+		for (size_t i = 0; i < serial.count(); i++) {
+			expected += serial.age[i] + delta < serial.lifetime[i];
+		}
+
+		if (step % 5 == 0) {
+			serial.burst(spawned);
+			parallel.burst(spawned);
+			expected += spawned;
+		}
+
+		glm::vec3 origin(step, 0, -float(step));
+		serial.step(delta, origin);
+		parallel.step(delta, origin, &jobs);
+
+		if (serial.count() != expected) {
+			fail("wrong number of survivors");
+		}
+
+		if (parallel.count() != serial.count()) {
+			fail("parallel step kept a different number of particles");
+		}
+
+		glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+		float maxSize = 0;
+
+		for (size_t i = 0; i < serial.count(); i++) {
+			if (serial.age[i] >= serial.lifetime[i]) {
+				fail("dead particle left in the live range");
+			}
+
+			if (serial.px[i] != parallel.px[i]
+			    || serial.age[i] != parallel.age[i]
+			    || serial.size[i] != parallel.size[i])
+			{
+				fail("parallel step reordered particles");
+			}
+
+			glm::vec3 p(serial.px[i], serial.py[i], serial.pz[i]);
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+			maxSize = std::max(maxSize, serial.size[i]);
+		}
+
+		if (serial.count() == 0) {
+			lo = hi = origin;
+
+		} else {
+			lo -= glm::vec3(maxSize);
+			hi += glm::vec3(maxSize);
+		}
+
+		if (serial.boundsMin() != lo || serial.boundsMax() != hi
+		    || parallel.boundsMin() != lo || parallel.boundsMax() != hi)
+		{
+			fail("bounds don't match the live particles");
+		}
+	}
+}
+
+// emitter settings and state survive a round trip, particles don't
+static void testParticleEmitterSerialization(void) {
+	particleSettings settings;
+	settings.spawnRate   = 12.f;
+	settings.bursts      = {{0.5f, 100, 2.f}, {3.f, 7}};
+	settings.lifetimeMin = 0.25f;
+	settings.lifetimeMax = 4.f;
+	settings.direction   = glm::vec3(1, 0, 0);
+	settings.spread      = 0.75f;
+	settings.spawnRadius = 2.f;
+	settings.color       = glm::vec4(1, 0.5f, 0.25f, 0.5f);
+	settings.gravity     = glm::vec3(0, -1, 0);
+	settings.drag        = 0.1f;
+	settings.sizeCurve.keys  = {{0.f, 1.f}, {0.5f, 2.f}, {1.f, 0.f}};
+	settings.colorCurve.keys = {{0.f, glm::vec4(1)}, {1.f, glm::vec4(0)}};
+	settings.maxParticles = 1234;
+
+	ecs::entityManager manager;
+	sceneNode::ptr node = manager.construct<sceneNode>();
+	auto *emitter = node->attach<particleEmitter>(settings);
+	emitter->position     = glm::vec3(1, 2, 3);
+	emitter->followEntity = false;
+	emitter->paused       = true;
+	emitter->simulation.burst(10);
+
+	sceneNode::ptr copyNode = manager.construct<sceneNode>();
+	auto *copy = copyNode->attach<particleEmitter>();
+	copy->simulation.burst(10);
+	particleEmitter::deserializer(copy, particleEmitter::serializer(emitter));
+
+	auto& a = emitter->simulation.settings;
+	auto& b = copy->simulation.settings;
+
+	if (b.bursts.size() != a.bursts.size()
+	    || b.bursts[0].time != a.bursts[0].time
+	    || b.bursts[0].count != a.bursts[0].count
+	    || b.bursts[0].interval != a.bursts[0].interval
+	    || b.bursts[1].interval != a.bursts[1].interval)
+	{
+		fail("bursts weren't restored");
+	}
+
+	if (b.spawnRate != a.spawnRate
+	    || b.lifetimeMin != a.lifetimeMin || b.lifetimeMax != a.lifetimeMax
+	    || b.direction != a.direction || b.spread != a.spread
+	    || b.speedMin != a.speedMin || b.speedMax != a.speedMax
+	    || b.spawnRadius != a.spawnRadius
+	    || b.sizeMin != a.sizeMin || b.sizeMax != a.sizeMax
+	    || b.color != a.color || b.gravity != a.gravity || b.drag != a.drag
+	    || b.maxParticles != a.maxParticles)
+	{
+		fail("settings weren't restored");
+	}
+
+	if (b.sizeCurve.keys != a.sizeCurve.keys
+	    || b.colorCurve.keys != a.colorCurve.keys)
+	{
+		fail("curves weren't restored");
+	}
+
+	if (copy->position != emitter->position
+	    || copy->followEntity != emitter->followEntity
+	    || copy->paused != emitter->paused)
+	{
+		fail("emitter state wasn't restored");
+	}
+
+	if (copy->simulation.count() != 0) {
+		fail("deserializing didn't clear the simulation");
+	}
+}
+
+// compares meshBVH and raycastScene hits against testing every triangle,
+// over random scenes with rays that miss and rays aimed at triangle edges
+static void testRaycast(void) {
+	struct triangle {
+		glm::vec3 a, b, c;
+		// instance id, triangle index in the mesh
+		uint32_t id;
+		uint32_t index;
+	};
+
+	auto failAt = [] (const char *what, unsigned seed, size_t ray) {
+		fail("%s, scene %u, ray %zu", what, seed, ray);
+	};
+
+	// Möller-Trumbore, only counting hits clearly away from the edges,
+	// by the same world unit tolerance compare() allows for hit points
+	auto triHit = [] (const glm::vec3& o, const glm::vec3& d,
+	                  const triangle& tri, float& t)
+	{
+		glm::vec3 e1 = tri.b - tri.a, e2 = tri.c - tri.a;
+		glm::vec3 p = glm::cross(d, e2);
+		float det = glm::dot(e1, p);
+
+		if (det == 0.f) {
+			return false;
+		}
+
+		glm::vec3 s = o - tri.a;
+		glm::vec3 q = glm::cross(s, e1);
+		float u = glm::dot(s, p) / det;
+		float v = glm::dot(d, q) / det;
+		t = glm::dot(e2, q) / det;
+
+		// barycentrics times the heights give distances to the edges
+		float area = glm::length(glm::cross(e1, e2));
+		float margin = 1e-3f * (1.f + glm::length(d)*t);
+
+		return t >= 0
+		    && u*area >= margin*glm::length(e2)
+		    && v*area >= margin*glm::length(e1)
+		    && (1 - u - v)*area >= margin*glm::length(tri.c - tri.b);
+	};
+
+	// closest point on a triangle, from Real-Time Collision Detection 5.1.5
+	auto closest = [] (const glm::vec3& p, const triangle& tri) -> glm::vec3 {
+		glm::vec3 ab = tri.b - tri.a, ac = tri.c - tri.a;
+		glm::vec3 ap = p - tri.a, bp = p - tri.b, cp = p - tri.c;
+		float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		float va = d3*d6 - d5*d4, vb = d5*d2 - d1*d6, vc = d1*d4 - d3*d2;
+
+		if (d1 <= 0 && d2 <= 0)                      return tri.a;
+		if (d3 >= 0 && d4 <= d3)                     return tri.b;
+		if (d6 >= 0 && d5 <= d6)                     return tri.c;
+		if (vc <= 0 && d1 >= 0 && d3 <= 0)           return tri.a + ab*(d1 / (d1 - d3));
+		if (vb <= 0 && d2 >= 0 && d6 <= 0)           return tri.a + ac*(d2 / (d2 - d6));
+		if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+			return tri.b + (tri.c - tri.b)*((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		}
+
+		float denom = 1.f / (va + vb + vc);
+		return tri.a + ab*(vb*denom) + ac*(vc*denom);
+	};
+
+	auto compare = [&] (const std::vector<triangle>& tris,
+	                    const glm::vec3& o, const glm::vec3& d,
+	                    bool hit, float dist, uint32_t id, uint32_t index,
+	                    const glm::vec3& normal, unsigned seed, size_t ray)
+	{
+		// nearest triangle the ray clearly crosses
+		float inside = FLT_MAX;
+		const triangle *reported = nullptr;
+
+		for (auto& tri : tris) {
+			float t;
+
+			if (triHit(o, d, tri, t)) {
+				inside = std::min(inside, t);
+			}
+
+			if (hit && tri.id == id && tri.index == index) {
+				reported = &tri;
+			}
+		}
+
+		if (!hit) {
+			if (inside < FLT_MAX) failAt("missed a triangle", seed, ray);
+			return;
+		}
+
+		// checked in world units, barycentrics blow up for rays that
+		// graze the triangle or are aimed at its edges from far away
+		glm::vec3 point = o + d*dist;
+		float tol = 1e-3f * (1.f + glm::length(d)*dist);
+
+		if (!reported || glm::distance(closest(point, *reported), point) > tol) {
+			failAt("hit point isn't on the reported triangle", seed, ray);
+		}
+
+		if (dist > inside + 1e-3f*(1.f + dist)) failAt("hit isn't the nearest", seed, ray);
+
+		glm::vec3 n = glm::cross(reported->b - reported->a, reported->c - reported->a);
+		float along = glm::dot(glm::normalize(normal), glm::normalize(d));
+
+		if (fabsf(glm::dot(glm::normalize(n), glm::normalize(normal))) < 0.999f
+		    || along > 1e-3f)
+		{
+			failAt("wrong hit normal", seed, ray);
+		}
+	};
+
+	for (unsigned seed = 1; seed <= 4; seed++) {
+		ecs::entityManager manager;
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+		auto randomDir = [&] {
+			glm::vec3 d;
+			do { d = {unit(rng), unit(rng), unit(rng)}; } while (glm::length(d) < 0.1f);
+			return glm::normalize(d);
+		};
+
+		// bumpy grid for shared edges, plus loose random triangles
+		std::vector<sceneModel::ptr> models;
+		std::vector<std::vector<triangle>> modelTris;
+
+		for (unsigned m = 0; m < 3; m++) {
+			sceneModel::ptr model = manager.construct<sceneModel>();
+			sceneMesh::ptr  mesh  = manager.construct<sceneMesh>();
+			auto& verts = model->attach<ecs::bufferComponent<sceneModel::vertex>>()->data;
+			auto& faces = mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+			setNode("mesh", model, mesh);
+
+			unsigned n = 9;
+			for (unsigned y = 0; y < n; y++) {
+				for (unsigned x = 0; x < n; x++) {
+					sceneModel::vertex v = {};
+					v.position = {float(x) - 4, unit(rng)*0.5f, float(y) - 4};
+					verts.push_back(v);
+				}
+			}
+
+			for (unsigned y = 0; y + 1 < n; y++) {
+				for (unsigned x = 0; x + 1 < n; x++) {
+					unsigned a = y*n + x, b = a + 1, c = a + n, d = c + 1;
+					faces.insert(faces.end(), {a, c, b, b, c, d});
+				}
+			}
+
+			for (unsigned i = 0; i < 32; i++) {
+				glm::vec3 center(unit(rng)*4, unit(rng)*3, unit(rng)*4);
+
+				for (unsigned k = 0; k < 3; k++) {
+					sceneModel::vertex v = {};
+					v.position = center + glm::vec3(unit(rng), unit(rng), unit(rng));
+					faces.push_back(verts.size());
+					verts.push_back(v);
+				}
+			}
+
+			model->buildBVHs();
+
+			std::vector<triangle> tris;
+			for (uint32_t i = 0; i < faces.size() / 3; i++) {
+				tris.push_back({
+					verts[faces[3*i]].position,
+					verts[faces[3*i + 1]].position,
+					verts[faces[3*i + 2]].position,
+					0, i
+				});
+			}
+
+			models.push_back(model);
+			modelTris.push_back(tris);
+		}
+
+		// rays through random points on random triangle edges, corners
+		// included, from outside the scene
+		auto edgeRay = [&] (const std::vector<triangle>& tris, float dist,
+		                    glm::vec3& o, glm::vec3& d)
+		{
+			auto& tri = tris[rng() % tris.size()];
+			glm::vec3 corners[3] = {tri.a, tri.b, tri.c};
+			unsigned e = rng() % 3;
+			float s = (rng() % 4 == 0)? 0.f : (unit(rng)*0.5f + 0.5f);
+
+			glm::vec3 target = glm::mix(corners[e], corners[(e + 1) % 3], s);
+			d = randomDir();
+			o = target - d*dist;
+		};
+
+		// object space rays against the mesh BVH directly, with directions
+		// that aren't normalized
+		for (size_t m = 0; m < models.size(); m++) {
+			auto mesh = ref_cast<sceneMesh>(models[m]->getNode("mesh"));
+			auto& tris = modelTris[m];
+
+			for (size_t ray = 0; ray < 1500; ray++) {
+				glm::vec3 o, d;
+
+				if (ray % 3 == 0) {
+					edgeRay(tris, 20.f, o, d);
+
+				} else if (ray % 3 == 1) {
+					// away from the mesh
+					d = randomDir();
+					o = d*20.f;
+
+				} else {
+					o = randomDir()*20.f;
+					d = glm::vec3(unit(rng)*4, unit(rng)*2, unit(rng)*4) - o;
+				}
+
+				d *= 0.75f + unit(rng)*0.25f;
+
+				meshHit hit;
+				bool found = mesh->bvh->raycast(o, d, FLT_MAX, hit);
+				compare(tris, o, d, found, hit.distance, 0, hit.triangle,
+				        hit.normal, seed, ray);
+			}
+		}
+
+		// instances with random rotations and non-uniform scales
+		sceneNode::ptr root = manager.construct<sceneNode>();
+		raycastScene scene;
+		std::vector<triangle> world;
+
+		for (uint32_t i = 0; i < 16; i++) {
+			sceneNode::ptr node = manager.construct<sceneNode>();
+			unsigned m = rng() % models.size();
+
+			node->transform.setPosition({unit(rng)*20, unit(rng)*5, unit(rng)*20});
+			node->transform.setRotation(glm::quat(glm::vec3(unit(rng), unit(rng)*3, unit(rng))));
+			node->transform.setScale(glm::vec3(1.f) + 0.5f*glm::vec3(unit(rng), unit(rng), unit(rng)));
+			setNode("model", node, models[m]);
+			setNode("instance" + std::to_string(i), root, node);
+			scene.add(node, nullptr, glm::mat4(1), i);
+
+			glm::mat4 trans = node->transform.getMatrix();
+			for (auto tri : modelTris[m]) {
+				tri.a  = applyTransform(trans, tri.a);
+				tri.b  = applyTransform(trans, tri.b);
+				tri.c  = applyTransform(trans, tri.c);
+				tri.id = i;
+				world.push_back(tri);
+			}
+		}
+
+		scene.build();
+
+		for (size_t ray = 0; ray < 1500; ray++) {
+			glm::vec3 o, d;
+
+			if (ray % 3 == 0) {
+				edgeRay(world, 60.f, o, d);
+
+			} else if (ray % 3 == 1) {
+				d = randomDir();
+				o = d*60.f;
+
+			} else {
+				o = randomDir()*60.f;
+				d = glm::normalize(glm::vec3(unit(rng)*20, unit(rng)*5, unit(rng)*20) - o);
+			}
+
+			raycastHit hit;
+			bool found = scene.raycast(o, d, hit);
+			compare(world, o, d, found, hit.distance, hit.id, hit.triangle,
+			        hit.normal, seed, ray);
+		}
+	}
+}
+
+// content hashes follow edits and keep textures that differ anywhere
+// apart, loads are shared per file and sampler settings
+static void testTextureCache(void) {
+	namespace fs = std::filesystem;
+
+	textureFileCache cache;
+	unsigned side = 64;
+	std::vector<uint8_t> px(side*side*4, 0x80);
+
+	// textures that differ in a single byte, everywhere a sampling hash
+	// would skip over, all of them have to stay distinct
+	std::vector<textureData::ptr> textures;
+	std::vector<textureData*> interned;
+
+	for (size_t i = 0; i < 1024; i++) {
+		auto tex = std::make_shared<textureData>();
+		tex->width = tex->height = side;
+		tex->channels = 4;
+		tex->pixels = px;
+		std::get<std::vector<uint8_t>>(tex->pixels)[(i*7919 + 1) % px.size()] ^= 1;
+		textures.push_back(tex);
+		interned.push_back(cache.intern(tex).get());
+	}
+
+	std::sort(interned.begin(), interned.end());
+	if (std::unique(interned.begin(), interned.end()) != interned.end()) {
+		fail("shared textures with different contents");
+	}
+
+	// cached hashes have to follow changes to the texture
+	auto& tex = *textures[0];
+	uint64_t hash = tex.hash();
+
+	std::get<std::vector<uint8_t>>(tex.pixels)[5] ^= 0x10;
+	tex.invalidateHash();
+	if (tex.hash() == hash || tex.hash() != hashTexture(tex)) {
+		fail("hash not updated after editing pixels in place");
+	}
+
+	hash = tex.hash();
+	tex.pixels = px;
+	tex.invalidateHash();
+	if (tex.hash() == hash || tex.hash() != hashTexture(tex)) {
+		fail("hash not updated after replacing the pixels");
+	}
+
+	hash = tex.hash();
+	tex.width = tex.height = side / 2;
+	tex.pixels = std::vector<uint8_t>(px.begin(), px.begin() + px.size()/4);
+	if (tex.hash() == hash || tex.hash() != hashTexture(tex)) {
+		fail("hash not updated after resizing");
+	}
+
+	hash = tex.hash();
+	tex.magFilter = textureData::filter::Nearest;
+	if (tex.hash() == hash || tex.hash() != hashTexture(tex)) {
+		fail("hash not updated after changing sampler settings");
+	}
+
+	// files are shared per set of sampler settings, without a decode or
+	// copy for repeated loads
+	fs::path dir = fs::temp_directory_path() / "grend-tests-textures";
+	std::string path = (dir / "tex.png").string();
+	fs::create_directories(dir);
+
+	if (!stbi_write_png(path.c_str(), side, side, 4, px.data(), side*4)) {
+		fail("couldn't write %s", path.c_str());
+	}
+
+	textureSampler nearest;
+	nearest.minFilter = nearest.magFilter = textureData::filter::Nearest;
+
+	auto plain  = cache.load(path);
+	auto plain2 = cache.load(path);
+	auto near   = cache.load(path, false, nearest);
+	auto near2  = cache.load(path, false, nearest);
+
+	if (plain != plain2 || near != near2) {
+		fail("repeated loads weren't shared");
+	}
+
+	if (near == plain || near->magFilter != textureData::filter::Nearest
+	    || plain->magFilter != textureSampler().magFilter)
+	{
+		fail("sampler settings leaked between uses of a file");
+	}
+
+	auto stats = cache.getStats();
+	if (stats.pathMisses != 2 || near->pixels != plain->pixels) {
+		fail("sampler variant wasn't loaded from the cached file");
+	}
+
+	fs::remove_all(dir);
+}
+
+// instances get their own lights and probes, with settings copied but not
+// rendered state, share models, and release() removes everything
+static void testPrefabInstancing(void) {
+	ecs::entityManager manager;
+	sceneNode::ptr source = manager.construct<sceneNode>();
+
+	sceneLightPoint::ptr point = manager.construct<sceneLightPoint>();
+	point->radius    = 3.f;
+	point->intensity = 20.f;
+	point->casts_shadows = true;
+	point->have_map  = true;
+
+	sceneLightSpot::ptr spot = manager.construct<sceneLightSpot>();
+	spot->angle = 0.5f;
+
+	sceneReflectionProbe::ptr refl  = manager.construct<sceneReflectionProbe>();
+	sceneIrradianceProbe::ptr irrad = manager.construct<sceneIrradianceProbe>();
+	refl->boundingBox = {glm::vec3(-2), glm::vec3(3)};
+	refl->have_map    = true;
+
+	sceneModel::ptr model = manager.construct<sceneModel>();
+
+	setNode("point", source, point);
+	setNode("spot",  source, spot);
+	setNode("refl",  source, refl);
+	setNode("irrad", source, irrad);
+	setNode("model", source, model);
+	point->transform.setPosition(glm::vec3(1, 2, 3));
+
+	prefab fab(source);
+	size_t before = manager.entities.size();
+	std::vector<sceneNode::ptr> instances;
+	fab.instantiate(&manager, 3, instances);
+
+	std::set<sceneNode*> seen = {point.getPtr(), spot.getPtr(), refl.getPtr(), irrad.getPtr()};
+
+	for (auto& inst : instances) {
+		auto lit  = ref_cast<sceneLightPoint>(inst->getNode("point"));
+		auto sp   = ref_cast<sceneLightSpot>(inst->getNode("spot"));
+		auto rp   = ref_cast<sceneReflectionProbe>(inst->getNode("refl"));
+		auto ip   = ref_cast<sceneIrradianceProbe>(inst->getNode("irrad"));
+
+		// shadowCache and probeScheduler track these by pointer
+		for (sceneNode *node : {(sceneNode*)lit.getPtr(), (sceneNode*)sp.getPtr(),
+		                        (sceneNode*)rp.getPtr(), (sceneNode*)ip.getPtr()})
+		{
+			if (!node || !seen.insert(node).second) {
+				fail("light or probe shared between instances");
+			}
+		}
+
+		if (lit->lightType != sceneLight::lightTypes::Point
+		    || lit->radius != 3.f || lit->intensity != 20.f || !lit->casts_shadows
+		    || lit->transform.getTRS().position != glm::vec3(1, 2, 3)
+		    || sp->angle != 0.5f
+		    || rp->boundingBox.max != glm::vec3(3))
+		{
+			fail("light or probe settings weren't copied");
+		}
+
+		if (lit->have_map || rp->have_map || !lit->changed) {
+			fail("rendered state copied into an instance");
+		}
+
+		if (inst->getNode("model").getPtr() != model.getPtr()) {
+			fail("model not shared");
+		}
+	}
+
+	for (auto& inst : instances) {
+		fab.release(&manager, inst);
+	}
+
+	manager.clearFreedEntities();
+
+	if (manager.entities.size() != before) {
+		fail("release() left instance nodes behind");
+	}
+}
+
+// wire format round trips, quantization error, lossy sessions and
+// malformed packets
+static void testReplication(void) {
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+	// the codec functions aren't used by the wire format itself
+	replicationSchema schema;
+	schema.add({"benchReplicated", 3, nullptr, nullptr, nullptr});
+
+	auto randomSnapshot = [&] (uint32_t tick, const netSnapshot *from,
+	                          uint32_t maxMask = 1)
+	{
+		netSnapshot ret;
+		ret.tick = tick;
+		uint32_t id = 0;
+
+		for (size_t i = 0; i < 200; i++) {
+			id += 1 + rng() % 3;
+			ptrdiff_t old = from? from->find(id) : -1;
+
+			// some removed, some added, some keep their old state
+			if (rng() % 8 == 0) continue;
+
+			uint32_t mask = (old >= 0 && rng() % 8)? from->typeMasks[old] : rng() % (maxMask + 1);
+			unsigned n = schema.fieldCount(mask);
+
+			ret.ids.push_back(id);
+			ret.typeMasks.push_back(mask);
+			ret.offsets.push_back(ret.fields.size());
+
+			for (unsigned f = 0; f < n; f++) {
+				bool sameMask = old >= 0 && from->typeMasks[old] == mask;
+				int32_t value = sameMask? from->get(old)[f] : int32_t(rng());
+
+				if (rng() % 4 == 0) {
+					// small changes, and ones that wrap around
+					value = (rng() % 2)? value + int32_t(rng() % 64) - 32
+					                   : value ^ INT32_MIN;
+				}
+
+				ret.fields.push_back(value);
+			}
+		}
+
+		return ret;
+	};
+
+	auto sameSnapshot = [] (const netSnapshot& a, const netSnapshot& b) {
+		return a.tick == b.tick
+		    && a.ids == b.ids
+		    && a.typeMasks == b.typeMasks
+		    && a.offsets == b.offsets
+		    && a.fields == b.fields;
+	};
+
+	// encode -> readDelta -> applyDelta has to give back the snapshot,
+	// against a baseline and as a full snapshot
+	netSnapshot base = randomSnapshot(10, nullptr);
+	netDelta delta, decodedDelta;
+	netSnapshot decoded;
+	std::vector<uint8_t> packet;
+
+	for (uint32_t tick = 11; tick < 40; tick++) {
+		netSnapshot cur = randomSnapshot(tick, &base);
+
+		const netSnapshot *bases[] = {&base, nullptr};
+
+		for (const netSnapshot *b : bases) {
+			makeDelta(schema, cur, b, delta);
+			writeDelta(delta, packet);
+
+			if (!readDelta(packet, decodedDelta)
+			    || !applyDelta(schema, decodedDelta, b, decoded)
+			    || !sameSnapshot(decoded, cur))
+			{
+				fail("delta round trip doesn't match the snapshot");
+			}
+		}
+
+		base = cur;
+	}
+
+	// quantized transforms, rotations are 10 bits over +-1/sqrt(2) for
+	// each of the three smallest components, about 0.28 degrees at worst
+	for (unsigned i = 0; i < 10000; i++) {
+		TRS t;
+		t.position = glm::vec3(unit(rng), unit(rng), unit(rng)) * 500.f;
+		t.rotation = glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+		t.scale    = glm::vec3(unit(rng), unit(rng), unit(rng)) * 4.f;
+
+		int32_t fields[replicationSchema::transformFields];
+		schema.writeTransform(t, fields);
+		TRS q = schema.readTransform(fields);
+
+		float angle = 2.f * acosf(std::min(1.f, fabsf(glm::dot(t.rotation, q.rotation))));
+		glm::vec3 dp = glm::abs(q.position - t.position);
+		glm::vec3 ds = glm::abs(q.scale - t.scale);
+		float maxPos = 0.5f / schema.positionSteps + 1e-4f;
+		float maxScale = 0.5f / schema.scaleSteps + 1e-5f;
+
+		if (angle > 0.005f) {
+			fail("quantized rotation error out of bounds");
+		}
+
+		if (std::max({dp.x, dp.y, dp.z}) > maxPos
+		    || std::max({ds.x, ds.y, ds.z}) > maxScale)
+		{
+			fail("quantized position or scale error out of bounds");
+		}
+	}
+
+	auto serverSchema = std::make_shared<replicationSchema>();
+	ecs::entityManager serverWorld, clientWorld;
+	std::vector<ecs::entity*> ents;
+
+	for (size_t i = 0; i < 64; i++) {
+		auto ent = serverWorld.construct<ecs::entity>();
+		ent->attach<ecs::replicated>();
+		ent->transform.setPosition({unit(rng)*50, 0, unit(rng)*50});
+		ents.push_back(ent);
+	}
+
+	auto [serverEnd, clientEnd] = loopbackTransport::makePair(0.5f, 99);
+	replicationServer server(serverSchema, &serverWorld);
+	replicationClient client(serverSchema, &clientWorld, clientEnd);
+	server.addClient(serverEnd);
+
+	auto matches = [&] {
+		client.interpolate(client.latestTick());
+
+		for (auto ent : ents) {
+			auto remote = client.find(ent->get<ecs::replicated>()->netID);
+			glm::vec3 a = ent->transform.getTRS().position;
+
+			if (!remote || glm::length(remote->transform.getTRS().position - a) > 0.01f) {
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	// heavy loss both ways, then acks lost for longer than the history,
+	// every snapshot that gets through has to decode to the server's state
+	for (unsigned tick = 0; tick < 200; tick++) {
+		if (tick == 100) {
+			clientEnd->loss = 1.f;
+			serverEnd->loss = 0.f;
+		}
+
+		for (size_t i = 0; i < ents.size() / 4; i++) {
+			auto ent = ents[rng() % ents.size()];
+			ent->transform.setPosition(ent->transform.getTRS().position
+			                           + glm::vec3(unit(rng), 0, unit(rng)));
+		}
+
+		uint32_t prev = client.latestTick();
+		server.receive();
+		server.tick();
+		client.receive();
+
+		if (client.latestTick() != prev
+		    && (client.latestTick() != server.currentTick() || !matches()))
+		{
+			fail("snapshot under loss doesn't match the server");
+		}
+	}
+
+	auto cstats = client.getStats();
+	if (cstats.invalid || cstats.missingBaseline || server.getStats().fullSnapshots < 2) {
+		fail("lossy session needed a baseline the client didn't have");
+	}
+
+	// once packets get through again the client has to end up with the
+	// server's state, within quantization error
+	serverEnd->loss = clientEnd->loss = 0.f;
+	for (unsigned i = 0; i < 4; i++) {
+		server.receive();
+		server.tick();
+		client.receive();
+	}
+
+	if (!matches()) {
+		fail("state after recovering from loss doesn't match the server");
+	}
+
+	// a delta against a baseline the client never got is counted and
+	// dropped, without touching the world
+	auto [sendEnd, recvEnd] = loopbackTransport::makePair();
+	replicationClient probe(serverSchema, &clientWorld, recvEnd);
+
+	// only transforms, serverSchema doesn't have the extra type
+	netSnapshot snap = randomSnapshot(5, nullptr, 0);
+	netSnapshot next = randomSnapshot(6, &snap, 0);
+	makeDelta(*serverSchema, snap, nullptr, delta);
+	writeDelta(delta, packet);
+	sendEnd->send(packet.data(), packet.size());
+	probe.receive();
+
+	makeDelta(*serverSchema, next, &snap, delta);
+	delta.baseTick = 3;
+	writeDelta(delta, packet);
+	sendEnd->send(packet.data(), packet.size());
+	probe.receive();
+
+	if (probe.getStats().missingBaseline != 1 || probe.latestTick() != 5) {
+		fail("delta without a baseline was applied");
+	}
+
+	// malformed packets: every truncation of a valid packet, varints that
+	// don't end, and IDs that don't increase or wrap around
+	makeDelta(*serverSchema, next, &snap, delta);
+	writeDelta(delta, packet);
+
+	std::vector<std::vector<uint8_t>> malformed;
+	for (size_t len = 0; len < packet.size(); len++) {
+		malformed.push_back(std::vector<uint8_t>(packet.begin(), packet.begin() + len));
+	}
+
+	uint8_t type = packet[0];
+	malformed.push_back({type, 7, 0, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01});
+	// entity 4, then a step of 0 back to entity 4
+	malformed.push_back({type, 7, 0, 4 << 1 | 1, 0, 0, 1, 0, 0, 0, 0});
+	// entity 4, then a step past UINT32_MAX
+	malformed.push_back({type, 7, 0, 4 << 1 | 1, 0, 0, 0xfe, 0xff, 0xff, 0xff, 0x1f, 0, 0, 0, 0});
+	// removed 4, then a step past UINT32_MAX
+	malformed.push_back({type, 7, 0, 0, 4, 0xff, 0xff, 0xff, 0xff, 0x0f, 0});
+
+	for (auto& bad : malformed) {
+		if (readDelta(bad, decodedDelta)) {
+			fail("malformed packet decoded");
+		}
+
+		sendEnd->send(bad.data(), bad.size());
+	}
+
+	size_t before = clientWorld.entities.size();
+	probe.receive();
+
+	if (probe.getStats().invalid != malformed.size()
+	    || probe.getStats().applied != 1
+	    || probe.latestTick() != 5
+	    || clientWorld.entities.size() != before)
+	{
+		fail("malformed packets weren't rejected");
+	}
+}
+
+// batched queries match single ones, layer masks filter hits, and sphere
+// overlaps test the shape rather than its bounds
+static void testPhysicsQueries(void) {
+#if defined(PHYSICS_BULLET)
+	bulletPhysics phys;
+	std::vector<physicsObject::ptr> objects;
+	size_t side = 8;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+	// grid of static boxes and spheres, odd rows on a second layer
+	for (size_t x = 0; x < side; x++) {
+		for (size_t z = 0; z < side; z++) {
+			glm::vec3 pos(x*4.f, 0, z*4.f);
+			AABBExtent box = {glm::vec3(0), glm::vec3(1)};
+			auto obj = ((x + z) % 2)
+				? phys.addBox(nullptr, pos, 0.f, box)
+				: phys.addSphere(nullptr, pos, 0.f, 1.f);
+
+			obj->setCollisionLayer((z % 2)? 2 : 1);
+			objects.push_back(obj);
+		}
+	}
+
+	size_t count = 1000;
+	float size = side*4.f;
+	std::vector<physicsRay> rays(count);
+	std::vector<physicsHit> hits(count), singleHits(count);
+	jobQueue jobs;
+
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 from(unit(rng)*size, 10.f, unit(rng)*size);
+		rays[i] = {from, from + glm::vec3(unit(rng)*8, -20.f, unit(rng)*8)};
+		phys.raycast(rays[i], singleHits[i]);
+	}
+
+	phys.raycastBatch(rays, hits, &jobs);
+
+	for (size_t i = 0; i < count; i++) {
+		if (hits[i].obj != singleHits[i].obj
+		    || fabsf(hits[i].fraction - singleHits[i].fraction) > 1e-5f)
+		{
+			fail("batched raycast %zu doesn't match a single raycast", i);
+		}
+	}
+
+	// straight down onto the first sphere, layer 1, which a layer 2 mask
+	// has to skip
+	physicsRay down = {glm::vec3(0, 10, 0), glm::vec3(0, -10, 0)};
+	physicsHit hit;
+
+	if (!phys.raycast(down, hit) || hit.obj != objects[0].get()
+	    || fabsf(hit.position.y - 1.f) > 0.01f)
+	{
+		fail("raycast missed a sphere");
+	}
+
+	down.filter.mask = 2;
+	hit = {};
+	if (phys.raycast(down, hit)) {
+		fail("raycast hit a filtered layer");
+	}
+
+	// sphere overlaps are exact, this one is inside the box's bounds but
+	// misses the sphere at the origin
+	std::vector<physicsHit> found;
+	physicsOverlap corner = {
+		.center = glm::vec3(1.2f, 1.2f, 1.2f),
+		.radius = 0.2f,
+	};
+
+	if (phys.overlap(corner, found) != 0) {
+		fail("sphere overlap hit outside of a sphere");
+	}
+
+#else
+	fprintf(stderr, "built without bullet, skipping\n");
+#endif
+}
+
+// cooked BVHs give the same hits as built ones, unused shapes are purged,
+// and per-model bodies share the cached mesh shape
+static void testShapeCache(void) {
+#if defined(PHYSICS_BULLET)
+	ecs::entityManager manager;
+
+	unsigned n = 16;
+	sceneModel::ptr model = manager.construct<sceneModel>();
+	sceneMesh::ptr  mesh  = manager.construct<sceneMesh>();
+	auto& verts = model->attach<ecs::bufferComponent<sceneModel::vertex>>()->data;
+	auto& faces = mesh->attach<ecs::bufferComponent<sceneMesh::faceType>>()->data;
+	setNode("mesh", model, mesh);
+
+	for (unsigned y = 0; y < n; y++) {
+		for (unsigned x = 0; x < n; x++) {
+			float fx = float(x)/(n - 1) - 0.5f, fy = float(y)/(n - 1) - 0.5f;
+			sceneModel::vertex v = {};
+			v.position = {fx*8, 0.3f*sinf(fx*20)*cosf(fy*20), fy*8};
+			verts.push_back(v);
+		}
+	}
+
+	for (unsigned y = 0; y + 1 < n; y++) {
+		for (unsigned x = 0; x + 1 < n; x++) {
+			unsigned a = y*n + x, b = a + 1, c = a + n, d = c + 1;
+			faces.insert(faces.end(), {a, c, b, b, c, d});
+		}
+	}
+
+	bulletPhysics phys;
+	std::vector<physicsObject::ptr> objects;
+
+	auto place = [&] (size_t i) {
+		TRS t;
+		t.position = glm::vec3((i % 32)*10.f, 0, (i / 32)*10.f);
+		t.scale    = glm::vec3((i % 4)? 1.f : 2.f);
+		objects.push_back(phys.addStaticMesh(nullptr, t, model, mesh));
+	};
+
+	auto reset = [&] {
+		objects.clear();
+		phys.shapes.clear();
+	};
+
+	physicsRay down = {glm::vec3(1.3f, 5, 0.7f), glm::vec3(1.3f, -5, 0.7f)};
+	physicsHit built, cooked;
+	place(0);
+	phys.raycast(down, built);
+
+	auto dir = std::filesystem::temp_directory_path() / "grend-tests-cooked";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	phys.shapes.setCookPath(dir.string());
+
+	// first one writes the cooked file, the second loads it
+	reset();
+	place(0);
+	reset();
+	place(0);
+	phys.raycast(down, cooked);
+
+	phys.shapes.setCookPath("");
+	std::filesystem::remove_all(dir);
+
+	if (phys.shapes.getStats().cookedLoads == 0 || !built.obj || !cooked.obj
+	    || fabsf(built.fraction - cooked.fraction) > 1e-5f)
+	{
+		fail("cooked collision mesh doesn't match the built one");
+	}
+
+	// nothing uses the shapes once the bodies are gone
+	reset();
+	place(0);
+	place(4);
+	objects.clear();
+
+	if (phys.shapes.purge() != 2 || phys.shapes.getStats().meshes != 0) {
+		fail("kept unused shapes");
+	}
+
+	// per-model bodies share the mesh shape between instances too
+	size_t hits = phys.shapes.getStats().hits;
+	auto first  = phys.addModelMeshBoxes(model);
+	auto second = phys.addModelMeshBoxes(model);
+	auto stats  = phys.shapes.getStats();
+
+	if (first.size() != 1 || !first[mesh] || !second[mesh]
+	    || stats.meshes != 1 || stats.hits == hits)
+	{
+		fail("model mesh bodies don't share the cached shape");
+	}
+
+	first.clear();
+	second.clear();
+
+	if (phys.shapes.purge() == 0 || phys.shapes.getStats().meshes != 0) {
+		fail("kept unused model mesh shapes");
+	}
+
+#else
+	fprintf(stderr, "built without bullet, skipping\n");
+#endif
+}
+
+struct testTag : public ecs::component {
+	testTag(ecs::regArgs t) : ecs::component(ecs::doRegister(this, t)) {}
+	virtual ~testTag() {}
+};
+
+// records what dispatch() hands to each handler, and what the default
+// onContacts() passes on to onCollision()
+struct testCollisionHandler : public ecs::collisionHandler {
+	testCollisionHandler(ecs::regArgs t)
+		: ecs::collisionHandler(ecs::doRegister(this, t), {}) {}
+	virtual ~testCollisionHandler() {}
+
+	virtual void onContacts(ecs::entityManager *manager, ecs::entity *ent,
+	                        std::span<const ecs::contact> contacts)
+	{
+		batches.push_back({contacts.begin(), contacts.end()});
+		ecs::collisionHandler::onContacts(manager, ent, contacts);
+	}
+
+	virtual void onCollision(ecs::entityManager *manager, ecs::entity *ent,
+	                         ecs::entity *other, collision& col)
+	{
+		collided.push_back(other);
+	}
+
+	std::vector<std::vector<ecs::contact>> batches;
+	std::vector<ecs::entity*> collided;
+};
+
+// events are batched into one onContacts() call per entity, in the order
+// they were generated and seen from the entity's side of the pair, and the
+// default onContacts() skips end events and entities without the tags
+static void testCollisionDispatch(void) {
+	ecs::entityManager manager;
+	ecs::entity *a = manager.construct<ecs::entity>();
+	ecs::entity *b = manager.construct<ecs::entity>();
+	ecs::entity *c = manager.construct<ecs::entity>();
+	c->attach<testTag>();
+
+	auto *ha = a->attach<testCollisionHandler>();
+	auto *hb = b->attach<testCollisionHandler>();
+	auto *tagged = b->attach<testCollisionHandler>();
+	tagged->tags = {getTypeName<testTag>()};
+
+	// only used as keys, never dereferenced
+	int objs[4];
+	auto obj = [&] (int i) { return reinterpret_cast<physicsObject*>(&objs[i]); };
+
+	std::vector<contactEvent> events;
+	auto add = [&] (int i, ecs::entity *ea, int k, ecs::entity *eb,
+	                contactEvent::type kind)
+	{
+		float n = events.size() + 1;
+		events.push_back({
+			.a = obj(i),
+			.b = obj(k),
+			.adata = ea,
+			.bdata = eb,
+			.positionA = glm::vec3(n, 0, 0),
+			.positionB = glm::vec3(0, n, 0),
+			.normal = glm::vec3(0, 0, n),
+			.depth = 0.1f*n,
+			.kind = kind,
+		});
+	};
+
+	add(0, a, 1, b, contactEvent::Begin);
+	add(1, b, 2, c, contactEvent::Begin);
+	// physics object outside the ECS
+	add(0, a, 3, nullptr, contactEvent::Persist);
+	add(0, a, 1, b, contactEvent::End);
+	add(2, c, 0, a, contactEvent::Persist);
+
+	ecs::entitySystemCollision system;
+	system.dispatch(&manager, events);
+
+	struct expected { size_t event; bool isA; };
+	auto check = [&] (testCollisionHandler *h, const char *name,
+	                  const std::vector<expected>& want)
+	{
+		if (h->batches.size() != 1) {
+			fail("%s got %zu batches, expected one", name, h->batches.size());
+		}
+
+		auto& batch = h->batches[0];
+		if (batch.size() != want.size()) {
+			fail("%s got %zu contacts, expected %zu", name, batch.size(), want.size());
+		}
+
+		for (size_t i = 0; i < want.size(); i++) {
+			auto& ev = events[want[i].event];
+			auto& con = batch[i];
+			bool isA = want[i].isA;
+
+			if (con.kind != ev.kind
+			    || con.other != (isA? ev.bdata : ev.adata)
+			    || con.position != (isA? ev.positionA : ev.positionB)
+			    || con.normal != (isA? -ev.normal : ev.normal)
+			    || con.depth != ev.depth)
+			{
+				fail("%s contact %zu doesn't match event %zu", name, i, want[i].event);
+			}
+		}
+	};
+
+	check(ha, "a", {{0, true}, {2, true}, {3, true}, {4, false}});
+	check(hb, "b", {{0, false}, {1, true}, {3, false}});
+	check(tagged, "b (tagged)", {{0, false}, {1, true}, {3, false}});
+
+	if (ha->collided != std::vector<ecs::entity*> {b, nullptr, c}
+	    || hb->collided != std::vector<ecs::entity*> {a, c}
+	    || tagged->collided != std::vector<ecs::entity*> {c})
+	{
+		fail("wrong onCollision() calls");
+	}
+
+	// nothing to dispatch, no calls
+	system.dispatch(&manager, {});
+
+	if (ha->batches.size() != 1 || hb->batches.size() != 1) {
+		fail("handlers called without any events");
+	}
+}
+
+// pairs whose layers don't match are dropped before generating events,
+// tracked pairs go through begin, persist and end in either order
+static void testContactLayers(void) {
+	contactStream stream;
+	int objs[3];
+	auto obj = [&] (int i) { return reinterpret_cast<physicsObject*>(&objs[i]); };
+
+	auto contact = [&] (int i, int k, uint32_t layerA, uint32_t maskA,
+	                    uint32_t layerB, uint32_t maskB)
+	{
+		return stream.addContact(obj(i), obj(k), nullptr, nullptr,
+		                         layerA, maskA, layerB, maskB,
+		                         glm::vec3(0), glm::vec3(0), glm::vec3(0, 1, 0), 0.1f);
+	};
+
+	stream.beginStep();
+	bool accepted = contact(0, 1, 1, 1, 1, 1);
+	// neither is in the other's mask, then only one direction matches
+	bool disjoint = contact(1, 2, 1, 1, 2, 2);
+	bool oneWay   = contact(0, 2, 1, 3, 2, 2);
+	stream.endStep();
+
+	if (!accepted || disjoint || oneWay || stream.stats().filtered != 2) {
+		fail("wrong pairs filtered");
+	}
+
+	auto kinds = [&] {
+		std::vector<contactEvent::type> ret;
+		for (auto& ev : stream.acquire()) {
+			if ((ev.a != obj(0) && ev.b != obj(0)) || (ev.a != obj(1) && ev.b != obj(1))) {
+				fail("event for a filtered pair");
+			}
+
+			ret.push_back(ev.kind);
+		}
+
+		return ret;
+	};
+
+	if (kinds() != std::vector<contactEvent::type> {contactEvent::Begin}) {
+		fail("no begin event");
+	}
+
+	// same pair, other way around
+	stream.beginStep();
+	contact(1, 0, 1, 1, 1, 1);
+	stream.endStep();
+
+	if (kinds() != std::vector<contactEvent::type> {contactEvent::Persist}) {
+		fail("no persist event");
+	}
+
+	stream.beginStep();
+	stream.endStep();
+
+	if (kinds() != std::vector<contactEvent::type> {contactEvent::End}
+	    || stream.stats().activePairs != 0)
+	{
+		fail("no end event");
+	}
+}
+
+// links that get their target after construction, or a new one, keep
+// child indexes and flattened hierarchies up to date, as do renames
+static void testSceneLinks(void) {
+	ecs::entityManager manager;
+	sceneNode::ptr root   = manager.construct<sceneNode>();
+	sceneNode::ptr first  = manager.construct<sceneNode>();
+	sceneNode::ptr second = manager.construct<sceneNode>();
+	first->name  = "first";
+	second->name = "second";
+
+	// cache the index and hierarchy before there's a link
+	if (root->getNode("first") || root->flatten().entries.size() != 1) {
+		fail("empty node has children");
+	}
+
+	auto *link = root->attach<ecs::link<sceneNode>>();
+	link->setRef(first.getPtr());
+
+	if (root->flatten().indexOf(first.getPtr()) == sceneHierarchy::none
+	    || root->getNode("first").getPtr() != first.getPtr())
+	{
+		fail("target set after construction wasn't picked up");
+	}
+
+	link->setRef(second.getPtr());
+	auto& flat = root->flatten();
+
+	if (flat.indexOf(first.getPtr()) != sceneHierarchy::none
+	    || flat.indexOf(second.getPtr()) == sceneHierarchy::none
+	    || root->getNode("first")
+	    || root->getNode("second").getPtr() != second.getPtr())
+	{
+		fail("changed target wasn't picked up");
+	}
+
+	second->name = "renamed";
+	ecs::baseLink::renamed();
+
+	if (root->getNode("second")
+	    || root->getNode("renamed").getPtr() != second.getPtr())
+	{
+		fail("renamed child wasn't picked up");
+	}
+}
+
+// word and type searches, and cached results following renames, which
+// don't change the manager's generation
+static void testEntityList(void) {
+	ecs::entityManager manager;
+	std::vector<ecs::entity*> ents;
+
+	for (unsigned i = 0; i < 20; i++) {
+		auto ent = manager.construct<ecs::entity>();
+		ent->name = "Thing " + std::to_string(i);
+		if (i % 2 == 0) ent->attach<testTag>();
+		ents.push_back(ent);
+	}
+
+	ecs::entityListCache cache;
+	std::string typeSearch = demangle(getTypeName<testTag>()) + " thing 1";
+
+	// thing 1 and 10 to 19, and the even ones of those
+	if (cache.query(&manager, "thing 1").size() != 11
+	    || cache.query(&manager, typeSearch).size() != 5)
+	{
+		fail("wrong matches");
+	}
+
+	uint64_t generation = manager.generation;
+	ents[12]->name = "Barrel";
+	ecs::baseLink::renamed();
+
+	if (cache.query(&manager, typeSearch).size() != 4) {
+		fail("same search wasn't updated after a rename");
+	}
+
+	ents[3]->name = "Crate";
+	ecs::baseLink::renamed();
+	auto found = cache.query(&manager, "crate");
+
+	if (found.size() != 1 || found[0] != ents[3]
+	    || manager.generation != generation)
+	{
+		fail("renamed entity not found");
+	}
+}
+
+// getters return values set this frame until a step that applied them is
+// published, then the simulated state
+static void testPhysicsSetGet(void) {
+#if defined(PHYSICS_BULLET)
+	bulletPhysics phys;
+	auto snapshots = phys.getSnapshots();
+	auto obj = phys.addSphere(nullptr, glm::vec3(0), 1.f, 0.5f);
+
+	// sets are deferred to the next step, as with the physics thread
+	phys.setAsyncStepping(true);
+	phys.stepSimulation(1/60.f);
+	snapshots->acquire();
+
+	TRS t = obj->getTransform();
+	t.position = glm::vec3(0, 50, 0);
+	obj->setTransform(t);
+	obj->setVelocity(glm::vec3(1, 0, 0));
+
+	if (obj->getTransform().position != t.position
+	    || obj->getVelocity() != glm::vec3(1, 0, 0))
+	{
+		fail("get right after a set returned the old value");
+	}
+
+	// a snapshot published before the step that applies the sets, as if
+	// the physics thread had one ready at the start of the frame
+	snapshots->acquire();
+
+	if (obj->getTransform().position != t.position) {
+		fail("get returned a snapshot from before the set");
+	}
+
+	// long enough for a few substeps
+	phys.stepSimulation(0.1f);
+	snapshots->acquire();
+	glm::vec3 pos = obj->getTransform().position;
+
+	if (pos == t.position || glm::length(pos - t.position) > 1.f) {
+		fail("get didn't return the simulated position after a step");
+	}
+
+	phys.setAsyncStepping(false);
+
+#else
+	fprintf(stderr, "built without bullet, skipping\n");
+#endif
+}
+
+// keep in sync with the add_test() list in CMakeLists.txt
+static const struct {
+	const char *name;
+	void (*run)(void);
+} tests[] = {
+	{"meshOptimizer", testMeshOptimizer},
+	{"lodSelection", testLodSelection},
+	{"occlusionBudget", testOcclusionBudget},
+	{"probeScheduler", testProbeScheduler},
+	{"terrainSelection", testTerrainSelection},
+	{"voxelSerialization", testVoxelSerialization},
+	{"particleBounds", testParticleBounds},
+	{"particleEmitterSerialization", testParticleEmitterSerialization},
+	{"raycast", testRaycast},
+	{"textureCache", testTextureCache},
+	{"prefabInstancing", testPrefabInstancing},
+	{"replication", testReplication},
+	{"physicsQueries", testPhysicsQueries},
+	{"shapeCache", testShapeCache},
+	{"collisionDispatch", testCollisionDispatch},
+	{"contactLayers", testContactLayers},
+	{"sceneLinks", testSceneLinks},
+	{"entityList", testEntityList},
+	{"physicsSetGet", testPhysicsSetGet},
+};
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [--list] [test...]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+	std::vector<std::string> names;
+	bool list = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+
+		if (arg == "--list") {
+			list = true;
+
+		} else if (arg[0] == '-') {
+			usage(argv[0]);
+			return 1;
+
+		} else {
+			auto it = std::find_if(std::begin(tests), std::end(tests),
+			                       [&] (auto& t) { return arg == t.name; });
+
+			if (it == std::end(tests)) {
+				fprintf(stderr, "unknown test %s\n", arg.c_str());
+				return 1;
+			}
+
+			names.push_back(arg);
+		}
+	}
+
+	for (auto& t : tests) {
+		if (!names.empty()
+		    && std::find(names.begin(), names.end(), t.name) == names.end())
+		{
+			continue;
+		}
+
+		if (list) {
+			puts(t.name);
+			continue;
+		}
+
+		fprintf(stderr, "running %s...\n", t.name);
+		currentTest = t.name;
+		t.run();
+	}
+
+	return 0;
+}